@@ -0,0 +1,478 @@
+#include "Atmosphere.h"
+
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+
+// Ray march steps for each LUT's texels
+#define TRANSMITTANCE_STEPS 40
+#define MULTIPLE_SCATTERING_STEPS 20
+#define MULTIPLE_SCATTERING_DIRECTIONS 64
+#define SKY_VIEW_STEPS 32
+
+// Rows each background task computes
+#define ATMOSPHERE_ROWS_PER_TASK 4
+
+// Keeps rays that start on the ground from starting inside it
+#define GROUND_OFFSET 0.01f
+
+AtmosphereParameters GetEarthAtmosphere()
+{
+	AtmosphereParameters atmosphere = {};
+	atmosphere.BottomRadius = 6360.0f;
+	atmosphere.TopRadius = 6460.0f;
+	atmosphere.ViewerAltitude = 0.2f;
+	atmosphere.RayleighScattering = XMFLOAT3(0.005802f, 0.013558f, 0.0331f);
+	atmosphere.RayleighScaleHeight = 8.0f;
+	atmosphere.MieScattering = 0.003996f;
+	atmosphere.MieAbsorption = 0.000444f;
+	atmosphere.MieScaleHeight = 1.2f;
+	atmosphere.MieAnisotropy = 0.8f;
+	atmosphere.OzoneAbsorption = XMFLOAT3(0.00065f, 0.001881f, 0.000085f);
+	atmosphere.OzoneCenterAltitude = 25.0f;
+	atmosphere.OzoneWidth = 30.0f;
+	atmosphere.GroundAlbedo = XMFLOAT3(0.3f, 0.3f, 0.3f);
+	return atmosphere;
+}
+
+// Nothing but floats, so comparing the bytes compares every member
+static_assert(sizeof(AtmosphereParameters) % sizeof(float) == 0);
+
+bool operator==(const AtmosphereParameters& a, const AtmosphereParameters& b)
+{
+	return memcmp(&a, &b, sizeof(AtmosphereParameters)) == 0;
+}
+
+bool operator!=(const AtmosphereParameters& a, const AtmosphereParameters& b)
+{
+	return !(a == b);
+}
+
+// --------------------------------------------------------
+// Geometry - a point in the atmosphere is its distance from
+// the planet's center (r), and a direction from it is the
+// cosine of its angle from straight up (mu)
+// --------------------------------------------------------
+
+static float DistanceToTop(const AtmosphereParameters& atmosphere, float r, float mu)
+{
+	float discriminant = r * r * (mu * mu - 1.0f) + atmosphere.TopRadius * atmosphere.TopRadius;
+	return fmaxf(-r * mu + sqrtf(fmaxf(discriminant, 0.0f)), 0.0f);
+}
+
+static bool RayIntersectsGround(const AtmosphereParameters& atmosphere, float r, float mu)
+{
+	return mu < 0.0f && r * r * (mu * mu - 1.0f) + atmosphere.BottomRadius * atmosphere.BottomRadius >= 0.0f;
+}
+
+static float DistanceToGround(const AtmosphereParameters& atmosphere, float r, float mu)
+{
+	float discriminant = r * r * (mu * mu - 1.0f) + atmosphere.BottomRadius * atmosphere.BottomRadius;
+	return fmaxf(-r * mu - sqrtf(fmaxf(discriminant, 0.0f)), 0.0f);
+}
+
+// How far a ray goes before leaving the atmosphere or hitting the ground
+static float DistanceToBoundary(const AtmosphereParameters& atmosphere, float r, float mu, bool& hitsGround)
+{
+	hitsGround = RayIntersectsGround(atmosphere, r, mu);
+	return hitsGround ? DistanceToGround(atmosphere, r, mu) : DistanceToTop(atmosphere, r, mu);
+}
+
+// --------------------------------------------------------
+// The medium at an altitude
+// --------------------------------------------------------
+struct AtmosphereMedium
+{
+	XMVECTOR RayleighScattering;
+	XMVECTOR MieScattering;
+	XMVECTOR Extinction;
+};
+
+static AtmosphereMedium SampleMedium(const AtmosphereParameters& atmosphere, float altitude)
+{
+	float rayleighDensity = expf(-altitude / atmosphere.RayleighScaleHeight);
+	float mieDensity = expf(-altitude / atmosphere.MieScaleHeight);
+	float ozoneDensity = fmaxf(1.0f - fabsf(altitude - atmosphere.OzoneCenterAltitude) / (atmosphere.OzoneWidth * 0.5f), 0.0f);
+
+	AtmosphereMedium medium;
+	medium.RayleighScattering = XMLoadFloat3(&atmosphere.RayleighScattering) * rayleighDensity;
+	medium.MieScattering = XMVectorReplicate(atmosphere.MieScattering * mieDensity);
+	medium.Extinction = medium.RayleighScattering + medium.MieScattering +
+		XMVectorReplicate(atmosphere.MieAbsorption * mieDensity) +
+		XMLoadFloat3(&atmosphere.OzoneAbsorption) * ozoneDensity;
+
+	// Only empty if every coefficient is zero, but it's divided by
+	medium.Extinction = XMVectorMax(medium.Extinction, XMVectorReplicate(1e-9f));
+	return medium;
+}
+
+// --------------------------------------------------------
+// LUT lookups.  Texel centers run from 0 to 1 inclusive, so
+// both ends of each range land exactly on a texel.
+// --------------------------------------------------------
+
+static XMVECTOR SampleLUT(const std::vector<XMFLOAT4>& lut, unsigned int width, unsigned int height, float x, float y)
+{
+	float fx = fminf(fmaxf(x, 0.0f), 1.0f) * (width - 1);
+	float fy = fminf(fmaxf(y, 0.0f), 1.0f) * (height - 1);
+	unsigned int x0 = (unsigned int)fx;
+	unsigned int y0 = (unsigned int)fy;
+	unsigned int x1 = x0 + 1 < width ? x0 + 1 : x0;
+	unsigned int y1 = y0 + 1 < height ? y0 + 1 : y0;
+
+	XMVECTOR top = XMVectorLerp(XMLoadFloat4(&lut[y0 * width + x0]), XMLoadFloat4(&lut[y0 * width + x1]), fx - x0);
+	XMVECTOR bottom = XMVectorLerp(XMLoadFloat4(&lut[y1 * width + x0]), XMLoadFloat4(&lut[y1 * width + x1]), fx - x0);
+	return XMVectorLerp(top, bottom, fy - y0);
+}
+
+static void GetTransmittanceCoordinates(const AtmosphereParameters& atmosphere, float r, float mu, float& x, float& y)
+{
+	float H = sqrtf(atmosphere.TopRadius * atmosphere.TopRadius - atmosphere.BottomRadius * atmosphere.BottomRadius);
+	float rho = sqrtf(fmaxf(r * r - atmosphere.BottomRadius * atmosphere.BottomRadius, 0.0f));
+	float dMin = atmosphere.TopRadius - r;
+	float dMax = rho + H;
+	x = (DistanceToTop(atmosphere, r, mu) - dMin) / (dMax - dMin);
+	y = rho / H;
+}
+
+static XMVECTOR SampleTransmittance(const AtmosphereParameters& atmosphere, const AtmosphereLUTs& luts, float r, float mu)
+{
+	float x, y;
+	GetTransmittanceCoordinates(atmosphere, r, mu, x, y);
+	return SampleLUT(luts.Transmittance, TRANSMITTANCE_LUT_WIDTH, TRANSMITTANCE_LUT_HEIGHT, x, y);
+}
+
+// Transmittance to the sun, which is zero once the planet's in the way
+static XMVECTOR SampleSunTransmittance(const AtmosphereParameters& atmosphere, const AtmosphereLUTs& luts, float r, float muSun)
+{
+	if (RayIntersectsGround(atmosphere, r, muSun))
+		return XMVectorZero();
+	return SampleTransmittance(atmosphere, luts, r, muSun);
+}
+
+static XMVECTOR SampleMultipleScattering(const AtmosphereParameters& atmosphere, const AtmosphereLUTs& luts, float r, float muSun)
+{
+	float x = muSun * 0.5f + 0.5f;
+	float y = (r - atmosphere.BottomRadius) / (atmosphere.TopRadius - atmosphere.BottomRadius);
+	return SampleLUT(luts.MultipleScattering, MULTIPLE_SCATTERING_LUT_SIZE, MULTIPLE_SCATTERING_LUT_SIZE, x, y);
+}
+
+// --------------------------------------------------------
+// Phase functions
+// --------------------------------------------------------
+
+static float RayleighPhase(float cosTheta)
+{
+	return 3.0f / (16.0f * XM_PI) * (1.0f + cosTheta * cosTheta);
+}
+
+static float CornetteShanksPhase(float g, float cosTheta)
+{
+	float k = 3.0f / (8.0f * XM_PI) * (1.0f - g * g) / (2.0f + g * g);
+	float denominator = 1.0f + g * g - 2.0f * g * cosTheta;
+	return k * (1.0f + cosTheta * cosTheta) / (denominator * sqrtf(denominator));
+}
+
+// --------------------------------------------------------
+// The LUTs
+// --------------------------------------------------------
+
+void ResizeAtmosphereLUTs(AtmosphereLUTs& luts)
+{
+	luts.Transmittance.resize(TRANSMITTANCE_LUT_WIDTH * TRANSMITTANCE_LUT_HEIGHT);
+	luts.MultipleScattering.resize(MULTIPLE_SCATTERING_LUT_SIZE * MULTIPLE_SCATTERING_LUT_SIZE);
+	luts.SkyView.resize(SKY_VIEW_LUT_WIDTH * SKY_VIEW_LUT_HEIGHT);
+}
+
+void ComputeTransmittanceRow(const AtmosphereParameters& atmosphere, unsigned int row, AtmosphereLUTs& luts)
+{
+	// The inverse of GetTransmittanceCoordinates()
+	float H = sqrtf(atmosphere.TopRadius * atmosphere.TopRadius - atmosphere.BottomRadius * atmosphere.BottomRadius);
+	float rho = H * row / (TRANSMITTANCE_LUT_HEIGHT - 1);
+	float r = sqrtf(rho * rho + atmosphere.BottomRadius * atmosphere.BottomRadius);
+	float dMin = atmosphere.TopRadius - r;
+	float dMax = rho + H;
+
+	for (unsigned int col = 0; col < TRANSMITTANCE_LUT_WIDTH; col++)
+	{
+		float d = dMin + (dMax - dMin) * col / (TRANSMITTANCE_LUT_WIDTH - 1);
+		float mu = d == 0.0f ? 1.0f : (H * H - rho * rho - d * d) / (2.0f * r * d);
+		mu = fminf(fmaxf(mu, -1.0f), 1.0f);
+
+		// Optical depth along the ray, out to the top of the atmosphere
+		float length = DistanceToTop(atmosphere, r, mu);
+		float dt = length / TRANSMITTANCE_STEPS;
+		XMVECTOR opticalDepth = XMVectorZero();
+		for (unsigned int i = 0; i < TRANSMITTANCE_STEPS; i++)
+		{
+			float t = (i + 0.5f) * dt;
+			float altitude = sqrtf(r * r + t * t + 2.0f * r * mu * t) - atmosphere.BottomRadius;
+			opticalDepth += SampleMedium(atmosphere, altitude).Extinction * dt;
+		}
+
+		XMStoreFloat4(&luts.Transmittance[row * TRANSMITTANCE_LUT_WIDTH + col], XMVectorSetW(XMVectorExpE(-opticalDepth), 1.0f));
+	}
+}
+
+void ComputeMultipleScatteringRow(const AtmosphereParameters& atmosphere, unsigned int row, AtmosphereLUTs& luts)
+{
+	float r = atmosphere.BottomRadius + fmaxf((atmosphere.TopRadius - atmosphere.BottomRadius) * row / (MULTIPLE_SCATTERING_LUT_SIZE - 1), GROUND_OFFSET);
+	const float isotropicPhase = 1.0f / (4.0f * XM_PI);
+	XMVECTOR groundAlbedo = XMLoadFloat3(&atmosphere.GroundAlbedo);
+
+	for (unsigned int col = 0; col < MULTIPLE_SCATTERING_LUT_SIZE; col++)
+	{
+		float muSun = 2.0f * col / (MULTIPLE_SCATTERING_LUT_SIZE - 1) - 1.0f;
+		XMVECTOR sun = XMVectorSet(sqrtf(fmaxf(1.0f - muSun * muSun, 0.0f)), muSun, 0.0f, 0.0f);
+		XMVECTOR origin = XMVectorSet(0.0f, r, 0.0f, 0.0f);
+
+		// Light scattered toward the point once more (after reaching every
+		// point around it directly from the sun, or off the ground), and the
+		// fraction of light an isotropic medium sends back to where it came
+		// from - every higher order is that fraction again, so they sum to
+		// a geometric series.  Directions are a spherical Fibonacci set.
+		XMVECTOR secondOrder = XMVectorZero();
+		XMVECTOR transfer = XMVectorZero();
+		for (unsigned int dir = 0; dir < MULTIPLE_SCATTERING_DIRECTIONS; dir++)
+		{
+			float y = 1.0f - (2.0f * dir + 1.0f) / MULTIPLE_SCATTERING_DIRECTIONS;
+			float ring = sqrtf(fmaxf(1.0f - y * y, 0.0f));
+			float angle = dir * XM_PI * (3.0f - sqrtf(5.0f));
+			XMVECTOR direction = XMVectorSet(ring * cosf(angle), y, ring * sinf(angle), 0.0f);
+
+			bool hitsGround;
+			float length = DistanceToBoundary(atmosphere, r, y, hitsGround);
+			float dt = length / MULTIPLE_SCATTERING_STEPS;
+
+			XMVECTOR transmittance = XMVectorSplatOne();
+			for (unsigned int i = 0; i < MULTIPLE_SCATTERING_STEPS; i++)
+			{
+				XMVECTOR position = origin + direction * ((i + 0.5f) * dt);
+				float pointR = XMVectorGetX(XMVector3Length(position));
+				float pointMuSun = XMVectorGetX(XMVector3Dot(position, sun)) / pointR;
+
+				AtmosphereMedium medium = SampleMedium(atmosphere, pointR - atmosphere.BottomRadius);
+				XMVECTOR scattering = medium.RayleighScattering + medium.MieScattering;
+				XMVECTOR stepTransmittance = XMVectorExpE(-medium.Extinction * dt);
+
+				// Each source term integrated exactly over the step
+				XMVECTOR inScattering = scattering * SampleSunTransmittance(atmosphere, luts, pointR, pointMuSun) * isotropicPhase;
+				secondOrder += transmittance * (inScattering - inScattering * stepTransmittance) / medium.Extinction;
+				transfer += transmittance * (scattering - scattering * stepTransmittance) / medium.Extinction;
+				transmittance *= stepTransmittance;
+			}
+
+			// Lambertian ground
+			if (hitsGround)
+			{
+				XMVECTOR normal = XMVector3Normalize(origin + direction * length);
+				float normalDotSun = XMVectorGetX(XMVector3Dot(normal, sun));
+				if (normalDotSun > 0.0f)
+				{
+					secondOrder += transmittance * SampleSunTransmittance(atmosphere, luts, atmosphere.BottomRadius, normalDotSun) *
+						groundAlbedo * (normalDotSun / XM_PI);
+				}
+			}
+		}
+
+		secondOrder /= (float)MULTIPLE_SCATTERING_DIRECTIONS;
+		transfer /= (float)MULTIPLE_SCATTERING_DIRECTIONS;
+		XMVECTOR allOrders = secondOrder / (XMVectorSplatOne() - XMVectorMin(transfer, XMVectorReplicate(0.999f)));
+
+		XMStoreFloat4(&luts.MultipleScattering[row * MULTIPLE_SCATTERING_LUT_SIZE + col], XMVectorSetW(allOrders, 1.0f));
+	}
+}
+
+void ComputeSkyViewRow(const AtmosphereParameters& atmosphere, float sunCosZenith, unsigned int row, AtmosphereLUTs& luts)
+{
+	// Rows are squeezed toward the horizon, where the sky changes fastest
+	float v = 2.0f * row / (SKY_VIEW_LUT_HEIGHT - 1) - 1.0f;
+	float elevation = (v < 0.0f ? -v * v : v * v) * XM_PIDIV2;
+
+	float r = atmosphere.BottomRadius + fmaxf(atmosphere.ViewerAltitude, GROUND_OFFSET);
+	XMVECTOR origin = XMVectorSet(0.0f, r, 0.0f, 0.0f);
+
+	// The sun is at azimuth 0
+	sunCosZenith = fminf(fmaxf(sunCosZenith, -1.0f), 1.0f);
+	XMVECTOR sun = XMVectorSet(sqrtf(1.0f - sunCosZenith * sunCosZenith), sunCosZenith, 0.0f, 0.0f);
+
+	for (unsigned int col = 0; col < SKY_VIEW_LUT_WIDTH; col++)
+	{
+		float azimuth = XM_PI * col / (SKY_VIEW_LUT_WIDTH - 1);
+		XMVECTOR direction = XMVectorSet(cosf(elevation) * cosf(azimuth), sinf(elevation), cosf(elevation) * sinf(azimuth), 0.0f);
+
+		float cosTheta = XMVectorGetX(XMVector3Dot(direction, sun));
+		float rayleighPhase = RayleighPhase(cosTheta);
+		float miePhase = CornetteShanksPhase(atmosphere.MieAnisotropy, cosTheta);
+
+		// Steps get longer with distance, since most of the light comes from close by
+		bool hitsGround;
+		float length = DistanceToBoundary(atmosphere, r, sinf(elevation), hitsGround);
+
+		XMVECTOR luminance = XMVectorZero();
+		XMVECTOR transmittance = XMVectorSplatOne();
+		for (unsigned int i = 0; i < SKY_VIEW_STEPS; i++)
+		{
+			float start = (float)i / SKY_VIEW_STEPS;
+			float end = (float)(i + 1) / SKY_VIEW_STEPS;
+			float t0 = start * start * length;
+			float t1 = end * end * length;
+			float dt = t1 - t0;
+
+			XMVECTOR position = origin + direction * ((t0 + t1) * 0.5f);
+			float pointR = XMVectorGetX(XMVector3Length(position));
+			float pointMuSun = XMVectorGetX(XMVector3Dot(position, sun)) / pointR;
+
+			AtmosphereMedium medium = SampleMedium(atmosphere, pointR - atmosphere.BottomRadius);
+			XMVECTOR sunTransmittance = SampleSunTransmittance(atmosphere, luts, pointR, pointMuSun);
+			XMVECTOR multipleScattering = SampleMultipleScattering(atmosphere, luts, pointR, pointMuSun);
+			XMVECTOR stepTransmittance = XMVectorExpE(-medium.Extinction * dt);
+
+			XMVECTOR inScattering =
+				medium.RayleighScattering * (sunTransmittance * rayleighPhase + multipleScattering) +
+				medium.MieScattering * (sunTransmittance * miePhase + multipleScattering);
+			luminance += transmittance * (inScattering - inScattering * stepTransmittance) / medium.Extinction;
+			transmittance *= stepTransmittance;
+		}
+
+		XMStoreFloat4(&luts.SkyView[row * SKY_VIEW_LUT_WIDTH + col], XMVectorSetW(luminance, 1.0f));
+	}
+}
+
+void ComputeAtmosphereLUTs(const AtmosphereParameters& atmosphere, float sunCosZenith, bool scattering,
+	ThreadPool& threadPool, AtmosphereLUTs& luts)
+{
+	ResizeAtmosphereLUTs(luts);
+
+	if (scattering)
+	{
+		threadPool.ParallelFor(TRANSMITTANCE_LUT_HEIGHT, [&](unsigned int row)
+		{
+			ComputeTransmittanceRow(atmosphere, row, luts);
+		});
+		threadPool.ParallelFor(MULTIPLE_SCATTERING_LUT_SIZE, [&](unsigned int row)
+		{
+			ComputeMultipleScatteringRow(atmosphere, row, luts);
+		});
+	}
+
+	threadPool.ParallelFor(SKY_VIEW_LUT_HEIGHT, [&](unsigned int row)
+	{
+		ComputeSkyViewRow(atmosphere, sunCosZenith, row, luts);
+	});
+}
+
+// --------------------------------------------------------
+// Background baking
+// --------------------------------------------------------
+
+AtmosphereBaker::AtmosphereBaker(std::shared_ptr<ThreadPool> threadPool) :
+	m_threadPool(threadPool),
+	m_lutAtmosphere(),
+	m_hasLUTs(false),
+	m_scatteringChanged(false),
+	m_bakeTime(0.0f),
+	m_atmosphere(),
+	m_sunCosZenith(0.0f),
+	m_bakingScattering(false),
+	m_running(false),
+	m_tasksLeft(0)
+{
+	ResizeAtmosphereLUTs(m_baking);
+}
+
+AtmosphereBaker::~AtmosphereBaker()
+{
+	// The bake's tasks write into this
+	while (m_running.load())
+	{
+		std::this_thread::yield();
+	}
+}
+
+bool AtmosphereBaker::Update(const AtmosphereParameters& atmosphere, float sunCosZenith)
+{
+	if (m_running.load())
+		return false;
+
+	// Hand over the bake that just finished, if there is one
+	bool finished = m_bakeEnd > m_bakeStart;
+	if (finished)
+	{
+		if (m_bakingScattering)
+			m_luts = m_baking;
+		else
+			m_luts.SkyView = m_baking.SkyView;
+
+		std::chrono::duration<float, std::milli> elapsed = m_bakeEnd - m_bakeStart;
+		m_bakeTime = elapsed.count();
+		m_lutAtmosphere = m_atmosphere;
+		m_scatteringChanged = m_bakingScattering;
+		m_hasLUTs = true;
+		m_bakeStart = m_bakeEnd;
+	}
+
+	// Start the next one.  The transmittance and multiple scattering from
+	// the last bake are still in m_baking, for the sky view to read.
+	bool scattering = !m_hasLUTs || atmosphere != m_atmosphere;
+	if (scattering || sunCosZenith != m_sunCosZenith)
+	{
+		m_atmosphere = atmosphere;
+		m_sunCosZenith = sunCosZenith;
+		m_bakingScattering = scattering;
+		m_bakeStart = std::chrono::high_resolution_clock::now();
+		m_running = true;
+		SubmitStage(scattering ? 0 : 2);
+	}
+
+	return finished;
+}
+
+void AtmosphereBaker::SubmitStage(unsigned int stage)
+{
+	static const unsigned int stageRows[] = { TRANSMITTANCE_LUT_HEIGHT, MULTIPLE_SCATTERING_LUT_SIZE, SKY_VIEW_LUT_HEIGHT };
+
+	unsigned int rows = stageRows[stage];
+	unsigned int tasks = (rows + ATMOSPHERE_ROWS_PER_TASK - 1) / ATMOSPHERE_ROWS_PER_TASK;
+	m_tasksLeft = tasks;
+
+	// Each stage reads the ones before, so the last of its tasks to
+	// finish queues the next (ParallelFor() can't be used from a task)
+	for (unsigned int task = 0; task < tasks; task++)
+	{
+		m_threadPool->Submit([this, stage, rows, task]()
+		{
+			unsigned int end = (task + 1) * ATMOSPHERE_ROWS_PER_TASK;
+			for (unsigned int row = task * ATMOSPHERE_ROWS_PER_TASK; row < end && row < rows; row++)
+			{
+				switch (stage)
+				{
+				case 0: ComputeTransmittanceRow(m_atmosphere, row, m_baking); break;
+				case 1: ComputeMultipleScatteringRow(m_atmosphere, row, m_baking); break;
+				default: ComputeSkyViewRow(m_atmosphere, m_sunCosZenith, row, m_baking); break;
+				}
+			}
+
+			if (--m_tasksLeft > 0)
+				return;
+
+			if (stage < 2)
+			{
+				SubmitStage(stage + 1);
+				return;
+			}
+
+			m_bakeEnd = std::chrono::high_resolution_clock::now();
+			m_running = false;
+		});
+	}
+}
+
+bool AtmosphereBaker::HasLUTs() const { return m_hasLUTs; }
+const AtmosphereLUTs& AtmosphereBaker::GetLUTs() const { return m_luts; }
+const AtmosphereParameters& AtmosphereBaker::GetAtmosphere() const { return m_lutAtmosphere; }
+bool AtmosphereBaker::ScatteringChanged() const { return m_scatteringChanged; }
+bool AtmosphereBaker::IsBaking() const { return m_running.load(); }
+float AtmosphereBaker::GetBakeTime() const { return m_bakeTime; }
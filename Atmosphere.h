@@ -0,0 +1,142 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// LUT sizes - must match the ATMOSPHERE_ defines in ShaderIncludes.hlsli
+#define TRANSMITTANCE_LUT_WIDTH 256 // View zenith angle
+#define TRANSMITTANCE_LUT_HEIGHT 64 // Altitude
+#define MULTIPLE_SCATTERING_LUT_SIZE 32 // Sun zenith angle across, altitude down
+#define SKY_VIEW_LUT_WIDTH 192 // Azimuth from the sun, 0 to pi
+#define SKY_VIEW_LUT_HEIGHT 108 // Elevation, -pi/2 to pi/2, squeezed toward the horizon
+
+// --------------------------------------------------------
+// A planet's atmosphere, for the procedural sky.  Distances
+// are in kilometers, and scattering and absorption are per
+// kilometer at the ground.
+// --------------------------------------------------------
+struct AtmosphereParameters
+{
+	float BottomRadius; // The ground
+	float TopRadius; // Where the atmosphere ends
+	float ViewerAltitude; // Where the sky is seen from, above the ground
+
+	DirectX::XMFLOAT3 RayleighScattering;
+	float RayleighScaleHeight; // Density falls off exponentially with altitude
+
+	float MieScattering;
+	float MieAbsorption;
+	float MieScaleHeight;
+	float MieAnisotropy; // Cornette-Shanks g, 0 to 1 (forward)
+
+	DirectX::XMFLOAT3 OzoneAbsorption;
+	float OzoneCenterAltitude; // Ozone density is a tent, 1 at the center
+	float OzoneWidth;
+
+	DirectX::XMFLOAT3 GroundAlbedo;
+};
+
+// The Earth, with the values from Hillaire's paper
+AtmosphereParameters GetEarthAtmosphere();
+
+bool operator==(const AtmosphereParameters& a, const AtmosphereParameters& b);
+bool operator!=(const AtmosphereParameters& a, const AtmosphereParameters& b);
+
+// --------------------------------------------------------
+// The LUTs the procedural sky is drawn from (Hillaire, "A
+// Scalable and Production Ready Sky and Atmosphere Rendering
+// Technique"), all linear RGB in RGBA float texels:
+//
+//  - Transmittance to the top of the atmosphere, by altitude
+//    and view zenith angle (Bruneton's parameterization)
+//  - Multiple scattering, as the light an isotropic medium
+//    would add at each altitude and sun zenith angle, summed
+//    over every order of scattering at once
+//  - The sky as seen from the viewer, by elevation and
+//    azimuth from the sun, for a sun of illuminance 1
+//
+// The first two only depend on the atmosphere, and the sky
+// view only on the atmosphere and the sun's zenith angle -
+// the sun's azimuth is a rotation in the shader.  Rows are
+// independent, so each can go to its own thread.  Nothing
+// in here touches Direct3D.
+// --------------------------------------------------------
+struct AtmosphereLUTs
+{
+	std::vector<DirectX::XMFLOAT4> Transmittance;
+	std::vector<DirectX::XMFLOAT4> MultipleScattering;
+	std::vector<DirectX::XMFLOAT4> SkyView;
+};
+
+// Sizes the LUTs, for the row functions below
+void ResizeAtmosphereLUTs(AtmosphereLUTs& luts);
+
+// One row of each LUT.  Multiple scattering reads the transmittance LUT,
+// and the sky view reads both.
+void ComputeTransmittanceRow(const AtmosphereParameters& atmosphere, unsigned int row, AtmosphereLUTs& luts);
+void ComputeMultipleScatteringRow(const AtmosphereParameters& atmosphere, unsigned int row, AtmosphereLUTs& luts);
+void ComputeSkyViewRow(const AtmosphereParameters& atmosphere, float sunCosZenith, unsigned int row, AtmosphereLUTs& luts);
+
+// Computes the LUTs with ParallelFor(), waiting until they're done.
+// scattering - false to only redo the sky view (the others must be there)
+void ComputeAtmosphereLUTs(const AtmosphereParameters& atmosphere, float sunCosZenith, bool scattering,
+	ThreadPool& threadPool, AtmosphereLUTs& luts);
+
+// --------------------------------------------------------
+// Bakes the atmosphere's LUTs in the background, as tasks on
+// the thread pool, so moving the sun never stalls a frame:
+//
+//   // Every frame
+//   if (baker.Update(atmosphere, sunDirection.y))
+//       Upload(baker.GetLUTs());
+//
+// Only one bake runs at a time, and a new one only starts
+// once the inputs differ from the last bake's.  If only the
+// sun's zenith angle changed, only the sky view is baked.
+// --------------------------------------------------------
+class AtmosphereBaker
+{
+public:
+	AtmosphereBaker(std::shared_ptr<ThreadPool> threadPool);
+	~AtmosphereBaker(); // Waits for a running bake
+	AtmosphereBaker(const AtmosphereBaker&) = delete;
+	AtmosphereBaker& operator=(const AtmosphereBaker&) = delete;
+
+	// Returns true when a bake has just finished, so GetLUTs() changed.
+	// Starts the next bake if the inputs changed and none is running.
+	bool Update(const AtmosphereParameters& atmosphere, float sunCosZenith);
+
+	bool HasLUTs() const; // At least one bake has finished
+	const AtmosphereLUTs& GetLUTs() const; // From the last finished bake
+	const AtmosphereParameters& GetAtmosphere() const; // What the last finished bake used
+	bool ScatteringChanged() const; // Whether the last finished bake redid transmittance and multiple scattering
+	bool IsBaking() const;
+	float GetBakeTime() const; // Milliseconds the last finished bake took
+
+private:
+	std::shared_ptr<ThreadPool> m_threadPool;
+
+	AtmosphereLUTs m_luts;
+	AtmosphereParameters m_lutAtmosphere;
+	bool m_hasLUTs;
+	bool m_scatteringChanged;
+	float m_bakeTime;
+
+	// The running (or last) bake, only written by its tasks while running
+	AtmosphereLUTs m_baking;
+	AtmosphereParameters m_atmosphere;
+	float m_sunCosZenith;
+	bool m_bakingScattering;
+	std::atomic<bool> m_running;
+	std::atomic<unsigned int> m_tasksLeft; // In the current stage
+	std::chrono::high_resolution_clock::time_point m_bakeStart;
+	std::chrono::high_resolution_clock::time_point m_bakeEnd;
+
+	// Queues one LUT's rows, and the next stage after its last task
+	void SubmitStage(unsigned int stage);
+};
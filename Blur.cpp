@@ -0,0 +1,314 @@
+#include "Blur.h"
+
+#include <DirectXMath.h>
+#include <cmath>
+#include <cstdlib>
+
+using namespace DirectX;
+
+static const char* BLUR_MODE_NAMES[(int)BlurMode::Count] = {
+	"Box",
+	"Separable",
+	"Sliding window",
+	"Dual filter" };
+
+const char* GetBlurModeName(BlurMode mode)
+{
+	return mode >= BlurMode::Box && mode < BlurMode::Count ? BLUR_MODE_NAMES[(int)mode] : "Unknown";
+}
+
+unsigned int GetDualFilterLevels(int radius)
+{
+	// Each level doubles how far the filter reaches, and a single
+	// down and up already covers a radius of about 1
+	unsigned int levels = 0;
+	while (levels < MAX_BLUR_LEVELS && (1 << levels) <= radius)
+		levels++;
+	return levels;
+}
+
+unsigned int GetBlurLevelSize(unsigned int size, unsigned int level)
+{
+	unsigned int levelSize = size >> (level + 1);
+	return levelSize > 0 ? levelSize : 1;
+}
+
+float GetBlurSamplesPerPixel(BlurMode mode, int radius, unsigned int width, unsigned int height)
+{
+	if (radius <= 0 || width == 0 || height == 0)
+		return 1.0f; // Just a copy
+
+	float taps = 2.0f * radius + 1.0f;
+	switch (mode)
+	{
+	case BlurMode::Box:
+		return taps * taps;
+
+	case BlurMode::Separable:
+		return 2.0f * taps;
+
+	case BlurMode::SlidingWindow:
+		// Each row or column reads a full window to start, then
+		// one texel in and one out per pixel
+		return (taps + 2.0f * (width - 1)) / width + (taps + 2.0f * (height - 1)) / height;
+
+	case BlurMode::DualFilter:
+	{
+		// 5 taps per pixel on the way down, 8 on the way up, by level area
+		float fullArea = (float)width * height;
+		unsigned int levels = GetDualFilterLevels(radius);
+		float samples = 8.0f;
+		for (unsigned int i = 0; i < levels; i++)
+		{
+			float area = (float)GetBlurLevelSize(width, i) * GetBlurLevelSize(height, i) / fullArea;
+			samples += 5.0f * area;
+			if (i + 1 < levels)
+				samples += 8.0f * area;
+		}
+		return samples;
+	}
+
+	default:
+		return 0.0f;
+	}
+}
+
+// A texel's byte values, clamped to the edges like the GPU's reads
+static XMVECTOR LoadBytes(const MipLevel& image, int x, int y)
+{
+	x = x < 0 ? 0 : (x >= (int)image.Width ? (int)image.Width - 1 : x);
+	y = y < 0 ? 0 : (y >= (int)image.Height ? (int)image.Height - 1 : y);
+	const unsigned char* texel = &image.Pixels[((size_t)y * image.Width + x) * 4];
+	return XMVectorSet(texel[0], texel[1], texel[2], texel[3]);
+}
+
+// Writes a 0 to 1 color the way a UNORM render target would
+static void StoreColor(MipLevel& image, unsigned int x, unsigned int y, XMVECTOR color)
+{
+	XMFLOAT4 bytes;
+	XMStoreFloat4(&bytes, XMVectorRound(XMVectorSaturate(color) * XMVectorReplicate(255.0f)));
+
+	unsigned char* texel = &image.Pixels[((size_t)y * image.Width + x) * 4];
+	texel[0] = (unsigned char)bytes.x;
+	texel[1] = (unsigned char)bytes.y;
+	texel[2] = (unsigned char)bytes.z;
+	texel[3] = (unsigned char)bytes.w;
+}
+
+// The shaders' box average - whole byte values are summed exactly,
+// then divided once
+static void StoreAverage(MipLevel& image, unsigned int x, unsigned int y, XMVECTOR byteSum, unsigned int count)
+{
+	StoreColor(image, x, y, byteSum / (255.0f * count));
+}
+
+static MipLevel CreateImage(unsigned int width, unsigned int height)
+{
+	MipLevel image = {};
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.resize((size_t)width * height * 4);
+	return image;
+}
+
+// The full (2r+1)^2 box.  The sums are whole numbers, so adding
+// rows of the box first gives exactly what the shader's loop does.
+static void BoxBlur(const MipLevel& source, MipLevel& dest, int radius, ThreadPool& threadPool)
+{
+	unsigned int width = source.Width;
+	std::vector<XMFLOAT4> rowSums((size_t)width * source.Height);
+	threadPool.ParallelFor(source.Height, [&](unsigned int y)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for (int dx = -radius; dx <= radius; dx++)
+				sum += LoadBytes(source, x + dx, y);
+			XMStoreFloat4(&rowSums[(size_t)y * width + x], sum);
+		}
+	});
+
+	int lastRow = (int)source.Height - 1;
+	unsigned int count = (2 * radius + 1) * (2 * radius + 1);
+	threadPool.ParallelFor(source.Height, [&](unsigned int y)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for (int dy = -radius; dy <= radius; dy++)
+			{
+				int row = (int)y + dy;
+				row = row < 0 ? 0 : (row > lastRow ? lastRow : row);
+				sum += XMLoadFloat4(&rowSums[(size_t)row * width + x]);
+			}
+			StoreAverage(dest, x, y, sum, count);
+		}
+	});
+}
+
+// One axis of the box, one row (or column) per job.  slidingWindow
+// keeps a running sum like blurSlidingCS does, instead of summing
+// the whole window for every texel like blurPS does - with whole
+// numbers, both give the same result.
+static void BoxBlurAxis(const MipLevel& source, MipLevel& dest, int radius, bool vertical, bool slidingWindow, ThreadPool& threadPool)
+{
+	unsigned int lines = vertical ? source.Width : source.Height;
+	unsigned int length = vertical ? source.Height : source.Width;
+	unsigned int count = 2 * radius + 1;
+
+	threadPool.ParallelFor(lines, [&](unsigned int line)
+	{
+		auto texel = [&](int i) { return vertical ? LoadBytes(source, line, i) : LoadBytes(source, i, line); };
+
+		XMVECTOR sum = XMVectorZero();
+		if (slidingWindow)
+		{
+			for (int i = -radius; i <= radius; i++)
+				sum += texel(i);
+		}
+
+		for (unsigned int i = 0; i < length; i++)
+		{
+			if (!slidingWindow)
+			{
+				sum = XMVectorZero();
+				for (int d = -radius; d <= radius; d++)
+					sum += texel((int)i + d);
+			}
+
+			if (vertical)
+				StoreAverage(dest, line, i, sum, count);
+			else
+				StoreAverage(dest, i, line, sum, count);
+
+			// Slide the window along: one texel in, one out
+			if (slidingWindow)
+				sum += texel((int)i + radius + 1) - texel((int)i - radius);
+		}
+	});
+}
+
+// Bilinear filtering with clamped addressing, like ppSampler
+static XMVECTOR SampleBilinear(const MipLevel& image, float u, float v)
+{
+	float x = u * image.Width - 0.5f;
+	float y = v * image.Height - 0.5f;
+	float left = floorf(x);
+	float top = floorf(y);
+	int ix = (int)left;
+	int iy = (int)top;
+
+	XMVECTOR blendX = XMVectorReplicate(x - left);
+	XMVECTOR upper = XMVectorLerpV(LoadBytes(image, ix, iy), LoadBytes(image, ix + 1, iy), blendX);
+	XMVECTOR lower = XMVectorLerpV(LoadBytes(image, ix, iy + 1), LoadBytes(image, ix + 1, iy + 1), blendX);
+	XMVECTOR bytes = XMVectorLerpV(upper, lower, XMVectorReplicate(y - top));
+	return bytes / 255.0f;
+}
+
+// One pass of the dual filter into dest, the same taps as blurPS.hlsl,
+// offset in texels of the source
+static void DualFilterPass(const MipLevel& source, MipLevel& dest, bool upsample, ThreadPool& threadPool)
+{
+	float texelU = 1.0f / source.Width;
+	float texelV = 1.0f / source.Height;
+
+	threadPool.ParallelFor(dest.Height, [&](unsigned int y)
+	{
+		float v = (y + 0.5f) / dest.Height;
+		for (unsigned int x = 0; x < dest.Width; x++)
+		{
+			float u = (x + 0.5f) / dest.Width;
+			auto tap = [&](float offsetX, float offsetY) { return SampleBilinear(source, u + offsetX * texelU, v + offsetY * texelV); };
+
+			XMVECTOR color;
+			if (upsample)
+			{
+				XMVECTOR edges = tap(-1, 0) + tap(1, 0) + tap(0, -1) + tap(0, 1);
+				XMVECTOR corners = tap(-0.5f, -0.5f) + tap(0.5f, -0.5f) + tap(-0.5f, 0.5f) + tap(0.5f, 0.5f);
+				color = (edges + corners * 2.0f) / 12.0f;
+			}
+			else
+			{
+				XMVECTOR corners = tap(-1, -1) + tap(1, -1) + tap(-1, 1) + tap(1, 1);
+				color = (tap(0, 0) * 4.0f + corners) / 8.0f;
+			}
+			StoreColor(dest, x, y, color);
+		}
+	});
+}
+
+MipLevel BlurImage(const MipLevel& source, BlurMode mode, int radius, ThreadPool& threadPool)
+{
+	if (source.Width == 0 || source.Height == 0 ||
+		source.Pixels.size() != (size_t)source.Width * source.Height * 4)
+		return MipLevel();
+
+	MipLevel result = CreateImage(source.Width, source.Height);
+	if (radius <= 0)
+	{
+		// Every mode is a copy
+		result.Pixels = source.Pixels;
+		return result;
+	}
+
+	switch (mode)
+	{
+	case BlurMode::Box:
+		BoxBlur(source, result, radius, threadPool);
+		break;
+
+	case BlurMode::Separable:
+	case BlurMode::SlidingWindow:
+	{
+		// The horizontal pass lands in an 8 bit texture, just like on the GPU
+		bool slidingWindow = mode == BlurMode::SlidingWindow;
+		MipLevel horizontal = CreateImage(source.Width, source.Height);
+		BoxBlurAxis(source, horizontal, radius, false, slidingWindow, threadPool);
+		BoxBlurAxis(horizontal, result, radius, true, slidingWindow, threadPool);
+		break;
+	}
+
+	case BlurMode::DualFilter:
+	{
+		// Down through the levels, then back up through them into the result
+		unsigned int levelCount = GetDualFilterLevels(radius);
+		std::vector<MipLevel> levels(levelCount);
+		for (unsigned int i = 0; i < levelCount; i++)
+		{
+			levels[i] = CreateImage(GetBlurLevelSize(source.Width, i), GetBlurLevelSize(source.Height, i));
+			DualFilterPass(i == 0 ? source : levels[i - 1], levels[i], false, threadPool);
+		}
+		for (unsigned int i = levelCount - 1; i > 0; i--)
+			DualFilterPass(levels[i], levels[i - 1], true, threadPool);
+		DualFilterPass(levels[0], result, true, threadPool);
+		break;
+	}
+
+	default:
+		result.Pixels = source.Pixels;
+		break;
+	}
+	return result;
+}
+
+unsigned int CompareImages(const MipLevel& a, const MipLevel& b, unsigned int& differentPixels)
+{
+	differentPixels = 0;
+	if (a.Width != b.Width || a.Height != b.Height || a.Pixels.size() != b.Pixels.size())
+		return ~0u;
+
+	unsigned int largest = 0;
+	for (size_t i = 0; i < a.Pixels.size(); i += 4)
+	{
+		unsigned int pixelLargest = 0;
+		for (size_t c = 0; c < 4; c++)
+		{
+			unsigned int difference = (unsigned int)abs(a.Pixels[i + c] - b.Pixels[i + c]);
+			pixelLargest = difference > pixelLargest ? difference : pixelLargest;
+		}
+		if (pixelLargest > 0)
+			differentPixels++;
+		largest = pixelLargest > largest ? pixelLargest : largest;
+	}
+	return largest;
+}
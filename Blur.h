@@ -0,0 +1,73 @@
+#pragma once
+
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+// Which pass blurPS.hlsl does - must match the BLUR_PASS_ defines there
+#define BLUR_PASS_BOX 0 // Full (2r+1)^2 box in one pass
+#define BLUR_PASS_HORIZONTAL 1 // One axis of the separable box
+#define BLUR_PASS_VERTICAL 2
+#define BLUR_PASS_DOWNSAMPLE 3 // Dual filter, to half size
+#define BLUR_PASS_UPSAMPLE 4 // Dual filter, to the next size up
+
+// Half size levels the dual filter can go down through
+#define MAX_BLUR_LEVELS 5
+
+// --------------------------------------------------------
+// The blur post process's ways of blurring, from slowest to
+// fastest as the radius grows:
+//  - Box: every texel of the (2r+1)^2 box, O(r^2)
+//  - Separable: a horizontal then a vertical 2r+1 pass, O(r)
+//  - SlidingWindow: the same two passes as running sums in a
+//    compute shader, one thread per row or column, so each
+//    texel costs the same at any radius
+//  - DualFilter: Marius Bjorge's downsample/upsample chain
+//    ("Bandwidth-Efficient Rendering"), one half size level
+//    per doubling of the radius.  Not a box - it's wider and
+//    smoother, and its cost barely grows with the radius.
+//
+// The first three give the same box blur, only quantized to
+// 8 bits between the separable passes.
+// --------------------------------------------------------
+enum class BlurMode
+{
+	Box,
+	Separable,
+	SlidingWindow,
+	DualFilter,
+	Count
+};
+
+const char* GetBlurModeName(BlurMode mode);
+
+// Half size levels the dual filter uses for a radius, up to MAX_BLUR_LEVELS
+unsigned int GetDualFilterLevels(int radius);
+
+// Width or height of one of the dual filter's levels (0 is half size)
+unsigned int GetBlurLevelSize(unsigned int size, unsigned int level);
+
+// Average texture reads per output pixel, for the UI
+float GetBlurSamplesPerPixel(BlurMode mode, int radius, unsigned int width, unsigned int height);
+
+// --------------------------------------------------------
+// CPU versions of each mode, on RGBA8 images, that do what
+// the GPU does step by step: texels are read as UNORM, the
+// edges clamp, the dual filter samples bilinearly, and every
+// pass writes 8 bits per channel with round to nearest.  A
+// pixel's 4 channels go through DirectXMath together, and
+// rows (or columns) are spread over the thread pool.
+//
+// The box modes add up whole byte values, which floats hold
+// exactly, and divide once.  They average an odd number of
+// texels, so the result is never halfway between two byte
+// values - they should match the GPU exactly.  The dual
+// filter's bilinear weights are only as precise as the
+// hardware's, so it can be 1 off.
+//
+// Nothing in here touches Direct3D.
+// --------------------------------------------------------
+MipLevel BlurImage(const MipLevel& source, BlurMode mode, int radius, ThreadPool& threadPool);
+
+// Returns the largest difference in any channel between two images of the
+// same size, and how many pixels differ at all (~0u if the sizes don't match)
+unsigned int CompareImages(const MipLevel& a, const MipLevel& b, unsigned int& differentPixels);
@@ -33,6 +33,16 @@ std::shared_ptr<Transform> Camera::GetTransform()
 	return m_transform;
 }
 
+float Camera::GetNearDistance() const
+{
+	return m_nearDist;
+}
+
+float Camera::GetFarDistance() const
+{
+	return m_farDist;
+}
+
 void Camera::SetFOV(const float fov)
 {
 	m_fov = fov;
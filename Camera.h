@@ -12,6 +12,8 @@ public:
 	DirectX::XMFLOAT4X4 GetViewMatrix();
 	DirectX::XMFLOAT4X4 GetProjectionMatrix();
 	std::shared_ptr<Transform> GetTransform();
+	float GetNearDistance() const;
+	float GetFarDistance() const;
 
 	// setters
 	void SetFOV(const float fov);
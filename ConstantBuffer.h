@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <type_traits>
+
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// A typed view of one of a shader's constant buffers, so a
+// whole struct is set in a single copy instead of one
+// SetData() call per variable.
+//
+// T should come from ShaderConstants.h, or be checked with
+// HlslPacking, so its layout matches the cbuffer. Its size
+// is checked against the shader's reflection data on every
+// Set(), which catches structs that have fallen out of date.
+//
+//   ConstantBuffer<PixelShaderPerFrame> perFrame(ps, "PerFrame");
+//   perFrame.Set(frameConstants);
+// --------------------------------------------------------
+template<typename T>
+class ConstantBuffer
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Constant buffer data is copied with memcpy");
+
+public:
+	ConstantBuffer(const std::shared_ptr<ISimpleShader>& shader, std::string_view bufferName) :
+		m_shader(shader),
+		m_bufferIndex(shader->GetBufferIndex(bufferName))
+	{
+	}
+
+	// False if the shader doesn't have this buffer
+	bool IsValid() const { return m_bufferIndex != -1; }
+
+	// Copies the struct into the shader's local copy of the buffer, which
+	// is uploaded with the shader's other buffers (and only if it changed)
+	bool Set(const T& data)
+	{
+		if (!IsValid())
+			return false;
+
+		return m_shader->SetBufferData((unsigned int)m_bufferIndex, &data, sizeof(T));
+	}
+
+private:
+	std::shared_ptr<ISimpleShader> m_shader;
+	int m_bufferIndex;
+};
@@ -0,0 +1,146 @@
+#include "ConstantBufferCodegen.h"
+#include "ConstantBufferLayout.h"
+#include "PathHelpers.h"
+
+#include <d3d11shader.h>
+#include <wrl/client.h>
+#include <fstream>
+#include <sstream>
+
+// --------------------------------------------------------
+// The C++ type with the same layout as an HLSL type, or an
+// empty string if there isn't one
+// --------------------------------------------------------
+static std::string GetCppType(const D3D11_SHADER_TYPE_DESC& typeDesc)
+{
+	const char* scalarType = 0;
+	const char* vectorType = 0;
+	switch (typeDesc.Type)
+	{
+	case D3D_SVT_FLOAT: scalarType = "float"; vectorType = "DirectX::XMFLOAT"; break;
+	case D3D_SVT_INT:
+	case D3D_SVT_BOOL: scalarType = "int"; vectorType = "DirectX::XMINT"; break; // HLSL bools are 4 bytes
+	case D3D_SVT_UINT: scalarType = "unsigned int"; vectorType = "DirectX::XMUINT"; break;
+	default: return "";
+	}
+
+	switch (typeDesc.Class)
+	{
+	case D3D_SVC_SCALAR:
+		return scalarType;
+
+	case D3D_SVC_VECTOR:
+		return std::string(vectorType) + std::to_string(typeDesc.Columns);
+
+	case D3D_SVC_MATRIX_ROWS:
+	case D3D_SVC_MATRIX_COLUMNS:
+		// Only 4x4 float matrices, which are copied over as-is (see Transform)
+		if (typeDesc.Type == D3D_SVT_FLOAT && typeDesc.Rows == 4 && typeDesc.Columns == 4)
+			return "DirectX::XMFLOAT4X4";
+		return "";
+
+	default:
+		return "";
+	}
+}
+
+// --------------------------------------------------------
+// Generates one struct per constant buffer in a compiled
+// shader, each followed by static_asserts on its layout
+// (see ConstantBufferLayout)
+//
+// shaderBlob   - The compiled shader
+// structPrefix - Put in front of each cbuffer's name
+// --------------------------------------------------------
+std::string GenerateConstantBufferStructs(ID3DBlob* shaderBlob, const std::string& structPrefix)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
+	HRESULT hr = D3DReflect(
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		IID_ID3D11ShaderReflection,
+		(void**)refl.GetAddressOf());
+	if (FAILED(hr))
+		return "";
+
+	D3D11_SHADER_DESC shaderDesc;
+	refl->GetDesc(&shaderDesc);
+
+	std::ostringstream out;
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
+	{
+		ID3D11ShaderReflectionConstantBuffer* cb = refl->GetConstantBufferByIndex(b);
+
+		D3D11_SHADER_BUFFER_DESC bufferDesc;
+		cb->GetDesc(&bufferDesc);
+
+		// Structured buffers show up in this list too
+		if (bufferDesc.Type != D3D_CT_CBUFFER)
+			continue;
+
+		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+		ConstantBufferDesc buffer = {};
+		buffer.Name = bufferDesc.Name;
+		buffer.BindPoint = bindDesc.BindPoint;
+		buffer.Size = bufferDesc.Size;
+
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			ID3D11ShaderReflectionVariable* var = cb->GetVariableByIndex(v);
+
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			var->GetDesc(&varDesc);
+
+			D3D11_SHADER_TYPE_DESC typeDesc;
+			var->GetType()->GetDesc(&typeDesc);
+
+			ConstantBufferVariableDesc variable = {};
+			variable.Name = varDesc.Name;
+			variable.HlslType = typeDesc.Name ? typeDesc.Name : "";
+			variable.CppType = GetCppType(typeDesc);
+			variable.StartOffset = varDesc.StartOffset;
+			variable.Size = varDesc.Size;
+			variable.Elements = typeDesc.Elements;
+			buffer.Variables.push_back(variable);
+		}
+
+		out << GenerateConstantBufferStruct(buffer, structPrefix);
+	}
+
+	return out.str();
+}
+
+// --------------------------------------------------------
+// Generates structs for each shader and writes them out as
+// a single header
+//
+// Returns false if a shader can't be read or the header
+// can't be written
+// --------------------------------------------------------
+bool WriteConstantBufferHeader(const std::vector<std::wstring>& shaderFiles, const std::wstring& headerFile)
+{
+	std::string structs;
+	for (const std::wstring& shaderFile : shaderFiles)
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+		if (FAILED(D3DReadFileToBlob(shaderFile.c_str(), shaderBlob.GetAddressOf())))
+			return false;
+
+		// Just the file name, without its folder or extension
+		size_t nameStart = shaderFile.find_last_of(L"\\/");
+		nameStart = nameStart == std::wstring::npos ? 0 : nameStart + 1;
+		size_t nameEnd = shaderFile.find_last_of(L'.');
+		nameEnd = nameEnd == std::wstring::npos || nameEnd < nameStart ? shaderFile.size() : nameEnd;
+
+		structs += GenerateConstantBufferStructs(shaderBlob.Get(), WideToNarrow(shaderFile.substr(nameStart, nameEnd - nameStart)));
+	}
+
+	std::ofstream file(headerFile);
+	if (!file)
+		return false;
+
+	file << GenerateConstantBufferHeader(structs);
+	return file.good();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <d3dcompiler.h>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Writes C++ structs that mirror compiled shaders' constant
+// buffers, using the same reflection data SimpleShader reads
+// when it loads a shader. Every member gets a static_assert
+// on its offset, and anything without an exact C++ match
+// (like a float array, whose elements are padded to 16
+// bytes) becomes a byte array of the right size.
+//
+// Structs are named after the shader file and the cbuffer,
+// so PixelShader.cso's PerFrame becomes PixelShaderPerFrame.
+// --------------------------------------------------------
+
+// The structs for every cbuffer in one compiled shader
+std::string GenerateConstantBufferStructs(ID3DBlob* shaderBlob, const std::string& structPrefix);
+
+// A complete header (like ShaderConstants.h) for a set of .cso files
+bool WriteConstantBufferHeader(const std::vector<std::wstring>& shaderFiles, const std::wstring& headerFile);
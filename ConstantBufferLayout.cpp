@@ -0,0 +1,82 @@
+#include "ConstantBufferLayout.h"
+
+#include <sstream>
+
+// --------------------------------------------------------
+// The declaration of one cbuffer variable as a struct member
+// --------------------------------------------------------
+static std::string GetMemberDeclaration(const ConstantBufferVariableDesc& variable)
+{
+	// A C++ array only matches when its elements already fill whole
+	// registers, since HLSL pads every element but the last one
+	bool arrayMatches =
+		variable.Elements == 0 ||
+		(variable.Size % variable.Elements == 0 && (variable.Size / variable.Elements) % 16 == 0);
+
+	if (variable.CppType.empty() || !arrayMatches)
+	{
+		std::string hlslType = variable.HlslType.empty() ? "?" : variable.HlslType;
+		if (variable.Elements > 0)
+			hlslType += "[" + std::to_string(variable.Elements) + "]";
+
+		return "unsigned char " + variable.Name + "[" + std::to_string(variable.Size) + "]; // HLSL " + hlslType;
+	}
+
+	std::string declaration = variable.CppType + " " + variable.Name;
+	if (variable.Elements > 0)
+		declaration += "[" + std::to_string(variable.Elements) + "]";
+
+	return declaration + ";";
+}
+
+std::string GenerateConstantBufferStruct(const ConstantBufferDesc& buffer, const std::string& structPrefix)
+{
+	std::string structName = structPrefix + buffer.Name;
+	std::ostringstream out;
+	std::ostringstream asserts;
+
+	out << "// --------------------------------------------------------\n";
+	out << "// " << structPrefix << " - cbuffer " << buffer.Name << " : register(b" << buffer.BindPoint << ")\n";
+	out << "// --------------------------------------------------------\n";
+	out << "struct alignas(16) " << structName << "\n{\n";
+
+	unsigned int end = 0;
+	unsigned int paddingCount = 0;
+	for (const ConstantBufferVariableDesc& variable : buffer.Variables)
+	{
+		// Make the packing rules' gaps explicit
+		if (variable.StartOffset > end)
+		{
+			out << "\tunsigned char Padding" << paddingCount++ << "[" << (variable.StartOffset - end) << "];\n";
+		}
+
+		out << "\t" << GetMemberDeclaration(variable) << "\n";
+		asserts << "static_assert(offsetof(" << structName << ", " << variable.Name << ") == " << variable.StartOffset << ");\n";
+
+		end = variable.StartOffset + variable.Size;
+	}
+
+	// alignas(16) pads the end out to a whole register, like the buffer itself
+	out << "};\n";
+	out << asserts.str();
+	out << "static_assert(sizeof(" << structName << ") == " << ((buffer.Size + 15) / 16) * 16 << ");\n\n";
+	return out.str();
+}
+
+std::string GenerateConstantBufferHeader(const std::string& structs)
+{
+	std::ostringstream out;
+	out << "#pragma once\n\n";
+	out << "// --------------------------------------------------------\n";
+	out << "// GENERATED from the compiled shaders' reflection data by\n";
+	out << "// running the game with -generate-constants (see Main.cpp)\n";
+	out << "// - regenerate it instead of editing it by hand.\n";
+	out << "//\n";
+	out << "// One struct per constant buffer, laid out exactly like the\n";
+	out << "// cbuffer, for setting in one copy with ConstantBuffer<T>.\n";
+	out << "// --------------------------------------------------------\n\n";
+	out << "#include <DirectXMath.h>\n";
+	out << "#include <cstddef>\n\n";
+	out << structs;
+	return out.str();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// A constant buffer's layout as plain data, the way shader
+// reflection describes it, and the C++ struct text written
+// from it.  ConstantBufferCodegen fills these in from a
+// compiled shader; nothing in here touches Direct3D, so the
+// struct writer can run (and be tested) anywhere.
+// --------------------------------------------------------
+struct ConstantBufferVariableDesc
+{
+	std::string Name;
+	std::string HlslType; // Without array brackets, like "float3"
+	std::string CppType; // Same layout as one element, or empty if there isn't one
+	unsigned int StartOffset;
+	unsigned int Size; // Bytes, including padding between array elements
+	unsigned int Elements; // 0 if it isn't an array
+};
+
+struct ConstantBufferDesc
+{
+	std::string Name;
+	unsigned int BindPoint;
+	unsigned int Size; // As reflection reports it
+	std::vector<ConstantBufferVariableDesc> Variables;
+};
+
+// One cbuffer as a struct named structPrefix + its name, with
+// explicit padding and static_asserts on every offset
+std::string GenerateConstantBufferStruct(const ConstantBufferDesc& buffer, const std::string& structPrefix);
+
+// Generated structs wrapped up as a complete header, like ShaderConstants.h
+std::string GenerateConstantBufferHeader(const std::string& structs);
@@ -0,0 +1,195 @@
+#include "ConstantRingBuffer.h"
+
+#include <cstring>
+#include <thread>
+
+// Offsets passed to *SetConstantBuffers1() must be multiples of 16 constants
+static const unsigned int ALLOCATION_ALIGNMENT = 256;
+
+// Frames that can be waiting on the GPU before EndFrame() has to wait
+static const unsigned int QUERY_POOL_SIZE = 8;
+
+ConstantRingBuffer::ConstantRingBuffer(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	const unsigned int sizeInBytes) :
+	m_device(device),
+	m_context(context),
+	m_supported(false),
+	m_firstMap(true),
+	m_size(sizeInBytes),
+	m_head(0),
+	m_frameStart(0),
+	m_frame(0),
+	m_frameBytes(0),
+	m_stallCount(0)
+{
+	// Offset binding and NO_OVERWRITE on constant buffers are both D3D11.1 features
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (FAILED(m_context.As(&m_context1)) ||
+		FAILED(m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) ||
+		!options.ConstantBufferOffsetting ||
+		!options.MapNoOverwriteOnDynamicConstantBuffer)
+	{
+		return;
+	}
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = m_size;
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (FAILED(m_device->CreateBuffer(&bufferDesc, 0, m_buffer.GetAddressOf())))
+	{
+		return;
+	}
+
+	// Without a query there'd be no way to know when space can be reused
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	for (unsigned int i = 0; i < QUERY_POOL_SIZE; i++)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> query;
+		if (SUCCEEDED(m_device->CreateQuery(&queryDesc, query.GetAddressOf())))
+		{
+			m_freeQueries.push_back(query);
+		}
+	}
+	m_supported = !m_freeQueries.empty();
+}
+
+bool ConstantRingBuffer::IsSupported() const
+{
+	return m_supported;
+}
+
+bool ConstantRingBuffer::Allocate(const void* data, const unsigned int size, ConstantRingAllocation& allocationOut)
+{
+	if (!m_supported)
+	{
+		return false;
+	}
+
+	unsigned int alignedSize = (size + ALLOCATION_ALIGNMENT - 1) / ALLOCATION_ALIGNMENT * ALLOCATION_ALIGNMENT;
+
+	// Blocks can't straddle the end of the buffer, so skip to the start
+	unsigned long long start = m_head;
+	unsigned int offset = static_cast<unsigned int>(start % m_size);
+	if (offset + alignedSize > m_size)
+	{
+		start += m_size - offset;
+		offset = 0;
+	}
+	unsigned long long end = start + alignedSize;
+
+	// This frame alone would lap the ring
+	if (end - m_frameStart > m_size)
+	{
+		return false;
+	}
+
+	// Anything written before end - m_size is about to be overwritten,
+	// so any frame that wrote there has to be finished on the GPU
+	while (!m_pendingFrames.empty() && m_pendingFrames.front().Start + m_size < end)
+	{
+		RetireOldestFrame();
+	}
+
+	// The very first map has to discard, after that the GPU is never
+	// reading anything we write to
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	D3D11_MAP mapType = m_firstMap ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (FAILED(m_context->Map(m_buffer.Get(), 0, mapType, 0, &mapped)))
+	{
+		return false;
+	}
+	memcpy(static_cast<unsigned char*>(mapped.pData) + offset, data, size);
+	m_context->Unmap(m_buffer.Get(), 0);
+	m_firstMap = false;
+
+	allocationOut.FirstConstant = offset / 16;
+	allocationOut.NumConstants = alignedSize / 16;
+	allocationOut.Frame = m_frame;
+
+	m_head = end;
+	return true;
+}
+
+bool ConstantRingBuffer::IsResident(const ConstantRingAllocation& allocation) const
+{
+	return m_supported && allocation.Frame == m_frame;
+}
+
+void ConstantRingBuffer::EndFrame()
+{
+	if (!m_supported)
+	{
+		return;
+	}
+
+	m_frameBytes = static_cast<unsigned int>(m_head - m_frameStart);
+
+	// Nothing to wait on later if nothing was written
+	if (m_head != m_frameStart)
+	{
+		// Every query is still waiting on an earlier frame, and the
+		// oldest of those is the first to finish
+		if (m_freeQueries.empty())
+		{
+			RetireOldestFrame();
+		}
+
+		PendingFrame frame = {};
+		frame.Start = m_frameStart;
+		frame.End = m_head;
+		frame.Query = m_freeQueries.back();
+		m_freeQueries.pop_back();
+		m_context->End(frame.Query.Get());
+
+		m_pendingFrames.push_back(frame);
+	}
+
+	m_frameStart = m_head;
+	m_frame++;
+}
+
+void ConstantRingBuffer::RetireOldestFrame()
+{
+	PendingFrame& oldest = m_pendingFrames.front();
+	if (m_context->GetData(oldest.Query.Get(), 0, 0, 0) == S_FALSE)
+	{
+		m_stallCount++;
+		while (m_context->GetData(oldest.Query.Get(), 0, 0, 0) == S_FALSE)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	m_freeQueries.push_back(oldest.Query);
+	m_pendingFrames.pop_front();
+}
+
+ID3D11Buffer* ConstantRingBuffer::GetBuffer() const
+{
+	return m_buffer.Get();
+}
+
+ID3D11DeviceContext1* ConstantRingBuffer::GetContext1() const
+{
+	return m_context1.Get();
+}
+
+unsigned long long ConstantRingBuffer::GetFrame() const
+{
+	return m_frame;
+}
+
+unsigned int ConstantRingBuffer::GetFrameBytes() const
+{
+	return m_frameBytes;
+}
+
+unsigned int ConstantRingBuffer::GetStallCount() const
+{
+	return m_stallCount;
+}
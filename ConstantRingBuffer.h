@@ -0,0 +1,89 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include <deque>
+#include <vector>
+
+// --------------------------------------------------------
+// Where one block of constants landed in the ring
+// --------------------------------------------------------
+struct ConstantRingAllocation
+{
+	unsigned int FirstConstant;	// In 16 byte shader constants, for *SetConstantBuffers1()
+	unsigned int NumConstants;
+	unsigned long long Frame;	// Only valid during the frame it was written
+};
+
+// --------------------------------------------------------
+// One large dynamic constant buffer that constants are
+// streamed into, bound with offsets (D3D11.1) instead of
+// giving every shader its own buffer to update per draw.
+//
+// Blocks are appended with Map(NO_OVERWRITE), so nothing
+// the GPU may still be reading is ever touched. Each frame
+// records an event query when it ends, and before wrapping
+// around onto space from an earlier frame the ring waits
+// for that frame's query. The queries come from a small
+// pool made up front - if none can be made, the ring isn't
+// used at all. A frame that runs out of space just fails
+// the allocation, and the caller falls back to its own
+// buffer.
+// --------------------------------------------------------
+class ConstantRingBuffer
+{
+public:
+	ConstantRingBuffer(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		const unsigned int sizeInBytes = 1024 * 1024);
+
+	// False if the device can't bind constant buffers with offsets
+	bool IsSupported() const;
+
+	// Copies a block into the ring. Returns false if it doesn't fit this frame.
+	bool Allocate(const void* data, const unsigned int size, ConstantRingAllocation& allocationOut);
+	bool IsResident(const ConstantRingAllocation& allocation) const;
+
+	// Call once per frame, after the last draw
+	void EndFrame();
+
+	// Getters
+	ID3D11Buffer* GetBuffer() const;
+	ID3D11DeviceContext1* GetContext1() const;
+	unsigned long long GetFrame() const;
+	unsigned int GetFrameBytes() const; // Bytes allocated during the last full frame
+	unsigned int GetStallCount() const; // Times the CPU has waited on the GPU for space
+
+private:
+	struct PendingFrame
+	{
+		unsigned long long Start;
+		unsigned long long End;
+		Microsoft::WRL::ComPtr<ID3D11Query> Query;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_context1;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_buffer;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> m_freeQueries; // Event queries not waiting on a frame
+	bool m_supported;
+	bool m_firstMap;
+
+	unsigned int m_size;
+
+	// Positions count bytes written since creation, so they never wrap.
+	// The buffer offset of a position is position % m_size.
+	unsigned long long m_head;
+	unsigned long long m_frameStart;
+	unsigned long long m_frame;
+	std::deque<PendingFrame> m_pendingFrames;
+
+	unsigned int m_frameBytes;
+	unsigned int m_stallCount;
+
+	// Waits for the oldest pending frame to finish on the GPU,
+	// then returns its query to the pool
+	void RetireOldestFrame();
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cmath>
+
+// --------------------------------------------------------
+// D3D's cube map layout, for CPU code that walks cube map
+// faces: +X, -X, +Y, -Y, +Z, -Z.  u and v run from -1 to 1
+// along each face's texture x and y.
+// --------------------------------------------------------
+
+// Each face's direction, and the directions its texture's x and y run in
+static const DirectX::XMFLOAT3 CUBE_FACE_AXES[6][3] = {
+	{ DirectX::XMFLOAT3( 1, 0, 0), DirectX::XMFLOAT3( 0, 0, -1), DirectX::XMFLOAT3(0, -1,  0) },
+	{ DirectX::XMFLOAT3(-1, 0, 0), DirectX::XMFLOAT3( 0, 0,  1), DirectX::XMFLOAT3(0, -1,  0) },
+	{ DirectX::XMFLOAT3( 0, 1, 0), DirectX::XMFLOAT3( 1, 0,  0), DirectX::XMFLOAT3(0,  0,  1) },
+	{ DirectX::XMFLOAT3( 0,-1, 0), DirectX::XMFLOAT3( 1, 0,  0), DirectX::XMFLOAT3(0,  0, -1) },
+	{ DirectX::XMFLOAT3( 0, 0, 1), DirectX::XMFLOAT3( 1, 0,  0), DirectX::XMFLOAT3(0, -1,  0) },
+	{ DirectX::XMFLOAT3( 0, 0,-1), DirectX::XMFLOAT3(-1, 0,  0), DirectX::XMFLOAT3(0, -1,  0) } };
+
+// Unit direction through a point on a face
+inline DirectX::XMFLOAT3 GetCubeFaceDirection(unsigned int face, float u, float v)
+{
+	const DirectX::XMFLOAT3* axes = CUBE_FACE_AXES[face];
+	float x = axes[0].x + u * axes[1].x + v * axes[2].x;
+	float y = axes[0].y + u * axes[1].y + v * axes[2].y;
+	float z = axes[0].z + u * axes[1].z + v * axes[2].z;
+	float inverseLength = 1.0f / sqrtf(x * x + y * y + z * z);
+	return DirectX::XMFLOAT3(x * inverseLength, y * inverseLength, z * inverseLength);
+}
+
+// The face a direction (any length) points at, and where on it
+inline void GetCubeFaceCoordinates(DirectX::XMFLOAT3 direction, unsigned int& face, float& u, float& v)
+{
+	float absX = fabsf(direction.x);
+	float absY = fabsf(direction.y);
+	float absZ = fabsf(direction.z);
+
+	if (absX >= absY && absX >= absZ)
+	{
+		face = direction.x > 0 ? 0 : 1;
+		u = (direction.x > 0 ? -direction.z : direction.z) / absX;
+		v = -direction.y / absX;
+	}
+	else if (absY >= absZ)
+	{
+		face = direction.y > 0 ? 2 : 3;
+		u = direction.x / absY;
+		v = (direction.y > 0 ? direction.z : -direction.z) / absY;
+	}
+	else
+	{
+		face = direction.z > 0 ? 4 : 5;
+		u = (direction.z > 0 ? direction.x : -direction.x) / absZ;
+		v = -direction.y / absZ;
+	}
+}
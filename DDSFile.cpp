@@ -0,0 +1,167 @@
+#include "DDSFile.h"
+
+#include <filesystem>
+#include <fstream>
+
+// Header layouts from the DDS documentation
+#define DDS_MAGIC 0x20534444 // "DDS "
+#define DDS_FOURCC_DX10 0x30315844 // "DX10"
+
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE 0x80000
+#define DDPF_FOURCC 0x4
+#define DDSCAPS_COMPLEX 0x8
+#define DDSCAPS_TEXTURE 0x1000
+#define DDSCAPS_MIPMAP 0x400000
+#define DDS_DIMENSION_TEXTURE2D 3
+
+struct DDSPixelFormat
+{
+	unsigned int Size;
+	unsigned int Flags;
+	unsigned int FourCC;
+	unsigned int RGBBitCount;
+	unsigned int RBitMask;
+	unsigned int GBitMask;
+	unsigned int BBitMask;
+	unsigned int ABitMask;
+};
+
+struct DDSHeader
+{
+	unsigned int Size;
+	unsigned int Flags;
+	unsigned int Height;
+	unsigned int Width;
+	unsigned int PitchOrLinearSize;
+	unsigned int Depth;
+	unsigned int MipMapCount;
+	unsigned int Reserved1[11];
+	DDSPixelFormat PixelFormat;
+	unsigned int Caps;
+	unsigned int Caps2;
+	unsigned int Caps3;
+	unsigned int Caps4;
+	unsigned int Reserved2;
+};
+
+struct DDSHeaderDX10
+{
+	unsigned int DxgiFormat;
+	unsigned int ResourceDimension;
+	unsigned int MiscFlag;
+	unsigned int ArraySize;
+	unsigned int MiscFlags2;
+};
+
+static_assert(sizeof(DDSHeader) == 124, "DDS header layout");
+static_assert(sizeof(DDSHeaderDX10) == 20, "DDS DX10 header layout");
+
+bool WriteDDS(const std::wstring& file, const DDSImage& image)
+{
+	if (image.Mips.empty())
+		return false;
+
+	DDSHeader header = {};
+	header.Size = sizeof(DDSHeader);
+	header.Flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.Height = image.Height;
+	header.Width = image.Width;
+	header.PitchOrLinearSize = (unsigned int)image.Mips[0].size();
+	header.MipMapCount = (unsigned int)image.Mips.size();
+	header.PixelFormat.Size = sizeof(DDSPixelFormat);
+	header.PixelFormat.Flags = DDPF_FOURCC;
+	header.PixelFormat.FourCC = DDS_FOURCC_DX10;
+	header.Caps = DDSCAPS_TEXTURE | (image.Mips.size() > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+	DDSHeaderDX10 headerDX10 = {};
+	headerDX10.DxgiFormat = image.Format;
+	headerDX10.ResourceDimension = DDS_DIMENSION_TEXTURE2D;
+	headerDX10.ArraySize = 1;
+
+	std::ofstream out(std::filesystem::path(file), std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	unsigned int magic = DDS_MAGIC;
+	out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(&headerDX10), sizeof(headerDX10));
+	for (const std::vector<unsigned char>& mip : image.Mips)
+		out.write(reinterpret_cast<const char*>(mip.data()), mip.size());
+
+	return out.good();
+}
+
+bool ReadDDS(const std::wstring& file, DDSImage& image, unsigned int firstMip, unsigned int mipCount)
+{
+	std::ifstream in(std::filesystem::path(file), std::ios::binary);
+	if (!in)
+		return false;
+
+	unsigned int magic = 0;
+	DDSHeader header = {};
+	DDSHeaderDX10 headerDX10 = {};
+	in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!in || magic != DDS_MAGIC || header.Size != sizeof(DDSHeader) ||
+		!(header.PixelFormat.Flags & DDPF_FOURCC) || header.PixelFormat.FourCC != DDS_FOURCC_DX10)
+		return false;
+
+	in.read(reinterpret_cast<char*>(&headerDX10), sizeof(headerDX10));
+	if (!in || headerDX10.ResourceDimension != DDS_DIMENSION_TEXTURE2D || headerDX10.ArraySize != 1 ||
+		GetDDSBlockSize(headerDX10.DxgiFormat) == 0)
+		return false;
+
+	unsigned int mipLevels = (header.Flags & DDSD_MIPMAPCOUNT) && header.MipMapCount > 0 ? header.MipMapCount : 1;
+	if (header.Width == 0 || header.Height == 0 || mipLevels > 32 || firstMip > mipLevels)
+		return false;
+
+	image.Width = header.Width;
+	image.Height = header.Height;
+	image.Format = headerDX10.DxgiFormat;
+	image.Mips.clear();
+	image.Mips.resize(mipLevels);
+
+	unsigned int lastMip = mipCount < mipLevels - firstMip ? firstMip + mipCount : mipLevels;
+	for (unsigned int mip = 0; mip < lastMip; mip++)
+	{
+		unsigned int width = image.Width >> mip;
+		unsigned int height = image.Height >> mip;
+		size_t size = GetDDSMipSize(image.Format, width > 0 ? width : 1, height > 0 ? height : 1);
+
+		// Mips are stored largest first, so skip straight past the unwanted ones
+		if (mip < firstMip)
+		{
+			in.seekg(size, std::ios::cur);
+			continue;
+		}
+
+		image.Mips[mip].resize(size);
+		in.read(reinterpret_cast<char*>(image.Mips[mip].data()), size);
+	}
+
+	return in.good();
+}
+
+unsigned int GetDDSBlockSize(unsigned int format)
+{
+	// BC1 and BC4 (typeless, unorm, srgb/snorm) pack a block into 8 bytes,
+	// and BC2, BC3, BC5, BC6H and BC7 into 16
+	if ((format >= 70 && format <= 72) || (format >= 79 && format <= 81))
+		return 8;
+	if ((format >= 73 && format <= 78) || (format >= 82 && format <= 84) || (format >= 94 && format <= 99))
+		return 16;
+	return 0;
+}
+
+size_t GetDDSMipSize(unsigned int format, unsigned int width, unsigned int height)
+{
+	size_t blocksWide = (width + 3) / 4;
+	size_t blocksHigh = (height + 3) / 4;
+	return blocksWide * blocksHigh * GetDDSBlockSize(format);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Minimal .dds file support for cooked textures: a single
+// 2D texture with its whole mip chain, always written with
+// the DX10 extended header so any DXGI format can be used.
+// DirectXTK's DDSTextureLoader reads these as-is.
+//
+// Reading only handles what the cook writes (block
+// compressed formats with the DX10 header), but can read
+// just part of the mip chain, for streaming.
+// --------------------------------------------------------
+struct DDSImage
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int Format; // DXGI_FORMAT
+	std::vector<std::vector<unsigned char>> Mips; // Largest first, each tightly packed
+};
+
+bool WriteDDS(const std::wstring& file, const DDSImage& image);
+
+// Reads mipCount mips starting at firstMip.  Mips has an entry for
+// every mip in the file, with the ones outside that range left empty,
+// so a mipCount of 0 reads just the size and format.
+bool ReadDDS(const std::wstring& file, DDSImage& image, unsigned int firstMip = 0, unsigned int mipCount = ~0u);
+
+// Bytes per 4x4 block of a block compressed DXGI_FORMAT, or 0 for others
+unsigned int GetDDSBlockSize(unsigned int format);
+
+// Bytes in one mip of a block compressed format
+size_t GetDDSMipSize(unsigned int format, unsigned int width, unsigned int height);
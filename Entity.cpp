@@ -1,31 +1,35 @@
 #include "Entity.h"
 #include "Graphics.h"
 
+using namespace DirectX;
+
 Entity::Entity(const std::shared_ptr<Mesh>& mesh,
 	const std::shared_ptr<Material>& material) :
-	m_colorTint(1.0f, 1.0f, 1.0f, 1.0f)
+	m_colorTint(1.0f, 1.0f, 1.0f, 1.0f),
+	m_isOccluder(false),
+	m_isStatic(false)
 {
 	m_mesh = mesh;
 	m_transform = std::make_shared<Transform>();
 	m_material = material;
+
+	m_worldHandle = m_material->GetVertexShader()->GetVariableHandle("world");
+	m_worldInvTransposeHandle = m_material->GetVertexShader()->GetVariableHandle("worldInvTranspose");
 }
 
-void Entity::Draw(const std::shared_ptr<Camera>& camera)
+// --------------------------------------------------------
+// Per-frame data (camera, lights, shadows) is expected to
+// already be set on the material's shaders
+// --------------------------------------------------------
+void Entity::Draw()
 {
 	m_material->PrepareMaterial();
 
 	std::shared_ptr<SimpleVertexShader> vs = m_material->GetVertexShader();
 	std::shared_ptr<SimplePixelShader> ps = m_material->GetPixelShader();
 
-	vs->SetMatrix4x4("world", m_transform->GetWorldMatrix());
-	vs->SetMatrix4x4("view", camera->GetViewMatrix());
-	vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());
-	vs->SetMatrix4x4("worldInvTranspose", m_transform->GetWorldInverseTransposeMatrix());
-
-	ps->SetFloat4("colorTint", m_material->GetColorTint());
-	ps->SetFloat2("uvScale", m_material->GetUVScale());
-	ps->SetFloat2("uvOffset", m_material->GetUVOffset());
-	ps->SetFloat3("camPos", camera->GetTransform()->GetPosition());
+	vs->SetMatrix4x4(m_worldHandle, m_transform->GetWorldMatrix());
+	vs->SetMatrix4x4(m_worldInvTransposeHandle, m_transform->GetWorldInverseTransposeMatrix());
 
 	vs->CopyAllBufferData();
 	ps->CopyAllBufferData();
@@ -50,3 +54,32 @@ std::shared_ptr<Material> Entity::GetMaterial() const
 {
 	return m_material;
 }
+
+BoundingBox Entity::GetWorldBounds() const
+{
+	XMFLOAT4X4 world = m_transform->GetWorldMatrix();
+
+	BoundingBox worldBounds;
+	m_mesh->GetBounds().Transform(worldBounds, XMLoadFloat4x4(&world));
+	return worldBounds;
+}
+
+bool Entity::IsOccluder() const
+{
+	return m_isOccluder;
+}
+
+void Entity::SetOccluder(const bool isOccluder)
+{
+	m_isOccluder = isOccluder;
+}
+
+bool Entity::IsStatic() const
+{
+	return m_isStatic;
+}
+
+void Entity::SetStatic(const bool isStatic)
+{
+	m_isStatic = isStatic;
+}
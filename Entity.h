@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <DirectXCollision.h>
 #include "Transform.h"
 #include "Mesh.h"
 #include "Camera.h"
@@ -12,16 +13,34 @@ public:
 	Entity(const std::shared_ptr<Mesh>& mesh,
 		const std::shared_ptr<Material>& material);
 
-	void Draw(const std::shared_ptr<Camera>& camera);
+	void Draw();
 
 	// Getters
 	std::shared_ptr<Mesh> GetMesh() const;
 	std::shared_ptr<Transform> GetTransform() const;
 	std::shared_ptr<Material> GetMaterial() const;
+	DirectX::BoundingBox GetWorldBounds() const;
+	bool IsOccluder() const;
+	bool IsStatic() const;
+
+	// Setters
+	void SetOccluder(const bool isOccluder);
+	void SetStatic(const bool isStatic);
 
 private:
 	std::shared_ptr<Transform> m_transform;
 	std::shared_ptr<Mesh> m_mesh;
 	DirectX::XMFLOAT4 m_colorTint;
 	std::shared_ptr<Material> m_material;
+
+	// Whether this entity is rasterized into the CPU occlusion buffer
+	bool m_isOccluder;
+
+	// Whether this entity is drawn into the cached static shadow map
+	// instead of being re-rendered every frame
+	bool m_isStatic;
+
+	// Resolved once from the material's vertex shader
+	SimpleShaderHandle m_worldHandle;
+	SimpleShaderHandle m_worldInvTransposeHandle;
 };
@@ -0,0 +1,447 @@
+#include "EnvironmentBaker.h"
+#include "CubeMap.h"
+#include "Hash.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+using namespace DirectX;
+
+// Bump the version whenever the bake or the file layout changes
+static const unsigned int CACHE_MAGIC = 0x424E5645; // "EVNB"
+static const unsigned int CACHE_VERSION = 1;
+
+// Same floor as ShaderIncludes.hlsli, for a perfect mirror
+#define MIN_ROUGHNESS 0.0000001f
+
+struct EnvironmentBakeHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned long long SourceHash;
+
+	// The settings it was baked with
+	unsigned int Size;
+	unsigned int Mips;
+	unsigned int Samples;
+	unsigned int BRDFSize;
+	unsigned int BRDFSamples;
+	unsigned int Padding;
+};
+
+// --------------------------------------------------------
+// The GGX pieces, exactly as ShaderIncludes.hlsli has them
+// --------------------------------------------------------
+
+// D_GGX's alpha squared: a = roughness^2, then squared again
+static float GetGGXAlpha2(float roughness)
+{
+	float a = roughness * roughness;
+	return fmaxf(a * a, MIN_ROUGHNESS);
+}
+
+static float DistributionGGX(float NdotH, float alpha2)
+{
+	float denomToSquare = NdotH * NdotH * (alpha2 - 1.0f) + 1.0f;
+	return alpha2 / (XM_PI * denomToSquare * denomToSquare);
+}
+
+// G_SchlickGGX, with the NdotX numerator the shader leaves out
+static float GeometrySchlickGGX(float NdotX, float roughness)
+{
+	float k = (roughness + 1.0f) * (roughness + 1.0f) / 8.0f;
+	return NdotX / (NdotX * (1.0f - k) + k);
+}
+
+// Point i of n on the unit square, spread evenly
+static XMFLOAT2 Hammersley(unsigned int i, unsigned int n)
+{
+	unsigned int bits = i;
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+	bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+	bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+	bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+	return XMFLOAT2((float)i / n, bits * 2.3283064365386963e-10f);
+}
+
+// A half vector around +Z, distributed like D_GGX
+static XMFLOAT3 ImportanceSampleGGX(XMFLOAT2 xi, float alpha2)
+{
+	float phi = 2.0f * XM_PI * xi.x;
+	float cosTheta = sqrtf((1.0f - xi.y) / (1.0f + (alpha2 - 1.0f) * xi.y));
+	float sinTheta = sqrtf(fmaxf(1.0f - cosTheta * cosTheta, 0.0f));
+	return XMFLOAT3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+}
+
+// --------------------------------------------------------
+// The source faces in linear floats, with box filtered mips
+// so wide lobes can sample a few blurry texels instead of
+// many sharp ones
+// --------------------------------------------------------
+struct SourceCube
+{
+	std::vector<unsigned int> Sizes;
+	std::vector<std::vector<XMFLOAT4>> Mips; // Six faces each, like PrefilteredEnvironment
+};
+
+static SourceCube DecodeSourceCube(const std::vector<MipLevel>& faces)
+{
+	// Same gamma the shaders decode with, per byte value
+	float gammaToLinear[256];
+	for (unsigned int i = 0; i < 256; i++)
+		gammaToLinear[i] = powf(i / 255.0f, 2.2f);
+
+	SourceCube cube;
+	unsigned int size = faces[0].Width;
+	cube.Sizes.push_back(size);
+	cube.Mips.emplace_back((size_t)6 * size * size);
+	for (unsigned int f = 0; f < 6; f++)
+	{
+		const unsigned char* pixels = faces[f].Pixels.data();
+		XMFLOAT4* texels = &cube.Mips[0][(size_t)f * size * size];
+		for (size_t t = 0; t < (size_t)size * size; t++)
+		{
+			texels[t] = XMFLOAT4(
+				gammaToLinear[pixels[t * 4 + 0]],
+				gammaToLinear[pixels[t * 4 + 1]],
+				gammaToLinear[pixels[t * 4 + 2]],
+				1.0f);
+		}
+	}
+
+	while (size > 1)
+	{
+		unsigned int sourceSize = size;
+		size /= 2;
+		const std::vector<XMFLOAT4>& source = cube.Mips.back();
+		std::vector<XMFLOAT4> mip((size_t)6 * size * size);
+		for (unsigned int f = 0; f < 6; f++)
+		{
+			const XMFLOAT4* sourceFace = &source[(size_t)f * sourceSize * sourceSize];
+			for (unsigned int y = 0; y < size; y++)
+			{
+				for (unsigned int x = 0; x < size; x++)
+				{
+					XMVECTOR sum =
+						XMLoadFloat4(&sourceFace[(y * 2) * sourceSize + x * 2]) +
+						XMLoadFloat4(&sourceFace[(y * 2) * sourceSize + x * 2 + 1]) +
+						XMLoadFloat4(&sourceFace[(y * 2 + 1) * sourceSize + x * 2]) +
+						XMLoadFloat4(&sourceFace[(y * 2 + 1) * sourceSize + x * 2 + 1]);
+					XMStoreFloat4(&mip[((size_t)f * size + y) * size + x], sum * 0.25f);
+				}
+			}
+		}
+		cube.Sizes.push_back(size);
+		cube.Mips.push_back(std::move(mip));
+	}
+	return cube;
+}
+
+static XMVECTOR SampleFace(const SourceCube& cube, unsigned int mip, XMFLOAT3 direction)
+{
+	unsigned int face;
+	float u, v;
+	GetCubeFaceCoordinates(direction, face, u, v);
+
+	// Bilinear, clamped at the face's edges
+	unsigned int size = cube.Sizes[mip];
+	float maxTexel = (float)(size - 1);
+	float x = fminf(fmaxf((u + 1.0f) * 0.5f * size - 0.5f, 0.0f), maxTexel);
+	float y = fminf(fmaxf((v + 1.0f) * 0.5f * size - 0.5f, 0.0f), maxTexel);
+	unsigned int x0 = (unsigned int)x;
+	unsigned int y0 = (unsigned int)y;
+	unsigned int x1 = x0 + 1 < size ? x0 + 1 : x0;
+	unsigned int y1 = y0 + 1 < size ? y0 + 1 : y0;
+	float fx = x - x0;
+	float fy = y - y0;
+
+	const XMFLOAT4* texels = &cube.Mips[mip][(size_t)face * size * size];
+	XMVECTOR top = XMVectorLerp(XMLoadFloat4(&texels[y0 * size + x0]), XMLoadFloat4(&texels[y0 * size + x1]), fx);
+	XMVECTOR bottom = XMVectorLerp(XMLoadFloat4(&texels[y1 * size + x0]), XMLoadFloat4(&texels[y1 * size + x1]), fx);
+	return XMVectorLerp(top, bottom, fy);
+}
+
+// Trilinear between the two nearest mips
+static XMVECTOR SampleCube(const SourceCube& cube, XMFLOAT3 direction, float mip)
+{
+	float maxMip = (float)(cube.Mips.size() - 1);
+	mip = fminf(fmaxf(mip, 0.0f), maxMip);
+	unsigned int mip0 = (unsigned int)mip;
+	unsigned int mip1 = mip0 + 1 < cube.Mips.size() ? mip0 + 1 : mip0;
+
+	XMVECTOR color = SampleFace(cube, mip0, direction);
+	if (mip1 == mip0 || mip == (float)mip0)
+		return color;
+
+	return XMVectorLerp(color, SampleFace(cube, mip1, direction), mip - mip0);
+}
+
+// One importance sample, in the space around the normal
+struct LobeSample
+{
+	XMFLOAT3 Direction;
+	float Weight; // NdotL
+	float SourceMip;
+};
+
+// --------------------------------------------------------
+// With the view along the normal, the lobe is the same
+// shape around every texel's direction, so its samples are
+// worked out once per roughness
+// --------------------------------------------------------
+static std::vector<LobeSample> BuildLobeSamples(float roughness, unsigned int sourceSize)
+{
+	float alpha2 = GetGGXAlpha2(roughness);
+
+	// Solid angle of one source texel, to compare each sample's share against
+	float texelSolidAngle = 4.0f * XM_PI / (6.0f * sourceSize * sourceSize);
+
+	std::vector<LobeSample> samples;
+	for (unsigned int i = 0; i < PREFILTERED_ENVIRONMENT_SAMPLES; i++)
+	{
+		XMFLOAT3 h = ImportanceSampleGGX(Hammersley(i, PREFILTERED_ENVIRONMENT_SAMPLES), alpha2);
+
+		// Reflect the view (+Z) about the half vector
+		XMFLOAT3 l(2.0f * h.z * h.x, 2.0f * h.z * h.y, 2.0f * h.z * h.z - 1.0f);
+		if (l.z <= 0.0f)
+			continue;
+
+		// Each sample covers about 1 / (count * pdf) of the sphere, and
+		// reads the source mip whose texels are about that size (Colbert
+		// and Krivanek, GPU Gems 3 chapter 20).  With N = V, the pdf is D / 4.
+		float pdf = DistributionGGX(h.z, alpha2) * 0.25f;
+		float sampleSolidAngle = 1.0f / (PREFILTERED_ENVIRONMENT_SAMPLES * pdf);
+		float sourceMip = 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+		samples.push_back({ l, l.z, fmaxf(sourceMip, 0.0f) });
+	}
+	return samples;
+}
+
+float GetPrefilteredMipRoughness(unsigned int mip)
+{
+	return (float)mip / (PREFILTERED_ENVIRONMENT_MIPS - 1);
+}
+
+PrefilteredEnvironment PrefilterEnvironment(const std::vector<MipLevel>& faces, ThreadPool& threadPool)
+{
+	PrefilteredEnvironment environment = {};
+	environment.Size = PREFILTERED_ENVIRONMENT_SIZE;
+
+	bool valid = faces.size() == 6 && faces[0].Width > 0 && faces[0].Width == faces[0].Height;
+	for (size_t i = 0; valid && i < faces.size(); i++)
+	{
+		valid = faces[i].Width == faces[0].Width &&
+			faces[i].Height == faces[0].Height &&
+			faces[i].Pixels.size() == (size_t)faces[i].Width * faces[i].Height * 4;
+	}
+	if (!valid)
+		return environment;
+
+	SourceCube source = DecodeSourceCube(faces);
+	unsigned int sourceSize = source.Sizes[0];
+
+	environment.Mips.resize(PREFILTERED_ENVIRONMENT_MIPS);
+	for (unsigned int mip = 0; mip < PREFILTERED_ENVIRONMENT_MIPS; mip++)
+	{
+		unsigned int size = PREFILTERED_ENVIRONMENT_SIZE >> mip;
+		std::vector<XMFLOAT4>& texels = environment.Mips[mip];
+		texels.resize((size_t)6 * size * size);
+
+		// A mirror just resamples the source, from the mip nearest this size
+		float mirrorMip = fmaxf(log2f((float)sourceSize / size), 0.0f);
+		std::vector<LobeSample> samples;
+		if (mip > 0)
+			samples = BuildLobeSamples(GetPrefilteredMipRoughness(mip), sourceSize);
+
+		threadPool.ParallelFor(6 * size, [&](unsigned int row)
+		{
+			unsigned int face = row / size;
+			unsigned int y = row % size;
+			for (unsigned int x = 0; x < size; x++)
+			{
+				XMFLOAT3 normal = GetCubeFaceDirection(face,
+					(x + 0.5f) * 2.0f / size - 1.0f,
+					(y + 0.5f) * 2.0f / size - 1.0f);
+
+				XMVECTOR color;
+				if (samples.empty())
+				{
+					color = SampleCube(source, normal, mirrorMip);
+				}
+				else
+				{
+					// Turn the lobe to face this texel's direction
+					XMVECTOR n = XMLoadFloat3(&normal);
+					XMVECTOR up = fabsf(normal.z) < 0.999f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(1, 0, 0, 0);
+					XMVECTOR tangent = XMVector3Normalize(XMVector3Cross(up, n));
+					XMVECTOR bitangent = XMVector3Cross(n, tangent);
+
+					color = XMVectorZero();
+					float totalWeight = 0.0f;
+					for (const LobeSample& sample : samples)
+					{
+						XMFLOAT3 l;
+						XMStoreFloat3(&l,
+							tangent * sample.Direction.x +
+							bitangent * sample.Direction.y +
+							n * sample.Direction.z);
+
+						color = XMVectorMultiplyAdd(SampleCube(source, l, sample.SourceMip), XMVectorReplicate(sample.Weight), color);
+						totalWeight += sample.Weight;
+					}
+					color /= totalWeight;
+				}
+
+				XMStoreFloat4(&texels[((size_t)face * size + y) * size + x], XMVectorSetW(color, 1.0f));
+			}
+		});
+	}
+
+	return environment;
+}
+
+BRDFLookupTable BakeBRDFLookupTable(ThreadPool& threadPool)
+{
+	BRDFLookupTable table = {};
+	table.Size = BRDF_LUT_SIZE;
+	table.Texels.resize((size_t)BRDF_LUT_SIZE * BRDF_LUT_SIZE);
+
+	threadPool.ParallelFor(BRDF_LUT_SIZE, [&](unsigned int row)
+	{
+		float roughness = (row + 0.5f) / BRDF_LUT_SIZE;
+		float alpha2 = GetGGXAlpha2(roughness);
+
+		for (unsigned int column = 0; column < BRDF_LUT_SIZE; column++)
+		{
+			float NdotV = (column + 0.5f) / BRDF_LUT_SIZE;
+			XMFLOAT3 v(sqrtf(1.0f - NdotV * NdotV), 0.0f, NdotV);
+
+			// Integrate the BRDF (without F0) against the GGX samples, split
+			// into the part F0 scales and the part added on regardless
+			float scale = 0.0f;
+			float bias = 0.0f;
+			for (unsigned int i = 0; i < BRDF_LUT_SAMPLES; i++)
+			{
+				XMFLOAT3 h = ImportanceSampleGGX(Hammersley(i, BRDF_LUT_SAMPLES), alpha2);
+				float VdotH = v.x * h.x + v.y * h.y + v.z * h.z;
+				float NdotL = 2.0f * VdotH * h.z - v.z;
+				if (NdotL <= 0.0f)
+					continue;
+
+				VdotH = fmaxf(VdotH, 0.0f);
+				float NdotH = fmaxf(h.z, 0.0f);
+
+				// The sample's BRDF * NdotL / pdf, with D cancelling out
+				float g = GeometrySchlickGGX(NdotV, roughness) * GeometrySchlickGGX(NdotL, roughness);
+				float visibility = g * VdotH / (NdotH * NdotV);
+				float fresnel = powf(1.0f - VdotH, 5.0f);
+
+				scale += (1.0f - fresnel) * visibility;
+				bias += fresnel * visibility;
+			}
+
+			table.Texels[(size_t)row * BRDF_LUT_SIZE + column] = XMFLOAT2(
+				scale / BRDF_LUT_SAMPLES,
+				bias / BRDF_LUT_SAMPLES);
+		}
+	});
+
+	return table;
+}
+
+unsigned long long HashCubemapFaces(const std::vector<MipLevel>& faces)
+{
+	unsigned long long hash = FNV1A_OFFSET_BASIS;
+	for (const MipLevel& face : faces)
+	{
+		hash = HashFNV1aBytes(&face.Width, sizeof(face.Width), hash);
+		hash = HashFNV1aBytes(&face.Height, sizeof(face.Height), hash);
+		hash = HashFNV1aBytes(face.Pixels.data(), face.Pixels.size(), hash);
+	}
+	return hash;
+}
+
+// Every setting the bake depends on
+static EnvironmentBakeHeader GetExpectedHeader(unsigned long long sourceHash)
+{
+	EnvironmentBakeHeader header = {};
+	header.Magic = CACHE_MAGIC;
+	header.Version = CACHE_VERSION;
+	header.SourceHash = sourceHash;
+	header.Size = PREFILTERED_ENVIRONMENT_SIZE;
+	header.Mips = PREFILTERED_ENVIRONMENT_MIPS;
+	header.Samples = PREFILTERED_ENVIRONMENT_SAMPLES;
+	header.BRDFSize = BRDF_LUT_SIZE;
+	header.BRDFSamples = BRDF_LUT_SAMPLES;
+	return header;
+}
+
+bool LoadEnvironmentBake(const std::wstring& cacheFile, unsigned long long sourceHash,
+	PrefilteredEnvironment& environmentOut, BRDFLookupTable& brdfOut)
+{
+	std::ifstream file(std::filesystem::path(cacheFile), std::ios::binary);
+	if (!file)
+		return false;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	// The settings are fixed, so a matching header means a known size
+	EnvironmentBakeHeader expected = GetExpectedHeader(sourceHash);
+	size_t expectedSize = sizeof(EnvironmentBakeHeader) + (size_t)BRDF_LUT_SIZE * BRDF_LUT_SIZE * sizeof(XMFLOAT2);
+	for (unsigned int mip = 0; mip < PREFILTERED_ENVIRONMENT_MIPS; mip++)
+	{
+		size_t size = PREFILTERED_ENVIRONMENT_SIZE >> mip;
+		expectedSize += 6 * size * size * sizeof(XMFLOAT4);
+	}
+
+	if (bytes.size() != expectedSize || memcmp(bytes.data(), &expected, sizeof(expected)) != 0)
+		return false;
+
+	const unsigned char* data = bytes.data() + sizeof(EnvironmentBakeHeader);
+
+	PrefilteredEnvironment environment = {};
+	environment.Size = PREFILTERED_ENVIRONMENT_SIZE;
+	environment.Mips.resize(PREFILTERED_ENVIRONMENT_MIPS);
+	for (unsigned int mip = 0; mip < PREFILTERED_ENVIRONMENT_MIPS; mip++)
+	{
+		size_t size = PREFILTERED_ENVIRONMENT_SIZE >> mip;
+		environment.Mips[mip].resize(6 * size * size);
+		memcpy(environment.Mips[mip].data(), data, environment.Mips[mip].size() * sizeof(XMFLOAT4));
+		data += environment.Mips[mip].size() * sizeof(XMFLOAT4);
+	}
+
+	BRDFLookupTable brdf = {};
+	brdf.Size = BRDF_LUT_SIZE;
+	brdf.Texels.resize((size_t)BRDF_LUT_SIZE * BRDF_LUT_SIZE);
+	memcpy(brdf.Texels.data(), data, brdf.Texels.size() * sizeof(XMFLOAT2));
+
+	environmentOut = std::move(environment);
+	brdfOut = std::move(brdf);
+	return true;
+}
+
+bool SaveEnvironmentBake(const std::wstring& cacheFile, unsigned long long sourceHash,
+	const PrefilteredEnvironment& environment, const BRDFLookupTable& brdf)
+{
+	// Only what the current settings would have baked
+	if (environment.Size != PREFILTERED_ENVIRONMENT_SIZE ||
+		environment.Mips.size() != PREFILTERED_ENVIRONMENT_MIPS ||
+		brdf.Size != BRDF_LUT_SIZE)
+		return false;
+
+	std::ofstream file(std::filesystem::path(cacheFile), std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	EnvironmentBakeHeader header = GetExpectedHeader(sourceHash);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const std::vector<XMFLOAT4>& mip : environment.Mips)
+		file.write(reinterpret_cast<const char*>(mip.data()), mip.size() * sizeof(XMFLOAT4));
+	file.write(reinterpret_cast<const char*>(brdf.Texels.data()), brdf.Texels.size() * sizeof(XMFLOAT2));
+	return file.good();
+}
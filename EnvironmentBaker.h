@@ -0,0 +1,76 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+// Prefiltered cube map - mip 0 is a mirror, the last mip is fully
+// rough, and the ones between step evenly through roughness.
+// Must match SKY_SPECULAR_MIPS in ShaderIncludes.hlsli.
+#define PREFILTERED_ENVIRONMENT_SIZE 128
+#define PREFILTERED_ENVIRONMENT_MIPS 6
+#define PREFILTERED_ENVIRONMENT_SAMPLES 256
+
+// Split-sum BRDF table - NdotV across, roughness down
+#define BRDF_LUT_SIZE 64
+#define BRDF_LUT_SAMPLES 512
+
+// --------------------------------------------------------
+// Bakes image-based specular lighting on the CPU, with the
+// split-sum approximation (Karis, "Real Shading in Unreal
+// Engine 4"):
+//
+//  - The environment, prefiltered with the GGX lobe at one
+//    roughness per mip, assuming the view is along the normal
+//  - A table of the scale and bias the rest of the BRDF
+//    applies to F0, by NdotV and roughness
+//
+// Both use the same roughness remapping as ShaderIncludes.hlsli
+// (D_GGX's a = roughness^2, G_SchlickGGX's k = (roughness + 1)^2
+// / 8), so image-based and direct lights match.
+//
+// Samples come from a Hammersley sequence, and every texel is
+// worked out on its own (spread over the thread pool), so the
+// results are exactly the same however the work is split.
+// Nothing in here touches Direct3D.
+// --------------------------------------------------------
+struct PrefilteredEnvironment
+{
+	unsigned int Size; // Of mip 0's faces
+
+	// Linear RGBA, six square faces per mip (+X, -X, +Y, -Y, +Z, -Z)
+	std::vector<std::vector<DirectX::XMFLOAT4>> Mips;
+};
+
+struct BRDFLookupTable
+{
+	unsigned int Size;
+	std::vector<DirectX::XMFLOAT2> Texels; // Scale and bias of F0, rows by roughness
+};
+
+// The roughness a prefiltered mip was baked at
+float GetPrefilteredMipRoughness(unsigned int mip);
+
+// faces - RGBA8 with the shaders' 2.2 gamma, all the same size.
+// Returns no mips if the faces don't fit.
+PrefilteredEnvironment PrefilterEnvironment(const std::vector<MipLevel>& faces, ThreadPool& threadPool);
+
+BRDFLookupTable BakeBRDFLookupTable(ThreadPool& threadPool);
+
+// --------------------------------------------------------
+// The bake is cached in one file, stamped with a hash of the
+// faces it came from and the settings above, and is baked
+// again if either changes
+// --------------------------------------------------------
+
+// 64-bit FNV-1a of the faces' sizes and pixels
+unsigned long long HashCubemapFaces(const std::vector<MipLevel>& faces);
+
+// False if the file is missing, damaged or from different faces
+bool LoadEnvironmentBake(const std::wstring& cacheFile, unsigned long long sourceHash,
+	PrefilteredEnvironment& environmentOut, BRDFLookupTable& brdfOut);
+bool SaveEnvironmentBake(const std::wstring& cacheFile, unsigned long long sourceHash,
+	const PrefilteredEnvironment& environment, const BRDFLookupTable& brdf);
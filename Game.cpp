@@ -6,6 +6,14 @@
 #include "Window.h"
 
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cfloat>
+#include <climits>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <random>
 
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
@@ -16,25 +24,80 @@
 #include "ImGui/imgui_impl_win32.h"
 
 #include "SimpleShader.h"
+#include "ConstantBuffer.h"
 #include "Material.h"
+#include "TextureArrayBuilder.h"
 
-#include "WICTextureLoader.h"
+#include "TextureCooker.h"
+#include "TextureStreaming.h"
 
 // For the DirectX Math library
 using namespace DirectX;
 
+// Each material's textures, in the order they're loaded
+static const char* materialTextureNames[3] = { "Albedo", "NormalMap", "ORMMap" };
+
 // --------------------------------------------------------
 // Called once per program, after the window and graphics API
 // are initialized but before the game loop begins
 // --------------------------------------------------------
 void Game::Initialize()
 {
+	// Shadow settings are needed before the shadow map can be created
+	shadowMapResolution = 1024;
+	numShadowCascades = 3;
+	cascadeSplitLambda = 0.75f;
+	shadowDistance = 40.0f;
+	for (unsigned int ii = 0; ii < MAX_SHADOW_CASCADES; ii++)
+		cascadeSplitDistances[ii] = 0.0f; // Unused cascades still go to the shader
+	numShadowCasterDraws = 0;
+	shadowCacheEnabled = true;
+	virtualShadowsEnabled = false;
+	virtualShadowLight = -1;
+	virtualShadowExtent = 256.0f;
+	XMStoreFloat4x4(&virtualShadowView, XMMatrixIdentity());
+	XMStoreFloat4x4(&virtualShadowProjection, XMMatrixIdentity());
+	XMStoreFloat4x4(&virtualShadowViewProjection, XMMatrixIdentity());
+	cachedStaticShadowVersion = 0;
+	numShadowCacheHits = 0;
+	numShadowTileCopies = 0;
+
+	// Worker threads are shared by shader loading, culling and lighting
+	threadPool = std::make_shared<ThreadPool>();
+
+	// Images decode on those workers, and at most this many upload per frame
+	imageLoader = std::make_shared<ImageLoader>(threadPool);
+	maxTextureUploadsPerFrame = 4;
+
+	// Mips of cooked textures stream in within this much memory
+	textureStreamingBudget = 32.0f;
+
+	skyAmbientIntensity = 1.0f;
+
+	// The sun starts straight overhead, like lights[0]
+	proceduralSkyEnabled = false;
+	atmosphere = GetEarthAtmosphere();
+	sunIlluminance = 8.0f;
+	sunElevation = 90.0f;
+	sunAzimuth = 0.0f;
+
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
 	CreateEntities();
 	CreateShadowMapSetup();
+	CreateVirtualShadowMapSetup();
 	CreatePostProcessSetup();
+	CreateOcclusionCullingSetup();
+
+	lightPacker = std::make_shared<LightPacker>();
+
+	// Constants that change between draws are streamed through one shared buffer
+	ISimpleShader::ConstantRing = std::make_shared<ConstantRingBuffer>(Graphics::Device, Graphics::Context);
+	constantBytesUploaded = 0;
+	constantBytesRequested = 0;
+	lightClusterBuilder = std::make_shared<LightClusterBuilder>(threadPool);
+	objectLightSelector = std::make_shared<ObjectLightSelector>(threadPool);
 
 	// Set initial graphics API state
 	//  - These settings persist until we change them
@@ -88,6 +151,27 @@ void Game::Initialize()
 	lights[4].Color = XMFLOAT3(0.8f, 0.5f, 0.2f);
 	lights[4].Intensity = 2.0f;
 
+	// One of each kind of light casts shadows
+	lights[1].CastShadows = true;
+	lights[2].CastShadows = true;
+	lights[4].CastShadows = true;
+
+	// No atlas tiles until UpdateLightMatrices() hands them out
+	for (Light& light : lights)
+	{
+		light.ShadowIndex = -1;
+	}
+
+	// Anything past these is a randomly placed test light
+	numBaseLights = lights.size();
+	numExtraLights = 0;
+	lightClusterBuildTime = 0.0f;
+	lightBufferCapacity = 0;
+	lightIndexBufferCapacity = 0;
+	clusterRangeBufferCapacity = 0;
+	perObjectLightsEnabled = false;
+	objectLightSelectTime = 0.0f;
+
 	activeCameraIdx = 0;
 
 
@@ -107,6 +191,17 @@ void Game::Initialize()
 	darkModeEnabled = true;
 
 	blurRadius = 5;
+	blurMode = (int)BlurMode::Separable;
+	blurCheckRequested = false;
+	blurChecked = false;
+	blurCheckMode = 0;
+	blurCheckRadius = 0;
+	blurCheckDifference = 0;
+	blurCheckPixels = 0;
+	blurCheckTime = 0.0f;
+
+	occlusionCullingEnabled = true;
+	numOccludedEntities = 0;
 
 	if (!darkModeEnabled)
 	{
@@ -127,6 +222,8 @@ void Game::Initialize()
 // --------------------------------------------------------
 Game::~Game()
 {
+	ISimpleShader::ConstantRing.reset();
+
 	// ImGui clean up
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
@@ -134,73 +231,284 @@ Game::~Game()
 }
 
 
+// --------------------------------------------------------
+// Queues a source image to decode (with its mips) on the
+// thread pool.  srv is filled in when the image loader
+// uploads it, so it has to outlive the load.
+// --------------------------------------------------------
+void Game::LoadTexture(const std::wstring& file, MipContent content, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	imageLoader->Load(file, content, [this, &srv](LoadedImage& image)
+	{
+		CreateTextureFromImage(image, srv);
+	});
+}
+
+// --------------------------------------------------------
+// Same, but packs a material's separate occlusion/roughness/
+// metalness maps into one (uncompressed) ORM texture
+// --------------------------------------------------------
+void Game::LoadORMTexture(const std::wstring& materialPath, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	ORMSourceFiles files = GetORMSourceFiles(materialPath);
+	imageLoader->Load([files](LoadedImage& image)
+	{
+		unsigned int width = 0;
+		unsigned int height = 0;
+		std::vector<unsigned char> orm;
+		if (!LoadORMImage(files, width, height, orm, image.Error))
+			return false;
+
+		image.Mips = GenerateMipChain(orm.data(), width, height, MipContent::Data);
+		return true;
+	},
+	[this, &srv](LoadedImage& image)
+	{
+		CreateTextureFromImage(image, srv);
+	});
+}
+
+// --------------------------------------------------------
+// Uploads a decoded RGBA image and its mips as an
+// immutable texture, or reports why it couldn't be decoded
+// --------------------------------------------------------
+void Game::CreateTextureFromImage(const LoadedImage& image, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	if (image.Mips.empty())
+	{
+		std::string error = image.Error + "\n";
+		printf_s("%s", error.c_str());
+		OutputDebugStringA(error.c_str());
+		return;
+	}
+
+	std::vector<D3D11_SUBRESOURCE_DATA> mipData(image.Mips.size());
+	for (size_t m = 0; m < image.Mips.size(); m++)
+	{
+		mipData[m].pSysMem = image.Mips[m].Pixels.data();
+		mipData[m].SysMemPitch = image.Mips[m].Width * 4;
+	}
+
+	D3D11_TEXTURE2D_DESC texDesc{};
+	texDesc.Width = image.Mips[0].Width;
+	texDesc.Height = image.Mips[0].Height;
+	texDesc.MipLevels = (UINT)image.Mips.size();
+	texDesc.ArraySize = 1;
+	texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Graphics::Device->CreateTexture2D(&texDesc, mipData.data(), texture.GetAddressOf());
+	Graphics::Device->CreateShaderResourceView(texture.Get(), 0, srv.ReleaseAndGetAddressOf());
+	numDecodedTextures++;
+}
+
+// --------------------------------------------------------
+// Points materials at the streamer's current arrays, which
+// are replaced whenever mips stream in or out
+// --------------------------------------------------------
+void Game::BindStreamedTextures()
+{
+	for (unsigned int m = 0; m < 4; m++)
+	{
+		for (unsigned int t = 0; t < 3; t++)
+		{
+			unsigned int index = materialStreamedTextures[m][t];
+			if (index != UINT_MAX)
+				materials[m]->AddTextureSRV(materialTextureNames[t], textureStreamer->GetArraySRV(index), textureStreamer->GetSlice(index));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Asks for the mip each visible entity's textures need at
+// its size on screen, then lets the streamer load and evict
+// --------------------------------------------------------
+void Game::UpdateTextureStreaming()
+{
+	std::shared_ptr<Camera> camera = cameras[activeCameraIdx];
+	XMFLOAT4X4 cameraView = camera->GetViewMatrix();
+	XMFLOAT4X4 cameraProjection = camera->GetProjectionMatrix();
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+
+	BoundingFrustum cameraFrustum(XMLoadFloat4x4(&cameraProjection));
+	cameraFrustum.Transform(cameraFrustum, XMMatrixInverse(nullptr, XMLoadFloat4x4(&cameraView)));
+
+	// Pixels per world unit at a distance of 1
+	float screenScale = (float)Window::Height() / (2.0f * tanf(camera->m_fov * 0.5f));
+
+	textureStreamer->SetBudget((unsigned long long)(textureStreamingBudget * 1024 * 1024));
+
+	// Decoded images and streamed mips share one limit on uploads per frame
+	unsigned int maxUploads = (unsigned int)maxTextureUploadsPerFrame;
+	unsigned int uploads = imageLoader->Upload(maxUploads);
+
+	for (const std::shared_ptr<Entity>& entity : scene)
+	{
+		BoundingBox worldBounds = entity->GetWorldBounds();
+		if (!cameraFrustum.Intersects(worldBounds) ||
+			(occlusionCullingEnabled && !entity->IsOccluder() && !occlusionCuller->IsVisible(worldBounds)))
+			continue;
+
+		unsigned int m = 0;
+		while (m < 4 && materials[m] != entity->GetMaterial())
+			m++;
+		if (m == 4)
+			continue;
+
+		// Distance to the closest point of the bounds
+		XMVECTOR offset = XMVectorAbs(XMLoadFloat3(&cameraPosition) - XMLoadFloat3(&worldBounds.Center));
+		offset = XMVectorMax(offset - XMLoadFloat3(&worldBounds.Extents), XMVectorZero());
+		float distance = XMVectorGetX(XMVector3Length(offset));
+
+		// The largest scale, since that's the way big, flat things (like the
+		// floor) are stretched
+		XMFLOAT3 scale = entity->GetTransform()->GetScale();
+		float worldScale = fmaxf(fabsf(scale.x), fmaxf(fabsf(scale.y), fabsf(scale.z)));
+		XMFLOAT2 uvScale = materials[m]->m_constants.uvScale;
+		float uvPerWorldUnit = entity->GetMesh()->GetUVDensity() * fmaxf(fabsf(uvScale.x), fabsf(uvScale.y)) / worldScale;
+
+		for (unsigned int t = 0; t < 3; t++)
+		{
+			unsigned int index = materialStreamedTextures[m][t];
+			if (index == UINT_MAX)
+				continue;
+
+			textureStreamer->RequestMip(index,
+				ComputeRequiredMip((float)textureStreamer->GetWidth(index), uvPerWorldUnit, distance, screenScale));
+		}
+	}
+
+	if (textureStreamer->Update(maxUploads - uploads))
+	{
+		BindStreamedTextures();
+	}
+}
+
 // --------------------------------------------------------
 // Creates the entities we're going to draw
 // --------------------------------------------------------
 void Game::CreateEntities()
 {
 	// Load shaders
+	//  - The files (and their reflection data) are read on the worker
+	//    threads, then the shaders are created here from what was read
+	auto loadStart = std::chrono::high_resolution_clock::now();
+
+	const wchar_t* shaderFileNames[] =
+	{
+		L"VertexShader.cso",
+		L"SkyVertexShader.cso",
+		L"ShadowMapVS.cso",
+		L"ShadowTileClearVS.cso",
+		L"PostProcessVS.cso",
+		L"PixelShader.cso",
+		L"SkyPixelShader.cso",
+		L"blurPS.cso",
+		L"chromaticAberPS.cso",
+		L"ShadowTileCopyPS.cso",
+		L"blurSlidingCS.cso",
+	};
+	const unsigned int shaderFileCount = sizeof(shaderFileNames) / sizeof(shaderFileNames[0]);
+
+	std::vector<SimpleShaderFile> shaderFiles(shaderFileCount);
+	threadPool->ParallelFor(shaderFileCount, [&](unsigned int ii)
+	{
+		ISimpleShader::ReadShaderFile(FixPath(shaderFileNames[ii]).c_str(), shaderFiles[ii]);
+	});
 
 	// Vertex Shaders
 	std::shared_ptr<SimpleVertexShader> vs = std::make_shared<SimpleVertexShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"VertexShader.cso").c_str());
+		Graphics::Device, Graphics::Context, shaderFiles[0]);
 	std::shared_ptr<SimpleVertexShader> skyVS = std::make_shared<SimpleVertexShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"SkyVertexShader.cso").c_str());
+		Graphics::Device, Graphics::Context, shaderFiles[1]);
 	shadowMapVS = std::make_shared<SimpleVertexShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"ShadowMapVS.cso").c_str());
+		Graphics::Device, Graphics::Context, shaderFiles[2]);
+	shadowWorldHandle = shadowMapVS->GetVariableHandle("world");
+	shadowTileClearVS = std::make_shared<SimpleVertexShader>(
+		Graphics::Device, Graphics::Context, shaderFiles[3]);
 	ppVS = std::make_shared<SimpleVertexShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"PostProcessVS.cso").c_str());
+		Graphics::Device, Graphics::Context, shaderFiles[4]);
 
 	// Pixel Shaders
 	std::shared_ptr<SimplePixelShader> ps = std::make_shared<SimplePixelShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"PixelShader.cso").c_str());
+		Graphics::Device, Graphics::Context, shaderFiles[5]);
 	std::shared_ptr<SimplePixelShader> skyPS = std::make_shared<SimplePixelShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"SkyPixelShader.cso").c_str());
+		Graphics::Device, Graphics::Context, shaderFiles[6]);
 	blurPS = std::make_shared<SimplePixelShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"blurPS.cso").c_str());
+		Graphics::Device, Graphics::Context, shaderFiles[7]);
 	caPS = std::make_shared<SimplePixelShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"chromaticAberPS.cso").c_str());
+		Graphics::Device, Graphics::Context, shaderFiles[8]);
+	shadowTileCopyPS = std::make_shared<SimplePixelShader>(
+		Graphics::Device, Graphics::Context, shaderFiles[9]);
+
+	// Compute Shaders
+	blurSlidingCS = std::make_shared<SimpleComputeShader>(
+		Graphics::Device, Graphics::Context, shaderFiles[10]);
+
+	std::chrono::duration<float, std::milli> loadElapsed = std::chrono::high_resolution_clock::now() - loadStart;
+	shaderLoadTime = loadElapsed.count();
+	numShaderReflectionsCached = 0;
+	for (const SimpleShaderFile& file : shaderFiles)
+	{
+		if (file.ReflectionCached)
+			numShaderReflectionsCached++;
+	}
 
 	// Load textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneAlbedoSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneNormalsSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneRoughnessSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneMetalnessSRV;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintAlbedoSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintNormalsSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintRoughnessSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintMetalnessSRV;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedAlbedoSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedNormalsSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedRoughnessSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedMetalnessSRV;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodAlbedoSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodNormalsSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodRoughnessSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodMetalnessSRV;
-
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/cobblestone_albedo.png").c_str(), nullptr, cobblestoneAlbedoSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/cobblestone_normals.png").c_str(), nullptr, cobblestoneNormalsSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/cobblestone_roughness.png").c_str(), nullptr, cobblestoneRoughnessSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/cobblestone_metal.png").c_str(), nullptr, cobblestoneMetalnessSRV.GetAddressOf());
-
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/paint_albedo.png").c_str(), nullptr, paintAlbedoSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/paint_normals.png").c_str(), nullptr, paintNormalsSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/paint_roughness.png").c_str(), nullptr, paintRoughnessSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/paint_metal.png").c_str(), nullptr, paintMetalnessSRV.GetAddressOf());
-
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/scratched_albedo.png").c_str(), nullptr, scratchedAlbedoSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/scratched_normals.png").c_str(), nullptr, scratchedNormalsSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/scratched_roughness.png").c_str(), nullptr, scratchedRoughnessSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/scratched_metal.png").c_str(), nullptr, scratchedMetalnessSRV.GetAddressOf());
-
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/wood_albedo.png").c_str(), nullptr, woodAlbedoSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/wood_normals.png").c_str(), nullptr, woodNormalsSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/wood_roughness.png").c_str(), nullptr, woodRoughnessSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/PBR/wood_metal.png").c_str(), nullptr, woodMetalnessSRV.GetAddressOf());
+	//  - Run "TextureCook" (from CMakeLists.txt) once to
+	//    use compressed versions, which stream their mips in as they're needed
+	//  - Roughness and metalness come packed in one ORM texture
+	//  - Anything uncooked is loaded whole, decoded on the thread pool
+	numCookedTextures = 0;
+	numDecodedTextures = 0;
+	const wchar_t* materialFileNames[4] = { L"cobblestone", L"paint", L"scratched", L"wood" };
+	const wchar_t* materialTextureSuffixes[3] = { L"_albedo.png", L"_normals.png", nullptr };
+	const MipContent materialTextureContents[3] = { MipContent::SRGBColor, MipContent::NormalMap, MipContent::Data };
+
+	textureStreamer = std::make_shared<TextureStreamer>(Graphics::Device, Graphics::Context, threadPool,
+		(unsigned long long)(textureStreamingBudget * 1024 * 1024));
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> materialTextures[4][3];
+	for (unsigned int m = 0; m < 4; m++)
+	{
+		std::wstring materialPath = FixPath(L"../../Assets/Textures/PBR/") + materialFileNames[m];
+		for (unsigned int t = 0; t < 3; t++)
+		{
+			std::wstring sourceFile = materialTextureSuffixes[t] ? materialPath + materialTextureSuffixes[t] : L"";
+			std::wstring cookedFile = materialTextureSuffixes[t] ? GetCookedTexturePath(sourceFile) : GetORMTexturePath(materialPath);
+
+			materialStreamedTextures[m][t] = UINT_MAX;
+			if (std::filesystem::exists(cookedFile))
+			{
+				materialStreamedTextures[m][t] = textureStreamer->Add(cookedFile);
+				numCookedTextures++;
+			}
+			else if (materialTextureSuffixes[t])
+			{
+				LoadTexture(sourceFile, materialTextureContents[t], materialTextures[m][t]);
+			}
+			else
+			{
+				LoadORMTexture(materialPath, materialTextures[m][t]);
+			}
+		}
+	}
+	textureStreamer->Build();
+
+	// The sky's faces decode alongside them
+	const wchar_t* skyFaceNames[6] = { L"right", L"left", L"up", L"down", L"front", L"back" };
+	std::vector<MipLevel> skyFaces(6);
+	for (unsigned int f = 0; f < 6; f++)
+	{
+		std::wstring faceFile = FixPath(L"../../Assets/Textures/CubeMaps/Clouds_Blue/") + skyFaceNames[f] + L".png";
+		imageLoader->Load(faceFile, [&skyFaces, f](LoadedImage& image)
+		{
+			if (!image.Mips.empty())
+				skyFaces[f] = std::move(image.Mips[0]);
+		});
+	}
 
 	// Create Sampler State
 	D3D11_SAMPLER_DESC samplerDesc{};
@@ -221,29 +529,37 @@ void Game::CreateEntities()
 	materials[2] = std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), vs, ps, 0.0f);
 	materials[3] = std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), vs, ps, 1.0f);
 
-	materials[0]->AddSampler("BasicSampler", samplerState);
-	materials[0]->AddTextureSRV("Albedo", cobblestoneAlbedoSRV);
-	materials[0]->AddTextureSRV("NormalMap", cobblestoneNormalsSRV);
-	materials[0]->AddTextureSRV("RoughnessMap", cobblestoneRoughnessSRV);
-	materials[0]->AddTextureSRV("MetalnessMap", cobblestoneMetalnessSRV);
-
-	materials[1]->AddSampler("BasicSampler", samplerState);
-	materials[1]->AddTextureSRV("Albedo", paintAlbedoSRV);
-	materials[1]->AddTextureSRV("NormalMap", paintNormalsSRV);
-	materials[1]->AddTextureSRV("RoughnessMap", paintRoughnessSRV);
-	materials[1]->AddTextureSRV("MetalnessMap", paintMetalnessSRV);
-
-	materials[2]->AddSampler("BasicSampler", samplerState);
-	materials[2]->AddTextureSRV("Albedo", scratchedAlbedoSRV);
-	materials[2]->AddTextureSRV("NormalMap", scratchedNormalsSRV);
-	materials[2]->AddTextureSRV("RoughnessMap", scratchedRoughnessSRV);
-	materials[2]->AddTextureSRV("MetalnessMap", scratchedMetalnessSRV);
-
-	materials[3]->AddSampler("BasicSampler", samplerState);
-	materials[3]->AddTextureSRV("Albedo", woodAlbedoSRV);
-	materials[3]->AddTextureSRV("NormalMap", woodNormalsSRV);
-	materials[3]->AddTextureSRV("RoughnessMap", woodRoughnessSRV);
-	materials[3]->AddTextureSRV("MetalnessMap", woodMetalnessSRV);
+	// Group the PBR textures into arrays by size and format, so materials
+	// sharing arrays only differ by the slice indices in their constants
+	//  - Streamed textures are already in the streamer's arrays
+	//  - Everything else has to finish decoding first
+	imageLoader->UploadAll();
+	TextureArrayBuilder arrayBuilder;
+	unsigned int arrayTextureIndices[4][3];
+	for (unsigned int m = 0; m < 4; m++)
+	{
+		for (unsigned int t = 0; t < 3; t++)
+		{
+			if (materialStreamedTextures[m][t] == UINT_MAX)
+				arrayTextureIndices[m][t] = arrayBuilder.Add(materialTextures[m][t]);
+		}
+	}
+	arrayBuilder.Build(Graphics::Device, Graphics::Context);
+	numMaterialTextureArrays = arrayBuilder.GetArrayCount() + textureStreamer->GetArrayCount();
+
+	for (unsigned int m = 0; m < 4; m++)
+	{
+		materials[m]->AddSampler("BasicSampler", samplerState);
+		for (unsigned int t = 0; t < 3; t++)
+		{
+			if (materialStreamedTextures[m][t] != UINT_MAX)
+				continue;
+
+			unsigned int index = arrayTextureIndices[m][t];
+			materials[m]->AddTextureSRV(materialTextureNames[t], arrayBuilder.GetArraySRV(index), arrayBuilder.GetSlice(index));
+		}
+	}
+	BindStreamedTextures();
 
 	meshes[0] = std::make_shared<Mesh>(FixPath("../../Assets/Models/sphere.obj").c_str(), "Sphere");
 	meshes[1] = std::make_shared<Mesh>(FixPath("../../Assets/Models/cube.obj").c_str(), "Cube");
@@ -272,26 +588,34 @@ void Game::CreateEntities()
 	// floor
 	scene[15] = std::make_shared<Entity>(meshes[1], materials[3]);
 
+	// Large, simple shapes make the best occluders
+	scene[1]->SetOccluder(true);
+	scene[6]->SetOccluder(true);
+	scene[11]->SetOccluder(true);
+	scene[15]->SetOccluder(true);
+
+	// The floor never moves, so its shadow depth can be cached
+	scene[15]->SetStatic(true);
+
 	// Create sky
 	sky = std::make_shared<Sky>(
 		meshes[1],
 		samplerState,
-		FixPath(L"../../Assets/Textures/CubeMaps/Clouds_Blue/right.png").c_str(),
-		FixPath(L"../../Assets/Textures/CubeMaps/Clouds_Blue/left.png").c_str(),
-		FixPath(L"../../Assets/Textures/CubeMaps/Clouds_Blue/up.png").c_str(),
-		FixPath(L"../../Assets/Textures/CubeMaps/Clouds_Blue/down.png").c_str(),
-		FixPath(L"../../Assets/Textures/CubeMaps/Clouds_Blue/front.png").c_str(),
-		FixPath(L"../../Assets/Textures/CubeMaps/Clouds_Blue/back.png").c_str(),
+		skyFaces,
+		threadPool,
+		FixPath(L"../../Assets/Textures/CubeMaps/Clouds_Blue/environment.bake"),
 		skyPS,
 		skyVS);
 }
 
 void Game::CreateShadowMapSetup()
 {
-	// Shadow texture
+	shadowAtlas = std::make_shared<ShadowAtlas>(4096);
+
+	// Shadow atlas - one texture shared by every shadowed light
 	D3D11_TEXTURE2D_DESC shadowDesc = {};
-	shadowDesc.Width = 1024;
-	shadowDesc.Height = 1024;
+	shadowDesc.Width = shadowAtlas->GetSize();
+	shadowDesc.Height = shadowAtlas->GetSize();
 	shadowDesc.ArraySize = 1;
 	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
 	shadowDesc.CPUAccessFlags = 0;
@@ -302,11 +626,8 @@ void Game::CreateShadowMapSetup()
 	shadowDesc.SampleDesc.Quality = 0;
 	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
 
-
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
 	Graphics::Device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
 
-	// Depth/stencil view
 	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
 	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
 	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
@@ -316,97 +637,888 @@ void Game::CreateShadowMapSetup()
 		&shadowDSDesc,
 		shadowDSV.GetAddressOf());
 
-	// SRV for shadow map
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
 	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Texture2D.MipLevels = 1;
 	srvDesc.Texture2D.MostDetailedMip = 0;
 
-	Graphics::Device->CreateShaderResourceView(
-		shadowTexture.Get(),
-		&srvDesc,
-		shadowSRV.GetAddressOf());
+	Graphics::Device->CreateShaderResourceView(
+		shadowTexture.Get(),
+		&srvDesc,
+		shadowSRV.GetAddressOf());
+
+	D3D11_RASTERIZER_DESC shadowRastDesc = {};
+	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
+	shadowRastDesc.CullMode = D3D11_CULL_BACK;
+	shadowRastDesc.DepthClipEnable = true;
+	shadowRastDesc.DepthBias = 1000;
+	shadowRastDesc.SlopeScaledDepthBias = 1.0f;
+	Graphics::Device->CreateRasterizerState(&shadowRastDesc, &shadowRasterizer);
+
+	D3D11_SAMPLER_DESC shadowSampDesc = {};
+	shadowSampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR;
+	shadowSampDesc.ComparisonFunc = D3D11_COMPARISON_LESS;
+	shadowSampDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+	shadowSampDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+	shadowSampDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+	shadowSampDesc.BorderColor[0] = 1.0f; // Only need the first component
+	Graphics::Device->CreateSamplerState(&shadowSampDesc, &shadowSampler);
+
+	// Always passes and writes, so the tile clear triangle overwrites whatever was there
+	D3D11_DEPTH_STENCIL_DESC clearDepthDesc = {};
+	clearDepthDesc.DepthEnable = true;
+	clearDepthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	clearDepthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	Graphics::Device->CreateDepthStencilState(&clearDepthDesc, shadowTileClearDepthState.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// The static casters' copy of the shadow atlas, created when
+// caching is turned on and released when it's turned off
+// --------------------------------------------------------
+void Game::CreateStaticShadowAtlas()
+{
+	// Same layout as the live atlas, so tiles copy texel for texel
+	D3D11_TEXTURE2D_DESC staticDesc = {};
+	shadowTexture->GetDesc(&staticDesc);
+	Graphics::Device->CreateTexture2D(&staticDesc, 0, staticShadowTexture.GetAddressOf());
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC staticDSDesc = {};
+	staticDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	staticDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	Graphics::Device->CreateDepthStencilView(
+		staticShadowTexture.Get(),
+		&staticDSDesc,
+		staticShadowDSV.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC staticSRVDesc = {};
+	staticSRVDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	staticSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	staticSRVDesc.Texture2D.MipLevels = 1;
+	Graphics::Device->CreateShaderResourceView(
+		staticShadowTexture.Get(),
+		&staticSRVDesc,
+		staticShadowSRV.GetAddressOf());
+
+	// Nothing has been drawn into it yet
+	shadowCacheValid.assign(shadowViews.size(), false);
+}
+
+// --------------------------------------------------------
+// Builds the shadow views for every shadowed light and
+// assigns each one a tile in the shadow atlas.
+//  - Directional lights split the active camera's frustum
+//    (up to shadowDistance) into cascades
+//  - Spot lights get one perspective view of their cone
+//  - Point lights get six 90 degree views
+// --------------------------------------------------------
+void Game::UpdateLightMatrices()
+{
+	std::shared_ptr<Camera>& camera = cameras[activeCameraIdx];
+	XMFLOAT4X4 cameraView = camera->GetViewMatrix();
+	XMFLOAT4X4 cameraProjection = camera->GetProjectionMatrix();
+	float cameraNear = camera->GetNearDistance();
+	float cameraFar = camera->GetFarDistance();
+	float maxDistance = shadowDistance < cameraFar ? shadowDistance : cameraFar;
+
+	// Cascade splits only depend on the camera, so every directional light shares them
+	ShadowCascades::ComputeSplitDistances(cameraNear, maxDistance, cascadeSplitLambda, numShadowCascades, cascadeSplitDistances);
+
+	XMFLOAT3 sliceCorners[MAX_SHADOW_CASCADES][8];
+	float sliceNear = cameraNear;
+	for (int ii = 0; ii < numShadowCascades; ii++)
+	{
+		ShadowCascades::GetFrustumSliceCorners(
+			cameraView, cameraProjection,
+			cameraNear, cameraFar,
+			sliceNear, cascadeSplitDistances[ii],
+			sliceCorners[ii]);
+		sliceNear = cascadeSplitDistances[ii];
+	}
+
+	// Everything that could possibly cast a shadow
+	BoundingBox sceneBounds = scene[0]->GetWorldBounds();
+	for (const std::shared_ptr<Entity>& entity : scene)
+	{
+		BoundingBox::CreateMerged(sceneBounds, sceneBounds, entity->GetWorldBounds());
+	}
+
+	shadowViews.clear();
+	shadowTileSizes.clear();
+	virtualShadowLight = -1;
+	for (size_t lightIndex = 0; lightIndex < lights.size(); lightIndex++)
+	{
+		Light& light = lights[lightIndex];
+		light.ShadowIndex = -1;
+		if (!light.CastShadows)
+		{
+			continue;
+		}
+
+		// One directional light can use the virtual shadow map instead of cascades
+		if (virtualShadowsEnabled && virtualShadowLight < 0 && light.Type == LIGHT_TYPE_DIRECTIONAL)
+		{
+			virtualShadowLight = (int)lightIndex;
+			continue;
+		}
+
+		size_t viewCount =
+			light.Type == LIGHT_TYPE_DIRECTIONAL ? numShadowCascades :
+			light.Type == LIGHT_TYPE_POINT ? 6 : 1;
+
+		// Out of room in the shader's arrays
+		if (shadowViews.size() + viewCount > MAX_SHADOW_VIEWS)
+		{
+			continue;
+		}
+
+		light.ShadowIndex = (int)shadowViews.size();
+
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+		{
+			sliceNear = cameraNear;
+			for (int ii = 0; ii < numShadowCascades; ii++)
+			{
+				ShadowView cascade = ShadowCascades::FitCascade(
+					sliceCorners[ii],
+					light.Direction,
+					sceneBounds,
+					shadowMapResolution);
+				cascade.SplitNear = sliceNear;
+				cascade.SplitFar = cascadeSplitDistances[ii];
+				sliceNear = cascadeSplitDistances[ii];
+
+				shadowViews.push_back(cascade);
+				shadowTileSizes.push_back(shadowMapResolution);
+			}
+		}
+		else if (light.Type == LIGHT_TYPE_SPOT)
+		{
+			shadowViews.push_back(ShadowCascades::FitSpotLight(
+				light.Position, light.Direction, light.SpotOuterAngle, light.Range));
+			shadowTileSizes.push_back(GetShadowTileSize(light));
+		}
+		else
+		{
+			// Each face only covers a sixth of the light's reach
+			unsigned int faceSize = GetShadowTileSize(light) / 2;
+			for (unsigned int face = 0; face < 6; face++)
+			{
+				shadowViews.push_back(ShadowCascades::FitPointLightFace(light.Position, light.Range, face));
+				shadowTileSizes.push_back(faceSize);
+			}
+		}
+	}
+
+	// Only repacks when the requested sizes change, and then every
+	// cached tile is somewhere else in the atlas
+	if (shadowAtlas->Allocate(shadowTileSizes))
+	{
+		shadowCacheValid.assign(shadowViews.size(), false);
+		shadowTileHasDynamicCasters.assign(shadowViews.size(), true);
+		cachedShadowViews.resize(shadowViews.size());
+	}
+}
+
+// --------------------------------------------------------
+// Sizes a spot or point light's tile by roughly how much of
+// the screen its range covers. Rounded down to a power of two
+// so small camera moves don't change the atlas layout.
+// --------------------------------------------------------
+unsigned int Game::GetShadowTileSize(const Light& light)
+{
+	XMFLOAT3 cameraPosition = cameras[activeCameraIdx]->GetTransform()->GetPosition();
+	float distance = XMVectorGetX(XMVector3Length(
+		XMVectorSubtract(XMLoadFloat3(&light.Position), XMLoadFloat3(&cameraPosition))));
+
+	// Inside the light's range it can cover the whole screen
+	float coverage = distance > light.Range ? light.Range / distance : 1.0f;
+
+	unsigned int maxSize = shadowMapResolution / 2;
+	unsigned int size = 128;
+	while (size * 2 <= maxSize && size * 2 <= maxSize * coverage)
+	{
+		size *= 2;
+	}
+	return size;
+}
+
+void Game::SetShadowTileViewport(const unsigned int viewIndex)
+{
+	const ShadowAtlasTile& tile = shadowAtlas->GetTile(viewIndex);
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.TopLeftX = (float)tile.X;
+	viewport.TopLeftY = (float)tile.Y;
+	viewport.Width = (float)tile.Size;
+	viewport.Height = (float)tile.Size;
+	viewport.MaxDepth = 1.0f;
+	Graphics::Context->RSSetViewports(1, &viewport);
+}
+
+// --------------------------------------------------------
+// Picks the dynamic entities worth drawing into one shadow view.
+// 
+// For cascades, receivers are whatever the camera can see inside
+// both the cascade's slice of the view frustum and the light's
+// volume. A caster only matters if it overlaps those receivers
+// in light space and sits between them and the light, so the
+// receiver region is extruded all the way back to the light's
+// near plane before testing casters against it. This keeps
+// off-screen casters that throw shadows onto visible objects.
+//
+// Spot and point views are perspective, which boxes don't
+// survive, so those just keep casters inside the light's frustum.
+// --------------------------------------------------------
+void Game::CullShadowCasters(const ShadowView& view)
+{
+	shadowCasters.clear();
+
+	if (view.Perspective)
+	{
+		BoundingFrustum lightFrustum(XMLoadFloat4x4(&view.Projection));
+		lightFrustum.Transform(lightFrustum, XMMatrixInverse(nullptr, XMLoadFloat4x4(&view.View)));
+
+		for (const std::shared_ptr<Entity>& entity : scene)
+		{
+			// Static casters come from the cached static shadow map
+			if (!entity->IsStatic() && lightFrustum.Intersects(entity->GetWorldBounds()))
+			{
+				shadowCasters.push_back(entity);
+			}
+		}
+		return;
+	}
+
+	// World space slice of the camera frustum covered by this cascade
+	std::shared_ptr<Camera>& camera = cameras[activeCameraIdx];
+	XMFLOAT4X4 cameraView = camera->GetViewMatrix();
+	XMFLOAT4X4 cameraProjection = camera->GetProjectionMatrix();
+
+	BoundingFrustum cameraFrustum(XMLoadFloat4x4(&cameraProjection));
+	cameraFrustum.Near = view.SplitNear;
+	cameraFrustum.Far = view.SplitFar;
+	cameraFrustum.Transform(cameraFrustum, XMMatrixInverse(nullptr, XMLoadFloat4x4(&cameraView)));
+
+	// The light projection is orthographic, so boxes stay boxes in its clip space,
+	// where the light volume is simply [-1,1] x [-1,1] x [0,1]
+	XMMATRIX lightViewProjection = XMMatrixMultiply(
+		XMLoadFloat4x4(&view.View),
+		XMLoadFloat4x4(&view.Projection));
+	BoundingBox lightVolume(XMFLOAT3(0.0f, 0.0f, 0.5f), XMFLOAT3(1.0f, 1.0f, 0.5f));
+
+	std::vector<BoundingBox> lightSpaceBounds(std::size(scene));
+	XMVECTOR receiverMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR receiverMax = XMVectorReplicate(-FLT_MAX);
+	bool hasReceivers = false;
+
+	for (size_t ii = 0; ii < std::size(scene); ii++)
+	{
+		BoundingBox worldBounds = scene[ii]->GetWorldBounds();
+		worldBounds.Transform(lightSpaceBounds[ii], lightViewProjection);
+
+		if (cameraFrustum.Intersects(worldBounds) && lightVolume.Intersects(lightSpaceBounds[ii]))
+		{
+			XMVECTOR center = XMLoadFloat3(&lightSpaceBounds[ii].Center);
+			XMVECTOR extents = XMLoadFloat3(&lightSpaceBounds[ii].Extents);
+			receiverMin = XMVectorMin(receiverMin, XMVectorSubtract(center, extents));
+			receiverMax = XMVectorMax(receiverMax, XMVectorAdd(center, extents));
+			hasReceivers = true;
+		}
+	}
+
+	// Nothing visible can receive a shadow, so nothing needs to cast one
+	if (!hasReceivers)
+	{
+		return;
+	}
+
+	// Clamp to the light volume and extrude toward the light (z = 0)
+	XMFLOAT3 casterMin;
+	XMFLOAT3 casterMax;
+	XMStoreFloat3(&casterMin, XMVectorMax(receiverMin, XMVectorSet(-1.0f, -1.0f, 0.0f, 0.0f)));
+	XMStoreFloat3(&casterMax, XMVectorMin(receiverMax, XMVectorSet(1.0f, 1.0f, 1.0f, 0.0f)));
+	casterMin.z = 0.0f;
+
+	BoundingBox casterRegion;
+	BoundingBox::CreateFromPoints(casterRegion, XMLoadFloat3(&casterMin), XMLoadFloat3(&casterMax));
+
+	for (size_t ii = 0; ii < std::size(scene); ii++)
+	{
+		// Static casters come from the cached static shadow map
+		if (!scene[ii]->IsStatic() && casterRegion.Intersects(lightSpaceBounds[ii]))
+		{
+			shadowCasters.push_back(scene[ii]);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Draws a list of casters into the bound shadow DSV and viewport
+// --------------------------------------------------------
+void Game::DrawShadowCasters(const ShadowView& view, const std::vector<std::shared_ptr<Entity>>& casters)
+{
+	shadowMapVS->SetMatrix4x4("view", view.View);
+	shadowMapVS->SetMatrix4x4("projection", view.Projection);
+
+	for (const auto& entity : casters)
+	{
+		shadowMapVS->SetMatrix4x4(shadowWorldHandle, entity->GetTransform()->GetWorldMatrix());
+		shadowMapVS->CopyAllBufferData();
+
+		entity->GetMesh()->Draw();
+	}
+
+	numShadowCasterDraws += casters.size();
+}
+
+void Game::PopulateShadowMap()
+{
+	// Set settings for shadow map
+	ID3D11RenderTargetView* nullRTV{};
+	Graphics::Context->PSSetShader(0, 0, 0);
+	Graphics::Context->RSSetState(shadowRasterizer.Get());
+
+	// Static casters only need redrawing if one of them actually moved
+	std::vector<std::shared_ptr<Entity>> staticCasters;
+	unsigned long long staticShadowVersion = 0;
+	for (const std::shared_ptr<Entity>& entity : scene)
+	{
+		if (entity->IsStatic())
+		{
+			staticCasters.push_back(entity);
+			staticShadowVersion += entity->GetTransform()->GetVersion();
+		}
+	}
+
+	if (staticShadowVersion != cachedStaticShadowVersion)
+	{
+		shadowCacheValid.assign(shadowViews.size(), false);
+		cachedStaticShadowVersion = staticShadowVersion;
+	}
+
+	numShadowCasterDraws = 0;
+	numShadowCacheHits = 0;
+	numShadowTileCopies = 0;
+
+	// The static atlas only exists while caching is on
+	if (shadowCacheEnabled && !staticShadowTexture)
+	{
+		CreateStaticShadowAtlas();
+	}
+	else if (!shadowCacheEnabled && staticShadowTexture)
+	{
+		staticShadowSRV.Reset();
+		staticShadowDSV.Reset();
+		staticShadowTexture.Reset();
+	}
+
+	// Bring stale tiles of the static atlas up to date
+	std::vector<bool> staticTileRedrawn(shadowViews.size(), false);
+	if (shadowCacheEnabled)
+	{
+		Graphics::Context->OMSetRenderTargets(1, &nullRTV, staticShadowDSV.Get());
+		for (unsigned int ii = 0; ii < shadowViews.size(); ii++)
+		{
+			const ShadowView& view = shadowViews[ii];
+
+			// The static layer is reusable as long as the view's light matrices are
+			// identical.  Cascades are centered on a texel-snapped light space origin,
+			// so they hold while the camera moves less than a texel and redraw after.
+			bool cacheHit = shadowCacheValid[ii] &&
+				memcmp(&cachedShadowViews[ii].View, &view.View, sizeof(XMFLOAT4X4)) == 0 &&
+				memcmp(&cachedShadowViews[ii].Projection, &view.Projection, sizeof(XMFLOAT4X4)) == 0;
+
+			if (cacheHit)
+			{
+				numShadowCacheHits++;
+				continue;
+			}
+
+			SetShadowTileViewport(ii);
+
+			shadowTileClearVS->SetShader();
+			Graphics::Context->OMSetDepthStencilState(shadowTileClearDepthState.Get(), 0);
+			Graphics::Context->Draw(3, 0);
+			Graphics::Context->OMSetDepthStencilState(0, 0);
+
+			// No receiver culling here, since the cached result has to
+			// hold up however the camera looks around
+			shadowMapVS->SetShader();
+			DrawShadowCasters(view, staticCasters);
+
+			cachedShadowViews[ii] = view;
+			shadowCacheValid[ii] = true;
+			staticTileRedrawn[ii] = true;
+		}
+	}
+
+	// Each live tile starts from its static depth and gets the dynamic
+	// casters on top, with every light sharing the one depth target
+	Graphics::Context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
+	for (unsigned int ii = 0; ii < shadowViews.size(); ii++)
+	{
+		SetShadowTileViewport(ii);
+
+		// Loop and draw the dynamic entities that can actually affect what's on screen
+		CullShadowCasters(shadowViews[ii]);
+
+		if (!shadowCacheEnabled)
+		{
+			// Nothing to start from, so the tile gets every caster
+			shadowTileClearVS->SetShader();
+			Graphics::Context->OMSetDepthStencilState(shadowTileClearDepthState.Get(), 0);
+			Graphics::Context->Draw(3, 0);
+			Graphics::Context->OMSetDepthStencilState(0, 0);
+
+			shadowMapVS->SetShader();
+			DrawShadowCasters(shadowViews[ii], staticCasters);
+		}
+		else if (staticTileRedrawn[ii] || shadowTileHasDynamicCasters[ii] || !shadowCasters.empty())
+		{
+			// The live tile still holds last frame's depth, which only needs
+			// replacing if the static layer changed or dynamic casters were or
+			// are about to be drawn over it.  D3D11 can only copy depth-stencil
+			// resources whole, so the tile is copied with a depth-writing triangle.
+			shadowTileCopyPS->SetShaderResourceView("StaticShadowAtlas", staticShadowSRV);
+			shadowTileCopyPS->SetShader();
+			shadowTileClearVS->SetShader();
+			Graphics::Context->OMSetDepthStencilState(shadowTileClearDepthState.Get(), 0);
+			Graphics::Context->Draw(3, 0);
+			Graphics::Context->OMSetDepthStencilState(0, 0);
+
+			Graphics::Context->PSSetShader(0, 0, 0);
+			ID3D11ShaderResourceView* noSRV = 0;
+			Graphics::Context->PSSetShaderResources(0, 1, &noSRV);
+			numShadowTileCopies++;
+		}
+
+		shadowMapVS->SetShader();
+		DrawShadowCasters(shadowViews[ii], shadowCasters);
+		shadowTileHasDynamicCasters[ii] = !shadowCacheEnabled || !shadowCasters.empty();
+	}
+
+	// Reset
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)Window::Width();
+	viewport.Height = (float)Window::Height();
+	viewport.MaxDepth = 1.0f;
+	Graphics::Context->RSSetViewports(1, &viewport);
+	Graphics::Context->OMSetRenderTargets(
+		1,
+		Graphics::BackBufferRTV.GetAddressOf(),
+		Graphics::DepthBufferDSV.Get());
+	Graphics::Context->RSSetState(0);
+}
+
+// --------------------------------------------------------
+// Physical page pool and page table for the virtual shadow map
+// --------------------------------------------------------
+void Game::CreateVirtualShadowMapSetup()
+{
+	virtualShadowMap = std::make_shared<VirtualShadowMap>();
+
+	D3D11_TEXTURE2D_DESC poolDesc = {};
+	poolDesc.Width = VSM_PHYSICAL_PAGES_PER_SIDE * VSM_PAGE_SIZE;
+	poolDesc.Height = VSM_PHYSICAL_PAGES_PER_SIDE * VSM_PAGE_SIZE;
+	poolDesc.ArraySize = 1;
+	poolDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	poolDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	poolDesc.MipLevels = 1;
+	poolDesc.SampleDesc.Count = 1;
+	poolDesc.Usage = D3D11_USAGE_DEFAULT;
+	Graphics::Device->CreateTexture2D(&poolDesc, 0, virtualShadowPoolTexture.GetAddressOf());
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC poolDSDesc = {};
+	poolDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	poolDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	Graphics::Device->CreateDepthStencilView(
+		virtualShadowPoolTexture.Get(),
+		&poolDSDesc,
+		virtualShadowPoolDSV.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC poolSRVDesc = {};
+	poolSRVDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	poolSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	poolSRVDesc.Texture2D.MipLevels = 1;
+	Graphics::Device->CreateShaderResourceView(
+		virtualShadowPoolTexture.Get(),
+		&poolSRVDesc,
+		virtualShadowPoolSRV.GetAddressOf());
+
+	// One texel per virtual page, holding its physical page index
+	D3D11_TEXTURE2D_DESC tableDesc = {};
+	tableDesc.Width = VSM_PAGES_PER_SIDE;
+	tableDesc.Height = VSM_PAGES_PER_SIDE;
+	tableDesc.ArraySize = 1;
+	tableDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	tableDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	tableDesc.Format = DXGI_FORMAT_R32_UINT;
+	tableDesc.MipLevels = 1;
+	tableDesc.SampleDesc.Count = 1;
+	tableDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+	D3D11_SUBRESOURCE_DATA tableData = {};
+	tableData.pSysMem = virtualShadowMap->GetPageTable().data();
+	tableData.SysMemPitch = VSM_PAGES_PER_SIDE * sizeof(unsigned int);
+	Graphics::Device->CreateTexture2D(&tableDesc, &tableData, virtualPageTableTexture.GetAddressOf());
+	Graphics::Device->CreateShaderResourceView(virtualPageTableTexture.Get(), 0, virtualPageTableSRV.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Light space rect of a world space box, in virtual UVs
+// --------------------------------------------------------
+void Game::GetVirtualShadowRect(const BoundingBox& worldBounds, XMFLOAT2& uvMin, XMFLOAT2& uvMax)
+{
+	BoundingBox lightBounds;
+	worldBounds.Transform(lightBounds, XMLoadFloat4x4(&virtualShadowView));
+
+	float halfExtent = virtualShadowExtent * 0.5f;
+	uvMin = XMFLOAT2(
+		(lightBounds.Center.x - lightBounds.Extents.x + halfExtent) / virtualShadowExtent,
+		(halfExtent - lightBounds.Center.y - lightBounds.Extents.y) / virtualShadowExtent);
+	uvMax = XMFLOAT2(
+		(lightBounds.Center.x + lightBounds.Extents.x + halfExtent) / virtualShadowExtent,
+		(halfExtent - lightBounds.Center.y + lightBounds.Extents.y) / virtualShadowExtent);
+}
+
+// --------------------------------------------------------
+// Works out which virtual pages the camera needs and which
+// of them are out of date.
+//
+// The virtual map is fixed around the world origin so page
+// contents stay valid while the camera moves. Casters
+// invalidate the pages they cover whenever their transform
+// changes; a light direction change invalidates everything.
+// --------------------------------------------------------
+void Game::UpdateVirtualShadowMap()
+{
+	if (virtualShadowLight < 0)
+	{
+		return;
+	}
+
+	XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lights[virtualShadowLight].Direction));
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	if (fabsf(XMVectorGetX(XMVector3Dot(direction, up))) > 0.99f)
+	{
+		up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+	}
+
+	float halfExtent = virtualShadowExtent * 0.5f;
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorZero(), direction, up));
+	XMStoreFloat4x4(&virtualShadowProjection, XMMatrixOrthographicOffCenterLH(
+		-halfExtent, halfExtent, -halfExtent, halfExtent, -halfExtent, halfExtent));
+
+	if (memcmp(&view, &virtualShadowView, sizeof(XMFLOAT4X4)) != 0)
+	{
+		virtualShadowView = view;
+		virtualShadowMap->InvalidateAll();
+	}
+	XMStoreFloat4x4(&virtualShadowViewProjection, XMMatrixMultiply(
+		XMLoadFloat4x4(&virtualShadowView),
+		XMLoadFloat4x4(&virtualShadowProjection)));
+
+	virtualShadowMap->BeginFrame();
+
+	// Casters
+	for (unsigned int ii = 0; ii < std::size(scene); ii++)
+	{
+		XMFLOAT2 uvMin, uvMax;
+		GetVirtualShadowRect(scene[ii]->GetWorldBounds(), uvMin, uvMax);
+		virtualShadowMap->UpdateCaster(ii, uvMin, uvMax, scene[ii]->GetTransform()->GetVersion());
+	}
+
+	// Receivers - only the parts of visible entities within shadow distance
+	std::shared_ptr<Camera>& camera = cameras[activeCameraIdx];
+	XMFLOAT4X4 cameraView = camera->GetViewMatrix();
+	XMFLOAT4X4 cameraProjection = camera->GetProjectionMatrix();
+
+	BoundingFrustum cameraFrustum(XMLoadFloat4x4(&cameraProjection));
+	cameraFrustum.Far = shadowDistance < cameraFrustum.Far ? shadowDistance : cameraFrustum.Far;
+	cameraFrustum.Transform(cameraFrustum, XMMatrixInverse(nullptr, XMLoadFloat4x4(&cameraView)));
+
+	XMFLOAT3 frustumCorners[BoundingFrustum::CORNER_COUNT];
+	cameraFrustum.GetCorners(frustumCorners);
+	BoundingBox frustumBounds;
+	BoundingBox::CreateFromPoints(frustumBounds, BoundingFrustum::CORNER_COUNT, frustumCorners, sizeof(XMFLOAT3));
+
+	XMFLOAT2 frustumMin, frustumMax;
+	GetVirtualShadowRect(frustumBounds, frustumMin, frustumMax);
+
+	for (const std::shared_ptr<Entity>& entity : scene)
+	{
+		BoundingBox worldBounds = entity->GetWorldBounds();
+		if (!cameraFrustum.Intersects(worldBounds))
+		{
+			continue;
+		}
+
+		XMFLOAT2 uvMin, uvMax;
+		GetVirtualShadowRect(worldBounds, uvMin, uvMax);
+		uvMin = XMFLOAT2(uvMin.x > frustumMin.x ? uvMin.x : frustumMin.x, uvMin.y > frustumMin.y ? uvMin.y : frustumMin.y);
+		uvMax = XMFLOAT2(uvMax.x < frustumMax.x ? uvMax.x : frustumMax.x, uvMax.y < frustumMax.y ? uvMax.y : frustumMax.y);
+		virtualShadowMap->MarkNeeded(uvMin, uvMax);
+	}
+
+	virtualShadowMap->Update();
+}
+
+// --------------------------------------------------------
+// Uploads the page table if it changed and re-renders every
+// page that was newly mapped or invalidated this frame
+// --------------------------------------------------------
+void Game::PopulateVirtualShadowMap()
+{
+	if (virtualShadowLight < 0)
+	{
+		return;
+	}
+
+	if (virtualShadowMap->IsPageTableChanged())
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		Graphics::Context->Map(virtualPageTableTexture.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+
+		const std::vector<unsigned int>& pageTable = virtualShadowMap->GetPageTable();
+		for (unsigned int row = 0; row < VSM_PAGES_PER_SIDE; row++)
+		{
+			memcpy(
+				(unsigned char*)mapped.pData + row * mapped.RowPitch,
+				&pageTable[row * VSM_PAGES_PER_SIDE],
+				VSM_PAGES_PER_SIDE * sizeof(unsigned int));
+		}
+
+		Graphics::Context->Unmap(virtualPageTableTexture.Get(), 0);
+	}
+
+	const std::vector<VirtualShadowMap::PageRender>& pages = virtualShadowMap->GetPagesToRender();
+	if (pages.empty())
+	{
+		return;
+	}
+
+	// Caster footprints, to only draw what touches each page
+	std::vector<XMFLOAT2> casterMin(std::size(scene));
+	std::vector<XMFLOAT2> casterMax(std::size(scene));
+	for (size_t ii = 0; ii < std::size(scene); ii++)
+	{
+		GetVirtualShadowRect(scene[ii]->GetWorldBounds(), casterMin[ii], casterMax[ii]);
+	}
+
+	ID3D11RenderTargetView* nullRTV{};
+	Graphics::Context->OMSetRenderTargets(1, &nullRTV, virtualShadowPoolDSV.Get());
+	Graphics::Context->PSSetShader(0, 0, 0);
+	Graphics::Context->RSSetState(shadowRasterizer.Get());
+
+	float halfExtent = virtualShadowExtent * 0.5f;
+	float pageWorldSize = virtualShadowExtent / VSM_PAGES_PER_SIDE;
+	float pageUVSize = 1.0f / VSM_PAGES_PER_SIDE;
+
+	for (const VirtualShadowMap::PageRender& page : pages)
+	{
+		D3D11_VIEWPORT viewport = {};
+		viewport.TopLeftX = (float)(page.PhysicalX * VSM_PAGE_SIZE);
+		viewport.TopLeftY = (float)(page.PhysicalY * VSM_PAGE_SIZE);
+		viewport.Width = (float)VSM_PAGE_SIZE;
+		viewport.Height = (float)VSM_PAGE_SIZE;
+		viewport.MaxDepth = 1.0f;
+		Graphics::Context->RSSetViewports(1, &viewport);
+
+		shadowTileClearVS->SetShader();
+		Graphics::Context->OMSetDepthStencilState(shadowTileClearDepthState.Get(), 0);
+		Graphics::Context->Draw(3, 0);
+		Graphics::Context->OMSetDepthStencilState(0, 0);
+
+		// Just this page's part of the virtual projection, with the same depth range
+		float left = -halfExtent + page.VirtualX * pageWorldSize;
+		float top = halfExtent - page.VirtualY * pageWorldSize;
+
+		ShadowView pageView = {};
+		pageView.View = virtualShadowView;
+		XMStoreFloat4x4(&pageView.Projection, XMMatrixOrthographicOffCenterLH(
+			left, left + pageWorldSize,
+			top - pageWorldSize, top,
+			-halfExtent, halfExtent));
+
+		XMFLOAT2 pageMin(page.VirtualX * pageUVSize, page.VirtualY * pageUVSize);
+		XMFLOAT2 pageMax(pageMin.x + pageUVSize, pageMin.y + pageUVSize);
+
+		shadowCasters.clear();
+		for (size_t ii = 0; ii < std::size(scene); ii++)
+		{
+			if (casterMin[ii].x <= pageMax.x && casterMax[ii].x >= pageMin.x &&
+				casterMin[ii].y <= pageMax.y && casterMax[ii].y >= pageMin.y)
+			{
+				shadowCasters.push_back(scene[ii]);
+			}
+		}
+
+		shadowMapVS->SetShader();
+		DrawShadowCasters(pageView, shadowCasters);
+	}
+
+	// Reset
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)Window::Width();
+	viewport.Height = (float)Window::Height();
+	viewport.MaxDepth = 1.0f;
+	Graphics::Context->RSSetViewports(1, &viewport);
+	Graphics::Context->OMSetRenderTargets(
+		1,
+		Graphics::BackBufferRTV.GetAddressOf(),
+		Graphics::DepthBufferDSV.Get());
+	Graphics::Context->RSSetState(0);
+}
+
+// --------------------------------------------------------
+// Adds or removes randomly placed point lights around the
+// scene, for stress testing the clustered light culling
+// --------------------------------------------------------
+void Game::SetExtraLightCount(const int count)
+{
+	lights.resize(numBaseLights + count);
 
-	D3D11_RASTERIZER_DESC shadowRastDesc = {};
-	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
-	shadowRastDesc.CullMode = D3D11_CULL_BACK;
-	shadowRastDesc.DepthClipEnable = true;
-	shadowRastDesc.DepthBias = 1000;
-	shadowRastDesc.SlopeScaledDepthBias = 1.0f;
-	Graphics::Device->CreateRasterizerState(&shadowRastDesc, &shadowRasterizer);
+	// Same seed every time, so a given count always gives the same lights
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> horizontal(-15.0f, 15.0f);
+	std::uniform_real_distribution<float> vertical(-2.0f, 3.0f);
+	std::uniform_real_distribution<float> range(1.0f, 3.0f);
+	std::uniform_real_distribution<float> color(0.2f, 1.0f);
 
-	D3D11_SAMPLER_DESC shadowSampDesc = {};
-	shadowSampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR;
-	shadowSampDesc.ComparisonFunc = D3D11_COMPARISON_LESS;
-	shadowSampDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
-	shadowSampDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
-	shadowSampDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
-	shadowSampDesc.BorderColor[0] = 1.0f; // Only need the first component
-	Graphics::Device->CreateSamplerState(&shadowSampDesc, &shadowSampler);
+	for (size_t ii = numBaseLights; ii < lights.size(); ii++)
+	{
+		Light& light = lights[ii];
+		light = {};
+		light.Type = LIGHT_TYPE_POINT;
+		light.Position = XMFLOAT3(horizontal(random), vertical(random), horizontal(random));
+		light.Range = range(random);
+		light.Intensity = 1.0f;
+		light.Color = XMFLOAT3(color(random), color(random), color(random));
+		light.ShadowIndex = -1;
+	}
 }
 
-void Game::UpdateLightMatrices()
+// --------------------------------------------------------
+// Bins every light into the active camera's clusters
+// --------------------------------------------------------
+void Game::BuildLightClusters()
 {
-	// Update light view and projection matrices for shadow map
-	XMVECTOR lightDirection = XMLoadFloat3(&lights[4].Direction);
+	std::shared_ptr<Camera>& camera = cameras[activeCameraIdx];
 
-	XMMATRIX lightView = XMMatrixLookToLH(
-		-lightDirection * 30,
-		lightDirection,
-		XMVectorSet(0, 1, 0, 0)
-	);
+	auto start = std::chrono::high_resolution_clock::now();
 
-	float lightProjectionSize = 20.0f;
-	XMMATRIX lightProjection = XMMatrixOrthographicLH(
-		lightProjectionSize,
-		lightProjectionSize,
-		1.0f,
-		100.0f);
+	lightClusterBuilder->Build(
+		lightPacker->GetSortedLights(),
+		camera->GetViewMatrix(),
+		camera->GetProjectionMatrix(),
+		camera->GetNearDistance(),
+		camera->GetFarDistance());
 
-	XMStoreFloat4x4(&lightViewMatrix, lightView);
-	XMStoreFloat4x4(&lightProjectionMatrix, lightProjection);
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	lightClusterBuildTime = elapsed.count();
 }
 
-void Game::PopulateShadowMap()
+// --------------------------------------------------------
+// Picks the most influential lights for each entity, reusing
+// last frame's picks where nothing relevant changed
+// --------------------------------------------------------
+void Game::SelectObjectLights()
 {
-	// Set settings for shadow map
-	Graphics::Context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+	auto start = std::chrono::high_resolution_clock::now();
 
-	ID3D11RenderTargetView* nullRTV{};
-	Graphics::Context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
-	Graphics::Context->PSSetShader(0, 0, 0);
+	std::vector<BoundingBox> bounds(std::size(scene));
+	std::vector<unsigned long long> versions(std::size(scene));
+	for (size_t ii = 0; ii < std::size(scene); ii++)
+	{
+		bounds[ii] = scene[ii]->GetWorldBounds();
+		versions[ii] = scene[ii]->GetTransform()->GetVersion();
+	}
 
-	D3D11_VIEWPORT viewport = {};
-	viewport.Width = (float)1024;
-	viewport.Height = (float)1024;
-	viewport.MaxDepth = 1.0f;
-	Graphics::Context->RSSetViewports(1, &viewport);
+	objectLightSelector->Update(lightPacker->GetSortedLights(), bounds, versions);
 
-	Graphics::Context->RSSetState(shadowRasterizer.Get());
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	objectLightSelectTime = elapsed.count();
+}
 
-	shadowMapVS->SetShader();
-	shadowMapVS->SetMatrix4x4("view", lightViewMatrix);
-	shadowMapVS->SetMatrix4x4("projection", lightProjectionMatrix);
-	// Loop and draw all entities
-	for (const auto& entity : scene)
-	{
-		shadowMapVS->SetMatrix4x4("world", entity->GetTransform()->GetWorldMatrix());
-		shadowMapVS->CopyAllBufferData();
+// --------------------------------------------------------
+// Sets everything that's the same for every entity drawn
+// with a material's shaders this frame
+// --------------------------------------------------------
+void Game::SetFrameShaderData(const std::shared_ptr<Material>& material,
+	const VertexShaderPerFrame& vertexFrameData, const PixelShaderPerFrame& pixelFrameData)
+{
+	std::shared_ptr<SimpleVertexShader> vs = material->GetVertexShader();
+	std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
+
+	// Both PerFrame cbuffers in one copy each
+	ConstantBuffer<VertexShaderPerFrame> vertexFrameBuffer(vs, "PerFrame");
+	ConstantBuffer<PixelShaderPerFrame> pixelFrameBuffer(ps, "PerFrame");
+	vertexFrameBuffer.Set(vertexFrameData);
+	pixelFrameBuffer.Set(pixelFrameData);
+
+	ps->SetShaderResourceView("ShadowAtlas", shadowSRV);
+	ps->SetSamplerState("ShadowSampler", shadowSampler);
+	ps->SetShaderResourceView("VirtualPageTable", virtualPageTableSRV);
+	ps->SetShaderResourceView("VirtualShadowPool", virtualShadowPoolSRV);
+
+	ps->SetShaderResourceView("Lights", lightSRV);
+	ps->SetShaderResourceView("ClusterRanges", clusterRangeSRV);
+	ps->SetShaderResourceView("ClusterLightIndices", lightIndexSRV);
+
+	ps->SetShaderResourceView("SpecularEnvironment", sky->GetSpecularSRV());
+	ps->SetShaderResourceView("BRDFLookup", sky->GetBRDFLookupSRV());
+	ps->SetSamplerState("ClampSampler", ppSampler);
+}
 
-		entity->GetMesh()->Draw();
+// --------------------------------------------------------
+// Copies data into a dynamic structured buffer, recreating
+// it (and its SRV) when it's too small
+// --------------------------------------------------------
+void Game::UploadStructuredBuffer(
+	Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv,
+	unsigned int& capacity,
+	const void* data,
+	const unsigned int count,
+	const unsigned int stride)
+{
+	if (count > capacity || !buffer)
+	{
+		// Grow with some headroom so slowly growing lists don't recreate every frame
+		capacity = count > 0 ? count + count / 2 : 1;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.ByteWidth = capacity * stride;
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = stride;
+
+		buffer.Reset();
+		srv.Reset();
+		Graphics::Device->CreateBuffer(&bufferDesc, 0, buffer.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = capacity;
+		Graphics::Device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.GetAddressOf());
 	}
 
+	if (count == 0)
+	{
+		return;
+	}
 
-	// Reset
-	viewport.Width = (float)Window::Width();
-	viewport.Height = (float)Window::Height();
-	Graphics::Context->RSSetViewports(1, &viewport);
-	Graphics::Context->OMSetRenderTargets(
-		1,
-		Graphics::BackBufferRTV.GetAddressOf(),
-		Graphics::DepthBufferDSV.Get());
-	Graphics::Context->RSSetState(0);
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	Graphics::Context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	memcpy(mapped.pData, data, (size_t)count * stride);
+	Graphics::Context->Unmap(buffer.Get(), 0);
 }
 
 void Game::CreatePostProcessSetup()
@@ -414,8 +1526,17 @@ void Game::CreatePostProcessSetup()
 	// Reset ComPtrs
 	blurSRV.Reset();
 	blurRTV.Reset();
+	blurTempSRV.Reset();
+	blurTempRTV.Reset();
+	blurTempUAV.Reset();
+	for (unsigned int i = 0; i < MAX_BLUR_LEVELS; i++)
+	{
+		blurLevelSRVs[i].Reset();
+		blurLevelRTVs[i].Reset();
+	}
 	caSRV.Reset();
 	caRTV.Reset();
+	caUAV.Reset();
 
 	// Sampler state for post processing
 	D3D11_SAMPLER_DESC ppSampDesc = {};
@@ -432,7 +1553,7 @@ void Game::CreatePostProcessSetup()
 	textureDesc.Width = Window::Width();
 	textureDesc.Height = Window::Height();
 	textureDesc.ArraySize = 1;
-	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
 	textureDesc.CPUAccessFlags = 0;
 	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	textureDesc.MipLevels = 1;
@@ -442,8 +1563,10 @@ void Game::CreatePostProcessSetup()
 	textureDesc.Usage = D3D11_USAGE_DEFAULT;
 
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> blurTexture;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> blurTempTexture;
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> caTexture;
 	Graphics::Device->CreateTexture2D(&textureDesc, 0, blurTexture.GetAddressOf());
+	Graphics::Device->CreateTexture2D(&textureDesc, 0, blurTempTexture.GetAddressOf());
 	Graphics::Device->CreateTexture2D(&textureDesc, 0, caTexture.GetAddressOf());
 
 	// Create the Render Target View
@@ -456,6 +1579,11 @@ void Game::CreatePostProcessSetup()
 		&rtvDesc,
 		blurRTV.ReleaseAndGetAddressOf());
 
+	Graphics::Device->CreateRenderTargetView(
+		blurTempTexture.Get(),
+		&rtvDesc,
+		blurTempRTV.ReleaseAndGetAddressOf());
+
 	Graphics::Device->CreateRenderTargetView(
 		caTexture.Get(),
 		&rtvDesc,
@@ -468,10 +1596,314 @@ void Game::CreatePostProcessSetup()
 		blurTexture.Get(),
 		0,
 		blurSRV.ReleaseAndGetAddressOf());
+	Graphics::Device->CreateShaderResourceView(
+		blurTempTexture.Get(),
+		0,
+		blurTempSRV.ReleaseAndGetAddressOf());
 	Graphics::Device->CreateShaderResourceView(
 		caTexture.Get(),
 		0,
 		caSRV.ReleaseAndGetAddressOf());
+
+	// Unordered access views for the sliding window blur's compute shader
+	Graphics::Device->CreateUnorderedAccessView(
+		blurTempTexture.Get(),
+		0,
+		blurTempUAV.ReleaseAndGetAddressOf());
+	Graphics::Device->CreateUnorderedAccessView(
+		caTexture.Get(),
+		0,
+		caUAV.ReleaseAndGetAddressOf());
+
+	// The dual filter's levels, each half the size of the one before
+	for (unsigned int i = 0; i < MAX_BLUR_LEVELS; i++)
+	{
+		D3D11_TEXTURE2D_DESC levelDesc = textureDesc;
+		levelDesc.Width = GetBlurLevelSize(textureDesc.Width, i);
+		levelDesc.Height = GetBlurLevelSize(textureDesc.Height, i);
+		levelDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> levelTexture;
+		Graphics::Device->CreateTexture2D(&levelDesc, 0, levelTexture.GetAddressOf());
+		Graphics::Device->CreateRenderTargetView(levelTexture.Get(), &rtvDesc, blurLevelRTVs[i].ReleaseAndGetAddressOf());
+		Graphics::Device->CreateShaderResourceView(levelTexture.Get(), 0, blurLevelSRVs[i].ReleaseAndGetAddressOf());
+	}
+}
+
+// --------------------------------------------------------
+// Blurs the scene (blurSRV) into caRTV with the chosen mode
+// --------------------------------------------------------
+void Game::DrawBlur()
+{
+	unsigned int width = Window::Width();
+	unsigned int height = Window::Height();
+	BlurMode mode = (BlurMode)blurMode;
+	if (blurRadius <= 0)
+	{
+		// Every mode is a copy, which the box pass does in one go
+		mode = BlurMode::Box;
+	}
+
+	// The chromatic aberration pass after this draws with it too
+	ppVS->SetShader();
+
+	if (mode == BlurMode::SlidingWindow)
+	{
+		// The compute shader reads the scene and writes the output
+		// directly, so neither can still be bound elsewhere
+		Graphics::Context->OMSetRenderTargets(0, 0, 0);
+		ID3D11ShaderResourceView* noSRV = 0;
+		Graphics::Context->PSSetShaderResources(0, 1, &noSRV);
+
+		blurSlidingCS->SetShader();
+		blurSlidingCS->SetInt("blurRadius", blurRadius);
+
+		// Rows into the temporary texture, one thread each
+		blurSlidingCS->SetInt("vertical", 0);
+		blurSlidingCS->CopyAllBufferData();
+		blurSlidingCS->SetUnorderedAccessView("Output", blurTempUAV);
+		blurSlidingCS->SetShaderResourceView("Pixels", blurSRV);
+		blurSlidingCS->DispatchByThreads(height, 1, 1);
+
+		// Then its columns into the output (the output's UAV replaces
+		// the temporary one before the temporary is read)
+		blurSlidingCS->SetInt("vertical", 1);
+		blurSlidingCS->CopyAllBufferData();
+		blurSlidingCS->SetUnorderedAccessView("Output", caUAV);
+		blurSlidingCS->SetShaderResourceView("Pixels", blurTempSRV);
+		blurSlidingCS->DispatchByThreads(width, 1, 1);
+
+		// Unbind so the output can be read by the next pass
+		blurSlidingCS->SetUnorderedAccessView("Output", nullptr);
+		blurSlidingCS->SetShaderResourceView("Pixels", nullptr);
+		return;
+	}
+
+	blurPS->SetShader();
+	blurPS->SetSamplerState("ClampSampler", ppSampler.Get());
+	blurPS->SetInt("blurRadius", blurRadius);
+
+	// One full screen pass of blurPS from one texture into another
+	auto drawPass = [&](int pass,
+		ID3D11ShaderResourceView* source, unsigned int sourceWidth, unsigned int sourceHeight,
+		ID3D11RenderTargetView* target, unsigned int targetWidth, unsigned int targetHeight)
+	{
+		// Unbind the last pass's input first, in case it's this pass's target
+		blurPS->SetShaderResourceView("Pixels", nullptr);
+		Graphics::Context->OMSetRenderTargets(1, &target, 0);
+
+		D3D11_VIEWPORT viewport = {};
+		viewport.Width = (float)targetWidth;
+		viewport.Height = (float)targetHeight;
+		viewport.MaxDepth = 1.0f;
+		Graphics::Context->RSSetViewports(1, &viewport);
+
+		blurPS->SetShaderResourceView("Pixels", source);
+		blurPS->SetInt("blurPass", pass);
+		blurPS->SetFloat("pixelWidth", 1.0f / sourceWidth);
+		blurPS->SetFloat("pixelHeight", 1.0f / sourceHeight);
+		blurPS->CopyAllBufferData();
+
+		Graphics::Context->Draw(3, 0);
+	};
+
+	switch (mode)
+	{
+	case BlurMode::Separable:
+		drawPass(BLUR_PASS_HORIZONTAL, blurSRV.Get(), width, height, blurTempRTV.Get(), width, height);
+		drawPass(BLUR_PASS_VERTICAL, blurTempSRV.Get(), width, height, caRTV.Get(), width, height);
+		break;
+
+	case BlurMode::DualFilter:
+	{
+		// Down through the levels, then back up through them into the output
+		unsigned int levels = GetDualFilterLevels(blurRadius);
+		for (unsigned int i = 0; i < levels; i++)
+		{
+			drawPass(BLUR_PASS_DOWNSAMPLE,
+				i == 0 ? blurSRV.Get() : blurLevelSRVs[i - 1].Get(),
+				i == 0 ? width : GetBlurLevelSize(width, i - 1),
+				i == 0 ? height : GetBlurLevelSize(height, i - 1),
+				blurLevelRTVs[i].Get(), GetBlurLevelSize(width, i), GetBlurLevelSize(height, i));
+		}
+		for (unsigned int i = levels - 1; i > 0; i--)
+		{
+			drawPass(BLUR_PASS_UPSAMPLE,
+				blurLevelSRVs[i].Get(), GetBlurLevelSize(width, i), GetBlurLevelSize(height, i),
+				blurLevelRTVs[i - 1].Get(), GetBlurLevelSize(width, i - 1), GetBlurLevelSize(height, i - 1));
+		}
+		drawPass(BLUR_PASS_UPSAMPLE,
+			blurLevelSRVs[0].Get(), GetBlurLevelSize(width, 0), GetBlurLevelSize(height, 0),
+			caRTV.Get(), width, height);
+
+		// Back to the full screen
+		D3D11_VIEWPORT viewport = {};
+		viewport.Width = (float)width;
+		viewport.Height = (float)height;
+		viewport.MaxDepth = 1.0f;
+		Graphics::Context->RSSetViewports(1, &viewport);
+		break;
+	}
+
+	default:
+		drawPass(BLUR_PASS_BOX, blurSRV.Get(), width, height, caRTV.Get(), width, height);
+		break;
+	}
+}
+
+// --------------------------------------------------------
+// Reads back the blur's input and output, and blurs the
+// input on the CPU to see whether the GPU got the same.
+// Waits for the GPU, so it's only done when asked for.
+// --------------------------------------------------------
+void Game::CheckBlur()
+{
+	blurCheckRequested = false;
+
+	MipLevel source;
+	MipLevel gpuResult;
+	ReadBackTexture(blurSRV.Get(), source);
+	ReadBackTexture(caSRV.Get(), gpuResult);
+
+	auto checkStart = std::chrono::high_resolution_clock::now();
+	MipLevel cpuResult = BlurImage(source, (BlurMode)blurMode, blurRadius, *threadPool);
+	std::chrono::duration<float, std::milli> checkElapsed = std::chrono::high_resolution_clock::now() - checkStart;
+
+	blurCheckTime = checkElapsed.count();
+	blurCheckDifference = CompareImages(cpuResult, gpuResult, blurCheckPixels);
+	blurCheckMode = blurMode;
+	blurCheckRadius = blurRadius;
+	blurChecked = true;
+}
+
+// --------------------------------------------------------
+// Copies an RGBA8 texture into an image through a staging
+// texture (left empty if that fails)
+// --------------------------------------------------------
+void Game::ReadBackTexture(ID3D11ShaderResourceView* srv, MipLevel& image)
+{
+	image = MipLevel();
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	srv->GetResource(resource.GetAddressOf());
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(resource.As(&texture)))
+	{
+		return;
+	}
+
+	D3D11_TEXTURE2D_DESC stagingDesc = {};
+	texture->GetDesc(&stagingDesc);
+	stagingDesc.BindFlags = 0;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	stagingDesc.MiscFlags = 0;
+	stagingDesc.Usage = D3D11_USAGE_STAGING;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staging;
+	if (stagingDesc.Format != DXGI_FORMAT_R8G8B8A8_UNORM ||
+		FAILED(Graphics::Device->CreateTexture2D(&stagingDesc, 0, staging.GetAddressOf())))
+	{
+		return;
+	}
+	Graphics::Context->CopyResource(staging.Get(), texture.Get());
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(Graphics::Context->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+	{
+		return;
+	}
+
+	image.Width = stagingDesc.Width;
+	image.Height = stagingDesc.Height;
+	image.Pixels.resize((size_t)image.Width * image.Height * 4);
+	for (unsigned int y = 0; y < image.Height; y++)
+	{
+		memcpy(&image.Pixels[(size_t)y * image.Width * 4],
+			static_cast<unsigned char*>(mapped.pData) + (size_t)y * mapped.RowPitch,
+			(size_t)image.Width * 4);
+	}
+
+	Graphics::Context->Unmap(staging.Get(), 0);
+}
+
+void Game::CreateOcclusionCullingSetup()
+{
+	occlusionCuller = std::make_shared<OcclusionCuller>(threadPool);
+
+	// CPU-writable texture so the occlusion buffer can be shown in the UI
+	D3D11_TEXTURE2D_DESC debugDesc = {};
+	debugDesc.Width = occlusionCuller->GetWidth();
+	debugDesc.Height = occlusionCuller->GetHeight();
+	debugDesc.ArraySize = 1;
+	debugDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	debugDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	debugDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	debugDesc.MipLevels = 1;
+	debugDesc.MiscFlags = 0;
+	debugDesc.SampleDesc.Count = 1;
+	debugDesc.SampleDesc.Quality = 0;
+	debugDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+	Graphics::Device->CreateTexture2D(&debugDesc, 0, occlusionDebugTexture.GetAddressOf());
+	Graphics::Device->CreateShaderResourceView(
+		occlusionDebugTexture.Get(),
+		0,
+		occlusionDebugSRV.GetAddressOf());
+}
+
+void Game::UpdateOcclusionBuffer()
+{
+	std::shared_ptr<Camera>& camera = cameras[activeCameraIdx];
+	occlusionCuller->BeginFrame(camera->GetViewMatrix(), camera->GetProjectionMatrix());
+
+	for (const std::shared_ptr<Entity>& entity : scene)
+	{
+		if (entity->IsOccluder())
+		{
+			const std::shared_ptr<Mesh>& mesh = entity->GetMesh();
+			occlusionCuller->AddOccluder(
+				mesh->GetPositions(),
+				mesh->GetIndices(),
+				entity->GetTransform()->GetWorldMatrix());
+		}
+	}
+
+	occlusionCuller->RasterizeOccluders();
+}
+
+void Game::UpdateOcclusionDebugTexture()
+{
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(Graphics::Context->Map(occlusionDebugTexture.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		return;
+	}
+
+	// Raw depth bunches up near 1, so show linear view distance instead
+	XMFLOAT4X4 projection = cameras[activeCameraIdx]->GetProjectionMatrix();
+	const std::vector<float>& depth = occlusionCuller->GetDepthBuffer();
+	unsigned int width = occlusionCuller->GetWidth();
+	unsigned int height = occlusionCuller->GetHeight();
+	const float maxVisibleDistance = 50.0f;
+
+	for (unsigned int y = 0; y < height; y++)
+	{
+		unsigned int* row = reinterpret_cast<unsigned int*>(static_cast<unsigned char*>(mapped.pData) + y * mapped.RowPitch);
+		for (unsigned int x = 0; x < width; x++)
+		{
+			float z = depth[y * width + x];
+			float viewDistance = projection._43 / (z - projection._33);
+			float shade = 0.0f;
+			if (z < 1.0f && viewDistance < maxVisibleDistance)
+			{
+				shade = 1.0f - viewDistance / maxVisibleDistance;
+			}
+			unsigned int value = static_cast<unsigned int>(shade * 255.0f);
+			row[x] = 0xFF000000 | (value << 16) | (value << 8) | value;
+		}
+	}
+
+	Graphics::Context->Unmap(occlusionDebugTexture.Get(), 0);
 }
 
 
@@ -555,7 +1987,33 @@ void Game::Update(float deltaTime, float totalTime)
 
 	cameras[activeCameraIdx]->Update(deltaTime);
 
+	// The procedural sky follows the sun, which shines the way lights[0] does
+	XMFLOAT3 sunDirection;
+	XMStoreFloat3(&sunDirection, -XMVector3Normalize(XMLoadFloat3(&lights[0].Direction)));
+	sky->SetProcedural(proceduralSkyEnabled);
+	sky->UpdateAtmosphere(sunDirection, sunIlluminance, atmosphere);
+
 	UpdateLightMatrices();
+	UpdateVirtualShadowMap();
+	// Both light lists index the packed (type-sorted) lights
+	lightPacker->Pack(lights, virtualShadowLight);
+
+	if (perObjectLightsEnabled)
+	{
+		SelectObjectLights();
+	}
+	else
+	{
+		BuildLightClusters();
+	}
+
+	if (occlusionCullingEnabled)
+	{
+		UpdateOcclusionBuffer();
+	}
+
+	// Uses the occlusion results, so it comes after them
+	UpdateTextureStreaming();
 
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::KeyDown(VK_ESCAPE))
@@ -611,6 +2069,17 @@ void Game::BuildUI(float totalTime)
 	// Window Dimensions
 	ImGui::Text("Window Dimensions: %dx%d", Window::Width(), Window::Height());
 
+	// Constant data sent to the GPU last frame, against copying every buffer on every draw
+	ImGui::Text("Constant uploads: %.1f KB (%.1f KB without tracking)",
+		constantBytesUploaded / 1024.0f,
+		constantBytesRequested / 1024.0f);
+	ImGui::Text("Constant ring: %.1f KB last frame, %s",
+		ISimpleShader::ConstantRing->GetFrameBytes() / 1024.0f,
+		ISimpleShader::ConstantRing->IsSupported() ? "enabled" : "unsupported");
+
+	// Startup shader loading, and how many skipped reflection thanks to the cache
+	ImGui::Text("Shader load: %.2f ms (%u reflections cached)", shaderLoadTime, numShaderReflectionsCached);
+
 	// Toggle button for demo window
 	if (ImGui::Button("Toggle demo window visibility"))
 	{
@@ -643,13 +2112,112 @@ void Game::BuildUI(float totalTime)
 
 	ImGui::DragInt("Blur Radius", &blurRadius, 1.0f, 0, 25);
 
+	const char* blurModeNames[(int)BlurMode::Count];
+	for (int i = 0; i < (int)BlurMode::Count; i++)
+	{
+		blurModeNames[i] = GetBlurModeName((BlurMode)i);
+	}
+	ImGui::Combo("Blur Mode", &blurMode, blurModeNames, (int)BlurMode::Count);
+	ImGui::Text("Blur: %.1f samples per pixel",
+		GetBlurSamplesPerPixel((BlurMode)blurMode, blurRadius, Window::Width(), Window::Height()));
+
+	if (ImGui::Button("Check blur against CPU"))
+	{
+		blurCheckRequested = true;
+	}
+	if (blurChecked)
+	{
+		if (blurCheckDifference == ~0u)
+		{
+			ImGui::Text("Blur check: couldn't read the blur back");
+		}
+		else
+		{
+			ImGui::Text("Blur check (%s, radius %d): %u pixels differ, by up to %u (CPU took %.1f ms)",
+				GetBlurModeName((BlurMode)blurCheckMode), blurCheckRadius, blurCheckPixels, blurCheckDifference, blurCheckTime);
+		}
+	}
+
 	// Light
 	if (ImGui::CollapsingHeader("Light Data"))
 	{
-		for (size_t ii = 0; ii < lights.size(); ii++)
+		if (ImGui::SliderInt("Extra point lights", &numExtraLights, 0, 10000))
+		{
+			SetExtraLightCount(numExtraLights);
+		}
+		ImGui::Checkbox("Per-object lights", &perObjectLightsEnabled);
+		ImGui::SliderFloat("Sky ambient", &skyAmbientIntensity, 0.0f, 2.0f);
+		if (sky->IsEnvironmentCached())
+			ImGui::Text("Sky specular: loaded from cache in %.1f ms", sky->GetEnvironmentBakeTime());
+		else
+			ImGui::Text("Sky specular: baked in %.1f ms", sky->GetEnvironmentBakeTime());
+		if (perObjectLightsEnabled)
+		{
+			ImGui::Text("Light selection: %.3f ms for %zu lights", objectLightSelectTime, lights.size());
+			ImGui::Text("Objects reselected: %u (%u reused)",
+				objectLightSelector->GetSelectionCount(),
+				objectLightSelector->GetReuseCount());
+		}
+		else
+		{
+			ImGui::Text("Cluster build: %.3f ms for %zu lights", lightClusterBuildTime, lights.size());
+			ImGui::Text("Light indices: %zu (plus %u directional)",
+				lightClusterBuilder->GetLightIndices().size(),
+				lightPacker->GetDirectionalCount());
+		}
+
+		for (size_t ii = 0; ii < numBaseLights; ii++)
 		{
 			std::string header = "Light " + std::to_string(ii) + " color";
 			ImGui::ColorEdit3(header.c_str(), &lights[ii].Color.x);
+
+			std::string shadowLabel = "Light " + std::to_string(ii) + " casts shadows";
+			bool castShadows = lights[ii].CastShadows != 0;
+			if (ImGui::Checkbox(shadowLabel.c_str(), &castShadows))
+			{
+				lights[ii].CastShadows = castShadows;
+			}
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Sky"))
+	{
+		ImGui::Checkbox("Procedural sky", &proceduralSkyEnabled);
+
+		// Light 0 is the sun
+		bool sunMoved = ImGui::SliderFloat("Sun elevation", &sunElevation, -10.0f, 90.0f);
+		sunMoved |= ImGui::SliderFloat("Sun azimuth", &sunAzimuth, 0.0f, 360.0f);
+		if (sunMoved)
+		{
+			float elevation = XMConvertToRadians(sunElevation);
+			float azimuth = XMConvertToRadians(sunAzimuth);
+			lights[0].Direction = XMFLOAT3(
+				-cosf(elevation) * sinf(azimuth),
+				-sinf(elevation),
+				-cosf(elevation) * cosf(azimuth));
+		}
+		ImGui::SliderFloat("Sun illuminance", &sunIlluminance, 0.0f, 40.0f);
+
+		// Changing these bakes every LUT again, and moving the sun up or down
+		// bakes just the sky view
+		ImGui::SliderFloat("Rayleigh scale height", &atmosphere.RayleighScaleHeight, 1.0f, 20.0f, "%.1f km");
+		ImGui::SliderFloat("Mie scattering", &atmosphere.MieScattering, 0.0f, 0.05f, "%.4f");
+		ImGui::SliderFloat("Mie anisotropy", &atmosphere.MieAnisotropy, 0.0f, 0.95f);
+		ImGui::ColorEdit3("Ground albedo", &atmosphere.GroundAlbedo.x);
+		if (ImGui::Button("Reset atmosphere"))
+		{
+			atmosphere = GetEarthAtmosphere();
+		}
+
+		std::shared_ptr<AtmosphereBaker> atmosphereBaker = sky->GetAtmosphereBaker();
+		if (atmosphereBaker->HasLUTs())
+		{
+			ImGui::Text("Last LUT bake: %.1f ms (%s)", atmosphereBaker->GetBakeTime(),
+				atmosphereBaker->ScatteringChanged() ? "all LUTs" : "sky view only");
+		}
+		if (atmosphereBaker->IsBaking())
+		{
+			ImGui::Text("Baking LUTs...");
 		}
 	}
 
@@ -711,7 +2279,28 @@ void Game::BuildUI(float totalTime)
 	if (ImGui::CollapsingHeader("Materials"))
 	{
 		uint32_t idx = 0;
-		ImVec2 imageSize(200, 200);
+		ImGui::Text("Textures: %u cooked, %u decoded at startup", numCookedTextures, numDecodedTextures);
+		ImGui::Text("Texture arrays: %u", numMaterialTextureArrays);
+
+		// Streamed arrays only - anything uncooked is always fully resident
+		const TextureStreamingPlanner& streaming = textureStreamer->GetPlanner();
+		ImGui::SliderFloat("Streaming budget (MB)", &textureStreamingBudget, 1.0f, 64.0f, "%.0f");
+		ImGui::Text("Resident: %.2f MB", streaming.GetResidentBytes() / (1024.0f * 1024.0f));
+		ImGui::Text("Requested: %.2f MB (%.2f MB within budget)",
+			streaming.GetWantedBytes() / (1024.0f * 1024.0f),
+			streaming.GetTargetBytes() / (1024.0f * 1024.0f));
+		ImGui::Text("Mips loading: %u", textureStreamer->GetPendingLoadCount());
+		ImGui::Text("Images decoding: %u (%u waiting to upload)", imageLoader->GetPendingCount(), imageLoader->GetDecodedCount());
+		ImGui::SliderInt("Uploads per frame", &maxTextureUploadsPerFrame, 1, 16);
+		for (unsigned int a = 0; a < streaming.GetTextureCount(); a++)
+		{
+			const StreamingTextureInfo& info = streaming.GetInfo(a);
+			unsigned int resident = streaming.GetResidentMip(a);
+			ImGui::Text("Array %u (%u slices): %ux%u resident, mip %u requested, mip %u in budget",
+				a, info.Slices,
+				info.Width >> resident, info.Height >> resident,
+				streaming.GetWantedMip(a), streaming.GetTargetMip(a));
+		}
 
 		for (const std::shared_ptr<Material>& material : materials)
 		{
@@ -722,13 +2311,16 @@ void Game::BuildUI(float totalTime)
 
 			if (ImGui::CollapsingHeader(header.c_str()))
 			{
-				ImGui::DragFloat4(colTintHeader.c_str(), &material->m_colorTint.x, 0.01f);
-				ImGui::DragFloat2(uvScaleHeader.c_str(), &material->m_uvScale.x, 0.01f);
-				ImGui::DragFloat2(uvOffsetHeader.c_str(), &material->m_uvOffset.x, 0.01f);
+				ImGui::DragFloat4(colTintHeader.c_str(), &material->m_constants.colorTint.x, 0.01f);
+				ImGui::DragFloat2(uvScaleHeader.c_str(), &material->m_constants.uvScale.x, 0.01f);
+				ImGui::DragFloat2(uvOffsetHeader.c_str(), &material->m_constants.uvOffset.x, 0.01f);
 
-				for (const auto& t : material->m_textureSRVs)
+				// Textures are array slices now, which ImGui can't show
+				const unsigned int* slices = &material->m_constants.textureSlices.x;
+				for (unsigned int t = 0; t < 3; t++)
 				{
-					ImGui::Image((ImTextureID)t.second.Get(), imageSize);
+					if (material->m_textureSRVs[t])
+						ImGui::Text("t%u: slice %u", t, slices[t]);
 				}
 			}
 
@@ -736,7 +2328,61 @@ void Game::BuildUI(float totalTime)
 		}
 	}
 
-	ImGui::Image((ImTextureID)shadowSRV.Get(), ImVec2(512, 512));
+	// Occlusion culling
+	if (ImGui::CollapsingHeader("Occlusion Culling"))
+	{
+		ImGui::Checkbox("Enabled##occlusion", &occlusionCullingEnabled);
+		ImGui::Text("Occluder triangles: %u", occlusionCuller->GetOccluderTriangleCount());
+		ImGui::Text("Entities culled: %u", numOccludedEntities);
+		ImGui::Text("Worker threads: %u", threadPool->GetThreadCount());
+		ImGui::Image((ImTextureID)occlusionDebugSRV.Get(),
+			ImVec2((float)occlusionCuller->GetWidth() * 2.0f, (float)occlusionCuller->GetHeight() * 2.0f));
+	}
+
+	// Shadows
+	if (ImGui::CollapsingHeader("Shadows"))
+	{
+		ImGui::SliderInt("Cascades", &numShadowCascades, 2, MAX_SHADOW_CASCADES);
+		ImGui::SliderFloat("Split lambda", &cascadeSplitLambda, 0.0f, 1.0f);
+		ImGui::SliderFloat("Shadow distance", &shadowDistance, 5.0f, 200.0f);
+		ImGui::Text("Shadow caster draws: %zu (%zu entities, %zu views)",
+			numShadowCasterDraws, std::size(scene), shadowViews.size());
+
+		ImGui::Checkbox("Cache static shadows", &shadowCacheEnabled);
+		ImGui::Text("Static cache: %s (%d / %zu views reused)",
+			numShadowCacheHits == (int)shadowViews.size() ? "hit" : "miss",
+			numShadowCacheHits, shadowViews.size());
+		ImGui::Text("Static tiles copied: %d / %zu", numShadowTileCopies, shadowViews.size());
+		ImGui::Text("Cascades follow the camera: moving a shadow texel redraws them");
+
+		for (size_t ii = 0; ii < lights.size(); ii++)
+		{
+			if (lights[ii].ShadowIndex < 0)
+			{
+				continue;
+			}
+
+			const ShadowAtlasTile& tile = shadowAtlas->GetTile(lights[ii].ShadowIndex);
+			ImGui::Text("Light %zu: first tile %ux%u at (%u, %u)", ii, tile.Size, tile.Size, tile.X, tile.Y);
+		}
+
+		ImGui::Text("Atlas: %u tiles, packed %u times", shadowAtlas->GetTileCount(), shadowAtlas->GetRepackCount());
+		ImGui::Image((ImTextureID)shadowSRV.Get(), ImVec2(512, 512));
+
+		ImGui::Checkbox("Virtual shadow map (directional)", &virtualShadowsEnabled);
+		if (virtualShadowLight >= 0)
+		{
+			ImGui::Text("Virtual pages needed: %u, rendered: %zu, not resident: %u",
+				virtualShadowMap->GetNeededPageCount(),
+				virtualShadowMap->GetPagesToRender().size(),
+				virtualShadowMap->GetUnmappedPageCount());
+			ImGui::Text("Physical pages in use: %u / %u, evictions: %u",
+				virtualShadowMap->GetResidentPageCount(),
+				VSM_PHYSICAL_PAGES_PER_SIDE * VSM_PHYSICAL_PAGES_PER_SIDE,
+				virtualShadowMap->GetEvictionCount());
+			ImGui::Image((ImTextureID)virtualShadowPoolSRV.Get(), ImVec2(512, 512));
+		}
+	}
 
 	ImGui::End();
 }
@@ -758,27 +2404,111 @@ void Game::Draw(float deltaTime, float totalTime)
 		Graphics::Context->ClearRenderTargetView(caRTV.Get(), backgroundColor);
 
 		PopulateShadowMap();
+		PopulateVirtualShadowMap();
 
 		Graphics::Context->OMSetRenderTargets(1, blurRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
 	}
 
 	// DRAW geometry
 	{
-		for (const std::shared_ptr<Entity>& entity : scene)
+		// The generated structs size their arrays from the shader's defines
+		static_assert(sizeof(PixelShaderPerFrame::shadowViewProjections) == sizeof(XMFLOAT4X4) * MAX_SHADOW_VIEWS);
+		static_assert(sizeof(PixelShaderPerFrame::cascadeSplits) == sizeof(cascadeSplitDistances));
+
+		std::shared_ptr<Camera>& camera = cameras[activeCameraIdx];
+		VertexShaderPerFrame vertexFrameData = {};
+		vertexFrameData.view = camera->GetViewMatrix();
+		vertexFrameData.projection = camera->GetProjectionMatrix();
+
+		PixelShaderPerFrame pixelFrameData = {};
+		pixelFrameData.camPos = camera->GetTransform()->GetPosition();
+
+		// Combined light matrices and atlas rects for every shadow view,
+		// plus split depths for cascade selection in the pixel shader
+		float atlasSize = (float)shadowAtlas->GetSize();
+		for (unsigned int ii = 0; ii < shadowViews.size(); ii++)
+		{
+			XMStoreFloat4x4(&pixelFrameData.shadowViewProjections[ii], XMMatrixMultiply(
+				XMLoadFloat4x4(&shadowViews[ii].View),
+				XMLoadFloat4x4(&shadowViews[ii].Projection)));
+
+			// UV offset, UV scale and half a texel of the tile (for clamping)
+			const ShadowAtlasTile& tile = shadowAtlas->GetTile(ii);
+			pixelFrameData.shadowAtlasRects[ii] = XMFLOAT4(
+				tile.X / atlasSize,
+				tile.Y / atlasSize,
+				tile.Size / atlasSize,
+				0.5f / tile.Size);
+		}
+		pixelFrameData.cascadeSplits = XMFLOAT4(cascadeSplitDistances);
+		pixelFrameData.numCascades = numShadowCascades;
+		pixelFrameData.virtualShadowViewProjection = virtualShadowViewProjection;
+
+		// Ambient light from the sky, already worked out as 9 colors
+		static_assert(sizeof(PixelShaderPerFrame::skyIrradianceSH) / sizeof(XMFLOAT4) == SH9_COEFFICIENTS);
+		const SH9Color& skySH = sky->GetIrradianceSH();
+		for (unsigned int k = 0; k < SH9_COEFFICIENTS; k++)
+		{
+			XMStoreFloat4(&pixelFrameData.skyIrradianceSH[k], XMLoadFloat3(&skySH.Coefficients[k]));
+		}
+		pixelFrameData.skyAmbientIntensity = skyAmbientIntensity;
+
+		// Lights and their cluster assignments, shared by every entity
+		UploadStructuredBuffer(lightBuffer, lightSRV, lightBufferCapacity,
+			lightPacker->GetPackedLights().data(), (unsigned int)lightPacker->GetPackedLights().size(), sizeof(PackedLight));
+		UploadStructuredBuffer(clusterRangeBuffer, clusterRangeSRV, clusterRangeBufferCapacity,
+			lightClusterBuilder->GetClusterRanges().data(), CLUSTER_COUNT, sizeof(XMUINT3));
+		UploadStructuredBuffer(lightIndexBuffer, lightIndexSRV, lightIndexBufferCapacity,
+			lightClusterBuilder->GetLightIndices().data(),
+			(unsigned int)lightClusterBuilder->GetLightIndices().size(), sizeof(unsigned int));
+
+		pixelFrameData.clusterParams = XMFLOAT4(
+			(float)Window::Width() / CLUSTER_COUNT_X,
+			(float)Window::Height() / CLUSTER_COUNT_Y,
+			lightClusterBuilder->GetSliceScale(),
+			lightClusterBuilder->GetSliceBias());
+		pixelFrameData.numDirectionalLights = (int)lightPacker->GetDirectionalCount();
+		pixelFrameData.perObjectLights = (int)perObjectLightsEnabled;
+
+		// Per-frame data only changes once, no matter how many entities share
+		// a shader (materials sharing shaders just repeat a no-op)
+		for (const std::shared_ptr<Material>& material : materials)
+		{
+			SetFrameShaderData(material, vertexFrameData, pixelFrameData);
+		}
+
+		numOccludedEntities = 0;
+
+		if (occlusionCullingEnabled)
 		{
-			std::shared_ptr<SimpleVertexShader> vs = entity->GetMaterial()->GetVertexShader();
-			std::shared_ptr<SimplePixelShader> ps = entity->GetMaterial()->GetPixelShader();
+			UpdateOcclusionDebugTexture();
+		}
+
+		// Earlier passes (and last frame's sky) bound their own resources,
+		// and material constants may have been edited in the UI since
+		Material::InvalidateBindings();
 
-			ps->SetShaderResourceView("ShadowMap", shadowSRV);
-			ps->SetSamplerState("ShadowSampler", shadowSampler);
+		for (unsigned int entityIndex = 0; entityIndex < std::size(scene); entityIndex++)
+		{
+			const std::shared_ptr<Entity>& entity = scene[entityIndex];
 
-			vs->SetMatrix4x4("lightView", lightViewMatrix);
-			vs->SetMatrix4x4("lightProjection", lightProjectionMatrix);
+			// Occluders pass their own test anyway, so don't bother checking them
+			if (occlusionCullingEnabled &&
+				!entity->IsOccluder() &&
+				!occlusionCuller->IsVisible(entity->GetWorldBounds()))
+			{
+				numOccludedEntities++;
+				continue;
+			}
 
-			ps->SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
-			ps->SetInt("numLights", (int)lights.size());
+			if (perObjectLightsEnabled)
+			{
+				// The list is laid out like the whole PerObject cbuffer (see ObjectLightSelector.h)
+				ConstantBuffer<ObjectLightList> objectLightBuffer(entity->GetMaterial()->GetPixelShader(), "PerObject");
+				objectLightBuffer.Set(objectLightSelector->GetLightList(entityIndex));
+			}
 
-			entity->Draw(cameras[activeCameraIdx]);
+			entity->Draw();
 		}
 	}
 
@@ -789,22 +2519,12 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	// Post Processing - Blur
 	{
-		Graphics::Context->OMSetRenderTargets(1, caRTV.GetAddressOf(), 0);
-
-		ppVS->SetShader();
-		blurPS->SetShader();
+		DrawBlur();
 
-		blurPS->SetShaderResourceView("Pixels", blurSRV.Get());
-		blurPS->SetSamplerState("ClampSampler", ppSampler.Get());
-
-		// Activate shaders and bind resources
-		blurPS->SetInt("blurRadius", blurRadius);
-		blurPS->SetFloat("pixelWidth", 1.0f / Window::Width());
-		blurPS->SetFloat("pixelHeight", 1.0f / Window::Height());
-
-		blurPS->CopyAllBufferData();
-
-		Graphics::Context->Draw(3, 0);
+		if (blurCheckRequested)
+		{
+			CheckBlur();
+		}
 	}
 
 	// Post Processing - Chromatic Aberration
@@ -821,7 +2541,7 @@ void Game::Draw(float deltaTime, float totalTime)
 	}
 
 	{
-		ImGui::Render(); // Turns this frames UI into renderable triangles
+		ImGui::Render(); // Turns this frame�s UI into renderable triangles
 		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData()); // Draws it to the screen
 	}
 	
@@ -843,5 +2563,12 @@ void Game::Draw(float deltaTime, float totalTime)
 
 		ID3D11ShaderResourceView* nullSRVs[128] = {};
 		Graphics::Context->PSSetShaderResources(0, 128, nullSRVs);
+
+		// Frame boundary for the constant ring, plus this frame's upload totals
+		ISimpleShader::ConstantRing->EndFrame();
+		constantBytesUploaded = ISimpleShader::ConstantBytesUploaded;
+		constantBytesRequested = ISimpleShader::ConstantBytesRequested;
+		ISimpleShader::ConstantBytesUploaded = 0;
+		ISimpleShader::ConstantBytesRequested = 0;
 	}
 }
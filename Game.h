@@ -11,6 +11,18 @@
 #include "Camera.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "ThreadPool.h"
+#include "ImageLoader.h"
+#include "OcclusionCuller.h"
+#include "ShadowCascades.h"
+#include "ShadowAtlas.h"
+#include "VirtualShadowMap.h"
+#include "LightClusterBuilder.h"
+#include "LightPacker.h"
+#include "ObjectLightSelector.h"
+#include "ShaderConstants.h"
+#include "TextureStreamer.h"
+#include "Blur.h"
 
 class Game
 {
@@ -30,6 +42,11 @@ public:
 private:
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
 	void CreateEntities();
+	void LoadTexture(const std::wstring& file, MipContent content, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+	void LoadORMTexture(const std::wstring& materialPath, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+	void CreateTextureFromImage(const LoadedImage& image, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+	void BindStreamedTextures();
+	void UpdateTextureStreaming();
 
 	// UI-related functions
 	void UpdateImGui(float deltaTime);
@@ -37,11 +54,44 @@ private:
 
 	// Shadow Map helper functions
 	void CreateShadowMapSetup();
+	void CreateStaticShadowAtlas();
 	void UpdateLightMatrices();
+	unsigned int GetShadowTileSize(const Light& light);
+	void SetShadowTileViewport(const unsigned int viewIndex);
+	void CullShadowCasters(const ShadowView& view);
+	void DrawShadowCasters(const ShadowView& view, const std::vector<std::shared_ptr<Entity>>& casters);
 	void PopulateShadowMap();
 
+	// Virtual shadow map helper functions
+	void CreateVirtualShadowMapSetup();
+	void GetVirtualShadowRect(const DirectX::BoundingBox& worldBounds, DirectX::XMFLOAT2& uvMin, DirectX::XMFLOAT2& uvMax);
+	void UpdateVirtualShadowMap();
+	void PopulateVirtualShadowMap();
+
+	// Clustered lighting helper functions
+	void SetExtraLightCount(const int count);
+	void BuildLightClusters();
+	void SelectObjectLights();
+	void SetFrameShaderData(const std::shared_ptr<Material>& material,
+		const VertexShaderPerFrame& vertexFrameData, const PixelShaderPerFrame& pixelFrameData);
+	void UploadStructuredBuffer(
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer,
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv,
+		unsigned int& capacity,
+		const void* data,
+		const unsigned int count,
+		const unsigned int stride);
+
 	// Post Process helper functions
 	void CreatePostProcessSetup();
+	void DrawBlur();
+	void CheckBlur();
+	void ReadBackTexture(ID3D11ShaderResourceView* srv, MipLevel& image);
+
+	// Occlusion culling helper functions
+	void CreateOcclusionCullingSetup();
+	void UpdateOcclusionBuffer();
+	void UpdateOcclusionDebugTexture();
 
 	// ImGui UI related variables
 	size_t numSecs;
@@ -54,21 +104,116 @@ private:
 	std::shared_ptr<Mesh> meshes[5];
 	std::shared_ptr<Entity> scene[16];
 	std::shared_ptr<Material> materials[4];
+	unsigned int numMaterialTextureArrays;
+	unsigned int numCookedTextures; // Loaded from .dds files
+	unsigned int numDecodedTextures; // Decoded from their source images
+
+	// Texture streaming - cooked textures start with only their smallest
+	// mips, and the rest stream in as the camera gets close enough to need them
+	std::shared_ptr<TextureStreamer> textureStreamer;
+	unsigned int materialStreamedTextures[4][3]; // Streamer index of each material texture, UINT_MAX if loaded whole
+	float textureStreamingBudget; // MB
+
+	// Source images decode on the thread pool, and upload a few per frame
+	std::shared_ptr<ImageLoader> imageLoader;
+	int maxTextureUploadsPerFrame; // Shared with streamed mips
 	std::vector<std::shared_ptr<Camera>> cameras;
 	std::vector<Light> lights;
 	std::shared_ptr<Sky> sky;
+	float skyAmbientIntensity; // Scales the sky's diffuse and specular light on objects
+
+	// Procedural sky, lit by the first light (the sun)
+	bool proceduralSkyEnabled;
+	AtmosphereParameters atmosphere;
+	float sunIlluminance;
+	float sunElevation; // Degrees - set the sun's direction from the UI
+	float sunAzimuth;
 
 	int activeCameraIdx;
 
 	// Shadow Map
+	// Every shadow view (directional cascades, spot lights and point
+	// light faces) renders into its own tile of one atlas texture
+	unsigned int shadowMapResolution; // Largest tile size, used by cascades
+	std::shared_ptr<ShadowAtlas> shadowAtlas;
+	int numShadowCascades;
+	float cascadeSplitLambda;
+	float shadowDistance;
+	float cascadeSplitDistances[MAX_SHADOW_CASCADES]; // Shared by every directional light
+	std::vector<ShadowView> shadowViews;
+	std::vector<unsigned int> shadowTileSizes; // Requested size for each view
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
-	DirectX::XMFLOAT4X4 lightViewMatrix;
-	DirectX::XMFLOAT4X4 lightProjectionMatrix;
+
+	// Static shadow cache - static casters are only redrawn into a tile when
+	// its light matrices change, the atlas is repacked or a static entity moves.
+	// The static atlas only exists while caching is on.
+	bool shadowCacheEnabled;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staticShadowTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> staticShadowDSV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> staticShadowSRV;
+	std::vector<ShadowView> cachedShadowViews;
+	std::vector<bool> shadowCacheValid;
+	std::vector<bool> shadowTileHasDynamicCasters; // Live tile no longer matches the static one
+	unsigned long long cachedStaticShadowVersion;
+	int numShadowCacheHits;
+	int numShadowTileCopies;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
 
 	std::shared_ptr<SimpleVertexShader> shadowMapVS;
+	SimpleShaderHandle shadowWorldHandle; // Set once per caster, so resolved up front
+
+	// Resets the depth of a single atlas tile, since DSV clears can't be limited to a rect.
+	// With the copy pixel shader it copies a tile from the static atlas instead.
+	std::shared_ptr<SimpleVertexShader> shadowTileClearVS;
+	std::shared_ptr<SimplePixelShader> shadowTileCopyPS;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> shadowTileClearDepthState;
+
+	// Virtual shadow map - a paged 16k x 16k alternative to cascades for one directional light
+	std::shared_ptr<VirtualShadowMap> virtualShadowMap;
+	bool virtualShadowsEnabled;
+	int virtualShadowLight; // Index into lights, -1 if unused this frame
+	float virtualShadowExtent; // World units covered by the whole virtual texture
+	DirectX::XMFLOAT4X4 virtualShadowView;
+	DirectX::XMFLOAT4X4 virtualShadowProjection;
+	DirectX::XMFLOAT4X4 virtualShadowViewProjection;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> virtualShadowPoolTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> virtualShadowPoolDSV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> virtualShadowPoolSRV;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> virtualPageTableTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> virtualPageTableSRV;
+
+	// Entities that can cast a shadow onto something the camera sees this frame
+	std::vector<std::shared_ptr<Entity>> shadowCasters;
+	size_t numShadowCasterDraws;
+
+	// Clustered lighting - lights live in a structured buffer and each
+	// pixel only loops over the ones assigned to its cluster
+	std::shared_ptr<LightPacker> lightPacker;
+	std::shared_ptr<LightClusterBuilder> lightClusterBuilder;
+	size_t numBaseLights; // Hand placed lights, before any extra test lights
+	int numExtraLights;
+	float lightClusterBuildTime; // Milliseconds
+	Microsoft::WRL::ComPtr<ID3D11Buffer> lightBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightSRV;
+	unsigned int lightBufferCapacity;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterRangeBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterRangeSRV;
+	unsigned int clusterRangeBufferCapacity;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> lightIndexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightIndexSRV;
+	unsigned int lightIndexBufferCapacity;
+
+	// Per-object light lists (an alternative to the clusters)
+	std::shared_ptr<ObjectLightSelector> objectLightSelector;
+	bool perObjectLightsEnabled;
+	float objectLightSelectTime; // Milliseconds
+
+	// Constant data copied to the GPU last frame (bytes)
+	unsigned long long constantBytesUploaded;
+	unsigned long long constantBytesRequested; // What copying every buffer on every draw would have cost
 
 	// Post Process
 	
@@ -81,10 +226,42 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> blurRTV; // For rendering
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> blurSRV; // For sampling
 
+	std::shared_ptr<SimpleComputeShader> blurSlidingCS;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> blurTempRTV; // Between the separable passes
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> blurTempSRV;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> blurTempUAV;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> blurLevelRTVs[MAX_BLUR_LEVELS]; // Dual filter's half size levels
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> blurLevelSRVs[MAX_BLUR_LEVELS];
+
 	std::shared_ptr<SimplePixelShader> caPS;
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> caRTV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> caSRV;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> caUAV; // The blur's output, for the sliding window
 
 	int blurRadius;
+	int blurMode; // BlurMode
+
+	// Comparing the GPU's blur to BlurImage() on the same input
+	bool blurCheckRequested;
+	bool blurChecked;
+	int blurCheckMode; // What was checked
+	int blurCheckRadius;
+	unsigned int blurCheckDifference; // Largest in any channel
+	unsigned int blurCheckPixels; // Pixels that differ at all
+	float blurCheckTime; // Milliseconds for the CPU blur
+
+	// Shared worker threads for CPU-side jobs
+	std::shared_ptr<ThreadPool> threadPool;
+
+	// Startup shader loading
+	float shaderLoadTime; // Milliseconds
+	unsigned int numShaderReflectionsCached; // Shaders whose reflection came from a .refl file
+
+	// Occlusion culling
+	std::shared_ptr<OcclusionCuller> occlusionCuller;
+	bool occlusionCullingEnabled;
+	unsigned int numOccludedEntities;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> occlusionDebugTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> occlusionDebugSRV;
 };
 
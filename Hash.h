@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// --------------------------------------------------------
+// 64-bit FNV-1a, the one hash used for names, shader
+// bytecode and cache keys.  Pass a previous result as the
+// starting hash to continue it over another block.
+// --------------------------------------------------------
+constexpr unsigned long long FNV1A_OFFSET_BASIS = 14695981039346656037ull;
+constexpr unsigned long long FNV1A_PRIME = 1099511628211ull;
+
+constexpr unsigned long long HashFNV1a(std::string_view bytes, unsigned long long hash = FNV1A_OFFSET_BASIS)
+{
+	for (char c : bytes)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= FNV1A_PRIME;
+	}
+	return hash;
+}
+
+inline unsigned long long HashFNV1aBytes(const void* data, size_t size, unsigned long long hash = FNV1A_OFFSET_BASIS)
+{
+	return HashFNV1a(std::string_view(static_cast<const char*>(data), size), hash);
+}
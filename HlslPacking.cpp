@@ -0,0 +1,74 @@
+#include "HlslPacking.h"
+#include "ShaderConstants.h"
+
+// --------------------------------------------------------
+// Compile-time tests for the packing rules.  Nothing here
+// runs - if a rule is wrong, the project doesn't build.
+// --------------------------------------------------------
+
+using namespace HlslPacking;
+
+// A float fills out the register after a float3
+constexpr Member FLOAT3_FLOAT[] = { Vector(3), Scalar() };
+static_assert(OffsetOf(FLOAT3_FLOAT, 1) == 12);
+static_assert(BufferSizeOf(FLOAT3_FLOAT) == 16);
+
+// A float2 doesn't fit after a float3, so it moves to the next register
+constexpr Member FLOAT3_FLOAT2[] = { Vector(3), Vector(2) };
+static_assert(OffsetOf(FLOAT3_FLOAT2, 1) == 16);
+static_assert(PackedSizeOf(FLOAT3_FLOAT2) == 24);
+static_assert(BufferSizeOf(FLOAT3_FLOAT2) == 32);
+
+// Two float2s share a register, but a float4 never shares one
+constexpr Member FLOAT2_FLOAT2_FLOAT4[] = { Vector(2), Vector(2), Vector(4) };
+static_assert(OffsetOf(FLOAT2_FLOAT2_FLOAT4, 1) == 8);
+static_assert(OffsetOf(FLOAT2_FLOAT2_FLOAT4, 2) == 16);
+
+constexpr Member FLOAT_FLOAT4[] = { Scalar(), Vector(4) };
+static_assert(OffsetOf(FLOAT_FLOAT4, 1) == 16);
+
+// Array elements are padded to whole registers, except the last one,
+// which can share its register with whatever comes next
+constexpr Member FLOAT_ARRAY_FLOAT[] = { Scalar(), Array(Scalar(), 3), Scalar() };
+static_assert(OffsetOf(FLOAT_ARRAY_FLOAT, 1) == 16);
+static_assert(OffsetOf(FLOAT_ARRAY_FLOAT, 2) == 52);
+static_assert(BufferSizeOf(FLOAT_ARRAY_FLOAT) == 64);
+
+// Matrices start a register, one per column
+constexpr Member FLOAT_MATRIX[] = { Scalar(), Matrix() };
+static_assert(OffsetOf(FLOAT_MATRIX, 1) == 16);
+static_assert(BufferSizeOf(FLOAT_MATRIX) == 80);
+static_assert(Matrix(4, 3).Size == 48);
+
+// Structs start a register too
+constexpr Member FLOAT_STRUCT[] = { Scalar(), Struct(8) };
+static_assert(OffsetOf(FLOAT_STRUCT, 1) == 16);
+
+// The rules should agree with the shader compiler, via the generated structs
+constexpr Member PIXEL_SHADER_PER_FRAME[] = {
+	Vector(3),						// camPos
+	Scalar(),						// numDirectionalLights
+	Vector(4),						// clusterParams
+	Scalar(),						// perObjectLights
+	Array(Matrix(), 16),			// shadowViewProjections
+	Array(Vector(4), 16),			// shadowAtlasRects
+	Vector(4),						// cascadeSplits
+	Scalar(),						// numCascades
+	Matrix(),						// virtualShadowViewProjection
+	Array(Vector(4), 9),			// skyIrradianceSH
+	Scalar() };						// skyAmbientIntensity
+static_assert(OffsetOf(PIXEL_SHADER_PER_FRAME, 1) == offsetof(PixelShaderPerFrame, numDirectionalLights));
+static_assert(OffsetOf(PIXEL_SHADER_PER_FRAME, 3) == offsetof(PixelShaderPerFrame, perObjectLights));
+static_assert(OffsetOf(PIXEL_SHADER_PER_FRAME, 4) == offsetof(PixelShaderPerFrame, shadowViewProjections));
+static_assert(OffsetOf(PIXEL_SHADER_PER_FRAME, 5) == offsetof(PixelShaderPerFrame, shadowAtlasRects));
+static_assert(OffsetOf(PIXEL_SHADER_PER_FRAME, 7) == offsetof(PixelShaderPerFrame, numCascades));
+static_assert(OffsetOf(PIXEL_SHADER_PER_FRAME, 8) == offsetof(PixelShaderPerFrame, virtualShadowViewProjection));
+static_assert(OffsetOf(PIXEL_SHADER_PER_FRAME, 9) == offsetof(PixelShaderPerFrame, skyIrradianceSH));
+static_assert(OffsetOf(PIXEL_SHADER_PER_FRAME, 10) == offsetof(PixelShaderPerFrame, skyAmbientIntensity));
+static_assert(BufferSizeOf(PIXEL_SHADER_PER_FRAME) == sizeof(PixelShaderPerFrame));
+
+constexpr Member PIXEL_SHADER_PER_MATERIAL[] = { Vector(4), Vector(2), Vector(2), Scalar(), Vector(4) };
+static_assert(OffsetOf(PIXEL_SHADER_PER_MATERIAL, 2) == offsetof(PixelShaderPerMaterial, uvOffset));
+static_assert(OffsetOf(PIXEL_SHADER_PER_MATERIAL, 3) == offsetof(PixelShaderPerMaterial, roughness));
+static_assert(OffsetOf(PIXEL_SHADER_PER_MATERIAL, 4) == offsetof(PixelShaderPerMaterial, textureSlices));
+static_assert(BufferSizeOf(PIXEL_SHADER_PER_MATERIAL) == sizeof(PixelShaderPerMaterial));
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// The HLSL constant buffer packing rules, worked out at
+// compile time, for checking that a C++ struct copied into
+// a cbuffer lines up with what the shader expects:
+//
+// - Everything is packed into 16 byte registers
+// - A member never straddles two registers; if it doesn't
+//   fit in what's left of the current one, it moves on to
+//   the start of the next
+// - Arrays, structs and matrices always start a register,
+//   and every array element but the last is padded out to
+//   a whole number of registers
+// - The buffer itself is rounded up to a whole register
+//
+// Describe the cbuffer as a list of members, then compare
+// against the C++ struct with static_assert:
+//
+//   constexpr HlslPacking::Member LAYOUT[] = {
+//       HlslPacking::Vector(3), HlslPacking::Scalar(), HlslPacking::Matrix() };
+//   static_assert(HlslPacking::OffsetOf(LAYOUT, 2) == offsetof(MyConstants, World));
+//
+// Structs generated from reflection (ShaderConstants.h) are
+// already checked against the shader; this is for structs
+// written by hand, like ObjectLightList.
+// --------------------------------------------------------
+namespace HlslPacking
+{
+	constexpr unsigned int REGISTER_SIZE = 16;
+
+	// One cbuffer member, as far as packing is concerned
+	struct Member
+	{
+		unsigned int Size;		// Bytes covered, including padding between array elements
+		bool StartsRegister;	// Arrays, structs and matrices
+	};
+
+	constexpr unsigned int AlignToRegister(const unsigned int offset)
+	{
+		return (offset + REGISTER_SIZE - 1) / REGISTER_SIZE * REGISTER_SIZE;
+	}
+
+	// float, int, uint or bool (which is 4 bytes in HLSL)
+	constexpr Member Scalar()
+	{
+		return { 4, false };
+	}
+
+	constexpr Member Vector(const unsigned int components)
+	{
+		return { 4 * components, false };
+	}
+
+	// A column_major matrix (HLSL's default) takes one register per column,
+	// and the last column only covers as many bytes as there are rows
+	constexpr Member Matrix(const unsigned int rows = 4, const unsigned int columns = 4)
+	{
+		return { REGISTER_SIZE * (columns - 1) + 4 * rows, true };
+	}
+
+	constexpr Member Array(const Member element, const unsigned int count)
+	{
+		return { AlignToRegister(element.Size) * (count - 1) + element.Size, true };
+	}
+
+	// A nested struct, from its PackedSizeOf() (not rounded up)
+	constexpr Member Struct(const unsigned int packedSize)
+	{
+		return { packedSize, true };
+	}
+
+	// Where a member goes when the members before it end at the given offset
+	constexpr unsigned int Place(const unsigned int end, const Member member)
+	{
+		unsigned int used = end % REGISTER_SIZE;
+		if (member.StartsRegister || (used != 0 && used + member.Size > REGISTER_SIZE))
+		{
+			return AlignToRegister(end);
+		}
+
+		return end;
+	}
+
+	template<size_t N>
+	constexpr unsigned int OffsetOf(const Member(&members)[N], const size_t index)
+	{
+		unsigned int end = 0;
+		for (size_t ii = 0; ii < index; ii++)
+		{
+			end = Place(end, members[ii]) + members[ii].Size;
+		}
+
+		return Place(end, members[index]);
+	}
+
+	// Where the last member ends, which is as much as needs to be copied
+	template<size_t N>
+	constexpr unsigned int PackedSizeOf(const Member(&members)[N])
+	{
+		return OffsetOf(members, N - 1) + members[N - 1].Size;
+	}
+
+	// The size of the whole buffer, as reflection reports it
+	template<size_t N>
+	constexpr unsigned int BufferSizeOf(const Member(&members)[N])
+	{
+		return AlignToRegister(PackedSizeOf(members));
+	}
+}
@@ -0,0 +1,107 @@
+#include "ImageLoader.h"
+#include "TextureCooker.h"
+#include "PathHelpers.h"
+
+#include <climits>
+#include <thread>
+#include <utility>
+
+ImageLoader::ImageLoader(std::shared_ptr<ThreadPool> threadPool) :
+	m_threadPool(threadPool),
+	m_pending(0),
+	m_decoding(0)
+{
+}
+
+ImageLoader::~ImageLoader()
+{
+	// Decodes still running push into the queue, so it has to outlive them.
+	// Anything decoded but never uploaded is freed with the queue.
+	while (m_decoding.load() > 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void ImageLoader::Load(const std::wstring& file, UploadFunction upload)
+{
+	Load([file](LoadedImage& image)
+	{
+		MipLevel level = {};
+		if (!LoadImageRGBA(file, level.Width, level.Height, level.Pixels))
+		{
+			image.Error = "Couldn't read " + WideToNarrow(file);
+			return false;
+		}
+
+		image.Mips.push_back(std::move(level));
+		return true;
+	}, std::move(upload));
+}
+
+void ImageLoader::Load(const std::wstring& file, MipContent content, UploadFunction upload)
+{
+	Load([file, content](LoadedImage& image)
+	{
+		unsigned int width = 0;
+		unsigned int height = 0;
+		std::vector<unsigned char> rgba;
+		if (!LoadImageRGBA(file, width, height, rgba))
+		{
+			image.Error = "Couldn't read " + WideToNarrow(file);
+			return false;
+		}
+
+		image.Mips = GenerateMipChain(rgba.data(), width, height, content);
+		return true;
+	}, std::move(upload));
+}
+
+void ImageLoader::Load(DecodeFunction decode, UploadFunction upload)
+{
+	m_pending++;
+	m_decoding++;
+
+	m_threadPool->Submit([this, decode = std::move(decode), upload = std::move(upload)]() mutable
+	{
+		DecodedImage decoded;
+		if (!decode(decoded.Image))
+			decoded.Image.Mips.clear();
+
+		// Let go of whatever the decode holds now, rather than after the
+		// count below says it's done (by when the loader may be gone)
+		decode = nullptr;
+		decoded.Upload = std::move(upload);
+
+		m_decoded.Push(std::move(decoded));
+		m_decoding--;
+	});
+}
+
+unsigned int ImageLoader::Upload(unsigned int maxUploads)
+{
+	unsigned int uploads = 0;
+	DecodedImage decoded;
+	while (uploads < maxUploads && m_decoded.TryPop(decoded))
+	{
+		decoded.Upload(decoded.Image);
+
+		// Let go of the pixels now, rather than when the next pop replaces them
+		decoded = DecodedImage();
+		m_pending--;
+		uploads++;
+	}
+	return uploads;
+}
+
+void ImageLoader::UploadAll()
+{
+	while (m_pending.load() > 0)
+	{
+		if (Upload(UINT_MAX) == 0)
+			std::this_thread::yield();
+	}
+}
+
+unsigned int ImageLoader::GetPendingCount() const { return m_pending.load(); }
+unsigned int ImageLoader::GetDecodedCount() const { return m_decoded.GetCount(); }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MipGenerator.h"
+#include "MPSCQueue.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// A decoded image, ready to upload
+// --------------------------------------------------------
+struct LoadedImage
+{
+	std::vector<MipLevel> Mips; // Empty if it couldn't be decoded
+	std::string Error;
+};
+
+// --------------------------------------------------------
+// Reads and decodes images on the thread pool, and hands
+// them back to the thread that owns the device to upload.
+// Nothing in here touches Direct3D - uploading is up to
+// each load's upload function.
+//
+//   loader.Load(L"wood_albedo.png", MipContent::SRGBColor,
+//       [&](LoadedImage& image) { CreateTexture(image, srv); });
+//
+//   // Every frame, on the device thread
+//   loader.Upload(maxUploadsPerFrame);
+//
+// Decoded images come back through a lock-free queue, so
+// workers never wait on the device thread (or each other).
+// Upload() bounds how many are handed over per call, so
+// loading during play doesn't hitch a frame.
+// --------------------------------------------------------
+class ImageLoader
+{
+public:
+	typedef std::function<bool(LoadedImage& image)> DecodeFunction; // Worker thread
+	typedef std::function<void(LoadedImage& image)> UploadFunction; // Upload() thread
+
+	ImageLoader(std::shared_ptr<ThreadPool> threadPool);
+	~ImageLoader();
+	ImageLoader(const ImageLoader&) = delete;
+	ImageLoader& operator=(const ImageLoader&) = delete;
+
+	// Decodes a file as one level, with no mips
+	void Load(const std::wstring& file, UploadFunction upload);
+
+	// Decodes a file and builds its mip chain for that content
+	void Load(const std::wstring& file, MipContent content, UploadFunction upload);
+
+	// Runs any decode on a worker.  A decode that fails (returns
+	// false) still reaches its upload, with no mips.
+	void Load(DecodeFunction decode, UploadFunction upload);
+
+	// Runs up to maxUploads upload functions for finished images,
+	// oldest first, and returns how many ran
+	unsigned int Upload(unsigned int maxUploads);
+
+	// Waits for (and uploads) everything loaded so far
+	void UploadAll();
+
+	// Getters
+	unsigned int GetPendingCount() const; // Loaded, but not uploaded yet
+	unsigned int GetDecodedCount() const; // Waiting in the queue to upload
+
+private:
+	struct DecodedImage
+	{
+		LoadedImage Image;
+		UploadFunction Upload;
+	};
+
+	std::shared_ptr<ThreadPool> m_threadPool;
+	MPSCQueue<DecodedImage> m_decoded;
+	std::atomic<unsigned int> m_pending; // Loaded but not uploaded
+	std::atomic<unsigned int> m_decoding; // Still on a worker
+};
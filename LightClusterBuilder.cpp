@@ -0,0 +1,228 @@
+#include "LightClusterBuilder.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+LightClusterBuilder::LightClusterBuilder(const std::shared_ptr<ThreadPool>& threadPool) :
+	m_threadPool(threadPool),
+	m_boundsNear(0.0f),
+	m_boundsFar(0.0f),
+	m_sliceScale(0.0f),
+	m_sliceBias(0.0f)
+{
+	XMStoreFloat4x4(&m_boundsProjection, XMMatrixIdentity());
+
+	m_clusterMin.resize(CLUSTER_COUNT);
+	m_clusterMax.resize(CLUSTER_COUNT);
+	m_sliceDepths.resize(CLUSTER_COUNT_Z + 1);
+	m_clusterLights.resize(CLUSTER_COUNT);
+	m_clusterRanges.resize(CLUSTER_COUNT);
+}
+
+void LightClusterBuilder::UpdateClusterBounds(const XMFLOAT4X4& projection, const float nearDist, const float farDist)
+{
+	if (memcmp(&projection, &m_boundsProjection, sizeof(XMFLOAT4X4)) == 0 &&
+		nearDist == m_boundsNear &&
+		farDist == m_boundsFar)
+	{
+		return;
+	}
+
+	m_boundsProjection = projection;
+	m_boundsNear = nearDist;
+	m_boundsFar = farDist;
+
+	// Exponential slices keep clusters roughly cube shaped as they get further away
+	float logDepthRange = std::log(farDist / nearDist);
+	for (unsigned int z = 0; z <= CLUSTER_COUNT_Z; z++)
+	{
+		m_sliceDepths[z] = nearDist * std::pow(farDist / nearDist, (float)z / CLUSTER_COUNT_Z);
+	}
+	m_sliceScale = CLUSTER_COUNT_Z / logDepthRange;
+	m_sliceBias = -CLUSTER_COUNT_Z * std::log(nearDist) / logDepthRange;
+
+	// View space x and y at a depth of 1 for an NDC coordinate
+	float invScaleX = 1.0f / projection._11;
+	float invScaleY = 1.0f / projection._22;
+
+	for (unsigned int z = 0; z < CLUSTER_COUNT_Z; z++)
+	{
+		float sliceNear = m_sliceDepths[z];
+		float sliceFar = m_sliceDepths[z + 1];
+
+		for (unsigned int y = 0; y < CLUSTER_COUNT_Y; y++)
+		{
+			// Row 0 is the top of the screen
+			float ndcTop = 1.0f - 2.0f * y / CLUSTER_COUNT_Y;
+			float ndcBottom = 1.0f - 2.0f * (y + 1) / CLUSTER_COUNT_Y;
+
+			for (unsigned int x = 0; x < CLUSTER_COUNT_X; x++)
+			{
+				float ndcLeft = -1.0f + 2.0f * x / CLUSTER_COUNT_X;
+				float ndcRight = -1.0f + 2.0f * (x + 1) / CLUSTER_COUNT_X;
+
+				// The cluster's frustum corners scale linearly with depth,
+				// so its extremes are at either the near or far depth
+				float xs[4] = {
+					ndcLeft * invScaleX * sliceNear, ndcRight * invScaleX * sliceNear,
+					ndcLeft * invScaleX * sliceFar, ndcRight * invScaleX * sliceFar };
+				float ys[4] = {
+					ndcBottom * invScaleY * sliceNear, ndcTop * invScaleY * sliceNear,
+					ndcBottom * invScaleY * sliceFar, ndcTop * invScaleY * sliceFar };
+
+				XMFLOAT3 clusterMin(xs[0], ys[0], sliceNear);
+				XMFLOAT3 clusterMax(xs[0], ys[0], sliceFar);
+				for (int ii = 1; ii < 4; ii++)
+				{
+					clusterMin.x = xs[ii] < clusterMin.x ? xs[ii] : clusterMin.x;
+					clusterMax.x = xs[ii] > clusterMax.x ? xs[ii] : clusterMax.x;
+					clusterMin.y = ys[ii] < clusterMin.y ? ys[ii] : clusterMin.y;
+					clusterMax.y = ys[ii] > clusterMax.y ? ys[ii] : clusterMax.y;
+				}
+
+				unsigned int cluster = (z * CLUSTER_COUNT_Y + y) * CLUSTER_COUNT_X + x;
+				m_clusterMin[cluster] = clusterMin;
+				m_clusterMax[cluster] = clusterMax;
+			}
+		}
+	}
+}
+
+void LightClusterBuilder::Build(const std::vector<Light>& lights,
+	const XMFLOAT4X4& view,
+	const XMFLOAT4X4& projection,
+	const float nearDist,
+	const float farDist)
+{
+	UpdateClusterBounds(projection, nearDist, farDist);
+
+	m_lightIndices.clear();
+	m_spheres.clear();
+
+	// Directional lights are handled separately by the shader,
+	// everything else gets a view space bounding sphere
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	for (unsigned int ii = 0; ii < lights.size(); ii++)
+	{
+		const Light& light = lights[ii];
+
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+		{
+			continue;
+		}
+
+		XMVECTOR center = XMLoadFloat3(&light.Position);
+		float radius = light.Range;
+
+		if (light.Type == LIGHT_TYPE_SPOT)
+		{
+			// Smallest sphere around the cone: wide cones are bounded by their
+			// end cap, narrow ones by a sphere through the apex and the cap's rim
+			XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&light.Direction));
+			float cosAngle = std::cos(light.SpotOuterAngle);
+			if (light.SpotOuterAngle > XM_PIDIV4)
+			{
+				center = XMVectorAdd(center, XMVectorScale(direction, light.Range * cosAngle));
+				radius = light.Range * std::sin(light.SpotOuterAngle);
+			}
+			else
+			{
+				radius = light.Range / (2.0f * cosAngle);
+				center = XMVectorAdd(center, XMVectorScale(direction, radius));
+			}
+		}
+
+		LightSphere sphere = {};
+		XMStoreFloat3(&sphere.Center, XMVector3Transform(center, viewMatrix));
+		sphere.Radius = radius;
+		sphere.LightIndex = ii;
+
+		// Entirely outside the clustered depth range
+		if (sphere.Center.z + radius < nearDist || sphere.Center.z - radius > farDist)
+		{
+			continue;
+		}
+
+		m_spheres.push_back(sphere);
+	}
+	m_threadPool->ParallelFor(CLUSTER_COUNT_Z, [this](unsigned int slice) { BinSlice(slice); });
+
+	// Flatten into one compact list, in cluster order. Spheres were binned
+	// in light order, so the spot lights are already at the end of each list.
+	unsigned int offset = 0;
+	for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+	{
+		const std::vector<unsigned int>& clusterLights = m_clusterLights[cluster];
+
+		unsigned int pointCount = 0;
+		while (pointCount < clusterLights.size() && lights[clusterLights[pointCount]].Type == LIGHT_TYPE_POINT)
+		{
+			pointCount++;
+		}
+
+		m_clusterRanges[cluster] = XMUINT3(offset, pointCount, static_cast<unsigned int>(clusterLights.size()) - pointCount);
+		m_lightIndices.insert(m_lightIndices.end(), clusterLights.begin(), clusterLights.end());
+		offset += static_cast<unsigned int>(clusterLights.size());
+	}
+}
+
+void LightClusterBuilder::BinSlice(const unsigned int slice)
+{
+	unsigned int firstCluster = slice * CLUSTER_COUNT_X * CLUSTER_COUNT_Y;
+	for (unsigned int ii = 0; ii < CLUSTER_COUNT_X * CLUSTER_COUNT_Y; ii++)
+	{
+		m_clusterLights[firstCluster + ii].clear();
+	}
+
+	float sliceNear = m_sliceDepths[slice];
+	float sliceFar = m_sliceDepths[slice + 1];
+
+	for (const LightSphere& sphere : m_spheres)
+	{
+		if (sphere.Center.z + sphere.Radius < sliceNear || sphere.Center.z - sphere.Radius > sliceFar)
+		{
+			continue;
+		}
+
+		XMVECTOR center = XMLoadFloat3(&sphere.Center);
+		XMVECTOR radiusSquared = XMVectorReplicate(sphere.Radius * sphere.Radius);
+
+		for (unsigned int ii = 0; ii < CLUSTER_COUNT_X * CLUSTER_COUNT_Y; ii++)
+		{
+			unsigned int cluster = firstCluster + ii;
+
+			// Distance from the sphere's center to the closest point in the box
+			XMVECTOR closest = XMVectorClamp(center,
+				XMLoadFloat3(&m_clusterMin[cluster]),
+				XMLoadFloat3(&m_clusterMax[cluster]));
+			XMVECTOR distanceSquared = XMVector3LengthSq(XMVectorSubtract(center, closest));
+
+			if (XMVector3LessOrEqual(distanceSquared, radiusSquared))
+			{
+				m_clusterLights[cluster].push_back(sphere.LightIndex);
+			}
+		}
+	}
+}
+
+const std::vector<XMUINT3>& LightClusterBuilder::GetClusterRanges() const
+{
+	return m_clusterRanges;
+}
+
+const std::vector<unsigned int>& LightClusterBuilder::GetLightIndices() const
+{
+	return m_lightIndices;
+}
+
+float LightClusterBuilder::GetSliceScale() const
+{
+	return m_sliceScale;
+}
+
+float LightClusterBuilder::GetSliceBias() const
+{
+	return m_sliceBias;
+}
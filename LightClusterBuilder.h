@@ -0,0 +1,79 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+
+#include "Lights.h"
+#include "ThreadPool.h"
+
+// Must match the CLUSTER_ defines in ShaderIncludes.hlsli
+#define CLUSTER_COUNT_X (16)
+#define CLUSTER_COUNT_Y (9)
+#define CLUSTER_COUNT_Z (24)
+#define CLUSTER_COUNT (CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z)
+
+// --------------------------------------------------------
+// Assigns lights to froxels (view space clusters) for
+// clustered forward shading.
+//
+// The view frustum is split into a screen space grid, and
+// into depth slices that grow exponentially with distance.
+// Point and spot lights are bounded by spheres and tested
+// against each cluster's view space box (DirectXMath SIMD),
+// one depth slice per job on the thread pool. Directional
+// lights touch everything, so they're skipped here and the
+// shader loops over them separately.
+//
+// The lights are expected to be sorted by type (see
+// LightPacker), so each cluster's list holds its point
+// lights followed by its spot lights.
+//
+// Nothing in here touches Direct3D.
+// --------------------------------------------------------
+class LightClusterBuilder
+{
+public:
+	LightClusterBuilder(const std::shared_ptr<ThreadPool>& threadPool);
+
+	void Build(const std::vector<Light>& lights,
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection,
+		const float nearDist,
+		const float farDist);
+
+	// Getters
+	const std::vector<DirectX::XMUINT3>& GetClusterRanges() const; // Offset, point light count and spot light count, per cluster
+	const std::vector<unsigned int>& GetLightIndices() const; // Each cluster's lights, in cluster order
+	float GetSliceScale() const; // Depth slice = log(view depth) * scale + bias
+	float GetSliceBias() const;
+
+private:
+	struct LightSphere
+	{
+		DirectX::XMFLOAT3 Center; // View space
+		float Radius;
+		unsigned int LightIndex;
+	};
+
+	std::shared_ptr<ThreadPool> m_threadPool;
+
+	// Cluster boxes only change with the projection
+	DirectX::XMFLOAT4X4 m_boundsProjection;
+	float m_boundsNear;
+	float m_boundsFar;
+	std::vector<DirectX::XMFLOAT3> m_clusterMin;
+	std::vector<DirectX::XMFLOAT3> m_clusterMax;
+	std::vector<float> m_sliceDepths; // CLUSTER_COUNT_Z + 1 boundaries
+	float m_sliceScale;
+	float m_sliceBias;
+
+	std::vector<LightSphere> m_spheres;
+	std::vector<std::vector<unsigned int>> m_clusterLights; // Scratch per cluster, kept between frames
+
+	std::vector<DirectX::XMUINT3> m_clusterRanges;
+	std::vector<unsigned int> m_lightIndices;
+
+	void UpdateClusterBounds(const DirectX::XMFLOAT4X4& projection, const float nearDist, const float farDist);
+	void BinSlice(const unsigned int slice);
+};
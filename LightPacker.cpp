@@ -0,0 +1,92 @@
+#include "LightPacker.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+LightPacker::LightPacker() :
+	m_typeCounts{}
+{
+}
+
+void LightPacker::Pack(const std::vector<Light>& lights, const int virtualShadowLight)
+{
+	m_packedLights.resize(lights.size());
+	m_sortedLights.resize(lights.size());
+
+	// Counting sort by type, which keeps the original order within each type
+	m_typeCounts[LIGHT_TYPE_DIRECTIONAL] = 0;
+	m_typeCounts[LIGHT_TYPE_POINT] = 0;
+	m_typeCounts[LIGHT_TYPE_SPOT] = 0;
+	for (const Light& light : lights)
+	{
+		m_typeCounts[light.Type]++;
+	}
+
+	unsigned int nextIndex[3] = {
+		0,
+		m_typeCounts[LIGHT_TYPE_DIRECTIONAL],
+		m_typeCounts[LIGHT_TYPE_DIRECTIONAL] + m_typeCounts[LIGHT_TYPE_POINT] };
+
+	for (unsigned int ii = 0; ii < lights.size(); ii++)
+	{
+		const Light& light = lights[ii];
+		unsigned int packedIndex = nextIndex[light.Type]++;
+
+		m_sortedLights[packedIndex] = light;
+
+		PackedLight& packed = m_packedLights[packedIndex];
+		packed.Position = light.Position;
+		packed.InvRangeSquared = light.Range > 0.0f ? 1.0f / (light.Range * light.Range) : 0.0f;
+
+		XMStoreFloat3(&packed.Direction, XMVector3Normalize(XMLoadFloat3(&light.Direction)));
+
+		packed.Radiance = XMFLOAT3(
+			light.Color.x * light.Intensity,
+			light.Color.y * light.Intensity,
+			light.Color.z * light.Intensity);
+
+		if (light.Type == LIGHT_TYPE_SPOT)
+		{
+			float cosOuter = std::cos(light.SpotOuterAngle);
+			float cosInner = std::cos(light.SpotInnerAngle);
+			packed.CosOuter = cosOuter;
+			packed.SpotScale = cosOuter != cosInner ? 1.0f / (cosOuter - cosInner) : -1.0e6f;
+		}
+		else
+		{
+			packed.CosOuter = 0.0f;
+			packed.SpotScale = 0.0f;
+		}
+
+		packed.ShadowIndex = light.ShadowIndex;
+		packed.VirtualShadow = static_cast<int>(ii) == virtualShadowLight;
+		packed.Padding[0] = 0.0f;
+		packed.Padding[1] = 0.0f;
+	}
+}
+
+const std::vector<PackedLight>& LightPacker::GetPackedLights() const
+{
+	return m_packedLights;
+}
+
+const std::vector<Light>& LightPacker::GetSortedLights() const
+{
+	return m_sortedLights;
+}
+
+unsigned int LightPacker::GetDirectionalCount() const
+{
+	return m_typeCounts[LIGHT_TYPE_DIRECTIONAL];
+}
+
+unsigned int LightPacker::GetPointCount() const
+{
+	return m_typeCounts[LIGHT_TYPE_POINT];
+}
+
+unsigned int LightPacker::GetSpotCount() const
+{
+	return m_typeCounts[LIGHT_TYPE_SPOT];
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Lights.h"
+
+// --------------------------------------------------------
+// A light as the pixel shader sees it, with everything that
+// doesn't change per pixel worked out ahead of time.
+// Must match PackedLight in ShaderIncludes.hlsli.
+// --------------------------------------------------------
+struct PackedLight
+{
+	DirectX::XMFLOAT3 Position;
+	float InvRangeSquared;
+
+	DirectX::XMFLOAT3 Direction; // Normalized, pointing away from the light
+	float CosOuter;
+
+	DirectX::XMFLOAT3 Radiance; // Color * Intensity
+	float SpotScale; // 1 / (cos(outer) - cos(inner))
+
+	int ShadowIndex; // First view in the shadow atlas, -1 if unshadowed
+	int VirtualShadow; // Uses the virtual shadow map instead of the atlas
+	float Padding[2];
+};
+
+// Structured buffers pack tightly rather than by cbuffer rules, so the
+// padding is only there to keep each light on whole 16 byte registers
+static_assert(sizeof(PackedLight) == 64, "PackedLight must match the shader's stride");
+
+// --------------------------------------------------------
+// Converts the scene's lights into PackedLights once per
+// frame, sorted by type: directional lights first, then
+// point lights, then spot lights. Anything that builds
+// index lists (clusters, per-object lists) works on the
+// sorted lights so its indices line up with the buffer, and
+// ascending index lists come out grouped by type for free.
+//
+// Nothing in here touches Direct3D.
+// --------------------------------------------------------
+class LightPacker
+{
+public:
+	LightPacker();
+
+	void Pack(const std::vector<Light>& lights, const int virtualShadowLight);
+
+	// Getters
+	const std::vector<PackedLight>& GetPackedLights() const;
+	const std::vector<Light>& GetSortedLights() const; // Same order as the packed lights
+	unsigned int GetDirectionalCount() const;
+	unsigned int GetPointCount() const;
+	unsigned int GetSpotCount() const;
+
+private:
+	std::vector<PackedLight> m_packedLights;
+	std::vector<Light> m_sortedLights;
+
+	unsigned int m_typeCounts[3];
+};
@@ -19,5 +19,6 @@ struct Light
 
 	float SpotInnerAngle;
 	float SpotOuterAngle;
-	DirectX::XMFLOAT2 Padding;
+	int CastShadows;
+	int ShadowIndex; // First view in the shadow atlas, -1 if unshadowed (filled in every frame)
 };
\ No newline at end of file
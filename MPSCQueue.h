@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// --------------------------------------------------------
+// An unbounded, lock-free, multiple producer / single
+// consumer FIFO queue (Dmitry Vyukov's node-based design).
+//
+// Any thread can Push(); only one thread at a time may
+// TryPop().  Each push allocates one node, which the
+// consumer frees as it pops past it, so nothing needs to be
+// reclaimed behind anyone's back.  Items from one producer
+// come out in the order they went in.
+//
+// A pop can briefly miss an item whose push is halfway done
+// (between the two steps in Push), and it'll show up on the
+// next pop instead.
+// --------------------------------------------------------
+template<typename T>
+class MPSCQueue
+{
+public:
+	MPSCQueue() :
+		m_head(new Node()),
+		m_count(0)
+	{
+		m_tail = m_head.load(std::memory_order_relaxed);
+	}
+
+	~MPSCQueue()
+	{
+		T item;
+		while (TryPop(item)) {}
+		delete m_tail;
+	}
+
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	void Push(T item)
+	{
+		Node* node = new Node();
+		node->Item = std::move(item);
+
+		// Counted first, so a quick pop can't take the count below zero
+		m_count.fetch_add(1, std::memory_order_relaxed);
+
+		// Claim the head, then link the old head to it.  Until the link
+		// is made, the consumer just sees the queue end at the old head.
+		Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+		previous->Next.store(node, std::memory_order_release);
+	}
+
+	// Consumer thread only
+	bool TryPop(T& item)
+	{
+		// The tail is a spent node, and the item is in the one after it
+		Node* tail = m_tail;
+		Node* next = tail->Next.load(std::memory_order_acquire);
+		if (!next)
+			return false;
+
+		item = std::move(next->Item);
+		m_tail = next;
+		delete tail;
+		m_count.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Approximate while producers are pushing
+	unsigned int GetCount() const
+	{
+		return m_count.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Node
+	{
+		std::atomic<Node*> Next{ nullptr };
+		T Item{};
+	};
+
+	std::atomic<Node*> m_head; // Newest, where producers push
+	Node* m_tail; // Oldest (already popped), consumer only
+	std::atomic<unsigned int> m_count;
+};
@@ -6,6 +6,8 @@
 #include "Graphics.h"
 #include "Game.h"
 #include "Input.h"
+#include "PathHelpers.h"
+#include "ConstantBufferCodegen.h"
 
 // Annonymous namespace to hold variables
 // only accessible in this file
@@ -50,6 +52,25 @@ int WINAPI WinMain(
 	printf("Console window created successfully.  Feel free to printf() here.\n");
 #endif
 
+	// Codegen mode: writes ShaderConstants.h from the compiled shaders and
+	// exits, so it can run after a build (optionally given where to write it)
+	//   D3D11Starter.exe -generate-constants "..\..\ShaderConstants.h"
+	const std::string generateConstantsFlag = "-generate-constants";
+	std::string commandLine = lpCmdLine;
+	if (commandLine.compare(0, generateConstantsFlag.size(), generateConstantsFlag) == 0)
+	{
+		std::string headerFile = commandLine.substr(generateConstantsFlag.size());
+		headerFile.erase(0, headerFile.find_first_not_of(" \""));
+		headerFile.erase(headerFile.find_last_not_of(" \"") + 1);
+
+		bool written = WriteConstantBufferHeader(
+			{ FixPath(L"VertexShader.cso"), FixPath(L"PixelShader.cso") },
+			headerFile.empty() ? FixPath(L"ShaderConstants.h") : NarrowToWide(headerFile));
+
+		printf(written ? "Constant buffer structs written.\n" : "Constant buffer structs could not be generated.\n");
+		return written ? 0 : 1;
+	}
+
 	// Set up app initialization details
 	unsigned int windowWidth = 1280;
 	unsigned int windowHeight = 720;
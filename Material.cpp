@@ -1,4 +1,15 @@
 #include "Material.h"
+#include "Graphics.h"
+
+#include <cstring>
+
+const Material* Material::s_boundMaterial = 0;
+ID3D11ShaderResourceView* Material::s_boundSRVs[MATERIAL_MAX_TEXTURES] = {};
+ID3D11SamplerState* Material::s_boundSamplers[MATERIAL_MAX_SAMPLERS] = {};
+unsigned int Material::s_boundSRVFirst = 0;
+unsigned int Material::s_boundSRVCount = 0;
+unsigned int Material::s_boundSamplerFirst = 0;
+unsigned int Material::s_boundSamplerCount = 0;
 
 Material::Material(
 	const DirectX::XMFLOAT4 colorTint,
@@ -7,28 +18,36 @@ Material::Material(
 	const float roughness,
 	const DirectX::XMFLOAT2 uvScale,
 	const DirectX::XMFLOAT2 uvOffset) :
-	m_colorTint(colorTint),
+	m_constants{},
 	m_vertexShader(vertexShader),
 	m_pixelShader(pixelShader),
-	m_roughness(roughness),
-	m_uvScale(uvScale),
-	m_uvOffset(uvOffset)
+	m_constantBuffer(pixelShader, "PerMaterial"),
+	m_srvSlots{},
+	m_samplerSlots{},
+	m_firstSRVSlot(0),
+	m_srvSlotCount(0),
+	m_firstSamplerSlot(0),
+	m_samplerSlotCount(0)
 {
+	m_constants.colorTint = colorTint;
+	m_constants.uvScale = uvScale;
+	m_constants.uvOffset = uvOffset;
+	m_constants.roughness = roughness;
 }
 
 DirectX::XMFLOAT4 Material::GetColorTint() const
 {
-	return m_colorTint;
+	return m_constants.colorTint;
 }
 
 DirectX::XMFLOAT2 Material::GetUVScale() const
 {
-	return m_uvScale;
+	return m_constants.uvScale;
 }
 
 DirectX::XMFLOAT2 Material::GetUVOffset() const
 {
-	return m_uvOffset;
+	return m_constants.uvOffset;
 }
 
 std::shared_ptr<SimpleVertexShader> Material::GetVertexShader() const
@@ -41,27 +60,112 @@ std::shared_ptr<SimplePixelShader> Material::GetPixelShader() const
 	return m_pixelShader;
 }
 
-void Material::AddTextureSRV(const std::string shaderVarName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+// --------------------------------------------------------
+// Grows a register range [first, first + count) to include
+// one more register
+// --------------------------------------------------------
+static void IncludeSlot(unsigned int slot, unsigned int& first, unsigned int& count)
 {
-	m_textureSRVs.insert({ shaderVarName, srv });
+	if (count == 0)
+	{
+		first = slot;
+		count = 1;
+		return;
+	}
+
+	unsigned int end = first + count;
+	if (slot < first) first = slot;
+	if (slot + 1 > end) end = slot + 1;
+	count = end - first;
 }
 
-void Material::AddSampler(const std::string shaderVarName, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool Material::AddTextureSRV(const std::string shaderVarName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, unsigned int slice)
 {
-	m_samplers.insert({ shaderVarName, samplerState });
+	const SimpleSRV* srvInfo = m_pixelShader->GetShaderResourceViewInfo(shaderVarName);
+	if (srvInfo == 0 || srvInfo->BindIndex >= MATERIAL_MAX_TEXTURES)
+		return false;
+
+	m_textureSRVs[srvInfo->BindIndex] = srv;
+	m_srvSlots[srvInfo->BindIndex] = srv.Get();
+	IncludeSlot(srvInfo->BindIndex, m_firstSRVSlot, m_srvSlotCount);
+
+	// One slice index per register, for textures in arrays
+	unsigned int* slices = &m_constants.textureSlices.x;
+	if (srvInfo->BindIndex < 4)
+		slices[srvInfo->BindIndex] = slice;
+
+	if (s_boundMaterial == this)
+		s_boundMaterial = 0;
+	return true;
 }
 
+bool Material::AddSampler(const std::string shaderVarName, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+{
+	const SimpleSampler* sampInfo = m_pixelShader->GetSamplerInfo(shaderVarName);
+	if (sampInfo == 0 || sampInfo->BindIndex >= MATERIAL_MAX_SAMPLERS)
+		return false;
+
+	m_samplers[sampInfo->BindIndex] = samplerState;
+	m_samplerSlots[sampInfo->BindIndex] = samplerState.Get();
+	IncludeSlot(sampInfo->BindIndex, m_firstSamplerSlot, m_samplerSlotCount);
+
+	if (s_boundMaterial == this)
+		s_boundMaterial = 0;
+	return true;
+}
+
+// --------------------------------------------------------
+// Whether a range of slots is already bound.  The bound
+// copy is only trusted over the range it was last set for.
+// --------------------------------------------------------
+template<typename T>
+static bool SlotsBound(T* const* bound, unsigned int boundFirst, unsigned int boundCount, T* const* slots, unsigned int first, unsigned int count)
+{
+	return
+		first >= boundFirst &&
+		first + count <= boundFirst + boundCount &&
+		memcmp(&bound[first], &slots[first], count * sizeof(T*)) == 0;
+}
+
+// --------------------------------------------------------
+// Sets this material's constants and binds its textures
+// and samplers, skipping whatever is already bound
+// --------------------------------------------------------
 void Material::PrepareMaterial()
 {
-	m_pixelShader->SetFloat("roughness", m_roughness);
+	if (s_boundMaterial == this)
+		return;
+
+	// Only copied to the GPU if it differs from what's there
+	m_constantBuffer.Set(m_constants);
 
-	for (const auto& t : m_textureSRVs)
+	if (m_srvSlotCount > 0 &&
+		!SlotsBound(s_boundSRVs, s_boundSRVFirst, s_boundSRVCount, m_srvSlots, m_firstSRVSlot, m_srvSlotCount))
 	{
-		m_pixelShader->SetShaderResourceView(t.first.c_str(), t.second);
+		Graphics::Context->PSSetShaderResources(m_firstSRVSlot, m_srvSlotCount, &m_srvSlots[m_firstSRVSlot]);
+
+		// Only this range is known now
+		memcpy(s_boundSRVs, m_srvSlots, sizeof(m_srvSlots));
+		s_boundSRVFirst = m_firstSRVSlot;
+		s_boundSRVCount = m_srvSlotCount;
 	}
 
-	for (const auto& s : m_samplers)
+	if (m_samplerSlotCount > 0 &&
+		!SlotsBound(s_boundSamplers, s_boundSamplerFirst, s_boundSamplerCount, m_samplerSlots, m_firstSamplerSlot, m_samplerSlotCount))
 	{
-		m_pixelShader->SetSamplerState(s.first.c_str(), s.second);
+		Graphics::Context->PSSetSamplers(m_firstSamplerSlot, m_samplerSlotCount, &m_samplerSlots[m_firstSamplerSlot]);
+
+		memcpy(s_boundSamplers, m_samplerSlots, sizeof(m_samplerSlots));
+		s_boundSamplerFirst = m_firstSamplerSlot;
+		s_boundSamplerCount = m_samplerSlotCount;
 	}
+
+	s_boundMaterial = this;
+}
+
+void Material::InvalidateBindings()
+{
+	s_boundMaterial = 0;
+	s_boundSRVCount = 0;
+	s_boundSamplerCount = 0;
 }
@@ -1,10 +1,31 @@
 #pragma once
 
 #include <memory>
-#include <unordered_map>
 #include <DirectXMath.h>
 #include "SimpleShader.h"
+#include "ConstantBuffer.h"
+#include "ShaderConstants.h"
 
+// Slots a material can fill, which must cover the pixel
+// shader's per-material textures and samplers
+#define MATERIAL_MAX_TEXTURES 8
+#define MATERIAL_MAX_SAMPLERS 4
+
+// --------------------------------------------------------
+// A pixel shader's per-material textures, samplers and
+// constants.
+//
+// Textures and samplers are resolved against the shader's
+// reflection when they're added, into arrays indexed by
+// register.  Preparing a material then binds each array in
+// one call, and only when it differs from what's bound -
+// see InvalidateBindings().
+//
+// Textures can be slices of a Texture2DArray (see
+// TextureArrayBuilder), in which case materials sharing
+// arrays only differ by the slice indices in their
+// constants and switching between them binds nothing.
+// --------------------------------------------------------
 class Material
 {
 public:
@@ -22,24 +43,51 @@ public:
 	std::shared_ptr<SimpleVertexShader> GetVertexShader() const;
 	std::shared_ptr<SimplePixelShader> GetPixelShader() const;
 
-	void AddTextureSRV(const std::string shaderVarName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	void AddSampler(const std::string shaderVarName, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	// False if the shader has no such variable (or its register is out of range).
+	// The slice goes in textureSlices, at the texture's register.
+	bool AddTextureSRV(const std::string shaderVarName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, unsigned int slice = 0);
+	bool AddSampler(const std::string shaderVarName, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 	void PrepareMaterial();
 
+	// Forgets which material was prepared last.  Call this once
+	// anything else may have touched the pixel shader's material
+	// registers (other passes, a new frame, UI edits).
+	static void InvalidateBindings();
+
 	// We need to give users direct control over variables via imgui
 	friend class Game;
 
 private:
-	DirectX::XMFLOAT4 m_colorTint;
-	DirectX::XMFLOAT2 m_uvScale;
-	DirectX::XMFLOAT2 m_uvOffset;
-
-	float m_roughness;
+	// Everything in the PerMaterial cbuffer, set in one copy
+	PixelShaderPerMaterial m_constants;
 
 	std::shared_ptr<SimpleVertexShader> m_vertexShader;
 	std::shared_ptr<SimplePixelShader> m_pixelShader;
+	ConstantBuffer<PixelShaderPerMaterial> m_constantBuffer;
+
+	// Indexed by register.  The raw pointers are what's bound, and
+	// the ComPtrs keep them alive.
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_textureSRVs[MATERIAL_MAX_TEXTURES];
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_samplers[MATERIAL_MAX_SAMPLERS];
+	ID3D11ShaderResourceView* m_srvSlots[MATERIAL_MAX_TEXTURES];
+	ID3D11SamplerState* m_samplerSlots[MATERIAL_MAX_SAMPLERS];
+
+	// The register range each array covers.  Registers inside a
+	// range that the material doesn't fill are bound to null.
+	unsigned int m_firstSRVSlot;
+	unsigned int m_srvSlotCount;
+	unsigned int m_firstSamplerSlot;
+	unsigned int m_samplerSlotCount;
+
+	// The material whose bindings are currently set, if known
+	static const Material* s_boundMaterial;
 
-	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_textureSRVs;
-	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> m_samplers;
-};
\ No newline at end of file
+	// What's currently bound to the material registers, if known (count > 0)
+	static ID3D11ShaderResourceView* s_boundSRVs[MATERIAL_MAX_TEXTURES];
+	static ID3D11SamplerState* s_boundSamplers[MATERIAL_MAX_SAMPLERS];
+	static unsigned int s_boundSRVFirst;
+	static unsigned int s_boundSRVCount;
+	static unsigned int s_boundSamplerFirst;
+	static unsigned int s_boundSamplerCount;
+};
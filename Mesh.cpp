@@ -1,5 +1,6 @@
 #include "Mesh.h"
 #include "Graphics.h"
+#include "TextureStreaming.h"
 
 #include <fstream>
 #include <stdexcept>
@@ -246,6 +247,26 @@ std::string Mesh::GetMeshName() const
 	return m_name;
 }
 
+const std::vector<XMFLOAT3>& Mesh::GetPositions() const
+{
+	return m_positions;
+}
+
+const std::vector<unsigned int>& Mesh::GetIndices() const
+{
+	return m_indices;
+}
+
+const BoundingBox& Mesh::GetBounds() const
+{
+	return m_bounds;
+}
+
+float Mesh::GetUVDensity() const
+{
+	return m_uvDensity;
+}
+
 void Mesh::Draw()
 {
 	UINT stride = sizeof(Vertex);
@@ -300,6 +321,17 @@ void Mesh::Initialize(Vertex* vertices,
 	m_vertexCount = numVertices;
 	m_indexCount = numIndices;
 	m_name = meshName;
+
+	// Keep positions and indices around for CPU-side work like occlusion culling
+	m_positions.resize(numVertices);
+	for (unsigned int ii = 0; ii < numVertices; ii++)
+	{
+		m_positions[ii] = vertices[ii].Position;
+	}
+	m_indices.assign(indices, indices + numIndices);
+
+	BoundingBox::CreateFromPoints(m_bounds, numVertices, &m_positions[0], sizeof(XMFLOAT3));
+	m_uvDensity = ComputeMeshUVDensity(vertices, indices, numIndices);
 }
 
 // --------------------------------------------------------
@@ -2,7 +2,9 @@
 
 #include <d3d11.h>
 #include <wrl/client.h>
+#include <DirectXCollision.h>
 #include <string>
+#include <vector>
 
 #include "Vertex.h"
 
@@ -22,6 +24,12 @@ public:
 
 	std::string GetMeshName() const;
 
+	// CPU-side copies for culling / software rasterization
+	const std::vector<DirectX::XMFLOAT3>& GetPositions() const;
+	const std::vector<unsigned int>& GetIndices() const;
+	const DirectX::BoundingBox& GetBounds() const;
+	float GetUVDensity() const; // UV units per object space unit, for texture streaming
+
 	void Draw();
 
 private:
@@ -33,6 +41,11 @@ private:
 
 	std::string m_name;
 
+	std::vector<DirectX::XMFLOAT3> m_positions;
+	std::vector<unsigned int> m_indices;
+	DirectX::BoundingBox m_bounds;
+	float m_uvDensity;
+
 	void Initialize(Vertex* vertices, unsigned int numVertices,
 		unsigned int* indices, unsigned int numIndices, std::string name);
 
@@ -0,0 +1,313 @@
+#include "MipGenerator.h"
+
+#include <DirectXMath.h>
+#include <cmath>
+
+using namespace DirectX;
+
+// Kaiser window settings - the filter reaches this many destination
+// texels each way, and alpha trades ringing against sharpness
+#define KAISER_RADIUS 3.0f
+#define KAISER_ALPHA 4.0f
+
+// --------------------------------------------------------
+// The source texels (and their weights) that make up each
+// destination texel along one axis
+// --------------------------------------------------------
+struct FilterTap
+{
+	unsigned int Source;
+	float Weight;
+};
+
+struct FilterTaps
+{
+	std::vector<unsigned int> Starts; // Destination d uses Taps[Starts[d]] up to Taps[Starts[d + 1]]
+	std::vector<FilterTap> Taps;
+};
+
+static float BesselI0(float x)
+{
+	// Power series, which converges quickly for the small values used here
+	float sum = 1.0f;
+	float term = 1.0f;
+	float halfX = x * 0.5f;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (halfX / k) * (halfX / k);
+		sum += term;
+		if (term < sum * 1e-7f)
+			break;
+	}
+	return sum;
+}
+
+static float Sinc(float x)
+{
+	if (fabsf(x) < 1e-6f)
+		return 1.0f;
+
+	x *= XM_PI;
+	return sinf(x) / x;
+}
+
+static unsigned int WrapTexel(int texel, unsigned int size)
+{
+	int wrapped = texel % (int)size;
+	return (unsigned int)(wrapped < 0 ? wrapped + (int)size : wrapped);
+}
+
+static FilterTaps BuildFilterTaps(unsigned int sourceSize, unsigned int destSize, MipFilter filter)
+{
+	FilterTaps filterTaps;
+	filterTaps.Starts.resize(destSize + 1);
+
+	float scale = (float)sourceSize / destSize;
+	float kaiserNormalization = 1.0f / BesselI0(KAISER_ALPHA);
+
+	for (unsigned int d = 0; d < destSize; d++)
+	{
+		filterTaps.Starts[d] = (unsigned int)filterTaps.Taps.size();
+
+		// An axis that's already done shrinking passes straight through
+		if (sourceSize == destSize)
+		{
+			filterTaps.Taps.push_back({ d, 1.0f });
+			continue;
+		}
+
+		size_t first = filterTaps.Taps.size();
+		float totalWeight = 0.0f;
+
+		if (filter == MipFilter::Box)
+		{
+			// Each source texel weighted by how much of it the destination covers
+			float left = d * scale;
+			float right = (d + 1) * scale;
+			for (int s = (int)floorf(left); (float)s < right; s++)
+			{
+				float overlap = fminf(right, (float)s + 1.0f) - fmaxf(left, (float)s);
+				if (overlap <= 0.0f)
+					continue;
+
+				filterTaps.Taps.push_back({ WrapTexel(s, sourceSize), overlap });
+				totalWeight += overlap;
+			}
+		}
+		else
+		{
+			// Windowed sinc, measured in destination texels
+			float center = (d + 0.5f) * scale;
+			float reach = KAISER_RADIUS * scale;
+			for (int s = (int)floorf(center - reach); (float)s <= center + reach; s++)
+			{
+				float t = ((float)s + 0.5f - center) / scale;
+				if (fabsf(t) >= KAISER_RADIUS)
+					continue;
+
+				float window = BesselI0(KAISER_ALPHA * sqrtf(1.0f - (t / KAISER_RADIUS) * (t / KAISER_RADIUS))) * kaiserNormalization;
+				float weight = Sinc(t) * window;
+
+				filterTaps.Taps.push_back({ WrapTexel(s, sourceSize), weight });
+				totalWeight += weight;
+			}
+		}
+
+		for (size_t t = first; t < filterTaps.Taps.size(); t++)
+			filterTaps.Taps[t].Weight /= totalWeight;
+	}
+
+	filterTaps.Starts[destSize] = (unsigned int)filterTaps.Taps.size();
+	return filterTaps;
+}
+
+// --------------------------------------------------------
+// Shrinks a float image, one axis at a time
+// --------------------------------------------------------
+static std::vector<XMFLOAT4A> FilterImage(
+	const std::vector<XMFLOAT4A>& source,
+	unsigned int sourceWidth,
+	unsigned int sourceHeight,
+	unsigned int destWidth,
+	unsigned int destHeight,
+	MipFilter filter)
+{
+	FilterTaps horizontalTaps = BuildFilterTaps(sourceWidth, destWidth, filter);
+	FilterTaps verticalTaps = BuildFilterTaps(sourceHeight, destHeight, filter);
+
+	// Horizontal: each destination texel gathers along its source row
+	std::vector<XMFLOAT4A> horizontal((size_t)destWidth * sourceHeight);
+	for (unsigned int y = 0; y < sourceHeight; y++)
+	{
+		const XMFLOAT4A* sourceRow = &source[(size_t)y * sourceWidth];
+		XMFLOAT4A* destRow = &horizontal[(size_t)y * destWidth];
+		for (unsigned int x = 0; x < destWidth; x++)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for (unsigned int t = horizontalTaps.Starts[x]; t < horizontalTaps.Starts[x + 1]; t++)
+			{
+				const FilterTap& tap = horizontalTaps.Taps[t];
+				sum = XMVectorMultiplyAdd(XMLoadFloat4A(&sourceRow[tap.Source]), XMVectorReplicate(tap.Weight), sum);
+			}
+			XMStoreFloat4A(&destRow[x], sum);
+		}
+	}
+
+	// Vertical: whole rows at a time, which keeps memory access linear
+	std::vector<XMFLOAT4A> dest((size_t)destWidth * destHeight);
+	for (unsigned int y = 0; y < destHeight; y++)
+	{
+		XMFLOAT4A* destRow = &dest[(size_t)y * destWidth];
+		for (unsigned int x = 0; x < destWidth; x++)
+			XMStoreFloat4A(&destRow[x], XMVectorZero());
+
+		for (unsigned int t = verticalTaps.Starts[y]; t < verticalTaps.Starts[y + 1]; t++)
+		{
+			const FilterTap& tap = verticalTaps.Taps[t];
+			const XMFLOAT4A* sourceRow = &horizontal[(size_t)tap.Source * destWidth];
+			XMVECTOR weight = XMVectorReplicate(tap.Weight);
+			for (unsigned int x = 0; x < destWidth; x++)
+			{
+				XMStoreFloat4A(&destRow[x], XMVectorMultiplyAdd(XMLoadFloat4A(&sourceRow[x]), weight, XMLoadFloat4A(&destRow[x])));
+			}
+		}
+	}
+
+	return dest;
+}
+
+// --------------------------------------------------------
+// Converting between stored bytes and filterable floats
+// --------------------------------------------------------
+static std::vector<XMFLOAT4A> UnpackImage(const unsigned char* rgba, size_t texelCount, MipContent content)
+{
+	// sRGB decoding per byte value, so it's only computed 256 times
+	float srgbToLinear[256];
+	for (unsigned int i = 0; i < 256; i++)
+		srgbToLinear[i] = XMVectorGetX(XMColorSRGBToRGB(XMVectorReplicate(i / 255.0f)));
+
+	std::vector<XMFLOAT4A> image(texelCount);
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		const unsigned char* texel = &rgba[i * 4];
+		XMVECTOR value = XMVectorSet(texel[0], texel[1], texel[2], texel[3]) / 255.0f;
+
+		if (content == MipContent::SRGBColor)
+		{
+			value = XMVectorSetX(value, srgbToLinear[texel[0]]);
+			value = XMVectorSetY(value, srgbToLinear[texel[1]]);
+			value = XMVectorSetZ(value, srgbToLinear[texel[2]]);
+		}
+		else if (content == MipContent::NormalMap)
+		{
+			XMVECTOR normal = XMVector3Normalize(value * 2.0f - XMVectorReplicate(1.0f));
+			value = XMVectorSelect(value, normal, g_XMSelect1110);
+		}
+
+		XMStoreFloat4A(&image[i], value);
+	}
+	return image;
+}
+
+static void PackImage(const std::vector<XMFLOAT4A>& image, MipContent content, MipLevel& level)
+{
+	size_t texelCount = image.size();
+	level.Pixels.resize(texelCount * 4);
+	if (content == MipContent::NormalMap)
+		level.NormalVariance.resize(texelCount);
+
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		XMVECTOR value = XMLoadFloat4A(&image[i]);
+
+		if (content == MipContent::SRGBColor)
+		{
+			value = XMColorRGBToSRGB(XMVectorSaturate(value));
+		}
+		else if (content == MipContent::NormalMap)
+		{
+			// The shorter the average, the more the normals disagreed
+			float length = fmaxf(XMVectorGetX(XMVector3Length(value)), 1e-4f);
+			level.NormalVariance[i] = fmaxf((1.0f - length) / length, 0.0f);
+
+			XMVECTOR normal = XMVector3Normalize(value) * 0.5f + XMVectorReplicate(0.5f);
+			value = XMVectorSelect(value, normal, g_XMSelect1110);
+		}
+
+		XMFLOAT4 bytes;
+		XMStoreFloat4(&bytes, XMVectorSaturate(value) * 255.0f + XMVectorReplicate(0.5f));
+		level.Pixels[i * 4 + 0] = (unsigned char)bytes.x;
+		level.Pixels[i * 4 + 1] = (unsigned char)bytes.y;
+		level.Pixels[i * 4 + 2] = (unsigned char)bytes.z;
+		level.Pixels[i * 4 + 3] = (unsigned char)bytes.w;
+	}
+}
+
+std::vector<MipLevel> GenerateMipChain(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	MipContent content,
+	MipFilter filter)
+{
+	std::vector<MipLevel> levels;
+	if (width == 0 || height == 0)
+		return levels;
+
+	MipLevel top;
+	top.Width = width;
+	top.Height = height;
+	top.Pixels.assign(rgba, rgba + (size_t)width * height * 4);
+	if (content == MipContent::NormalMap)
+		top.NormalVariance.assign((size_t)width * height, 0.0f);
+	levels.push_back(top);
+
+	// Each level is filtered from the unrounded one above it.  Normals
+	// stay unnormalized here, so their averages keep shrinking with
+	// the whole footprint rather than just the last step.
+	std::vector<XMFLOAT4A> image = UnpackImage(rgba, (size_t)width * height, content);
+	while (width > 1 || height > 1)
+	{
+		unsigned int mipWidth = width > 1 ? width / 2 : 1;
+		unsigned int mipHeight = height > 1 ? height / 2 : 1;
+		image = FilterImage(image, width, height, mipWidth, mipHeight, filter);
+		width = mipWidth;
+		height = mipHeight;
+
+		MipLevel level;
+		level.Width = width;
+		level.Height = height;
+		PackImage(image, content, level);
+		levels.push_back(level);
+	}
+
+	return levels;
+}
+
+unsigned int AdjustRoughnessForNormalVariance(std::vector<MipLevel>& roughnessMips, const std::vector<MipLevel>& normalMips, unsigned int channel)
+{
+	unsigned int adjusted = 0;
+	for (size_t m = 1; m < roughnessMips.size() && m < normalMips.size(); m++)
+	{
+		MipLevel& roughness = roughnessMips[m];
+		const MipLevel& normals = normalMips[m];
+		if (roughness.Width != normals.Width ||
+			roughness.Height != normals.Height ||
+			normals.NormalVariance.size() != (size_t)roughness.Width * roughness.Height)
+			continue;
+
+		for (size_t i = 0; i < normals.NormalVariance.size(); i++)
+		{
+			// Widen the GGX distribution (alpha = roughness squared) by the
+			// normals' spread, then store it as perceptual roughness again
+			unsigned char& texel = roughness.Pixels[i * 4 + channel];
+			float perceptual = texel / 255.0f;
+			float alphaSquared = perceptual * perceptual * perceptual * perceptual;
+			alphaSquared = fminf(alphaSquared + 2.0f * normals.NormalVariance[i], 1.0f);
+
+			texel = (unsigned char)(sqrtf(sqrtf(alphaSquared)) * 255.0f + 0.5f);
+		}
+		adjusted++;
+	}
+	return adjusted;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// Builds full mip chains for cooked textures on the CPU.
+//
+// Each level is filtered from the one above it in floating
+// point (four channels at a time with DirectXMath), using a
+// separable box or Kaiser-windowed sinc filter that wraps at
+// the edges like the tiling textures it's used on.
+//
+// How texels are averaged depends on what they hold:
+//  - SRGBColor: converted to linear first, so dark and bright
+//    texels average to the right brightness
+//  - NormalMap: unpacked, averaged, then renormalized.  How
+//    much the average shrank is kept as the normals' variance.
+//  - Data: averaged as-is (roughness, metalness, masks)
+//
+// Nothing in here touches Direct3D.
+// --------------------------------------------------------
+enum class MipFilter
+{
+	Box,
+	Kaiser
+};
+
+enum class MipContent
+{
+	Data,
+	SRGBColor,
+	NormalMap
+};
+
+struct MipLevel
+{
+	unsigned int Width;
+	unsigned int Height;
+	std::vector<unsigned char> Pixels; // RGBA8
+
+	// NormalMap only: per texel variance of the averaged normals,
+	// (1 - |average|) / |average|, which is zero on the top level
+	std::vector<float> NormalVariance;
+};
+
+// Every level down to 1x1, starting with a copy of the source
+std::vector<MipLevel> GenerateMipChain(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	MipContent content,
+	MipFilter filter = MipFilter::Kaiser);
+
+// --------------------------------------------------------
+// Toksvig-style specular anti-aliasing: widens roughness
+// (perceptual roughness, in the given channel) on each level
+// by the variance of the normal map's averaged normals, so
+// bumpy surfaces get blurrier highlights in the distance
+// instead of sparkling.  Levels whose sizes don't match the
+// normal map's are left alone.  Returns the levels adjusted.
+// --------------------------------------------------------
+unsigned int AdjustRoughnessForNormalVariance(std::vector<MipLevel>& roughnessMips, const std::vector<MipLevel>& normalMips, unsigned int channel = 0);
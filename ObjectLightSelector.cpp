@@ -0,0 +1,214 @@
+#include "ObjectLightSelector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+using namespace DirectX;
+
+ObjectLightSelector::ObjectLightSelector(const std::shared_ptr<ThreadPool>& threadPool) :
+	m_threadPool(threadPool),
+	m_selectionCount(0),
+	m_reuseCount(0)
+{
+}
+
+void ObjectLightSelector::Update(const std::vector<Light>& lights,
+	const std::vector<BoundingBox>& bounds,
+	const std::vector<unsigned long long>& boundsVersions)
+{
+	if (m_objects.size() != bounds.size())
+	{
+		m_objects.assign(bounds.size(), ObjectState{});
+	}
+
+	// Adding or removing lights shifts indices around, so start over
+	bool lightCountChanged = lights.size() != m_previousLights.size();
+
+	m_changedLights.clear();
+	if (!lightCountChanged)
+	{
+		for (unsigned int ii = 0; ii < lights.size(); ii++)
+		{
+			if (!IsLightEqual(lights[ii], m_previousLights[ii]))
+			{
+				m_changedLights.push_back(ii);
+			}
+		}
+	}
+
+	m_threadPool->ParallelFor(static_cast<unsigned int>(m_objects.size()), [&](unsigned int objectIndex)
+		{
+			ObjectState& object = m_objects[objectIndex];
+			const BoundingBox& objectBounds = bounds[objectIndex];
+
+			object.Dirty = !object.Valid ||
+				lightCountChanged ||
+				object.BoundsVersion != boundsVersions[objectIndex];
+
+			// An edited light only matters if it could reach the object before
+			// (it may be in the list) or can now (it may need to be added)
+			for (size_t ii = 0; ii < m_changedLights.size() && !object.Dirty; ii++)
+			{
+				unsigned int lightIndex = m_changedLights[ii];
+				object.Dirty =
+					CanReach(m_previousLights[lightIndex], objectBounds) ||
+					CanReach(lights[lightIndex], objectBounds);
+			}
+
+			if (object.Dirty)
+			{
+				SelectLights(lights, objectBounds, object.Lights);
+				object.BoundsVersion = boundsVersions[objectIndex];
+				object.Valid = true;
+			}
+		});
+
+	m_selectionCount = 0;
+	for (const ObjectState& object : m_objects)
+	{
+		m_selectionCount += object.Dirty ? 1 : 0;
+	}
+	m_reuseCount = static_cast<unsigned int>(m_objects.size()) - m_selectionCount;
+
+	m_previousLights = lights;
+}
+
+void ObjectLightSelector::SelectLights(const std::vector<Light>& lights, const BoundingBox& bounds, ObjectLightList& listOut) const
+{
+	float influences[MAX_OBJECT_LIGHTS] = {};
+	unsigned int count = 0;
+
+	for (unsigned int ii = 0; ii < lights.size(); ii++)
+	{
+		if (!CanReach(lights[ii], bounds))
+		{
+			continue;
+		}
+
+		float influence = GetInfluence(lights[ii], bounds);
+
+		// Insertion into a short list sorted by influence, strongest first
+		unsigned int slot = count;
+		while (slot > 0 && influences[slot - 1] < influence)
+		{
+			slot--;
+		}
+
+		if (slot >= MAX_OBJECT_LIGHTS)
+		{
+			continue;
+		}
+
+		unsigned int last = count < MAX_OBJECT_LIGHTS ? count : MAX_OBJECT_LIGHTS - 1;
+		for (unsigned int jj = last; jj > slot; jj--)
+		{
+			influences[jj] = influences[jj - 1];
+			listOut.Indices[jj] = listOut.Indices[jj - 1];
+		}
+
+		influences[slot] = influence;
+		listOut.Indices[slot] = ii;
+		count = count < MAX_OBJECT_LIGHTS ? count + 1 : MAX_OBJECT_LIGHTS;
+	}
+
+	// Back to light order so the shader can loop each type separately
+	std::sort(listOut.Indices, listOut.Indices + count);
+
+	listOut.DirectionalCount = 0;
+	listOut.PointCount = 0;
+	listOut.SpotCount = 0;
+	for (unsigned int ii = 0; ii < count; ii++)
+	{
+		switch (lights[listOut.Indices[ii]].Type)
+		{
+		case LIGHT_TYPE_DIRECTIONAL: listOut.DirectionalCount++; break;
+		case LIGHT_TYPE_POINT: listOut.PointCount++; break;
+		case LIGHT_TYPE_SPOT: listOut.SpotCount++; break;
+		}
+	}
+}
+
+bool ObjectLightSelector::CanReach(const Light& light, const BoundingBox& bounds)
+{
+	if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+	{
+		return true;
+	}
+
+	// Range check against the closest point of the box
+	XMVECTOR position = XMLoadFloat3(&light.Position);
+	XMVECTOR center = XMLoadFloat3(&bounds.Center);
+	XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+	XMVECTOR closest = XMVectorClamp(position, XMVectorSubtract(center, extents), XMVectorAdd(center, extents));
+	if (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(position, closest))) > light.Range * light.Range)
+	{
+		return false;
+	}
+
+	if (light.Type == LIGHT_TYPE_SPOT)
+	{
+		// Cone test against the box's bounding sphere
+		XMVECTOR toCenter = XMVectorSubtract(center, position);
+		XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&light.Direction));
+		float radius = XMVectorGetX(XMVector3Length(extents));
+
+		float alongAxis = XMVectorGetX(XMVector3Dot(toCenter, direction));
+		float distanceSquared = XMVectorGetX(XMVector3LengthSq(toCenter));
+		float fromAxis = std::sqrt(distanceSquared - alongAxis * alongAxis > 0.0f ? distanceSquared - alongAxis * alongAxis : 0.0f);
+
+		// Signed distance from the sphere's center to the cone's surface
+		float coneDistance = std::cos(light.SpotOuterAngle) * fromAxis - std::sin(light.SpotOuterAngle) * alongAxis;
+		if (coneDistance > radius || alongAxis < -radius)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+float ObjectLightSelector::GetInfluence(const Light& light, const BoundingBox& bounds)
+{
+	float brightest = light.Color.x > light.Color.y ? light.Color.x : light.Color.y;
+	brightest = light.Color.z > brightest ? light.Color.z : brightest;
+	float influence = light.Intensity * brightest;
+
+	if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+	{
+		return influence;
+	}
+
+	// Same falloff as Attenuate() in the pixel shader, at the closest point of the box
+	XMVECTOR position = XMLoadFloat3(&light.Position);
+	XMVECTOR center = XMLoadFloat3(&bounds.Center);
+	XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+	XMVECTOR closest = XMVectorClamp(position, XMVectorSubtract(center, extents), XMVectorAdd(center, extents));
+	float distanceSquared = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(position, closest)));
+
+	float attenuation = 1.0f - distanceSquared / (light.Range * light.Range);
+	attenuation = attenuation > 0.0f ? attenuation : 0.0f;
+	return influence * attenuation * attenuation;
+}
+
+bool ObjectLightSelector::IsLightEqual(const Light& a, const Light& b)
+{
+	// Everything up to the shadow fields, which don't affect selection
+	return memcmp(&a, &b, offsetof(Light, CastShadows)) == 0;
+}
+
+const ObjectLightList& ObjectLightSelector::GetLightList(const unsigned int objectIndex) const
+{
+	return m_objects[objectIndex].Lights;
+}
+
+unsigned int ObjectLightSelector::GetSelectionCount() const
+{
+	return m_selectionCount;
+}
+
+unsigned int ObjectLightSelector::GetReuseCount() const
+{
+	return m_reuseCount;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "HlslPacking.h"
+#include "Lights.h"
+#include "ThreadPool.h"
+
+// Must match MAX_OBJECT_LIGHTS in ShaderIncludes.hlsli (and stay a multiple of 4)
+#define MAX_OBJECT_LIGHTS (8)
+
+// --------------------------------------------------------
+// The lights picked for one object, laid out to be copied
+// straight into the pixel shader's constant buffer. Indices
+// are in ascending order, so with type-sorted lights the
+// directional lights come first, then point, then spot.
+// --------------------------------------------------------
+struct ObjectLightList
+{
+	unsigned int Indices[MAX_OBJECT_LIGHTS];
+	unsigned int DirectionalCount;
+	unsigned int PointCount;
+	unsigned int SpotCount;
+};
+
+// The pixel shader's PerObject cbuffer: uint4 objectLights[MAX_OBJECT_LIGHTS / 4], uint3 objectLightCounts
+constexpr HlslPacking::Member OBJECT_LIGHT_LIST_LAYOUT[] = {
+	HlslPacking::Array(HlslPacking::Vector(4), MAX_OBJECT_LIGHTS / 4),
+	HlslPacking::Vector(3) };
+static_assert(HlslPacking::OffsetOf(OBJECT_LIGHT_LIST_LAYOUT, 1) == offsetof(ObjectLightList, DirectionalCount));
+static_assert(HlslPacking::PackedSizeOf(OBJECT_LIGHT_LIST_LAYOUT) == sizeof(ObjectLightList));
+
+// --------------------------------------------------------
+// Picks the few most influential lights for each object, as
+// a cheaper alternative to clustered lighting.
+//
+// Lights are ranked by their attenuated intensity at the
+// closest point of the object's bounds, after rejecting any
+// whose range or cone can't reach it. An object's list is
+// only rebuilt when the object moved, or when a light that
+// could affect it (before or after the change) was edited.
+//
+// Nothing in here touches Direct3D.
+// --------------------------------------------------------
+class ObjectLightSelector
+{
+public:
+	ObjectLightSelector(const std::shared_ptr<ThreadPool>& threadPool);
+
+	// Refreshes every object's list, one object per job. Lights should be
+	// sorted by type (see LightPacker) for the per-type counts to be usable.
+	// boundsVersions should change whenever the matching bounds do.
+	void Update(const std::vector<Light>& lights,
+		const std::vector<DirectX::BoundingBox>& bounds,
+		const std::vector<unsigned long long>& boundsVersions);
+
+	// Getters
+	const ObjectLightList& GetLightList(const unsigned int objectIndex) const;
+	unsigned int GetSelectionCount() const; // Lists rebuilt in the last update
+	unsigned int GetReuseCount() const; // Lists kept from the previous frame
+
+private:
+	struct ObjectState
+	{
+		ObjectLightList Lights;
+		unsigned long long BoundsVersion;
+		bool Valid;
+		bool Dirty;
+	};
+
+	std::shared_ptr<ThreadPool> m_threadPool;
+
+	std::vector<ObjectState> m_objects;
+
+	// Copy of the lights from the last update, for spotting edits
+	std::vector<Light> m_previousLights;
+	std::vector<unsigned int> m_changedLights;
+
+	unsigned int m_selectionCount;
+	unsigned int m_reuseCount;
+
+	void SelectLights(const std::vector<Light>& lights, const DirectX::BoundingBox& bounds, ObjectLightList& listOut) const;
+	static bool CanReach(const Light& light, const DirectX::BoundingBox& bounds);
+	static float GetInfluence(const Light& light, const DirectX::BoundingBox& bounds);
+	static bool IsLightEqual(const Light& a, const Light& b);
+};
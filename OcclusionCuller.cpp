@@ -0,0 +1,328 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Anything closer to the eye than this (in clip space w) is treated
+// as crossing the near plane, which we never try to clip
+static const float MIN_CLIP_W = 1e-4f;
+
+OcclusionCuller::OcclusionCuller(const std::shared_ptr<ThreadPool>& threadPool,
+	const unsigned int width,
+	const unsigned int height) :
+	m_threadPool(threadPool),
+	m_width(width),
+	m_height(height),
+	m_tilesX(width / TILE_WIDTH),
+	m_tilesY(height / TILE_HEIGHT)
+{
+	m_depthBuffer.resize(m_width * m_height, 1.0f);
+	m_tileMaxDepth.resize(m_tilesX * m_tilesY, 1.0f);
+	m_tileBins.resize(m_tilesX * m_tilesY);
+
+	XMStoreFloat4x4(&m_viewProjection, XMMatrixIdentity());
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	XMStoreFloat4x4(&m_viewProjection,
+		XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+
+	std::fill(m_depthBuffer.begin(), m_depthBuffer.end(), 1.0f);
+	std::fill(m_tileMaxDepth.begin(), m_tileMaxDepth.end(), 1.0f);
+
+	m_triangles.clear();
+	for (std::vector<unsigned int>& bin : m_tileBins)
+	{
+		bin.clear();
+	}
+}
+
+void OcclusionCuller::AddOccluder(const std::vector<XMFLOAT3>& positions,
+	const std::vector<unsigned int>& indices,
+	const XMFLOAT4X4& world)
+{
+	if (positions.empty())
+	{
+		return;
+	}
+
+	// Transform every vertex straight to clip space
+	XMMATRIX worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&m_viewProjection));
+
+	m_clipPositions.resize(positions.size());
+	XMVector3TransformStream(
+		&m_clipPositions[0], sizeof(XMFLOAT4),
+		&positions[0], sizeof(XMFLOAT3),
+		positions.size(),
+		worldViewProjection);
+
+	float width = static_cast<float>(m_width);
+	float height = static_cast<float>(m_height);
+
+	for (size_t ii = 0; ii + 2 < indices.size(); ii += 3)
+	{
+		const XMFLOAT4* clip[3] = {
+			&m_clipPositions[indices[ii]],
+			&m_clipPositions[indices[ii + 1]],
+			&m_clipPositions[indices[ii + 2]] };
+
+		// Skip triangles crossing the near plane - dropping occluder
+		// triangles can only make culling less aggressive, never wrong
+		if (clip[0]->w < MIN_CLIP_W || clip[1]->w < MIN_CLIP_W || clip[2]->w < MIN_CLIP_W)
+		{
+			continue;
+		}
+
+		ScreenTriangle tri;
+		for (int v = 0; v < 3; v++)
+		{
+			float invW = 1.0f / clip[v]->w;
+			tri.X[v] = (clip[v]->x * invW * 0.5f + 0.5f) * width;
+			tri.Y[v] = (0.5f - clip[v]->y * invW * 0.5f) * height;
+			tri.Z[v] = std::max(clip[v]->z * invW, 0.0f);
+		}
+
+		// Clockwise on screen (with y pointing down) is front facing
+		tri.Area = (tri.X[1] - tri.X[0]) * (tri.Y[2] - tri.Y[0]) - (tri.X[2] - tri.X[0]) * (tri.Y[1] - tri.Y[0]);
+		if (tri.Area <= 0.0f)
+		{
+			continue;
+		}
+
+		// Screen bounds, rejecting anything fully off screen
+		float minX = std::min({ tri.X[0], tri.X[1], tri.X[2] });
+		float maxX = std::max({ tri.X[0], tri.X[1], tri.X[2] });
+		float minY = std::min({ tri.Y[0], tri.Y[1], tri.Y[2] });
+		float maxY = std::max({ tri.Y[0], tri.Y[1], tri.Y[2] });
+		if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+		{
+			continue;
+		}
+
+		int tileX0 = static_cast<int>(std::max(minX, 0.0f)) / TILE_WIDTH;
+		int tileX1 = static_cast<int>(std::min(maxX, width - 1.0f)) / TILE_WIDTH;
+		int tileY0 = static_cast<int>(std::max(minY, 0.0f)) / TILE_HEIGHT;
+		int tileY1 = static_cast<int>(std::min(maxY, height - 1.0f)) / TILE_HEIGHT;
+
+		unsigned int triIndex = static_cast<unsigned int>(m_triangles.size());
+		m_triangles.push_back(tri);
+
+		for (int ty = tileY0; ty <= tileY1; ty++)
+		{
+			for (int tx = tileX0; tx <= tileX1; tx++)
+			{
+				m_tileBins[ty * m_tilesX + tx].push_back(triIndex);
+			}
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeOccluders()
+{
+	m_threadPool->ParallelFor(m_tilesX * m_tilesY, [this](unsigned int tileIndex)
+		{
+			RasterizeTile(tileIndex);
+		});
+}
+
+void OcclusionCuller::RasterizeTile(const unsigned int tileIndex)
+{
+	const std::vector<unsigned int>& bin = m_tileBins[tileIndex];
+	if (bin.empty())
+	{
+		return;
+	}
+
+	int tileMinX = static_cast<int>((tileIndex % m_tilesX) * TILE_WIDTH);
+	int tileMinY = static_cast<int>((tileIndex / m_tilesX) * TILE_HEIGHT);
+	int tileMaxX = tileMinX + TILE_WIDTH - 1;
+	int tileMaxY = tileMinY + TILE_HEIGHT - 1;
+
+	const XMVECTOR pixelOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	const XMVECTOR zero = XMVectorZero();
+
+	for (unsigned int triIndex : bin)
+	{
+		const ScreenTriangle& tri = m_triangles[triIndex];
+
+		// Pixel bounds of the triangle within this tile, aligned to 4 pixel groups.
+		// Clamp in float first since off screen vertices can be huge
+		int minX = static_cast<int>(std::floor(std::max(std::min({ tri.X[0], tri.X[1], tri.X[2] }), static_cast<float>(tileMinX))));
+		int maxX = static_cast<int>(std::ceil(std::min(std::max({ tri.X[0], tri.X[1], tri.X[2] }), static_cast<float>(tileMaxX))));
+		int minY = static_cast<int>(std::floor(std::max(std::min({ tri.Y[0], tri.Y[1], tri.Y[2] }), static_cast<float>(tileMinY))));
+		int maxY = static_cast<int>(std::ceil(std::min(std::max({ tri.Y[0], tri.Y[1], tri.Y[2] }), static_cast<float>(tileMaxY))));
+		minX &= ~3;
+
+		if (minX > maxX || minY > maxY)
+		{
+			continue;
+		}
+
+		// Edge functions E(x, y) = A*x + B*y + C, positive inside.
+		// Edge i is opposite vertex i, so E_i / area is that vertex's barycentric weight
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		for (int e = 0; e < 3; e++)
+		{
+			int a = (e + 1) % 3;
+			int b = (e + 2) % 3;
+			edgeA[e] = tri.Y[a] - tri.Y[b];
+			edgeB[e] = tri.X[b] - tri.X[a];
+			edgeC[e] = (tri.Y[b] - tri.Y[a]) * tri.X[a] - (tri.X[b] - tri.X[a]) * tri.Y[a];
+		}
+
+		// Depth is linear in screen space after the perspective divide
+		float invArea = 1.0f / tri.Area;
+		float zA = (edgeA[0] * tri.Z[0] + edgeA[1] * tri.Z[1] + edgeA[2] * tri.Z[2]) * invArea;
+		float zB = (edgeB[0] * tri.Z[0] + edgeB[1] * tri.Z[1] + edgeB[2] * tri.Z[2]) * invArea;
+		float zC = (edgeC[0] * tri.Z[0] + edgeC[1] * tri.Z[1] + edgeC[2] * tri.Z[2]) * invArea;
+
+		XMVECTOR a0 = XMVectorReplicate(edgeA[0]);
+		XMVECTOR a1 = XMVectorReplicate(edgeA[1]);
+		XMVECTOR a2 = XMVectorReplicate(edgeA[2]);
+		XMVECTOR aZ = XMVectorReplicate(zA);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			float py = static_cast<float>(y) + 0.5f;
+			XMVECTOR row0 = XMVectorReplicate(edgeB[0] * py + edgeC[0]);
+			XMVECTOR row1 = XMVectorReplicate(edgeB[1] * py + edgeC[1]);
+			XMVECTOR row2 = XMVectorReplicate(edgeB[2] * py + edgeC[2]);
+			XMVECTOR rowZ = XMVectorReplicate(zB * py + zC);
+
+			float* depthRow = &m_depthBuffer[y * m_width];
+
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				XMVECTOR px = XMVectorAdd(XMVectorReplicate(static_cast<float>(x)), pixelOffsets);
+
+				XMVECTOR inside = XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a0, px, row0), zero);
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a1, px, row1), zero));
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a2, px, row2), zero));
+
+				XMVECTOR depth = XMLoadFloat4(reinterpret_cast<XMFLOAT4*>(depthRow + x));
+				XMVECTOR z = XMVectorMax(XMVectorMultiplyAdd(aZ, px, rowZ), zero);
+
+				XMVECTOR write = XMVectorAndInt(inside, XMVectorLess(z, depth));
+				XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(depthRow + x), XMVectorSelect(depth, z, write));
+			}
+		}
+	}
+
+	// Update the tile's farthest depth for the hierarchical test
+	XMVECTOR tileMax = XMVectorZero();
+	for (int y = tileMinY; y <= tileMaxY; y++)
+	{
+		const float* depthRow = &m_depthBuffer[y * m_width];
+		for (int x = tileMinX; x <= tileMaxX; x += 4)
+		{
+			tileMax = XMVectorMax(tileMax, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(depthRow + x)));
+		}
+	}
+
+	XMFLOAT4 maxes;
+	XMStoreFloat4(&maxes, tileMax);
+	m_tileMaxDepth[tileIndex] = std::max({ maxes.x, maxes.y, maxes.z, maxes.w });
+}
+
+bool OcclusionCuller::IsVisible(const BoundingBox& worldBounds) const
+{
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	worldBounds.GetCorners(corners);
+
+	XMMATRIX viewProjection = XMLoadFloat4x4(&m_viewProjection);
+
+	float minX = FLT_MAX;
+	float maxX = -FLT_MAX;
+	float minY = FLT_MAX;
+	float maxY = -FLT_MAX;
+	float minZ = FLT_MAX;
+
+	for (const XMFLOAT3& corner : corners)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corner), viewProjection));
+
+		// Bounds cross the near plane, so the camera may well be inside them
+		if (clip.w < MIN_CLIP_W)
+		{
+			return true;
+		}
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * m_width;
+		float y = (0.5f - clip.y * invW * 0.5f) * m_height;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * invW);
+	}
+
+	// Outside the frustum entirely
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height || minZ > 1.0f)
+	{
+		return false;
+	}
+
+	int x0 = static_cast<int>(std::floor(std::max(minX, 0.0f)));
+	int x1 = static_cast<int>(std::ceil(std::min(maxX, m_width - 1.0f)));
+	int y0 = static_cast<int>(std::floor(std::max(minY, 0.0f)));
+	int y1 = static_cast<int>(std::ceil(std::min(maxY, m_height - 1.0f)));
+
+	for (int ty = y0 / static_cast<int>(TILE_HEIGHT); ty <= y1 / static_cast<int>(TILE_HEIGHT); ty++)
+	{
+		for (int tx = x0 / static_cast<int>(TILE_WIDTH); tx <= x1 / static_cast<int>(TILE_WIDTH); tx++)
+		{
+			// Every occluder pixel in this tile is in front of the bounds
+			if (m_tileMaxDepth[ty * m_tilesX + tx] < minZ)
+			{
+				continue;
+			}
+
+			int px0 = std::max(x0, tx * static_cast<int>(TILE_WIDTH));
+			int px1 = std::min(x1, (tx + 1) * static_cast<int>(TILE_WIDTH) - 1);
+			int py0 = std::max(y0, ty * static_cast<int>(TILE_HEIGHT));
+			int py1 = std::min(y1, (ty + 1) * static_cast<int>(TILE_HEIGHT) - 1);
+
+			for (int y = py0; y <= py1; y++)
+			{
+				for (int x = px0; x <= px1; x++)
+				{
+					if (m_depthBuffer[y * m_width + x] >= minZ)
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+unsigned int OcclusionCuller::GetWidth() const
+{
+	return m_width;
+}
+
+unsigned int OcclusionCuller::GetHeight() const
+{
+	return m_height;
+}
+
+const std::vector<float>& OcclusionCuller::GetDepthBuffer() const
+{
+	return m_depthBuffer;
+}
+
+unsigned int OcclusionCuller::GetOccluderTriangleCount() const
+{
+	return static_cast<unsigned int>(m_triangles.size());
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <memory>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// CPU occlusion culling using a low resolution software
+// depth buffer.
+//
+// Occluder triangles are transformed and binned into screen
+// tiles on the calling thread, then each tile is rasterized
+// 4 pixels at a time (DirectXMath SIMD) on the thread pool.
+// Every tile also keeps the farthest depth it contains, which
+// lets bounds tests skip whole tiles before touching pixels.
+//
+// Nothing in here touches Direct3D, so it can be driven
+// without a window or device.
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	static constexpr unsigned int TILE_WIDTH = 32;
+	static constexpr unsigned int TILE_HEIGHT = 32;
+
+	// width must be a multiple of TILE_WIDTH, height a multiple of TILE_HEIGHT
+	OcclusionCuller(const std::shared_ptr<ThreadPool>& threadPool,
+		const unsigned int width = 256,
+		const unsigned int height = 128);
+
+	// Clears the buffer and captures the camera for this frame
+	void BeginFrame(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+
+	// Transforms and bins one occluder mesh - call between BeginFrame() and RasterizeOccluders()
+	void AddOccluder(const std::vector<DirectX::XMFLOAT3>& positions,
+		const std::vector<unsigned int>& indices,
+		const DirectX::XMFLOAT4X4& world);
+
+	// Rasterizes all binned triangles, one tile per job
+	void RasterizeOccluders();
+
+	// True if any part of the bounds could be visible past the occluders
+	bool IsVisible(const DirectX::BoundingBox& worldBounds) const;
+
+	// Getters
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+	const std::vector<float>& GetDepthBuffer() const;
+	unsigned int GetOccluderTriangleCount() const;
+
+private:
+	struct ScreenTriangle
+	{
+		float X[3];
+		float Y[3];
+		float Z[3];
+		float Area;
+	};
+
+	std::shared_ptr<ThreadPool> m_threadPool;
+
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_tilesX;
+	unsigned int m_tilesY;
+
+	DirectX::XMFLOAT4X4 m_viewProjection;
+
+	std::vector<float> m_depthBuffer;
+	std::vector<float> m_tileMaxDepth;
+
+	std::vector<ScreenTriangle> m_triangles;
+	std::vector<std::vector<unsigned int>> m_tileBins;
+
+	// Scratch space for transformed vertices, kept to avoid reallocating per occluder
+	std::vector<DirectX::XMFLOAT4> m_clipPositions;
+
+	void RasterizeTile(const unsigned int tileIndex);
+};
@@ -0,0 +1,32 @@
+#include <filesystem>
+
+#include "PathHelpers.h"
+
+// ----------------------------------------------------
+//  The string conversions from PathHelpers.h, which
+//  need nothing from Windows - std::filesystem already
+//  converts between UTF-8 and the platform's wide
+//  strings, so cooking and loading can use these on
+//  any platform.
+// ----------------------------------------------------
+
+
+// ----------------------------------------------------
+//  Helper function for converting a wide character 
+//  string to a standard ("narrow") character string
+// ----------------------------------------------------
+std::string WideToNarrow(const std::wstring& str)
+{
+	std::u8string utf8 = std::filesystem::path(str).u8string();
+	return std::string(utf8.begin(), utf8.end());
+}
+
+
+// ----------------------------------------------------
+//  Helper function for converting a standard ("narrow") 
+//  string to a wide character string
+// ----------------------------------------------------
+std::wstring NarrowToWide(const std::string& str)
+{
+	return std::filesystem::path(std::u8string(str.begin(), str.end())).wstring();
+}
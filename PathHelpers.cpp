@@ -1,7 +1,5 @@
 
 #include <Windows.h>
-#include <codecvt>
-#include <locale>
 
 #include "PathHelpers.h"
 
@@ -76,29 +74,3 @@ std::wstring FixPath(const std::wstring& relativeFilePath)
 {
 	return NarrowToWide(GetExePath()) + L"\\" + relativeFilePath;
 }
-
-
-// ----------------------------------------------------
-//  Helper function for converting a wide character 
-//  string to a standard ("narrow") character string
-// ----------------------------------------------------
-std::string WideToNarrow(const std::wstring& str)
-{
-	int size = WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.length(), 0, 0, 0, 0);
-	std::string result(size, 0);
-	WideCharToMultiByte(CP_UTF8, 0, str.c_str(), -1, &result[0], size, 0, 0);
-	return result;
-}
-
-
-// ----------------------------------------------------
-//  Helper function for converting a standard ("narrow") 
-//  string to a wide character string
-// ----------------------------------------------------
-std::wstring NarrowToWide(const std::string& str)
-{
-	int size = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), (int)str.length(), 0, 0);
-	std::wstring result(size, 0);
-	MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, &result[0], size);
-	return result;
-}
\ No newline at end of file
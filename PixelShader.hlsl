@@ -1,93 +1,340 @@
 #include "ShaderIncludes.hlsli"
 
-#define MAX_LIGHTS (5)
+// Constants are grouped by how often they change, so a draw
+// only re-uploads the groups that are actually different
 
-cbuffer ExternalData : register(b0)
+cbuffer PerFrame : register(b0)
+{
+	float3 camPos;
+
+	// Clustered lighting
+	int numDirectionalLights; // Lights are sorted by type, so these are the first ones in Lights
+	float4 clusterParams; // Tile width and height (pixels), depth slice scale and bias
+
+	// Per-object lighting, used instead of the clusters when enabled
+	int perObjectLights;
+
+	// Every shadow view in the atlas - lights index these with ShadowIndex
+	matrix shadowViewProjections[MAX_SHADOW_VIEWS];
+	float4 shadowAtlasRects[MAX_SHADOW_VIEWS]; // UV offset (xy), UV scale (z), half texel (w)
+	float4 cascadeSplits; // Far view depth of each cascade
+	int numCascades;
+
+	// Virtual shadow map, used by at most one directional light
+	matrix virtualShadowViewProjection;
+
+	// The sky's diffuse light, as SH9 constants with the basis functions'
+	// constants and the cosine lobe already folded in (rgb)
+	float4 skyIrradianceSH[9];
+	float skyAmbientIntensity; // Scales all of the sky's light
+}
+
+cbuffer PerMaterial : register(b1)
 {
 	float4 colorTint;
 	float2 uvScale;
 	float2 uvOffset;
-
 	float roughness;
-	float3 camPos;
+	uint4 textureSlices; // Array slice of each material texture, by register
+}
 
-	Light lights[MAX_LIGHTS];
-	int numLights;
+cbuffer PerObject : register(b2)
+{
+	uint4 objectLights[MAX_OBJECT_LIGHTS / 4]; // Indices into Lights, 4 per element
+	uint3 objectLightCounts; // Directional, point and spot lights in objectLights
 }
 
-Texture2D Albedo : register(t0);
-Texture2D NormalMap : register(t1);
-Texture2D RoughnessMap : register(t2);
-Texture2D MetalnessMap : register(t3);
-Texture2D ShadowMap : register(t4);
+// Material textures are slices of arrays shared between materials
+Texture2DArray Albedo : register(t0);
+Texture2DArray NormalMap : register(t1);
+Texture2DArray ORMMap : register(t2); // Ambient occlusion, roughness, metalness
+Texture2D ShadowAtlas : register(t3);
+Texture2D<uint> VirtualPageTable : register(t4);
+Texture2D VirtualShadowPool : register(t5);
+
+StructuredBuffer<PackedLight> Lights : register(t6); // Directional, then point, then spot lights
+StructuredBuffer<uint3> ClusterRanges : register(t7); // Offset into ClusterLightIndices, point light count, spot light count
+StructuredBuffer<uint> ClusterLightIndices : register(t8);
+TextureCube SpecularEnvironment : register(t9); // GGX prefiltered sky, one roughness per mip
+Texture2D<float2> BRDFLookup : register(t10); // Split-sum scale and bias of F0, by NdotV (u) and roughness (v)
 
 SamplerState BasicSampler : register(s0);
 SamplerComparisonState ShadowSampler : register(s1);
+SamplerState ClampSampler : register(s2);
+
+// Samples one view's tile of the shadow atlas
+float SampleShadowView(int view, float3 worldPos)
+{
+	float4 shadowMapPos = mul(shadowViewProjections[view], float4(worldPos, 1.0f));
+	shadowMapPos /= shadowMapPos.w;
+	float2 shadowUV = shadowMapPos.xy * 0.5f + 0.5f;
+	shadowUV.y = 1 - shadowUV.y;
+	float distToLight = shadowMapPos.z;
+
+	// Tiles share one texture, so there's no border color to fall back on
+	if (any(shadowUV < 0.0f) || any(shadowUV > 1.0f) || distToLight > 1.0f)
+	{
+		return 1.0f;
+	}
+
+	// Keep filtering from reaching into the neighboring tiles
+	float4 rect = shadowAtlasRects[view];
+	shadowUV = clamp(shadowUV, rect.w, 1.0f - rect.w) * rect.z + rect.xy;
+
+	// Get a ratio of comparison results using SampleCmpLevelZero()
+	return ShadowAtlas.SampleCmpLevelZero(
+		ShadowSampler,
+		shadowUV,
+		distToLight).r;
+}
+
+// Directional lights use the first cascade that covers this
+// depth (unshadowed past the last one)
+float SampleCascadeShadow(PackedLight light, float3 worldPos, float viewDepth)
+{
+	int cascade = 0;
+	while (cascade < numCascades && viewDepth > cascadeSplits[cascade])
+	{
+		cascade++;
+	}
+
+	if (cascade >= numCascades)
+	{
+		return 1.0f;
+	}
+
+	return SampleShadowView(light.ShadowIndex + cascade, worldPos);
+}
+
+// Point lights use the cube face along the major axis from the light
+float SamplePointShadow(PackedLight light, float3 worldPos)
+{
+	int view = light.ShadowIndex;
+
+	// Faces are in +X, -X, +Y, -Y, +Z, -Z order
+	float3 toPixel = worldPos - light.Position;
+	float3 axisLengths = abs(toPixel);
+
+	if (axisLengths.x >= axisLengths.y && axisLengths.x >= axisLengths.z)
+	{
+		view += toPixel.x > 0 ? 0 : 1;
+	}
+	else if (axisLengths.y >= axisLengths.z)
+	{
+		view += toPixel.y > 0 ? 2 : 3;
+	}
+	else
+	{
+		view += toPixel.z > 0 ? 4 : 5;
+	}
+
+	return SampleShadowView(view, worldPos);
+}
+
+// Looks up the virtual page this pixel lands on and samples its physical page
+float SampleVirtualShadow(float3 worldPos)
+{
+	float4 shadowMapPos = mul(virtualShadowViewProjection, float4(worldPos, 1.0f));
+	float2 virtualUV = shadowMapPos.xy * 0.5f + 0.5f;
+	virtualUV.y = 1 - virtualUV.y;
+	float distToLight = shadowMapPos.z;
+
+	if (any(virtualUV < 0.0f) || any(virtualUV >= 1.0f) || distToLight > 1.0f)
+	{
+		return 1.0f;
+	}
+
+	float2 pageCoord = virtualUV * VSM_PAGES_PER_SIDE;
+	uint physicalPage = VirtualPageTable.Load(int3(pageCoord, 0));
+
+	// Not resident (the pool ran out) - better unshadowed than wrong
+	if (physicalPage == VSM_INVALID_PAGE)
+	{
+		return 1.0f;
+	}
+
+	// Keep filtering inside the page, since its neighbors are unrelated
+	float halfTexel = 0.5f / VSM_PAGE_SIZE;
+	float2 inPage = clamp(frac(pageCoord), halfTexel, 1.0f - halfTexel);
+	float2 physicalCoord = float2(
+		physicalPage % VSM_PHYSICAL_PAGES_PER_SIDE,
+		physicalPage / VSM_PHYSICAL_PAGES_PER_SIDE);
+
+	return VirtualShadowPool.SampleCmpLevelZero(
+		ShadowSampler,
+		(physicalCoord + inPage) / VSM_PHYSICAL_PAGES_PER_SIDE,
+		distToLight).r;
+}
 
 // Provided function for attenuation
-float Attenuate(Light light, float3 worldPos)
+float Attenuate(PackedLight light, float3 worldPos)
 {
-	float dist = distance(light.Position, worldPos);
-	float att = saturate(1.0f - (dist * dist / (light.Range * light.Range)));
+	float3 toLight = light.Position - worldPos;
+	float att = saturate(1.0f - dot(toLight, toLight) * light.InvRangeSquared);
 	return att * att;
 }
 
-float3 calculateLightContributions(float3 worldPos, float3 normal,
-	float roughness, float metalness, float3 specColor, float3 surfaceColor,
-	float shadowAmount)
+// The BRDF shared by every light type
+float3 SurfaceLighting(float3 toLight, float3 toCam, float3 radiance, float3 normal,
+	float roughness, float metalness, float3 specColor, float3 surfaceColor)
 {
-	float3 totalContribution = float3(0.0, 0.0, 0.0);
+	float diff = DiffusePBR(normal, toLight);
+	float3 F;
+	float3 spec = MicrofacetBRDF(normal, toLight, toCam, roughness, specColor, F);
+	float3 balancedDiff = DiffuseEnergyConserve(diff, F, metalness);
+	return (balancedDiff * surfaceColor + spec) * radiance;
+}
+
+float3 DirectionalLight(PackedLight light, float3 worldPos, float viewDepth, float3 toCam, float3 normal,
+	float roughness, float metalness, float3 specColor, float3 surfaceColor)
+{
+	float3 contribution = SurfaceLighting(-light.Direction, toCam, light.Radiance,
+		normal, roughness, metalness, specColor, surfaceColor);
 
-	for (int ii = 0; ii < numLights; ii++)
+	if (light.VirtualShadow)
+	{
+		contribution *= SampleVirtualShadow(worldPos);
+	}
+	else if (light.ShadowIndex >= 0)
 	{
-		// Diffuse
-		float3 incomingLightDir = float3(0, 0, 0);
+		contribution *= SampleCascadeShadow(light, worldPos, viewDepth);
+	}
 
-		if (lights[ii].Type == LIGHT_TYPE_DIRECTIONAL)
-		{
-			incomingLightDir = normalize(lights[ii].Direction);
-		}
-		else
+	return contribution;
+}
+
+float3 PointLight(PackedLight light, float3 worldPos, float3 toCam, float3 normal,
+	float roughness, float metalness, float3 specColor, float3 surfaceColor)
+{
+	float3 toLight = normalize(light.Position - worldPos);
+	float3 contribution = SurfaceLighting(toLight, toCam, light.Radiance,
+		normal, roughness, metalness, specColor, surfaceColor) * Attenuate(light, worldPos);
+
+	if (light.ShadowIndex >= 0)
+	{
+		contribution *= SamplePointShadow(light, worldPos);
+	}
+
+	return contribution;
+}
+
+float3 SpotLight(PackedLight light, float3 worldPos, float3 toCam, float3 normal,
+	float roughness, float metalness, float3 specColor, float3 surfaceColor)
+{
+	float3 toLight = normalize(light.Position - worldPos);
+	float3 contribution = SurfaceLighting(toLight, toCam, light.Radiance,
+		normal, roughness, metalness, specColor, surfaceColor) * Attenuate(light, worldPos);
+
+	// Linear falloff between the cone angles, with the cosines worked out on the CPU
+	float pixelAngle = saturate(dot(-toLight, light.Direction));
+	contribution *= saturate((light.CosOuter - pixelAngle) * light.SpotScale);
+
+	if (light.ShadowIndex >= 0)
+	{
+		contribution *= SampleShadowView(light.ShadowIndex, worldPos);
+	}
+
+	return contribution;
+}
+
+// Ambient light reaching a surface from the whole sky, already divided
+// by pi for Lambertian diffuse - one multiply-add per coefficient
+float3 SkyIrradiance(float3 n)
+{
+	float3 irradiance = skyIrradianceSH[0].rgb;
+	irradiance += skyIrradianceSH[1].rgb * n.y;
+	irradiance += skyIrradianceSH[2].rgb * n.z;
+	irradiance += skyIrradianceSH[3].rgb * n.x;
+	irradiance += skyIrradianceSH[4].rgb * (n.x * n.y);
+	irradiance += skyIrradianceSH[5].rgb * (n.y * n.z);
+	irradiance += skyIrradianceSH[6].rgb * (3.0f * n.z * n.z - 1.0f);
+	irradiance += skyIrradianceSH[7].rgb * (n.x * n.z);
+	irradiance += skyIrradianceSH[8].rgb * (n.x * n.x - n.y * n.y);
+	return max(irradiance, 0.0f);
+}
+
+// All of the sky's light on a surface: diffuse from the SH9 constants,
+// and specular from the prefiltered environment and the split-sum table.
+// Whatever the specular reflects isn't left for diffuse.
+float3 SkyLighting(float3 toCam, float3 normal, float roughness, float metalness,
+	float3 specColor, float3 surfaceColor)
+{
+	float NdotV = saturate(dot(normal, toCam));
+	float2 brdf = BRDFLookup.SampleLevel(ClampSampler, float2(NdotV, roughness), 0);
+	float3 specularScale = specColor * brdf.x + brdf.y;
+
+	float3 reflected = reflect(-toCam, normal);
+	float3 prefiltered = SpecularEnvironment.SampleLevel(ClampSampler, reflected, roughness * (SKY_SPECULAR_MIPS - 1)).rgb;
+
+	float3 diffuse = SkyIrradiance(normal) * surfaceColor * (1.0f - specularScale) * (1.0f - metalness);
+	return (diffuse + prefiltered * specularScale) * skyAmbientIntensity;
+}
+
+uint GetObjectLight(uint index)
+{
+	return objectLights[index / 4][index % 4];
+}
+
+// Only loops over the lights picked for this object, or the directional
+// lights and the lights assigned to this pixel's cluster. Lights are sorted
+// by type, so each type gets its own loop with no branching on the type.
+float3 calculateLightContributions(float2 screenPos, float3 worldPos, float viewDepth, float3 normal,
+	float roughness, float metalness, float3 specColor, float3 surfaceColor)
+{
+	float3 totalContribution = float3(0.0, 0.0, 0.0);
+	float3 toCam = normalize(camPos - worldPos);
+
+	// The CPU already picked the lights that matter for this object
+	if (perObjectLights)
+	{
+		uint ii = 0;
+		uint end = objectLightCounts.x;
+		for (; ii < end; ii++)
 		{
-			incomingLightDir = normalize(worldPos - lights[ii].Position);
+			totalContribution += DirectionalLight(Lights[GetObjectLight(ii)], worldPos, viewDepth, toCam,
+				normal, roughness, metalness, specColor, surfaceColor);
 		}
-		
-		float diff = DiffusePBR(normal, -incomingLightDir);
-		float3 toCam = normalize(camPos - worldPos);
-		float3 F;
-		float3 spec = MicrofacetBRDF(normal, -incomingLightDir, toCam, roughness, specColor, F);
-		float3 balancedDiff = DiffuseEnergyConserve(diff, F, metalness);
-		float3 contribution = (balancedDiff * surfaceColor + spec) * lights[ii].Intensity * lights[ii].Color;
-
-		if (lights[ii].Type != LIGHT_TYPE_DIRECTIONAL)
+
+		end += objectLightCounts.y;
+		for (; ii < end; ii++)
 		{
-			contribution *= Attenuate(lights[ii], worldPos);
-
-			if (lights[ii].Type == LIGHT_TYPE_SPOT)
-			{
-				// Provided code for spot light term calculation
-				
-				// Get cos(angle) between pixel and light direction
-				float pixelAngle = saturate(dot(incomingLightDir, lights[ii].Direction));
-
-				// Get cosines of angles and calculate range
-				float cosOuter = cos(lights[ii].SpotOuterAngle);
-				float cosInner = cos(lights[ii].SpotInnerAngle);
-				float falloffRange = cosOuter - cosInner;
-
-				// Linear falloff over the range, clamp 0-1, apply to light calc
-				float spotTerm = saturate((cosOuter - pixelAngle) / falloffRange);
-				contribution *= spotTerm;
-			}
+			totalContribution += PointLight(Lights[GetObjectLight(ii)], worldPos, toCam,
+				normal, roughness, metalness, specColor, surfaceColor);
 		}
 
-		// If this is the first light, apply the shadowing result
-		if (ii == 4)
+		end += objectLightCounts.z;
+		for (; ii < end; ii++)
 		{
-			contribution *= shadowAmount;
+			totalContribution += SpotLight(Lights[GetObjectLight(ii)], worldPos, toCam,
+				normal, roughness, metalness, specColor, surfaceColor);
 		}
 
-		totalContribution += contribution;
+		return totalContribution;
+	}
+
+	for (int ii = 0; ii < numDirectionalLights; ii++)
+	{
+		totalContribution += DirectionalLight(Lights[ii], worldPos, viewDepth, toCam,
+			normal, roughness, metalness, specColor, surfaceColor);
+	}
+
+	// Find this pixel's froxel
+	uint2 tile = min(uint2(screenPos / clusterParams.xy), uint2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1));
+	int slice = clamp((int)floor(log(viewDepth) * clusterParams.z + clusterParams.w), 0, CLUSTER_COUNT_Z - 1);
+	uint cluster = (slice * CLUSTER_COUNT_Y + tile.y) * CLUSTER_COUNT_X + tile.x;
+
+	uint3 range = ClusterRanges[cluster];
+	for (uint jj = 0; jj < range.y; jj++)
+	{
+		totalContribution += PointLight(Lights[ClusterLightIndices[range.x + jj]], worldPos, toCam,
+			normal, roughness, metalness, specColor, surfaceColor);
+	}
+
+	uint spotStart = range.x + range.y;
+	for (uint kk = 0; kk < range.z; kk++)
+	{
+		totalContribution += SpotLight(Lights[ClusterLightIndices[spotStart + kk]], worldPos, toCam,
+			normal, roughness, metalness, specColor, surfaceColor);
 	}
 
 	return totalContribution;
@@ -104,24 +351,16 @@ float3 calculateLightContributions(float3 worldPos, float3 normal,
 // --------------------------------------------------------
 float4 main(VertexToPixel input) : SV_TARGET
 {
-	input.shadowMapPos /= input.shadowMapPos.w;
-	float2 shadowUV = input.shadowMapPos.xy * 0.5f + 0.5f;
-	shadowUV.y = 1 - shadowUV.y;
-	float distToLight = input.shadowMapPos.z;
-
-	// Get a ratio of comparison results using SampleCmpLevelZero()
-	float shadowAmount = ShadowMap.SampleCmpLevelZero(
-		ShadowSampler,
-		shadowUV,
-		distToLight).r;
-	
-	float3 unpackedNormal = NormalMap.Sample(BasicSampler, input.uv).rgb * 2.0 - 1.0;
+	// Only X and Y are stored (BC5 keeps two channels), so rebuild Z
+	float3 unpackedNormal;
+	unpackedNormal.xy = NormalMap.Sample(BasicSampler, float3(input.uv, textureSlices.y)).rg * 2.0 - 1.0;
+	unpackedNormal.z = sqrt(saturate(1.0 - dot(unpackedNormal.xy, unpackedNormal.xy)));
 	unpackedNormal = normalize(unpackedNormal);
 
 	input.normal = normalize(input.normal);
 	input.tangent = normalize(input.tangent);
 	input.uv = input.uv * uvScale + uvOffset;
-	float3 surfaceColor = (pow(Albedo.Sample(BasicSampler, input.uv), 2.2f) * colorTint).rgb;
+	float3 surfaceColor = (pow(Albedo.Sample(BasicSampler, float3(input.uv, textureSlices.x)), 2.2f) * colorTint).rgb;
 
 	// Gram-Schmidt orthonormalize process
 	float3 N = input.normal;
@@ -132,8 +371,10 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	input.normal = mul(unpackedNormal, TBN);
 
-	float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
-	float metalness = MetalnessMap.Sample(BasicSampler, input.uv).r;
+	// One fetch for all three (red is ambient occlusion, for the sky's light)
+	float3 orm = ORMMap.Sample(BasicSampler, float3(input.uv, textureSlices.z)).rgb;
+	float roughness = orm.g;
+	float metalness = orm.b;
 
 	// Specular color determination -----------------
 	// Assume albedo texture is actually holding specular color where metalness == 1
@@ -142,8 +383,12 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float3 specColor = lerp(F0_NON_METAL, surfaceColor.rgb, metalness);
 
 	float3 lightContributions = calculateLightContributions(
-		input.worldPosition, input.normal, roughness, metalness, specColor, surfaceColor,
-		shadowAmount);
+		input.screenPosition.xy, input.worldPosition, input.viewDepth,
+		input.normal, roughness, metalness, specColor, surfaceColor);
+
+	// Ambient from the sky, darkened in crevices
+	float3 ambient = SkyLighting(normalize(camPos - input.worldPosition), input.normal,
+		roughness, metalness, specColor, surfaceColor) * orm.r;
 
-	return float4(pow(lightContributions, 1.0f/2.2f), 1.0f);
+	return float4(pow(lightContributions + ambient, 1.0f/2.2f), 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+// --------------------------------------------------------
+// GENERATED from the compiled shaders' reflection data by
+// running the game with -generate-constants (see Main.cpp)
+// - regenerate it instead of editing it by hand.
+//
+// One struct per constant buffer, laid out exactly like the
+// cbuffer, for setting in one copy with ConstantBuffer<T>.
+// --------------------------------------------------------
+
+#include <DirectXMath.h>
+#include <cstddef>
+
+// --------------------------------------------------------
+// VertexShader - cbuffer PerFrame : register(b0)
+// --------------------------------------------------------
+struct alignas(16) VertexShaderPerFrame
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+};
+static_assert(offsetof(VertexShaderPerFrame, view) == 0);
+static_assert(offsetof(VertexShaderPerFrame, projection) == 64);
+static_assert(sizeof(VertexShaderPerFrame) == 128);
+
+// --------------------------------------------------------
+// VertexShader - cbuffer PerObject : register(b2)
+// --------------------------------------------------------
+struct alignas(16) VertexShaderPerObject
+{
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+};
+static_assert(offsetof(VertexShaderPerObject, world) == 0);
+static_assert(offsetof(VertexShaderPerObject, worldInvTranspose) == 64);
+static_assert(sizeof(VertexShaderPerObject) == 128);
+
+// --------------------------------------------------------
+// PixelShader - cbuffer PerFrame : register(b0)
+// --------------------------------------------------------
+struct alignas(16) PixelShaderPerFrame
+{
+	DirectX::XMFLOAT3 camPos;
+	int numDirectionalLights;
+	DirectX::XMFLOAT4 clusterParams;
+	int perObjectLights;
+	unsigned char Padding0[12];
+	DirectX::XMFLOAT4X4 shadowViewProjections[16];
+	DirectX::XMFLOAT4 shadowAtlasRects[16];
+	DirectX::XMFLOAT4 cascadeSplits;
+	int numCascades;
+	unsigned char Padding1[12];
+	DirectX::XMFLOAT4X4 virtualShadowViewProjection;
+	DirectX::XMFLOAT4 skyIrradianceSH[9];
+	float skyAmbientIntensity;
+};
+static_assert(offsetof(PixelShaderPerFrame, camPos) == 0);
+static_assert(offsetof(PixelShaderPerFrame, numDirectionalLights) == 12);
+static_assert(offsetof(PixelShaderPerFrame, clusterParams) == 16);
+static_assert(offsetof(PixelShaderPerFrame, perObjectLights) == 32);
+static_assert(offsetof(PixelShaderPerFrame, shadowViewProjections) == 48);
+static_assert(offsetof(PixelShaderPerFrame, shadowAtlasRects) == 1072);
+static_assert(offsetof(PixelShaderPerFrame, cascadeSplits) == 1328);
+static_assert(offsetof(PixelShaderPerFrame, numCascades) == 1344);
+static_assert(offsetof(PixelShaderPerFrame, virtualShadowViewProjection) == 1360);
+static_assert(offsetof(PixelShaderPerFrame, skyIrradianceSH) == 1424);
+static_assert(offsetof(PixelShaderPerFrame, skyAmbientIntensity) == 1568);
+static_assert(sizeof(PixelShaderPerFrame) == 1584);
+
+// --------------------------------------------------------
+// PixelShader - cbuffer PerMaterial : register(b1)
+// --------------------------------------------------------
+struct alignas(16) PixelShaderPerMaterial
+{
+	DirectX::XMFLOAT4 colorTint;
+	DirectX::XMFLOAT2 uvScale;
+	DirectX::XMFLOAT2 uvOffset;
+	float roughness;
+	unsigned char Padding0[12];
+	DirectX::XMUINT4 textureSlices;
+};
+static_assert(offsetof(PixelShaderPerMaterial, colorTint) == 0);
+static_assert(offsetof(PixelShaderPerMaterial, uvScale) == 16);
+static_assert(offsetof(PixelShaderPerMaterial, uvOffset) == 24);
+static_assert(offsetof(PixelShaderPerMaterial, roughness) == 32);
+static_assert(offsetof(PixelShaderPerMaterial, textureSlices) == 48);
+static_assert(sizeof(PixelShaderPerMaterial) == 64);
+
+// --------------------------------------------------------
+// PixelShader - cbuffer PerObject : register(b2)
+// --------------------------------------------------------
+struct alignas(16) PixelShaderPerObject
+{
+	DirectX::XMUINT4 objectLights[2];
+	DirectX::XMUINT3 objectLightCounts;
+};
+static_assert(offsetof(PixelShaderPerObject, objectLights) == 0);
+static_assert(offsetof(PixelShaderPerObject, objectLightCounts) == 32);
+static_assert(sizeof(PixelShaderPerObject) == 48);
+
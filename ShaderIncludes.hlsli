@@ -6,6 +6,35 @@
 #define LIGHT_TYPE_SPOT (2)
 #define MAX_SPECULAR_EXPONENT (256.0f)
 
+// Must match MAX_SHADOW_CASCADES in ShadowCascades.h
+#define MAX_SHADOW_CASCADES (4)
+
+// Must match MAX_SHADOW_VIEWS in ShadowAtlas.h
+#define MAX_SHADOW_VIEWS (16)
+
+// Must match the VSM_ defines in VirtualShadowMap.h
+#define VSM_PAGE_SIZE (128)
+#define VSM_PAGES_PER_SIDE (128)
+#define VSM_PHYSICAL_PAGES_PER_SIDE (32)
+#define VSM_INVALID_PAGE (0xFFFFFFFF)
+
+// Must match the CLUSTER_ defines in LightClusterBuilder.h
+#define CLUSTER_COUNT_X (16)
+#define CLUSTER_COUNT_Y (9)
+#define CLUSTER_COUNT_Z (24)
+
+// Must match MAX_OBJECT_LIGHTS in ObjectLightSelector.h
+#define MAX_OBJECT_LIGHTS (8)
+
+// Must match PREFILTERED_ENVIRONMENT_MIPS in EnvironmentBaker.h
+#define SKY_SPECULAR_MIPS (6)
+
+// Must match the LUT sizes in Atmosphere.h
+#define ATMOSPHERE_TRANSMITTANCE_WIDTH (256)
+#define ATMOSPHERE_TRANSMITTANCE_HEIGHT (64)
+#define ATMOSPHERE_SKY_VIEW_WIDTH (192)
+#define ATMOSPHERE_SKY_VIEW_HEIGHT (108)
+
 struct VertexShaderInput
 {
     float3 localPosition : POSITION; // XYZ position
@@ -21,7 +50,7 @@ struct VertexToPixel
     float3 normal : NORMAL;
     float3 worldPosition : POSITION;
     float3 tangent : TANGENT;
-    float4 shadowMapPos : SHADOW_POSITION;
+    float viewDepth : VIEW_DEPTH;
 };
 
 struct VertexToPixel_Sky
@@ -30,19 +59,20 @@ struct VertexToPixel_Sky
     float3 sampleDir : DIRECTION;
 };
 
-struct Light
+// Must match PackedLight in LightPacker.h
+struct PackedLight
 {
-    int Type;
-    float3 Direction;
-
-    float Range;
     float3 Position;
+    float InvRangeSquared;
+
+    float3 Direction; // Normalized, pointing away from the light
+    float CosOuter;
 
-    float Intensity;
-    float3 Color;
+    float3 Radiance; // Color * Intensity
+    float SpotScale; // 1 / (cos(outer) - cos(inner))
 
-    float SpotInnerAngle;
-    float SpotOuterAngle;
+    int ShadowIndex; // First view in the shadow atlas, -1 if unshadowed
+    int VirtualShadow; // Uses the virtual shadow map instead of the atlas
     float2 Padding;
 };
 
@@ -0,0 +1,263 @@
+#include "ShaderReflectionCache.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+// Bump the version whenever the layout below changes
+static const unsigned int CACHE_MAGIC = 0x4C464552; // "REFL"
+static const unsigned int CACHE_VERSION = 1;
+
+// --------------------------------------------------------
+// Appends plain values to a byte buffer
+// --------------------------------------------------------
+class ReflectionWriter
+{
+public:
+	ReflectionWriter(std::vector<unsigned char>& bytes) : m_bytes(bytes) {}
+
+	template<typename T>
+	void Write(const T& value)
+	{
+		const unsigned char* start = reinterpret_cast<const unsigned char*>(&value);
+		m_bytes.insert(m_bytes.end(), start, start + sizeof(T));
+	}
+
+	void WriteString(const std::string& value)
+	{
+		Write((unsigned int)value.size());
+		m_bytes.insert(m_bytes.end(), value.begin(), value.end());
+	}
+
+private:
+	std::vector<unsigned char>& m_bytes;
+};
+
+// --------------------------------------------------------
+// Reads plain values back out, failing (rather than reading
+// past the end) on truncated data
+// --------------------------------------------------------
+class ReflectionReader
+{
+public:
+	ReflectionReader(const unsigned char* data, size_t size) :
+		m_data(data),
+		m_size(size),
+		m_position(0)
+	{
+	}
+
+	template<typename T>
+	bool Read(T& value)
+	{
+		if (m_size - m_position < sizeof(T))
+			return false;
+
+		memcpy(&value, m_data + m_position, sizeof(T));
+		m_position += sizeof(T);
+		return true;
+	}
+
+	bool ReadString(std::string& value)
+	{
+		unsigned int length = 0;
+		if (!Read(length) || m_size - m_position < length)
+			return false;
+
+		value.assign(reinterpret_cast<const char*>(m_data + m_position), length);
+		m_position += length;
+		return true;
+	}
+
+	// Guards vector sizes against garbage counts
+	bool CanHold(unsigned int count, size_t minimumSize) const
+	{
+		return (m_size - m_position) / minimumSize >= count;
+	}
+
+	bool AtEnd() const { return m_position == m_size; }
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+	size_t m_position;
+};
+
+unsigned long long HashShaderBytecode(const void* data, size_t size)
+{
+	return HashFNV1aBytes(data, size);
+}
+
+// --------------------------------------------------------
+// Layout:
+//  header:    magic, version, bytecode hash
+//  counts:    SRVs, samplers, buffers, variables, input elements
+//  then each array in that order, strings as length + chars
+// --------------------------------------------------------
+std::vector<unsigned char> SerializeShaderReflection(const ShaderReflectionData& reflection, unsigned long long bytecodeHash)
+{
+	std::vector<unsigned char> bytes;
+	ReflectionWriter writer(bytes);
+
+	writer.Write(CACHE_MAGIC);
+	writer.Write(CACHE_VERSION);
+	writer.Write(bytecodeHash);
+
+	writer.Write((unsigned int)reflection.ShaderResourceViews.size());
+	writer.Write((unsigned int)reflection.Samplers.size());
+	writer.Write((unsigned int)reflection.ConstantBuffers.size());
+	writer.Write((unsigned int)reflection.Variables.size());
+	writer.Write((unsigned int)reflection.InputElements.size());
+
+	for (const ShaderReflectionResource& srv : reflection.ShaderResourceViews)
+	{
+		writer.Write(srv.NameHash);
+		writer.Write(srv.BindPoint);
+	}
+
+	for (const ShaderReflectionResource& sampler : reflection.Samplers)
+	{
+		writer.Write(sampler.NameHash);
+		writer.Write(sampler.BindPoint);
+	}
+
+	for (const ShaderReflectionBuffer& buffer : reflection.ConstantBuffers)
+	{
+		writer.WriteString(buffer.Name);
+		writer.Write(buffer.Type);
+		writer.Write(buffer.BindPoint);
+		writer.Write(buffer.Size);
+		writer.Write(buffer.FirstVariable);
+		writer.Write(buffer.VariableCount);
+	}
+
+	for (const ShaderReflectionVariable& variable : reflection.Variables)
+	{
+		writer.Write(variable.NameHash);
+		writer.Write(variable.ByteOffset);
+		writer.Write(variable.Size);
+	}
+
+	for (const ShaderReflectionInputElement& element : reflection.InputElements)
+	{
+		writer.WriteString(element.SemanticName);
+		writer.Write(element.SemanticIndex);
+		writer.Write(element.Format);
+		writer.Write((unsigned int)element.PerInstance);
+	}
+
+	return bytes;
+}
+
+bool DeserializeShaderReflection(const unsigned char* data, size_t size, unsigned long long bytecodeHash, ShaderReflectionData& reflectionOut)
+{
+	ReflectionReader reader(data, size);
+
+	unsigned int magic = 0;
+	unsigned int version = 0;
+	unsigned long long hash = 0;
+	if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(hash) ||
+		magic != CACHE_MAGIC || version != CACHE_VERSION || hash != bytecodeHash)
+		return false;
+
+	unsigned int srvCount = 0;
+	unsigned int samplerCount = 0;
+	unsigned int bufferCount = 0;
+	unsigned int variableCount = 0;
+	unsigned int inputCount = 0;
+	if (!reader.Read(srvCount) || !reader.Read(samplerCount) || !reader.Read(bufferCount) ||
+		!reader.Read(variableCount) || !reader.Read(inputCount))
+		return false;
+
+	// Smallest possible encoding of each entry, so a damaged count can't
+	// trigger a huge allocation
+	if (!reader.CanHold(srvCount, 12) ||
+		!reader.CanHold(samplerCount, 12) ||
+		!reader.CanHold(bufferCount, 24) ||
+		!reader.CanHold(variableCount, 16) ||
+		!reader.CanHold(inputCount, 16))
+		return false;
+
+	ShaderReflectionData reflection;
+	reflection.ShaderResourceViews.resize(srvCount);
+	reflection.Samplers.resize(samplerCount);
+	reflection.ConstantBuffers.resize(bufferCount);
+	reflection.Variables.resize(variableCount);
+	reflection.InputElements.resize(inputCount);
+
+	for (ShaderReflectionResource& srv : reflection.ShaderResourceViews)
+	{
+		if (!reader.Read(srv.NameHash) || !reader.Read(srv.BindPoint))
+			return false;
+	}
+
+	for (ShaderReflectionResource& sampler : reflection.Samplers)
+	{
+		if (!reader.Read(sampler.NameHash) || !reader.Read(sampler.BindPoint))
+			return false;
+	}
+
+	for (ShaderReflectionBuffer& buffer : reflection.ConstantBuffers)
+	{
+		if (!reader.ReadString(buffer.Name) ||
+			!reader.Read(buffer.Type) ||
+			!reader.Read(buffer.BindPoint) ||
+			!reader.Read(buffer.Size) ||
+			!reader.Read(buffer.FirstVariable) ||
+			!reader.Read(buffer.VariableCount))
+			return false;
+
+		// Each buffer's variables have to be inside the table
+		if (buffer.FirstVariable > variableCount || buffer.VariableCount > variableCount - buffer.FirstVariable)
+			return false;
+	}
+
+	for (ShaderReflectionVariable& variable : reflection.Variables)
+	{
+		if (!reader.Read(variable.NameHash) || !reader.Read(variable.ByteOffset) || !reader.Read(variable.Size))
+			return false;
+	}
+
+	for (ShaderReflectionInputElement& element : reflection.InputElements)
+	{
+		unsigned int perInstance = 0;
+		if (!reader.ReadString(element.SemanticName) ||
+			!reader.Read(element.SemanticIndex) ||
+			!reader.Read(element.Format) ||
+			!reader.Read(perInstance))
+			return false;
+
+		element.PerInstance = perInstance != 0;
+	}
+
+	if (!reader.AtEnd())
+		return false;
+
+	reflectionOut = std::move(reflection);
+	return true;
+}
+
+bool LoadShaderReflection(const std::wstring& cacheFile, unsigned long long bytecodeHash, ShaderReflectionData& reflectionOut)
+{
+	std::ifstream file(std::filesystem::path(cacheFile), std::ios::binary);
+	if (!file)
+		return false;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return DeserializeShaderReflection(bytes.data(), bytes.size(), bytecodeHash, reflectionOut);
+}
+
+bool SaveShaderReflection(const std::wstring& cacheFile, unsigned long long bytecodeHash, const ShaderReflectionData& reflection)
+{
+	std::vector<unsigned char> bytes = SerializeShaderReflection(reflection, bytecodeHash);
+
+	std::ofstream file(std::filesystem::path(cacheFile), std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	return file.good();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Everything SimpleShader needs from shader reflection, as
+// plain data. Filled in either by reflecting a compiled
+// shader or from the on-disk cache, so warm runs skip
+// D3DReflect() entirely.
+//
+// Nothing in here touches Direct3D - enum values (buffer
+// types, DXGI formats) are stored as plain integers.
+// --------------------------------------------------------
+struct ShaderReflectionResource
+{
+	unsigned long long NameHash; // SimpleShaderHash() of the name
+	unsigned int BindPoint;
+};
+
+struct ShaderReflectionVariable
+{
+	unsigned long long NameHash;
+	unsigned int ByteOffset;
+	unsigned int Size;
+};
+
+struct ShaderReflectionBuffer
+{
+	std::string Name;
+	unsigned int Type; // D3D_CBUFFER_TYPE
+	unsigned int BindPoint;
+	unsigned int Size;
+	unsigned int FirstVariable; // Run of ShaderReflectionData::Variables
+	unsigned int VariableCount;
+};
+
+struct ShaderReflectionInputElement
+{
+	std::string SemanticName;
+	unsigned int SemanticIndex;
+	unsigned int Format; // DXGI_FORMAT
+	bool PerInstance; // Semantic ends in "_PER_INSTANCE"
+};
+
+struct ShaderReflectionData
+{
+	std::vector<ShaderReflectionResource> ShaderResourceViews;
+	std::vector<ShaderReflectionResource> Samplers;
+	std::vector<ShaderReflectionBuffer> ConstantBuffers;
+	std::vector<ShaderReflectionVariable> Variables;
+	std::vector<ShaderReflectionInputElement> InputElements; // Vertex shaders only
+};
+
+// --------------------------------------------------------
+// The cache itself: one small binary file per shader,
+// stamped with a hash of the .cso it was made from. A
+// shader that's been recompiled no longer matches its
+// cache file, which is then rewritten.
+// --------------------------------------------------------
+
+// 64-bit FNV-1a of a compiled shader's bytes
+unsigned long long HashShaderBytecode(const void* data, size_t size);
+
+std::vector<unsigned char> SerializeShaderReflection(const ShaderReflectionData& reflection, unsigned long long bytecodeHash);
+bool DeserializeShaderReflection(const unsigned char* data, size_t size, unsigned long long bytecodeHash, ShaderReflectionData& reflectionOut);
+
+// False if the file is missing, damaged or from different bytecode
+bool LoadShaderReflection(const std::wstring& cacheFile, unsigned long long bytecodeHash, ShaderReflectionData& reflectionOut);
+bool SaveShaderReflection(const std::wstring& cacheFile, unsigned long long bytecodeHash, const ShaderReflectionData& reflection);
@@ -0,0 +1,81 @@
+#include "ShadowAtlas.h"
+
+// ImGui compiles its own copy of the packer as static functions,
+// which aren't visible from here, so this file provides the
+// implementation for the declarations ShadowAtlas.h pulled in
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "ImGui/imstb_rectpack.h"
+
+ShadowAtlas::ShadowAtlas(const unsigned int atlasSize) :
+	m_size(atlasSize),
+	m_repackCount(0)
+{
+	m_nodes.resize(atlasSize);
+}
+
+bool ShadowAtlas::Allocate(const std::vector<unsigned int>& tileSizes)
+{
+	if (tileSizes == m_requestedSizes)
+	{
+		return false;
+	}
+
+	m_requestedSizes = tileSizes;
+	m_tiles.resize(tileSizes.size());
+	m_rects.resize(tileSizes.size());
+	m_repackCount++;
+
+	// Halve everything until it all fits - a tile can't get smaller than 1 texel,
+	// so this always ends as long as there are fewer tiles than texels
+	for (unsigned int shift = 0; ; shift++)
+	{
+		for (size_t ii = 0; ii < tileSizes.size(); ii++)
+		{
+			unsigned int size = tileSizes[ii] >> shift;
+			if (size < 1) size = 1;
+			if (size > m_size) size = m_size;
+
+			m_rects[ii] = {};
+			m_rects[ii].id = static_cast<int>(ii);
+			m_rects[ii].w = static_cast<stbrp_coord>(size);
+			m_rects[ii].h = static_cast<stbrp_coord>(size);
+		}
+
+		stbrp_context context;
+		stbrp_init_target(&context, m_size, m_size, m_nodes.data(), static_cast<int>(m_nodes.size()));
+		if (stbrp_pack_rects(&context, m_rects.data(), static_cast<int>(m_rects.size())))
+		{
+			break;
+		}
+	}
+
+	for (const stbrp_rect& rect : m_rects)
+	{
+		m_tiles[rect.id] = {
+			static_cast<unsigned int>(rect.x),
+			static_cast<unsigned int>(rect.y),
+			static_cast<unsigned int>(rect.w) };
+	}
+
+	return true;
+}
+
+unsigned int ShadowAtlas::GetSize() const
+{
+	return m_size;
+}
+
+unsigned int ShadowAtlas::GetTileCount() const
+{
+	return static_cast<unsigned int>(m_tiles.size());
+}
+
+const ShadowAtlasTile& ShadowAtlas::GetTile(const unsigned int index) const
+{
+	return m_tiles[index];
+}
+
+unsigned int ShadowAtlas::GetRepackCount() const
+{
+	return m_repackCount;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "ImGui/imstb_rectpack.h"
+
+// Must match MAX_SHADOW_VIEWS in ShaderIncludes.hlsli
+#define MAX_SHADOW_VIEWS (16)
+
+// --------------------------------------------------------
+// One square region of the shadow atlas, in texels
+// --------------------------------------------------------
+struct ShadowAtlasTile
+{
+	unsigned int X;
+	unsigned int Y;
+	unsigned int Size;
+};
+
+// --------------------------------------------------------
+// Packs square shadow map tiles into a single atlas texture
+// using the rect packer that ships with ImGui.
+//
+// Packing only happens when the requested tile sizes change,
+// so tiles stay put (and cached shadows stay valid) from
+// frame to frame. Nothing in here touches Direct3D.
+// --------------------------------------------------------
+class ShadowAtlas
+{
+public:
+	ShadowAtlas(const unsigned int atlasSize);
+
+	// One tile per requested size, in the same order. If they don't all fit,
+	// every tile is halved until they do. Returns true if the layout changed.
+	bool Allocate(const std::vector<unsigned int>& tileSizes);
+
+	// Getters
+	unsigned int GetSize() const;
+	unsigned int GetTileCount() const;
+	const ShadowAtlasTile& GetTile(const unsigned int index) const;
+	unsigned int GetRepackCount() const;
+
+private:
+	unsigned int m_size;
+	unsigned int m_repackCount;
+
+	std::vector<unsigned int> m_requestedSizes;
+	std::vector<ShadowAtlasTile> m_tiles;
+
+	// Scratch space for the packer
+	std::vector<stbrp_node> m_nodes;
+	std::vector<stbrp_rect> m_rects;
+};
@@ -0,0 +1,183 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+void ShadowCascades::ComputeSplitDistances(
+	const float nearDist,
+	const float farDist,
+	const float lambda,
+	const unsigned int cascadeCount,
+	float* splitDistancesOut)
+{
+	for (unsigned int ii = 0; ii < cascadeCount; ii++)
+	{
+		float fraction = static_cast<float>(ii + 1) / cascadeCount;
+
+		float logSplit = nearDist * std::pow(farDist / nearDist, fraction);
+		float uniformSplit = nearDist + (farDist - nearDist) * fraction;
+
+		splitDistancesOut[ii] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+	}
+
+	// Avoid any floating point drift on the last one
+	splitDistancesOut[cascadeCount - 1] = farDist;
+}
+
+void ShadowCascades::GetFrustumSliceCorners(
+	const XMFLOAT4X4& view,
+	const XMFLOAT4X4& projection,
+	const float cameraNear,
+	const float cameraFar,
+	const float sliceNear,
+	const float sliceFar,
+	XMFLOAT3 cornersOut[8])
+{
+	XMMATRIX inverseViewProjection = XMMatrixInverse(nullptr,
+		XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+
+	// View depth is linear along each edge from a near corner to its far corner
+	float nearFraction = (sliceNear - cameraNear) / (cameraFar - cameraNear);
+	float farFraction = (sliceFar - cameraNear) / (cameraFar - cameraNear);
+
+	const XMFLOAT2 ndcCorners[4] = {
+		XMFLOAT2(-1.0f, 1.0f),
+		XMFLOAT2(1.0f, 1.0f),
+		XMFLOAT2(1.0f, -1.0f),
+		XMFLOAT2(-1.0f, -1.0f) };
+
+	for (int ii = 0; ii < 4; ii++)
+	{
+		XMVECTOR nearCorner = XMVector3TransformCoord(
+			XMVectorSet(ndcCorners[ii].x, ndcCorners[ii].y, 0.0f, 1.0f), inverseViewProjection);
+		XMVECTOR farCorner = XMVector3TransformCoord(
+			XMVectorSet(ndcCorners[ii].x, ndcCorners[ii].y, 1.0f, 1.0f), inverseViewProjection);
+
+		XMStoreFloat3(&cornersOut[ii], XMVectorLerp(nearCorner, farCorner, nearFraction));
+		XMStoreFloat3(&cornersOut[ii + 4], XMVectorLerp(nearCorner, farCorner, farFraction));
+	}
+}
+
+ShadowView ShadowCascades::FitCascade(
+	const XMFLOAT3 sliceCorners[8],
+	const XMFLOAT3& lightDirection,
+	const BoundingBox& sceneBounds,
+	const unsigned int shadowMapResolution)
+{
+	// Bounding sphere of the slice
+	XMVECTOR center = XMVectorZero();
+	for (int ii = 0; ii < 8; ii++)
+	{
+		center = XMVectorAdd(center, XMLoadFloat3(&sliceCorners[ii]));
+	}
+	center = XMVectorScale(center, 1.0f / 8.0f);
+
+	float radius = 0.0f;
+	for (int ii = 0; ii < 8; ii++)
+	{
+		radius = std::max(radius, XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&sliceCorners[ii]), center))));
+	}
+
+	// Quantize the radius so tiny precision changes don't resize the cascade
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	// Light view centered on the slice, avoiding a degenerate up vector
+	XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	if (std::abs(XMVectorGetX(XMVector3Dot(direction, up))) > 0.99f)
+	{
+		up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+	}
+
+	// Snap the center to whole texels in light space, so the light matrices
+	// only change when the slice moves a full texel.  This stops shimmering,
+	// and identical matrices are also what lets the static shadow cache reuse
+	// a cascade - it's keyed on this snapped origin, not the camera position.
+	float texelSize = 2.0f * radius / shadowMapResolution;
+	XMMATRIX lightRotation = XMMatrixLookToLH(XMVectorZero(), direction, up);
+	XMVECTOR lightSpaceCenter = XMVector3Transform(center, lightRotation);
+	lightSpaceCenter = XMVectorScale(XMVectorRound(XMVectorScale(lightSpaceCenter, 1.0f / texelSize)), texelSize);
+	center = XMVector3Transform(lightSpaceCenter, XMMatrixTranspose(lightRotation));
+
+	XMMATRIX lightView = XMMatrixLookToLH(center, direction, up);
+
+	// Pull the near plane back far enough to catch every caster in the scene
+	XMFLOAT3 sceneCorners[BoundingBox::CORNER_COUNT];
+	sceneBounds.GetCorners(sceneCorners);
+
+	float nearZ = -radius;
+	for (const XMFLOAT3& corner : sceneCorners)
+	{
+		nearZ = std::min(nearZ, XMVectorGetZ(XMVector3Transform(XMLoadFloat3(&corner), lightView)));
+	}
+
+	// Round it out in coarse steps so moving casters don't change the
+	// projection every frame (which would also defeat shadow caching)
+	nearZ = std::floor(nearZ / 8.0f) * 8.0f;
+
+	XMMATRIX lightProjection = XMMatrixOrthographicOffCenterLH(
+		-radius, radius,
+		-radius, radius,
+		nearZ, radius);
+
+	ShadowView cascade = {};
+	XMStoreFloat4x4(&cascade.View, lightView);
+	XMStoreFloat4x4(&cascade.Projection, lightProjection);
+	cascade.Perspective = false;
+	return cascade;
+}
+
+ShadowView ShadowCascades::FitSpotLight(
+	const XMFLOAT3& position,
+	const XMFLOAT3& direction,
+	const float outerAngle,
+	const float range)
+{
+	XMVECTOR lightDirection = XMVector3Normalize(XMLoadFloat3(&direction));
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	if (std::abs(XMVectorGetX(XMVector3Dot(lightDirection, up))) > 0.99f)
+	{
+		up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+	}
+
+	// The outer angle is measured from the center of the cone
+	float fieldOfView = std::min(outerAngle * 2.0f, XM_PI - 0.01f);
+
+	ShadowView view = {};
+	XMStoreFloat4x4(&view.View, XMMatrixLookToLH(XMLoadFloat3(&position), lightDirection, up));
+	XMStoreFloat4x4(&view.Projection, XMMatrixPerspectiveFovLH(fieldOfView, 1.0f, 0.1f, range));
+	view.Perspective = true;
+	return view;
+}
+
+ShadowView ShadowCascades::FitPointLightFace(
+	const XMFLOAT3& position,
+	const float range,
+	const unsigned int face)
+{
+	const XMFLOAT3 faceDirections[6] = {
+		XMFLOAT3(1.0f, 0.0f, 0.0f),
+		XMFLOAT3(-1.0f, 0.0f, 0.0f),
+		XMFLOAT3(0.0f, 1.0f, 0.0f),
+		XMFLOAT3(0.0f, -1.0f, 0.0f),
+		XMFLOAT3(0.0f, 0.0f, 1.0f),
+		XMFLOAT3(0.0f, 0.0f, -1.0f) };
+	const XMFLOAT3 faceUps[6] = {
+		XMFLOAT3(0.0f, 1.0f, 0.0f),
+		XMFLOAT3(0.0f, 1.0f, 0.0f),
+		XMFLOAT3(0.0f, 0.0f, -1.0f),
+		XMFLOAT3(0.0f, 0.0f, 1.0f),
+		XMFLOAT3(0.0f, 1.0f, 0.0f),
+		XMFLOAT3(0.0f, 1.0f, 0.0f) };
+
+	ShadowView view = {};
+	XMStoreFloat4x4(&view.View, XMMatrixLookToLH(
+		XMLoadFloat3(&position),
+		XMLoadFloat3(&faceDirections[face]),
+		XMLoadFloat3(&faceUps[face])));
+	XMStoreFloat4x4(&view.Projection, XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 0.1f, range));
+	view.Perspective = true;
+	return view;
+}
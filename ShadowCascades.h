@@ -0,0 +1,72 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+// Must match MAX_SHADOW_CASCADES in ShaderIncludes.hlsli
+#define MAX_SHADOW_CASCADES (4)
+
+// --------------------------------------------------------
+// The light matrices for one shadow map view: a cascade of a
+// directional light, a spot light or one face of a point light
+// --------------------------------------------------------
+struct ShadowView
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	float SplitNear;	// View space depth where this cascade starts (cascades only)
+	float SplitFar;		// View space depth where this cascade ends (cascades only)
+	bool Perspective;	// Spot and point lights
+};
+
+// --------------------------------------------------------
+// Math for splitting a camera frustum into cascades and fitting
+// light projections around each one, plus the simpler fixed
+// projections for spot and point lights. Pure CPU code with no
+// Direct3D dependencies.
+// --------------------------------------------------------
+namespace ShadowCascades
+{
+	// Practical split scheme: blends logarithmic and uniform splits by lambda
+	// (0 = uniform, 1 = logarithmic). Writes cascadeCount far distances.
+	void ComputeSplitDistances(
+		const float nearDist,
+		const float farDist,
+		const float lambda,
+		const unsigned int cascadeCount,
+		float* splitDistancesOut);
+
+	// World space corners of the part of the camera frustum between two view depths
+	void GetFrustumSliceCorners(
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection,
+		const float cameraNear,
+		const float cameraFar,
+		const float sliceNear,
+		const float sliceFar,
+		DirectX::XMFLOAT3 cornersOut[8]);
+
+	// Fits an orthographic light projection around a frustum slice.
+	//  - XY uses the slice's bounding sphere so the size never changes as the camera turns
+	//  - Z is tightened to the slice, extended toward the light to include the scene's casters
+	//  - The center is snapped to whole shadow map texels in light space, so the
+	//    matrices stay bit for bit identical until the slice moves a texel
+	ShadowView FitCascade(
+		const DirectX::XMFLOAT3 sliceCorners[8],
+		const DirectX::XMFLOAT3& lightDirection,
+		const DirectX::BoundingBox& sceneBounds,
+		const unsigned int shadowMapResolution);
+
+	// Perspective view covering a spot light's outer cone
+	ShadowView FitSpotLight(
+		const DirectX::XMFLOAT3& position,
+		const DirectX::XMFLOAT3& direction,
+		const float outerAngle,
+		const float range);
+
+	// 90 degree view down one axis of a point light, in +X, -X, +Y, -Y, +Z, -Z order
+	ShadowView FitPointLightFace(
+		const DirectX::XMFLOAT3& position,
+		const float range,
+		const unsigned int face);
+}
@@ -0,0 +1,14 @@
+// --------------------------------------------------------
+// Fullscreen triangle at the far plane. Drawn with depth
+// writes always on, it resets one shadow atlas tile (the
+// bound viewport) without touching the rest of the atlas.
+// --------------------------------------------------------
+float4 main(uint id : SV_VertexID) : SV_POSITION
+{
+	// Calculate the UV (0,0) to (2,2) using the ID
+	float2 uv = float2(
+		(id << 1) & 2,
+		id & 2);
+
+	return float4(uv.x * 2 - 1, uv.y * -2 + 1, 1.0f, 1.0f);
+}
@@ -0,0 +1,13 @@
+// --------------------------------------------------------
+// Copies one shadow atlas tile from the static atlas. Drawn
+// with ShadowTileClearVS over the tile's viewport and depth
+// writes always on, since D3D11 can only copy depth-stencil
+// resources whole.
+// --------------------------------------------------------
+Texture2D StaticShadowAtlas : register(t0);
+
+float main(float4 position : SV_POSITION) : SV_DEPTH
+{
+	// Both atlases share a layout, so the same texel holds this tile's depth
+	return StaticShadowAtlas.Load(int3(position.xy, 0)).r;
+}
@@ -1,8 +1,17 @@
 #include "SimpleShader.h"
 
+#include <algorithm>
+#include <new>
+
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
+bool ISimpleShader::UseReflectionCache = true;
+
+// No ring until the application provides one
+std::shared_ptr<ConstantRingBuffer> ISimpleShader::ConstantRing;
+unsigned long long ISimpleShader::ConstantBytesUploaded = 0;
+unsigned long long ISimpleShader::ConstantBytesRequested = 0;
 
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
@@ -26,8 +35,20 @@ ISimpleShader::ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Micros
 	this->deviceContext = context;
 
 	// Set up fields
+	this->arena = 0;
+	this->arenaSize = 0;
 	this->constantBufferCount = 0;
+	this->variableCount = 0;
+	this->shaderResourceViewCount = 0;
+	this->samplerCount = 0;
 	this->constantBuffers = 0;
+	this->variables = 0;
+	this->shaderResourceViews = 0;
+	this->samplerStates = 0;
+	this->cbTable = 0;
+	this->varTable = 0;
+	this->textureTable = 0;
+	this->samplerTable = 0;
 	this->shaderValid = false;
 }
 
@@ -45,29 +66,30 @@ ISimpleShader::~ISimpleShader()
 // --------------------------------------------------------
 void ISimpleShader::CleanUp()
 {
-	// Handle constant buffers and local data buffers
+	// Everything lives in the arena, but the constant buffers hold
+	// Direct3D resources (and names) that still need releasing
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		delete[] constantBuffers[i].LocalDataBuffer;
+		constantBuffers[i].~SimpleConstantBuffer();
 	}
 
-	if (constantBuffers)
-	{
-		delete[] constantBuffers;
-		constantBufferCount = 0;
-	}
+	delete[] arena;
+	arena = 0;
+	arenaSize = 0;
 
-	for (unsigned int i = 0; i < shaderResourceViews.size(); i++)
-		delete shaderResourceViews[i];
-	
-	for (unsigned int i = 0; i < samplerStates.size(); i++)
-		delete samplerStates[i];
-
-	// Clean up tables
-	varTable.clear();
-	cbTable.clear();
-	samplerTable.clear();
-	textureTable.clear();
+	// Clean up tables, which pointed into the arena
+	constantBufferCount = 0;
+	variableCount = 0;
+	shaderResourceViewCount = 0;
+	samplerCount = 0;
+	constantBuffers = 0;
+	variables = 0;
+	shaderResourceViews = 0;
+	samplerStates = 0;
+	cbTable = 0;
+	varTable = 0;
+	textureTable = 0;
+	samplerTable = 0;
 }
 
 // --------------------------------------------------------
@@ -80,55 +102,82 @@ void ISimpleShader::CleanUp()
 // --------------------------------------------------------
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
-	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, shaderBlob.GetAddressOf());
+	SimpleShaderFile file;
+	ReadShaderFile(shaderFile, file);
+	return LoadShader(file);
+}
+
+// --------------------------------------------------------
+// Reads a compiled shader and its reflection data without
+// creating anything, so it's safe to call from worker
+// threads (to read several shaders at once) before the
+// shaders themselves are created.
+//
+// The reflection data comes from the cache file next to the
+// shader (shaderFile + ".refl") if that was made from the
+// same bytecode.  Otherwise the shader is reflected and the
+// cache file is rewritten.
+//
+// Returns false if the file couldn't be read or reflected
+// --------------------------------------------------------
+bool ISimpleShader::ReadShaderFile(LPCWSTR shaderFile, SimpleShaderFile& fileOut)
+{
+	fileOut.Path = shaderFile;
+	fileOut.ReflectionCached = false;
+
+	HRESULT hr = D3DReadFileToBlob(shaderFile, fileOut.Blob.ReleaseAndGetAddressOf());
 	if (hr != S_OK)
 	{
-		if (ReportErrors)
-		{
-			LogError("SimpleShader::LoadShaderFile() - Error loading file '");
-			LogW(shaderFile);
-			LogError("'. Ensure this file exists and is spelled correctly.\n");
-		}
-
+		fileOut.Blob.Reset();
 		return false;
 	}
 
-	// Create the shader - Calls an overloaded version of this abstract
-	// method in the appropriate child class
-	shaderValid = CreateShader(shaderBlob);
-	if (!shaderValid)
+	unsigned long long bytecodeHash = HashShaderBytecode(
+		fileOut.Blob->GetBufferPointer(),
+		fileOut.Blob->GetBufferSize());
+	std::wstring cacheFile = fileOut.Path + L".refl";
+
+	if (UseReflectionCache && LoadShaderReflection(cacheFile, bytecodeHash, fileOut.Reflection))
 	{
-		if (ReportErrors)
-		{
-			LogError("SimpleShader::LoadShaderFile() - Error creating shader from file '");
-			LogW(shaderFile);
-			LogError("'. Ensure the type of shader (vertex, pixel, etc.) matches the SimpleShader type (SimpleVertexShader, SimplePixelShader, etc.) you're using.\n");
-		}
+		fileOut.ReflectionCached = true;
+		return true;
+	}
 
+	if (!ReflectShader(fileOut.Blob.Get(), fileOut.Reflection))
 		return false;
-	}
 
+	// A read-only folder just means no cache next time
+	if (UseReflectionCache)
+		SaveShaderReflection(cacheFile, bytecodeHash, fileOut.Reflection);
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Gathers everything SimpleShader needs from a compiled
+// shader's reflection interface
+// --------------------------------------------------------
+bool ISimpleShader::ReflectShader(ID3DBlob* shaderBlob, ShaderReflectionData& reflectionOut)
+{
 	// Set up shader reflection to get information about
 	// this shader and its variables,  buffers, etc.
 	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
+	HRESULT hr = D3DReflect(
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		IID_ID3D11ShaderReflection,
 		(void**)refl.GetAddressOf());
+	if (FAILED(hr))
+		return false;
 	
 	// Get the description of the shader
 	D3D11_SHADER_DESC shaderDesc;
 	refl->GetDesc(&shaderDesc);
 
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
+	reflectionOut = ShaderReflectionData();
+
 	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
+	for (unsigned int r = 0; r < shaderDesc.BoundResources; r++)
 	{
 		// Get this resource's description
 		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
@@ -139,33 +188,17 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		{
 		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
 		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
+			reflectionOut.ShaderResourceViews.push_back({ SimpleShaderHash(resourceDesc.Name), resourceDesc.BindPoint });
 			break;
 
 		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
+			reflectionOut.Samplers.push_back({ SimpleShaderHash(resourceDesc.Name), resourceDesc.BindPoint });
 			break;
 		}
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
 	{
 		// Get this buffer
 		ID3D11ShaderReflectionConstantBuffer* cb =
@@ -175,57 +208,229 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		cb->GetDesc(&bufferDesc);
 
-		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
 		// Get the description of the resource binding, so
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+		ShaderReflectionBuffer buffer;
+		buffer.Name = bufferDesc.Name;
+		buffer.Type = bufferDesc.Type;
+		buffer.BindPoint = bindDesc.BindPoint;
+		buffer.Size = bufferDesc.Size;
+		buffer.FirstVariable = (unsigned int)reflectionOut.Variables.size();
+		buffer.VariableCount = bufferDesc.Variables;
+		reflectionOut.ConstantBuffers.push_back(buffer);
+
+		// Loop through all variables in this buffer
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			// Get the description of the variable
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
+
+			reflectionOut.Variables.push_back({ SimpleShaderHash(varDesc.Name), varDesc.StartOffset, varDesc.Size });
+		}
+	}
+
+	// Vertex shaders also need their inputs, for building an input layout
+	if (D3D11_SHVER_GET_TYPE(shaderDesc.Version) != D3D11_SHVER_VERTEX_SHADER)
+		return true;
+
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		ShaderReflectionInputElement element;
+		element.SemanticName = paramDesc.SemanticName;
+		element.SemanticIndex = paramDesc.SemanticIndex;
+
+		// Check the semantic name for "_PER_INSTANCE"
+		std::string perInstanceStr = "_PER_INSTANCE";
+		int lenDiff = (int)element.SemanticName.size() - (int)perInstanceStr.size();
+		element.PerInstance =
+			lenDiff >= 0 &&
+			element.SemanticName.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+
+		// Determine DXGI format
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		if (paramDesc.Mask == 1)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 3)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 7)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 15)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32A32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32A32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+		element.Format = format;
+
+		reflectionOut.InputElements.push_back(element);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Creates the shader from a file read with ReadShaderFile()
+// and builds the variable table from its reflection data
+//
+// Returns true if shader is loaded properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShader(const SimpleShaderFile& file)
+{
+	// Ensure the file was actually read
+	if (!file.Blob)
+	{
+		if (ReportErrors)
+		{
+			LogError("SimpleShader::LoadShaderFile() - Error loading file '");
+			LogW(file.Path);
+			LogError("'. Ensure this file exists and is spelled correctly.\n");
+		}
+
+		return false;
+	}
+
+	// Create the shader - Calls an overloaded version of this abstract
+	// method in the appropriate child class
+	shaderBlob = file.Blob;
+	shaderValid = CreateShader(shaderBlob, file.Reflection);
+	if (!shaderValid)
+	{
+		if (ReportErrors)
+		{
+			LogError("SimpleShader::LoadShaderFile() - Error creating shader from file '");
+			LogW(file.Path);
+			LogError("'. Ensure the type of shader (vertex, pixel, etc.) matches the SimpleShader type (SimpleVertexShader, SimplePixelShader, etc.) you're using.\n");
+		}
+
+		return false;
+	}
+
+	const ShaderReflectionData& reflection = file.Reflection;
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
+	variableCount = (unsigned int)reflection.Variables.size();
+	shaderResourceViewCount = (unsigned int)reflection.ShaderResourceViews.size();
+	samplerCount = (unsigned int)reflection.Samplers.size();
+
+	size_t localDataSize = 0;
+	for (const ShaderReflectionBuffer& buffer : reflection.ConstantBuffers)
+	{
+		localDataSize += AlignArenaOffset(buffer.Size, 16);
+	}
+
+	// Lay out the arena:
+	//  [constant buffers][variables][SRVs][samplers][lookup tables][local constant data]
+	// Everything a draw touches (the tables, the bind points and the
+	// data being copied) ends up in a handful of neighboring cache lines
+	size_t variableOffset = AlignArenaOffset(sizeof(SimpleConstantBuffer) * constantBufferCount, alignof(SimpleShaderVariable));
+	size_t srvOffset = AlignArenaOffset(variableOffset + sizeof(SimpleShaderVariable) * variableCount, alignof(SimpleSRV));
+	size_t samplerOffset = AlignArenaOffset(srvOffset + sizeof(SimpleSRV) * shaderResourceViewCount, alignof(SimpleSampler));
+	size_t tableOffset = AlignArenaOffset(samplerOffset + sizeof(SimpleSampler) * samplerCount, alignof(SimpleShaderLookup));
+	size_t tableCount = (size_t)constantBufferCount + variableCount + shaderResourceViewCount + samplerCount;
+	size_t localDataOffset = AlignArenaOffset(tableOffset + sizeof(SimpleShaderLookup) * tableCount, 16);
+
+	arenaSize = localDataOffset + localDataSize;
+	arena = new unsigned char[arenaSize];
+	ZeroMemory(arena, arenaSize);
+
+	constantBuffers = reinterpret_cast<SimpleConstantBuffer*>(arena);
+	variables = reinterpret_cast<SimpleShaderVariable*>(arena + variableOffset);
+	shaderResourceViews = reinterpret_cast<SimpleSRV*>(arena + srvOffset);
+	samplerStates = reinterpret_cast<SimpleSampler*>(arena + samplerOffset);
+	cbTable = reinterpret_cast<SimpleShaderLookup*>(arena + tableOffset);
+	varTable = cbTable + constantBufferCount;
+	textureTable = varTable + variableCount;
+	samplerTable = textureTable + shaderResourceViewCount;
+
+	// SRVs and samplers
+	for (unsigned int r = 0; r < shaderResourceViewCount; r++)
+	{
+		shaderResourceViews[r].BindIndex = reflection.ShaderResourceViews[r].BindPoint;	// Shader bind point
+		shaderResourceViews[r].Index = r;												// Raw index
+		textureTable[r] = { reflection.ShaderResourceViews[r].NameHash, r };
+	}
+
+	for (unsigned int s = 0; s < samplerCount; s++)
+	{
+		samplerStates[s].BindIndex = reflection.Samplers[s].BindPoint;
+		samplerStates[s].Index = s;
+		samplerTable[s] = { reflection.Samplers[s].NameHash, s };
+	}
+
+	// Loop through all constant buffers
+	size_t localDataUsed = 0;
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const ShaderReflectionBuffer& buffer = reflection.ConstantBuffers[b];
+
+		// The constant buffers aren't plain data, so they're constructed in place
+		SimpleConstantBuffer* cb = new (&constantBuffers[b]) SimpleConstantBuffer();
+
+		// Save the type, which we reference when setting these buffers
+		cb->Type = (D3D_CBUFFER_TYPE)buffer.Type;
 		
-		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
+		// Set up the buffer and put its index in the table
+		cb->BindIndex = buffer.BindPoint;
+		cb->Name = buffer.Name;
+		cbTable[b] = { SimpleShaderHash(buffer.Name), b };
 
 		// Create this constant buffer
 		D3D11_BUFFER_DESC newBuffDesc = {};
 		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = ((bufferDesc.Size + 15) / 16) * 16; // Quick and dirty 16-byte alignment using integer division
+		newBuffDesc.ByteWidth = ((buffer.Size + 15) / 16) * 16; // Quick and dirty 16-byte alignment using integer division
 		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 		newBuffDesc.CPUAccessFlags = 0;
 		newBuffDesc.MiscFlags = 0;
 		newBuffDesc.StructureByteStride = 0;
-		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
+		device->CreateBuffer(&newBuffDesc, 0, cb->ConstantBuffer.GetAddressOf());
 
-		// Set up the data buffer for this constant buffer
-		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		// Point this buffer at its (already zeroed) space in the arena
+		cb->Size = buffer.Size;
+		cb->LocalDataBuffer = arena + localDataOffset + localDataUsed;
+		localDataUsed += AlignArenaOffset(buffer.Size, 16);
 
-		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		// Its variables are a contiguous run of the flat table
+		cb->FirstVariable = buffer.FirstVariable;
+		cb->VariableCount = buffer.VariableCount;
+		for (unsigned int v = buffer.FirstVariable; v < buffer.FirstVariable + buffer.VariableCount; v++)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
-
-			// Create the variable struct
-			SimpleShaderVariable varStruct = {};
-			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
-
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
-			constantBuffers[b].Variables.push_back(varStruct);
+			variables[v].ConstantBufferIndex = b;
+			variables[v].ByteOffset = reflection.Variables[v].ByteOffset;
+			variables[v].Size = reflection.Variables[v].Size;
+			varTable[v] = { reflection.Variables[v].NameHash, v };
+		}
+	}
+
+	// Sort the tables by hash for binary searching
+	SortLookupTable(cbTable, constantBufferCount);
+	SortLookupTable(varTable, variableCount);
+	SortLookupTable(textureTable, shaderResourceViewCount);
+	SortLookupTable(samplerTable, samplerCount);
+
+	// A hash collision would shadow a variable, so report it
+	for (unsigned int v = 1; v < variableCount && ReportWarnings; v++)
+	{
+		if (varTable[v].Hash == varTable[v - 1].Hash)
+		{
+			LogWarning("SimpleShader::LoadShaderFile() - Two shader variables have the same name hash, and one of them can't be looked up.\n");
 		}
 	}
 
@@ -240,18 +445,17 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // name - the name of the variable to look for
 // size - the size of the variable (for verification), or -1 to bypass
 // --------------------------------------------------------
-SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
+SimpleShaderVariable* ISimpleShader::FindVariable(std::string_view name, int size)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
-		varTable.find(name);
+	int index = FindLookup(varTable, variableCount, SimpleShaderHash(name));
 
 	// Did we find the key?
-	if (result == varTable.end())
+	if (index == -1)
 		return 0;
 
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	// Grab the result from the flat table
+	SimpleShaderVariable* var = &variables[index];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -264,18 +468,25 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 // --------------------------------------------------------
 // Helper for looking up a constant buffer by name
 // --------------------------------------------------------
-SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
+SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string_view name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
-		cbTable.find(name);
+	int index = FindLookup(cbTable, constantBufferCount, SimpleShaderHash(name));
 
 	// Did we find the key?
-	if (result == cbTable.end())
+	if (index == -1)
 		return 0;
 
 	// Success
-	return result->second;
+	return &constantBuffers[index];
+}
+
+// --------------------------------------------------------
+// Rounds an offset into the arena up to the given alignment
+// --------------------------------------------------------
+size_t ISimpleShader::AlignArenaOffset(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
 }
 
 // --------------------------------------------------------
@@ -335,6 +546,71 @@ void ISimpleShader::SetShader()
 	SetShaderAndCBs();
 }
 
+// --------------------------------------------------------
+// Copies a constant buffer's local data to the GPU, if the
+// GPU's copy is out of date
+//
+// - Unchanged data that's still on the GPU isn't copied at all
+// - The first change in a frame goes to the buffer's own
+//   resource, so data that rarely changes stays put
+// - Further changes in the same frame go to the shared ring
+//   (when there is one), which avoids the driver renaming
+//   the buffer's resource once per draw
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer* cb)
+{
+	ConstantBytesRequested += cb->Size;
+
+	// Ring data only lives for the frame it was written in
+	bool ringExpired = cb->InRing && !(ConstantRing && ConstantRing->IsResident(cb->RingAllocation));
+	if (!cb->Dirty && !ringExpired)
+		return;
+
+	unsigned long long frame = ConstantRing ? ConstantRing->GetFrame() : 0;
+
+	bool wasInRing = cb->InRing;
+	cb->InRing =
+		cb->Dirty &&
+		ConstantRing &&
+		cb->UploadFrame == frame &&
+		ConstantRing->Allocate(cb->LocalDataBuffer, cb->Size, cb->RingAllocation);
+
+	if (!cb->InRing)
+	{
+		deviceContext->UpdateSubresource(
+			cb->ConstantBuffer.Get(), 0, 0,
+			cb->LocalDataBuffer, 0, 0);
+	}
+
+	ConstantBytesUploaded += cb->Size;
+	cb->UploadFrame = frame;
+	cb->Dirty = false;
+
+	// A new ring window, or moving from the ring back to the buffer's
+	// own resource, changes what has to be bound.  SetShaderAndCBs()
+	// only binds when the shader is set, so a shader that's already
+	// set (and copied to again between draws) is rebound here.
+	if ((cb->InRing || wasInRing) && IsShaderActive())
+		BindConstantBuffer(cb);
+}
+
+// --------------------------------------------------------
+// Gets the ring buffer binding for a constant buffer whose
+// data currently lives in the ring.  Returns the D3D11.1
+// context to bind it with, or null to bind the buffer's own
+// resource as usual.
+// --------------------------------------------------------
+ID3D11DeviceContext1* ISimpleShader::GetRingBinding(const SimpleConstantBuffer* cb, ID3D11Buffer** buffer, UINT* firstConstant, UINT* numConstants)
+{
+	if (!cb->InRing || !ConstantRing)
+		return 0;
+
+	*buffer = ConstantRing->GetBuffer();
+	*firstConstant = cb->RingAllocation.FirstConstant;
+	*numConstants = cb->RingAllocation.NumConstants;
+	return ConstantRing->GetContext1();
+}
+
 // --------------------------------------------------------
 // Copies the relevant data to the all of this 
 // shader's constant buffers.  To just copy one
@@ -345,13 +621,10 @@ void ISimpleShader::CopyAllBufferData()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy any that changed
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		UploadBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -380,9 +653,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -392,7 +663,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 //              Useful for updating more frequently-changing
 //              variables without having to re-copy all buffers.
 // --------------------------------------------------------
-void ISimpleShader::CopyBufferData(std::string bufferName)
+void ISimpleShader::CopyBufferData(std::string_view bufferName)
 {
 	// Ensure the shader is valid
 	if (!shaderValid) return;
@@ -402,9 +673,7 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
 }
 
 
@@ -417,7 +686,7 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 //
 // Returns true if data is copied, false if variable doesn't exist
 // --------------------------------------------------------
-bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
+bool ISimpleShader::SetData(std::string_view name, const void* data, unsigned int size)
 {
 	// Look for the variable and verify
 	SimpleShaderVariable* var = FindVariable(name, -1);
@@ -426,7 +695,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleShader::SetData() - Shader variable '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' not found. Ensure the name is spelled correctly and that it exists in a constant buffer in the shader.\n");
 		}
 		return false;
@@ -439,26 +708,185 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleShader::SetData() - Shader variable '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' is smaller than the size of the data being set. Ensure the variable is large enough for the specified data.\n");
 		}
 		return false;
 	}
 
 	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	CopyVariableData(var, data, size);
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Copies data into a variable's spot in the local data buffer,
+// noting whether it actually changed so unchanged buffers
+// aren't re-uploaded
+// --------------------------------------------------------
+void ISimpleShader::CopyVariableData(const SimpleShaderVariable* var, const void* data, unsigned int size)
+{
+	CopyLocalData(&constantBuffers[var->ConstantBufferIndex], var->ByteOffset, data, size);
+}
+
+// --------------------------------------------------------
+// Copies data into a constant buffer's local data buffer,
+// marking the buffer dirty only if something changed
+// --------------------------------------------------------
+void ISimpleShader::CopyLocalData(SimpleConstantBuffer* cb, unsigned int byteOffset, const void* data, unsigned int size)
+{
+	if (memcmp(cb->LocalDataBuffer + byteOffset, data, size) != 0)
+	{
+		memcpy(cb->LocalDataBuffer + byteOffset, data, size);
+		cb->Dirty = true;
+	}
+}
+
+// --------------------------------------------------------
+// Sets an entire constant buffer from one block of data,
+// such as a struct from ShaderConstants.h
+//
+// index - The index of the buffer (see GetBufferIndex())
+// data  - The data to copy, laid out like the cbuffer
+// size  - The size of the data, which must cover the same
+//         number of 16 byte registers as the buffer
+//
+// Returns true if data is copied, false if the buffer doesn't
+// exist or the size doesn't match
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferData(unsigned int index, const void* data, unsigned int size)
+{
+	if (index >= constantBufferCount)
+		return false;
+
+	// Trailing padding aside, a different size means the C++ struct
+	// and the cbuffer don't agree on the layout
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if ((size + 15) / 16 != (cb->Size + 15) / 16)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::SetBufferData() - Constant buffer '");
+			Log(cb->Name);
+			LogWarning("' is " + std::to_string(cb->Size) + " bytes, but the data being set is " + std::to_string(size) + " bytes. Ensure the struct matches the cbuffer (or regenerate ShaderConstants.h).\n");
+		}
+		return false;
+	}
+
+	CopyLocalData(cb, 0, data, size < cb->Size ? size : cb->Size);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets an entire constant buffer by name
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferData(std::string_view bufferName, const void* data, unsigned int size)
+{
+	int index = GetBufferIndex(bufferName);
+	if (index == -1)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::SetBufferData() - Constant buffer '");
+			Log(std::string(bufferName));
+			LogWarning("' not found. Ensure the name is spelled correctly and that it exists in the shader.\n");
+		}
+		return false;
+	}
+
+	return SetBufferData((unsigned int)index, data, size);
+}
+
+// --------------------------------------------------------
+// Looks up a variable once, for use with the handle-based
+// setters.  The handle is only valid for this shader.
+//
+// Returns an invalid handle if the variable doesn't exist
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetVariableHandle(std::string_view name)
+{
+	return GetVariableHandle(SimpleShaderHash(name));
+}
+
+// --------------------------------------------------------
+// Looks up a variable by a name hash from SimpleShaderHash(),
+// which can be computed at compile time
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetVariableHandle(unsigned long long nameHash)
+{
+	SimpleShaderHandle handle;
+
+	int index = FindLookup(varTable, variableCount, nameHash);
+	if (index != -1)
+		handle.Index = (unsigned int)index;
+
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable through a handle with arbitrary data of the
+// specified size - no lookups, just an index into the table
+//
+// Returns true if data is copied, false if the handle is invalid
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleShaderHandle handle, const void* data, unsigned int size)
+{
+	// Invalid handles come from variables the shader doesn't have
+	if (!handle.IsValid() || handle.Index >= variableCount)
+		return false;
+
+	const SimpleShaderVariable* var = &variables[handle.Index];
+	if (size > var->Size)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::SetData() - Shader variable with handle ");
+			Log(std::to_string(handle.Index));
+			LogWarning(" is smaller than the size of the data being set. Ensure the variable is large enough for the specified data.\n");
+		}
+		return false;
+	}
+
+	CopyVariableData(var, data, size);
+	return true;
+}
+
+bool ISimpleShader::SetInt(SimpleShaderHandle handle, int data)
+{
+	return this->SetData(handle, &data, sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(SimpleShaderHandle handle, float data)
+{
+	return this->SetData(handle, &data, sizeof(float));
+}
+
+bool ISimpleShader::SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 16);
+}
+
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
-bool ISimpleShader::SetInt(std::string name, int data)
+bool ISimpleShader::SetInt(std::string_view name, int data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(int));
 }
@@ -466,7 +894,7 @@ bool ISimpleShader::SetInt(std::string name, int data)
 // --------------------------------------------------------
 // Sets a FLOAT variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat(std::string name, float data)
+bool ISimpleShader::SetFloat(std::string_view name, float data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(float));
 }
@@ -474,7 +902,7 @@ bool ISimpleShader::SetFloat(std::string name, float data)
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const float data[2])
+bool ISimpleShader::SetFloat2(std::string_view name, const float data[2])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 2);
 }
@@ -482,7 +910,7 @@ bool ISimpleShader::SetFloat2(std::string name, const float data[2])
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
+bool ISimpleShader::SetFloat2(std::string_view name, const DirectX::XMFLOAT2 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 2);
 }
@@ -490,7 +918,7 @@ bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const float data[3])
+bool ISimpleShader::SetFloat3(std::string_view name, const float data[3])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 3);
 }
@@ -498,7 +926,7 @@ bool ISimpleShader::SetFloat3(std::string name, const float data[3])
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
+bool ISimpleShader::SetFloat3(std::string_view name, const DirectX::XMFLOAT3 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 3);
 }
@@ -506,7 +934,7 @@ bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const float data[4])
+bool ISimpleShader::SetFloat4(std::string_view name, const float data[4])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 4);
 }
@@ -514,7 +942,7 @@ bool ISimpleShader::SetFloat4(std::string name, const float data[4])
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
+bool ISimpleShader::SetFloat4(std::string_view name, const DirectX::XMFLOAT4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 4);
 }
@@ -522,7 +950,7 @@ bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
+bool ISimpleShader::SetMatrix4x4(std::string_view name, const float data[16])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 16);
 }
@@ -530,7 +958,7 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data)
+bool ISimpleShader::SetMatrix4x4(std::string_view name, const DirectX::XMFLOAT4X4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
@@ -539,7 +967,7 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
 // --------------------------------------------------------
-bool ISimpleShader::HasVariable(std::string name)
+bool ISimpleShader::HasVariable(std::string_view name)
 {
 	return FindVariable(name, -1) != 0;
 }
@@ -547,7 +975,7 @@ bool ISimpleShader::HasVariable(std::string name)
 // --------------------------------------------------------
 // Determines if the shader contains the specified SRV
 // --------------------------------------------------------
-bool ISimpleShader::HasShaderResourceView(std::string name)
+bool ISimpleShader::HasShaderResourceView(std::string_view name)
 {
 	return GetShaderResourceViewInfo(name) != 0;
 }
@@ -555,7 +983,7 @@ bool ISimpleShader::HasShaderResourceView(std::string name)
 // --------------------------------------------------------
 // Determines if the shader contains the specified sampler
 // --------------------------------------------------------
-bool ISimpleShader::HasSamplerState(std::string name)
+bool ISimpleShader::HasSamplerState(std::string_view name)
 {
 	return GetSamplerInfo(name) != 0;
 }
@@ -563,7 +991,7 @@ bool ISimpleShader::HasSamplerState(std::string name)
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
-const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
+const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string_view name)
 {
 	return FindVariable(name, -1);
 }
@@ -573,18 +1001,17 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 //
 // name - the name of the SRV
 // --------------------------------------------------------
-const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
+const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string_view name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleSRV*>::iterator result =
-		textureTable.find(name);
+	int index = FindLookup(textureTable, shaderResourceViewCount, SimpleShaderHash(name));
 
 	// Did we find the key?
-	if (result == textureTable.end())
+	if (index == -1)
 		return 0;
 
 	// Success
-	return result->second;
+	return &shaderResourceViews[index];
 }
 
 
@@ -596,10 +1023,10 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
 const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 {
 	// Valid index?
-	if (index >= shaderResourceViews.size()) return 0;
+	if (index >= shaderResourceViewCount) return 0;
 
 	// Grab the bind index
-	return shaderResourceViews[index];
+	return &shaderResourceViews[index];
 }
 
 
@@ -608,18 +1035,17 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 // 
 // name - the name of the sampler
 // --------------------------------------------------------
-const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
+const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string_view name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleSampler*>::iterator result =
-		samplerTable.find(name);
+	int index = FindLookup(samplerTable, samplerCount, SimpleShaderHash(name));
 
 	// Did we find the key?
-	if (result == samplerTable.end())
+	if (index == -1)
 		return 0;
 
 	// Success
-	return result->second;
+	return &samplerStates[index];
 }
 
 // --------------------------------------------------------
@@ -630,10 +1056,10 @@ const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
 const SimpleSampler* ISimpleShader::GetSamplerInfo(unsigned int index)
 {
 	// Valid index?
-	if (index >= samplerStates.size()) return 0;
+	if (index >= samplerCount) return 0;
 
 	// Grab the bind index
-	return samplerStates[index];
+	return &samplerStates[index];
 }
 
 
@@ -657,11 +1083,22 @@ unsigned int ISimpleShader::GetBufferSize(unsigned int index)
 	return constantBuffers[index].Size;
 }
 
+// --------------------------------------------------------
+// Gets the index of a constant buffer by name, or -1
+// --------------------------------------------------------
+int ISimpleShader::GetBufferIndex(std::string_view name)
+{
+	SimpleConstantBuffer* cb = FindConstantBuffer(name);
+	if (!cb) return -1;
+
+	return (int)(cb - constantBuffers);
+}
+
 // --------------------------------------------------------
 // Gets info about a particular constant buffer 
 // by name, if it exists
 // --------------------------------------------------------
-const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(std::string name)
+const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(std::string_view name)
 {
 	return FindConstantBuffer(name);
 }
@@ -721,6 +1158,21 @@ SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> devi
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor overload for a shader that's already been read
+// with ReadShaderFile() (possibly on another thread)
+// --------------------------------------------------------
+SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const SimpleShaderFile& shaderFile)
+	: ISimpleShader(device, context)
+{
+	// Ensure we set to zero to successfully trigger
+	// the Input Layout creation during LoadShader()
+	this->perInstanceCompatible = false;
+
+	// Create the shader from the data already read
+	this->LoadShader(shaderFile);
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -744,7 +1196,7 @@ void SimpleVertexShader::CleanUp()
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -767,48 +1219,26 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
-	// matches what the vertex shader expects.  Code adapted from:
+	// reflected inputs to create an input layout that matches what
+	// the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
 
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
+	// Read input layout description from the reflection data
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (const ShaderReflectionInputElement& element : reflection.InputElements)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
-		// Check the semantic name for "_PER_INSTANCE"
-		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
-		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
-		bool isPerInstance = 
-			lenDiff >= 0 &&
-			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
-
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
-		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
+		elementDesc.SemanticName = element.SemanticName.c_str();
+		elementDesc.SemanticIndex = element.SemanticIndex;
+		elementDesc.Format = (DXGI_FORMAT)element.Format;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 		elementDesc.InstanceDataStepRate = 0;
 
 		// Replace anything affected by "per instance" data
-		if (isPerInstance)
+		if (element.PerInstance)
 		{
 			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
 			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
@@ -817,32 +1247,6 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 			perInstanceCompatible = true;
 		}
 
-		// Determine DXGI format
-		if (paramDesc.Mask == 1)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 3)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 7)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 15)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		}
-
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
@@ -875,16 +1279,51 @@ void SimpleVertexShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to the vertex shader stage -
+// either a window of the shared ring or the buffer's own
+// resource.  Buffers that aren't true constant buffers
+// are skipped.
+// --------------------------------------------------------
+void SimpleVertexShader::BindConstantBuffer(const SimpleConstantBuffer* cb)
+{
+	if (cb->Type != D3D11_CT_CBUFFER)
+		return;
 
-		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+	ID3D11Buffer* ringBuffer = 0;
+	UINT firstConstant = 0;
+	UINT numConstants = 0;
+	ID3D11DeviceContext1* context1 = GetRingBinding(cb, &ringBuffer, &firstConstant, &numConstants);
+	if (context1)
+	{
+		context1->VSSetConstantBuffers1(
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			&ringBuffer,
+			&firstConstant,
+			&numConstants);
+		return;
 	}
+
+	deviceContext->VSSetConstantBuffers(
+		cb->BindIndex,
+		1,
+		cb->ConstantBuffer.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Whether this is the shader currently set on the vertex
+// shader stage
+// --------------------------------------------------------
+bool SimpleVertexShader::IsShaderActive()
+{
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> current;
+	deviceContext->VSGetShader(current.GetAddressOf(), 0, 0);
+	return current.Get() == shader.Get();
 }
 
 // --------------------------------------------------------
@@ -895,7 +1334,7 @@ void SimpleVertexShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleVertexShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -904,7 +1343,7 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleVertexShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -925,7 +1364,7 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleVertexShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -934,7 +1373,7 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleVertexShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -962,6 +1401,17 @@ SimplePixelShader::SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor overload for a shader that's already been read
+// with ReadShaderFile() (possibly on another thread)
+// --------------------------------------------------------
+SimplePixelShader::SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const SimpleShaderFile& shaderFile)
+	: ISimpleShader(device, context)
+{
+	// Create the shader from the data already read
+	this->LoadShader(shaderFile);
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -985,7 +1435,7 @@ void SimplePixelShader::CleanUp()
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimplePixelShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1017,16 +1467,51 @@ void SimplePixelShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to the pixel shader stage -
+// either a window of the shared ring or the buffer's own
+// resource.  Buffers that aren't true constant buffers
+// are skipped.
+// --------------------------------------------------------
+void SimplePixelShader::BindConstantBuffer(const SimpleConstantBuffer* cb)
+{
+	if (cb->Type != D3D11_CT_CBUFFER)
+		return;
 
-		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+	ID3D11Buffer* ringBuffer = 0;
+	UINT firstConstant = 0;
+	UINT numConstants = 0;
+	ID3D11DeviceContext1* context1 = GetRingBinding(cb, &ringBuffer, &firstConstant, &numConstants);
+	if (context1)
+	{
+		context1->PSSetConstantBuffers1(
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			&ringBuffer,
+			&firstConstant,
+			&numConstants);
+		return;
 	}
+
+	deviceContext->PSSetConstantBuffers(
+		cb->BindIndex,
+		1,
+		cb->ConstantBuffer.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Whether this is the shader currently set on the pixel
+// shader stage
+// --------------------------------------------------------
+bool SimplePixelShader::IsShaderActive()
+{
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> current;
+	deviceContext->PSGetShader(current.GetAddressOf(), 0, 0);
+	return current.Get() == shader.Get();
 }
 
 // --------------------------------------------------------
@@ -1037,7 +1522,7 @@ void SimplePixelShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimplePixelShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1046,7 +1531,7 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 		if (ReportWarnings)
 		{
 			LogWarning("SimplePixelShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1067,7 +1552,7 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimplePixelShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1076,7 +1561,7 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 		if (ReportWarnings)
 		{
 			LogWarning("SimplePixelShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1129,7 +1614,7 @@ void SimpleDomainShader::CleanUp()
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleDomainShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1161,16 +1646,51 @@ void SimpleDomainShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to the domain shader stage -
+// either a window of the shared ring or the buffer's own
+// resource.  Buffers that aren't true constant buffers
+// are skipped.
+// --------------------------------------------------------
+void SimpleDomainShader::BindConstantBuffer(const SimpleConstantBuffer* cb)
+{
+	if (cb->Type != D3D11_CT_CBUFFER)
+		return;
 
-		// This is a real constant buffer, so set it
-		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+	ID3D11Buffer* ringBuffer = 0;
+	UINT firstConstant = 0;
+	UINT numConstants = 0;
+	ID3D11DeviceContext1* context1 = GetRingBinding(cb, &ringBuffer, &firstConstant, &numConstants);
+	if (context1)
+	{
+		context1->DSSetConstantBuffers1(
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			&ringBuffer,
+			&firstConstant,
+			&numConstants);
+		return;
 	}
+
+	deviceContext->DSSetConstantBuffers(
+		cb->BindIndex,
+		1,
+		cb->ConstantBuffer.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Whether this is the shader currently set on the domain
+// shader stage
+// --------------------------------------------------------
+bool SimpleDomainShader::IsShaderActive()
+{
+	Microsoft::WRL::ComPtr<ID3D11DomainShader> current;
+	deviceContext->DSGetShader(current.GetAddressOf(), 0, 0);
+	return current.Get() == shader.Get();
 }
 
 // --------------------------------------------------------
@@ -1181,7 +1701,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleDomainShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1190,7 +1710,7 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleDomainShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1211,7 +1731,7 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleDomainShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1220,7 +1740,7 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleDomainShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1272,7 +1792,7 @@ void SimpleHullShader::CleanUp()
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleHullShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1304,16 +1824,51 @@ void SimpleHullShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
 
-		// This is a real constant buffer, so set it
-		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+// --------------------------------------------------------
+// Binds one constant buffer to the hull shader stage -
+// either a window of the shared ring or the buffer's own
+// resource.  Buffers that aren't true constant buffers
+// are skipped.
+// --------------------------------------------------------
+void SimpleHullShader::BindConstantBuffer(const SimpleConstantBuffer* cb)
+{
+	if (cb->Type != D3D11_CT_CBUFFER)
+		return;
+
+	ID3D11Buffer* ringBuffer = 0;
+	UINT firstConstant = 0;
+	UINT numConstants = 0;
+	ID3D11DeviceContext1* context1 = GetRingBinding(cb, &ringBuffer, &firstConstant, &numConstants);
+	if (context1)
+	{
+		context1->HSSetConstantBuffers1(
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			&ringBuffer,
+			&firstConstant,
+			&numConstants);
+		return;
 	}
+
+	deviceContext->HSSetConstantBuffers(
+		cb->BindIndex,
+		1,
+		cb->ConstantBuffer.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Whether this is the shader currently set on the hull
+// shader stage
+// --------------------------------------------------------
+bool SimpleHullShader::IsShaderActive()
+{
+	Microsoft::WRL::ComPtr<ID3D11HullShader> current;
+	deviceContext->HSGetShader(current.GetAddressOf(), 0, 0);
+	return current.Get() == shader.Get();
 }
 
 // --------------------------------------------------------
@@ -1324,7 +1879,7 @@ void SimpleHullShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleHullShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1333,7 +1888,7 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleHullShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1354,7 +1909,7 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleHullShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1363,7 +1918,7 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleHullShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1420,7 +1975,7 @@ void SimpleGeometryShader::CleanUp()
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleGeometryShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1578,16 +2133,51 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
 
-		// This is a real constant buffer, so set it
-		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+// --------------------------------------------------------
+// Binds one constant buffer to the geometry shader stage -
+// either a window of the shared ring or the buffer's own
+// resource.  Buffers that aren't true constant buffers
+// are skipped.
+// --------------------------------------------------------
+void SimpleGeometryShader::BindConstantBuffer(const SimpleConstantBuffer* cb)
+{
+	if (cb->Type != D3D11_CT_CBUFFER)
+		return;
+
+	ID3D11Buffer* ringBuffer = 0;
+	UINT firstConstant = 0;
+	UINT numConstants = 0;
+	ID3D11DeviceContext1* context1 = GetRingBinding(cb, &ringBuffer, &firstConstant, &numConstants);
+	if (context1)
+	{
+		context1->GSSetConstantBuffers1(
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			&ringBuffer,
+			&firstConstant,
+			&numConstants);
+		return;
 	}
+
+	deviceContext->GSSetConstantBuffers(
+		cb->BindIndex,
+		1,
+		cb->ConstantBuffer.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Whether this is the shader currently set on the geometry
+// shader stage
+// --------------------------------------------------------
+bool SimpleGeometryShader::IsShaderActive()
+{
+	Microsoft::WRL::ComPtr<ID3D11GeometryShader> current;
+	deviceContext->GSGetShader(current.GetAddressOf(), 0, 0);
+	return current.Get() == shader.Get();
 }
 
 // --------------------------------------------------------
@@ -1598,7 +2188,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleGeometryShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1607,7 +2197,7 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleGeometryShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1628,7 +2218,7 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleGeometryShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1637,7 +2227,7 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::Com
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleGeometryShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1688,6 +2278,22 @@ SimpleComputeShader::SimpleComputeShader(Microsoft::WRL::ComPtr<ID3D11Device> de
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor overload for a shader that's already been read
+// with ReadShaderFile() (possibly on another thread)
+// --------------------------------------------------------
+SimpleComputeShader::SimpleComputeShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const SimpleShaderFile& shaderFile)
+	: ISimpleShader(device, context)
+{
+	this->threadsTotal = 0;
+	this->threadsX = 0;
+	this->threadsY = 0;
+	this->threadsZ = 0;
+
+	// Create the shader from the data already read
+	this->LoadShader(shaderFile);
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -1713,7 +2319,7 @@ void SimpleComputeShader::CleanUp()
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1765,10 +2371,12 @@ bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBl
 		case D3D_SIT_UAV_RWSTRUCTURED:
 		case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
 		case D3D_SIT_UAV_RWTYPED:
-			uavTable.insert(std::pair<std::string, unsigned int>(resourceDesc.Name, resourceDesc.BindPoint));
+			uavTable.push_back({ SimpleShaderHash(resourceDesc.Name), resourceDesc.BindPoint });
 		}
 	}
 
+	SortLookupTable(uavTable.data(), uavTable.size());
+
 	// All set
 	return true;
 }
@@ -1788,16 +2396,51 @@ void SimpleComputeShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
 
-		// This is a real constant buffer, so set it
-		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+// --------------------------------------------------------
+// Binds one constant buffer to the compute shader stage -
+// either a window of the shared ring or the buffer's own
+// resource.  Buffers that aren't true constant buffers
+// are skipped.
+// --------------------------------------------------------
+void SimpleComputeShader::BindConstantBuffer(const SimpleConstantBuffer* cb)
+{
+	if (cb->Type != D3D11_CT_CBUFFER)
+		return;
+
+	ID3D11Buffer* ringBuffer = 0;
+	UINT firstConstant = 0;
+	UINT numConstants = 0;
+	ID3D11DeviceContext1* context1 = GetRingBinding(cb, &ringBuffer, &firstConstant, &numConstants);
+	if (context1)
+	{
+		context1->CSSetConstantBuffers1(
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			&ringBuffer,
+			&firstConstant,
+			&numConstants);
+		return;
 	}
+
+	deviceContext->CSSetConstantBuffers(
+		cb->BindIndex,
+		1,
+		cb->ConstantBuffer.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Whether this is the shader currently set on the compute
+// shader stage
+// --------------------------------------------------------
+bool SimpleComputeShader::IsShaderActive()
+{
+	Microsoft::WRL::ComPtr<ID3D11ComputeShader> current;
+	deviceContext->CSGetShader(current.GetAddressOf(), 0, 0);
+	return current.Get() == shader.Get();
 }
 
 // --------------------------------------------------------
@@ -1856,7 +2499,7 @@ void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int
 // --------------------------------------------------------
 // Determines if this shader has the specified UAV
 // --------------------------------------------------------
-bool SimpleComputeShader::HasUnorderedAccessView(std::string name)
+bool SimpleComputeShader::HasUnorderedAccessView(std::string_view name)
 {
 	return GetUnorderedAccessViewIndex(name) != -1;
 }
@@ -1869,7 +2512,7 @@ bool SimpleComputeShader::HasUnorderedAccessView(std::string name)
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+bool SimpleComputeShader::SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1878,7 +2521,7 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleComputeShader::SetShaderResourceView() - SRV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1899,7 +2542,7 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+bool SimpleComputeShader::SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1908,7 +2551,7 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleComputeShader::SetSamplerState() - Sampler named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1930,7 +2573,7 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 //
 // Returns true if a UAV of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetUnorderedAccessView(std::string name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset)
+bool SimpleComputeShader::SetUnorderedAccessView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset)
 {
 	// Look for the variable and verify
 	unsigned int bindIndex = GetUnorderedAccessViewIndex(name);
@@ -1939,7 +2582,7 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, Microsoft::WR
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleComputeShader::SetUnorderedAccessView() - UAV named '");
-			Log(name);
+			Log(std::string(name));
 			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
 		}
 		return false;
@@ -1955,16 +2598,8 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, Microsoft::WR
 // --------------------------------------------------------
 // Gets the index of the specified UAV (or -1)
 // --------------------------------------------------------
-int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string name)
+int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string_view name)
 {
-	// Look for the key
-	std::unordered_map<std::string, unsigned int>::iterator result =
-		uavTable.find(name);
-
-	// Did we find the key?
-	if (result == uavTable.end())
-		return -1;
-
-	// Success
-	return result->second;
+	// Look for the key (-1 if it's not there)
+	return FindLookup(uavTable.data(), uavTable.size(), SimpleShaderHash(name));
 }
\ No newline at end of file
@@ -7,10 +7,26 @@
 #include <DirectXMath.h>
 #include <wrl/client.h>
 
-#include <unordered_map>
+#include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 
+#include "ConstantRingBuffer.h"
+#include "ShaderReflectionCache.h"
+#include "SimpleShaderLookup.h"
+
+
+// --------------------------------------------------------
+// An index into a shader's flat variable table. Resolve it
+// once with GetVariableHandle() and later sets skip the
+// name lookup entirely.
+// --------------------------------------------------------
+struct SimpleShaderHandle
+{
+	unsigned int Index = 0xFFFFFFFF;
+	bool IsValid() const { return Index != 0xFFFFFFFF; }
+};
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -35,8 +51,16 @@ struct SimpleConstantBuffer
 	unsigned int Size = 0;
 	unsigned int BindIndex = 0;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
-	unsigned char* LocalDataBuffer = 0;
-	std::vector<SimpleShaderVariable> Variables;
+	unsigned char* LocalDataBuffer = 0; // Points into the shader's arena
+	unsigned int FirstVariable = 0; // This buffer's run of the shader's variable table
+	unsigned int VariableCount = 0;
+
+	// Upload tracking: only changed data is copied, and data that changes
+	// more than once per frame goes to the shared ring buffer instead
+	bool Dirty = true;
+	bool InRing = false;
+	unsigned long long UploadFrame = ~0ull;
+	ConstantRingAllocation RingAllocation = {};
 };
 
 // --------------------------------------------------------
@@ -57,6 +81,18 @@ struct SimpleSampler
 	unsigned int BindIndex; // The register of the Sampler
 };
 
+// --------------------------------------------------------
+// A compiled shader and its reflection data, read ahead of
+// creating the shader - see ISimpleShader::ReadShaderFile()
+// --------------------------------------------------------
+struct SimpleShaderFile
+{
+	std::wstring Path;
+	Microsoft::WRL::ComPtr<ID3DBlob> Blob; // Null if the file couldn't be read
+	ShaderReflectionData Reflection;
+	bool ReflectionCached = false; // Came from the .refl file rather than D3DReflect()
+};
+
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
 // --------------------------------------------------------
@@ -73,55 +109,88 @@ public:
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
-	void CopyBufferData(std::string bufferName);
+	void CopyBufferData(std::string_view bufferName);
+
+	// Resolving variables ahead of time, for the handle-based setters
+	SimpleShaderHandle GetVariableHandle(std::string_view name);
+	SimpleShaderHandle GetVariableHandle(unsigned long long nameHash);
+
+	// Sets shader data through a handle
+	bool SetData(SimpleShaderHandle handle, const void* data, unsigned int size);
+	bool SetInt(SimpleShaderHandle handle, int data);
+	bool SetFloat(SimpleShaderHandle handle, float data);
+	bool SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data);
+
+	// Sets a whole constant buffer at once (see ConstantBuffer<T>)
+	bool SetBufferData(unsigned int index, const void* data, unsigned int size);
+	bool SetBufferData(std::string_view bufferName, const void* data, unsigned int size);
 
 	// Sets arbitrary shader data
-	bool SetData(std::string name, const void* data, unsigned int size);
-
-	bool SetInt(std::string name, int data);
-	bool SetFloat(std::string name, float data);
-	bool SetFloat2(std::string name, const float data[2]);
-	bool SetFloat2(std::string name, const DirectX::XMFLOAT2 data);
-	bool SetFloat3(std::string name, const float data[3]);
-	bool SetFloat3(std::string name, const DirectX::XMFLOAT3 data);
-	bool SetFloat4(std::string name, const float data[4]);
-	bool SetFloat4(std::string name, const DirectX::XMFLOAT4 data);
-	bool SetMatrix4x4(std::string name, const float data[16]);
-	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
+	bool SetData(std::string_view name, const void* data, unsigned int size);
+
+	bool SetInt(std::string_view name, int data);
+	bool SetFloat(std::string_view name, float data);
+	bool SetFloat2(std::string_view name, const float data[2]);
+	bool SetFloat2(std::string_view name, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(std::string_view name, const float data[3]);
+	bool SetFloat3(std::string_view name, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(std::string_view name, const float data[4]);
+	bool SetFloat4(std::string_view name, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(std::string_view name, const float data[16]);
+	bool SetMatrix4x4(std::string_view name, const DirectX::XMFLOAT4X4 data);
 
 	// Setting shader resources
-	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
-	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
+	virtual bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
+	virtual bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
 
 	// Simple resource checking
-	bool HasVariable(std::string name);
-	bool HasShaderResourceView(std::string name);
-	bool HasSamplerState(std::string name);
+	bool HasVariable(std::string_view name);
+	bool HasShaderResourceView(std::string_view name);
+	bool HasSamplerState(std::string_view name);
 
 	// Getting data about variables and resources
-	const SimpleShaderVariable* GetVariableInfo(std::string name);
+	const SimpleShaderVariable* GetVariableInfo(std::string_view name);
 	
-	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
+	const SimpleSRV* GetShaderResourceViewInfo(std::string_view name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
-	size_t GetShaderResourceViewCount() { return textureTable.size(); }
+	size_t GetShaderResourceViewCount() { return shaderResourceViewCount; }
 	
-	const SimpleSampler* GetSamplerInfo(std::string name);
+	const SimpleSampler* GetSamplerInfo(std::string_view name);
 	const SimpleSampler* GetSamplerInfo(unsigned int index);
-	size_t GetSamplerCount() { return samplerTable.size(); }
+	size_t GetSamplerCount() { return samplerCount; }
 
 	// Get data about constant buffers
 	unsigned int GetBufferCount();
 	unsigned int GetBufferSize(unsigned int index);
-	const SimpleConstantBuffer* GetBufferInfo(std::string name);
+	int GetBufferIndex(std::string_view name);
+	const SimpleConstantBuffer* GetBufferInfo(std::string_view name);
 	const SimpleConstantBuffer* GetBufferInfo(unsigned int index);
 	
 	// Misc getters
 	Microsoft::WRL::ComPtr<ID3DBlob> GetShaderBlob() { return shaderBlob; }
 
+	// Reads a shader and its reflection data (cached on disk) without
+	// creating anything, so several can be read in parallel
+	static bool ReadShaderFile(LPCWSTR shaderFile, SimpleShaderFile& fileOut);
+
 	// Error reporting
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Whether reflection data is read from and written to .refl files
+	static bool UseReflectionCache;
+
+	// Optional shared ring for constants that change between draws
+	static std::shared_ptr<ConstantRingBuffer> ConstantRing;
+
+	// Running totals of constant data, for comparing against copying
+	// every buffer on every CopyAllBufferData() call
+	static unsigned long long ConstantBytesUploaded;
+	static unsigned long long ConstantBytesRequested;
+
 protected:
 	
 	bool shaderValid;
@@ -129,30 +198,54 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
 
+	// All of the reflection data and local constant data lives in
+	// this one allocation - everything below points into it
+	unsigned char* arena;
+	size_t arenaSize;
+
 	// Resource counts
 	unsigned int constantBufferCount;
+	unsigned int variableCount;
+	unsigned int shaderResourceViewCount;
+	unsigned int samplerCount;
 	
-	// Maps for variables and buffers
-	SimpleConstantBuffer*		constantBuffers; // For index-based lookup
-	std::vector<SimpleSRV*>		shaderResourceViews;
-	std::vector<SimpleSampler*>	samplerStates;
-	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
-	std::unordered_map<std::string, SimpleSRV*> textureTable;
-	std::unordered_map<std::string, SimpleSampler*> samplerTable;
-
-	// Initialization method
+	// Flat arrays for variables and buffers
+	SimpleConstantBuffer*	constantBuffers; // For index-based lookup
+	SimpleShaderVariable*	variables; // Flat table that handles index into
+	SimpleSRV*				shaderResourceViews;
+	SimpleSampler*			samplerStates;
+
+	// Lookup tables, sorted by SimpleShaderHash() of the name
+	SimpleShaderLookup* cbTable;
+	SimpleShaderLookup* varTable;
+	SimpleShaderLookup* textureTable;
+	SimpleShaderLookup* samplerTable;
+
+	// Initialization methods
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool LoadShader(const SimpleShaderFile& file);
+	static bool ReflectShader(ID3DBlob* shaderBlob, ShaderReflectionData& reflectionOut);
 
 	// Pure virtual functions for dealing with shader types
-	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob) = 0;
+	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection) = 0;
 	virtual void SetShaderAndCBs() = 0;
+	virtual void BindConstantBuffer(const SimpleConstantBuffer* cb) = 0;
+	virtual bool IsShaderActive() = 0;
 
 	virtual void CleanUp();
 
 	// Helpers for finding data by name
-	SimpleShaderVariable* FindVariable(std::string name, int size);
-	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+	SimpleShaderVariable* FindVariable(std::string_view name, int size);
+	SimpleConstantBuffer* FindConstantBuffer(std::string_view name);
+
+	// Helpers for the sorted lookup tables and the arena
+	static size_t AlignArenaOffset(size_t offset, size_t alignment);
+
+	// Helpers for moving constant data to the GPU
+	void CopyVariableData(const SimpleShaderVariable* var, const void* data, unsigned int size);
+	void CopyLocalData(SimpleConstantBuffer* cb, unsigned int byteOffset, const void* data, unsigned int size);
+	void UploadBuffer(SimpleConstantBuffer* cb);
+	ID3D11DeviceContext1* GetRingBinding(const SimpleConstantBuffer* cb, ID3D11Buffer** buffer, UINT* firstConstant, UINT* numConstants);
 
 	// Error logging
 	void Log(std::string message, WORD color);
@@ -173,20 +266,23 @@ class SimpleVertexShader : public ISimpleShader
 public:
 	SimpleVertexShader( Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
 	SimpleVertexShader( Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile, Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout, bool perInstanceCompatible);
+	SimpleVertexShader( Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const SimpleShaderFile& shaderFile);
 	~SimpleVertexShader();
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> GetDirectXShader() { return shader; }
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> GetInputLayout() { return inputLayout; }
 	bool GetPerInstanceCompatible() { return perInstanceCompatible; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	bool perInstanceCompatible;
 	 Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
 	 Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(const SimpleConstantBuffer* cb);
+	bool IsShaderActive();
 	void CleanUp();
 };
 
@@ -198,16 +294,19 @@ class SimplePixelShader : public ISimpleShader
 {
 public:
 	SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
+	SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const SimpleShaderFile& shaderFile);
 	~SimplePixelShader();
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(const SimpleConstantBuffer* cb);
+	bool IsShaderActive();
 	void CleanUp();
 };
 
@@ -221,13 +320,15 @@ public:
 	~SimpleDomainShader();
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(const SimpleConstantBuffer* cb);
+	bool IsShaderActive();
 	void CleanUp();
 };
 
@@ -241,13 +342,15 @@ public:
 	~SimpleHullShader();
 	Microsoft::WRL::ComPtr<ID3D11HullShader> GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(const SimpleConstantBuffer* cb);
+	bool IsShaderActive();
 	void CleanUp();
 };
 
@@ -261,8 +364,8 @@ public:
 	~SimpleGeometryShader();
 	Microsoft::WRL::ComPtr<ID3D11GeometryShader> GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, int vertexCount);
 
@@ -277,9 +380,11 @@ protected:
 	bool allowStreamOutRasterization;
 	unsigned int streamOutVertexSize;
 
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection);
 	bool CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(const SimpleConstantBuffer* cb);
+	bool IsShaderActive();
 	void CleanUp();
 
 	// Helpers
@@ -294,30 +399,33 @@ class SimpleComputeShader : public ISimpleShader
 {
 public:
 	SimpleComputeShader(Microsoft::WRL::ComPtr<ID3D11Device> device,  Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
+	SimpleComputeShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const SimpleShaderFile& shaderFile);
 	~SimpleComputeShader();
 	Microsoft::WRL::ComPtr<ID3D11ComputeShader> GetDirectXShader() { return shader; }
 
 	void DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
 	void DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ);
 
-	bool HasUnorderedAccessView(std::string name);
+	bool HasUnorderedAccessView(std::string_view name);
 
-	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
-	bool SetUnorderedAccessView(std::string name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset = -1);
+	bool SetShaderResourceView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(std::string_view name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetUnorderedAccessView(std::string_view name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset = -1);
 
-	int GetUnorderedAccessViewIndex(std::string name);
+	int GetUnorderedAccessViewIndex(std::string_view name);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11ComputeShader> shader;
-	std::unordered_map<std::string, unsigned int> uavTable;
+	std::vector<SimpleShaderLookup> uavTable; // Sorted by SimpleShaderHash() of the name, indexes are bind points
 
 	unsigned int threadsX;
 	unsigned int threadsY;
 	unsigned int threadsZ;
 	unsigned int threadsTotal;
 
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const ShaderReflectionData& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(const SimpleConstantBuffer* cb);
+	bool IsShaderActive();
 	void CleanUp();
 };
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+
+#include "Hash.h"
+
+// --------------------------------------------------------
+// Hashes a variable or resource name (64-bit FNV-1a). All
+// of the lookup tables are keyed by these, so finding a
+// name never allocates, and names known ahead of time can
+// be hashed at compile time:
+//
+//   constexpr unsigned long long WORLD = SimpleShaderHash("world");
+// --------------------------------------------------------
+constexpr unsigned long long SimpleShaderHash(std::string_view name)
+{
+	return HashFNV1a(name);
+}
+
+// --------------------------------------------------------
+// One entry in a shader's lookup tables, which are sorted
+// by hash and binary searched. Nothing in here touches
+// Direct3D, so the tables can be benchmarked anywhere.
+// --------------------------------------------------------
+struct SimpleShaderLookup
+{
+	unsigned long long Hash;	// SimpleShaderHash() of the name
+	unsigned int Index;			// Into the matching flat array (or a bind point)
+};
+
+// --------------------------------------------------------
+// Sorts a lookup table by hash, for FindLookup()
+// --------------------------------------------------------
+inline void SortLookupTable(SimpleShaderLookup* table, size_t count)
+{
+	std::sort(table, table + count,
+		[](const SimpleShaderLookup& a, const SimpleShaderLookup& b) { return a.Hash < b.Hash; });
+}
+
+// --------------------------------------------------------
+// Binary search of a lookup table sorted by SortLookupTable()
+//
+// Returns the index stored with the hash, or -1
+// --------------------------------------------------------
+inline int FindLookup(const SimpleShaderLookup* table, size_t count, unsigned long long hash)
+{
+	const SimpleShaderLookup* end = table + count;
+	const SimpleShaderLookup* result = std::lower_bound(table, end, hash,
+		[](const SimpleShaderLookup& entry, unsigned long long key) { return entry.Hash < key; });
+
+	if (result == end || result->Hash != hash)
+		return -1;
+
+	return (int)result->Index;
+}
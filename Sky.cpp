@@ -2,26 +2,33 @@
 
 #include "Graphics.h"
 
-#include "WICTextureLoader.h"
+#include <chrono>
+#include <stdio.h>
 
 using namespace DirectX;
 
+// Radians - about twice the real sun, so it's more than a pixel or two
+#define SUN_ANGULAR_RADIUS 0.01f
+
 Sky::Sky(
 	const std::shared_ptr<Mesh> mesh,
 	const Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState,
-	const wchar_t* right,
-	const wchar_t* left,
-	const wchar_t* up,
-	const wchar_t* down,
-	const wchar_t* front,
-	const wchar_t* back,
+	const std::vector<MipLevel>& faces,
+	std::shared_ptr<ThreadPool> threadPool,
+	const std::wstring& environmentCacheFile,
 	std::shared_ptr<SimplePixelShader> ps,
 	std::shared_ptr<SimpleVertexShader> vs)
 	:
 	m_mesh(mesh),
 	m_samplerState(samplerState),
 	m_ps(ps),
-	m_vs(vs)
+	m_vs(vs),
+	m_environmentCached(false),
+	m_environmentBakeTime(0.0f),
+	m_procedural(false),
+	m_atmosphere(GetEarthAtmosphere()),
+	m_sunDirection(0.0f, 1.0f, 0.0f),
+	m_sunIlluminance(1.0f)
 {
 	// Create rasterizer state
 	D3D11_RASTERIZER_DESC rasterizerDesc{};
@@ -37,7 +44,24 @@ Sky::Sky(
 	
 	Graphics::Device->CreateDepthStencilState(&depthStencilDesc, m_depthStencilState.GetAddressOf());
 
-	m_cubeMapSRV = CreateCubemap(right, left, up, down, front, back);
+	m_cubeMapSRV = CreateCubemap(faces);
+
+	// Objects are lit by the same faces, boiled down to 9 colors
+	m_irradianceSH = ComputeSH9DiffuseConstants(ProjectCubemapSH9(faces, *threadPool));
+	CreateEnvironmentLighting(faces, *threadPool, environmentCacheFile);
+
+	// The procedural sky's LUTs, which bake later (and only if it's used)
+	m_atmosphereBaker = std::make_shared<AtmosphereBaker>(threadPool);
+	CreateLUT(TRANSMITTANCE_LUT_WIDTH, TRANSMITTANCE_LUT_HEIGHT, m_transmittanceLUT, m_transmittanceSRV);
+	CreateLUT(SKY_VIEW_LUT_WIDTH, SKY_VIEW_LUT_HEIGHT, m_skyViewLUT, m_skyViewSRV);
+
+	D3D11_SAMPLER_DESC lutSamplerDesc = {};
+	lutSamplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	lutSamplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	lutSamplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	lutSamplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	lutSamplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	Graphics::Device->CreateSamplerState(&lutSamplerDesc, m_lutSampler.GetAddressOf());
 }
 
 Sky::~Sky()
@@ -56,6 +80,23 @@ void Sky::Draw(std::shared_ptr<Camera> camera)
 	m_ps->SetShader();
 
 	m_ps->SetShaderResourceView("Skybox", m_cubeMapSRV);
+
+	// The cube map stands in until the first bake is done
+	bool procedural = m_procedural && m_atmosphereBaker->HasLUTs();
+	m_ps->SetInt("procedural", procedural);
+	if (procedural)
+	{
+		m_ps->SetShaderResourceView("TransmittanceLUT", m_transmittanceSRV);
+		m_ps->SetShaderResourceView("SkyViewLUT", m_skyViewSRV);
+		m_ps->SetSamplerState("LUTSampler", m_lutSampler);
+
+		m_ps->SetFloat3("sunDirection", m_sunDirection);
+		m_ps->SetFloat("sunIlluminance", m_sunIlluminance);
+		m_ps->SetFloat("sunCosAngularRadius", cosf(SUN_ANGULAR_RADIUS));
+		m_ps->SetFloat("bottomRadius", m_atmosphere.BottomRadius);
+		m_ps->SetFloat("topRadius", m_atmosphere.TopRadius);
+		m_ps->SetFloat("viewerRadius", m_atmosphere.BottomRadius + m_atmosphere.ViewerAltitude);
+	}
 	
 	m_vs->SetMatrix4x4("view", camera->GetViewMatrix());
 	m_vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());
@@ -70,75 +111,101 @@ void Sky::Draw(std::shared_ptr<Camera> camera)
 	Graphics::Context->OMSetDepthStencilState(nullptr, 0);
 }
 
-// Provided code
+const SH9Color& Sky::GetIrradianceSH() const
+{
+	return m_irradianceSH;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetSpecularSRV() const { return m_specularSRV; }
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetBRDFLookupSRV() const { return m_brdfLookupSRV; }
+bool Sky::IsEnvironmentCached() const { return m_environmentCached; }
+float Sky::GetEnvironmentBakeTime() const { return m_environmentBakeTime; }
+void Sky::SetProcedural(bool procedural) { m_procedural = procedural; }
+std::shared_ptr<AtmosphereBaker> Sky::GetAtmosphereBaker() const { return m_atmosphereBaker; }
+
 // --------------------------------------------------------
-// Loads six individual textures (the six faces of a cube map), then
-// creates a blank cube map and copies each of the six textures to
-// another face. Afterwards, creates a shader resource view for
-// the cube map and cleans up all of the temporary resources.
+// Keeps the procedural sky's LUTs up to date - call every
+// frame.  Finished bakes are uploaded here, and the next
+// one is started if anything changed since the last.
 // --------------------------------------------------------
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
-	const wchar_t* right,
-	const wchar_t* left,
-	const wchar_t* up,
-	const wchar_t* down,
-	const wchar_t* front,
-	const wchar_t* back)
+void Sky::UpdateAtmosphere(const XMFLOAT3& sunDirection, float sunIlluminance, const AtmosphereParameters& atmosphere)
 {
-	// Load the 6 textures into an array.
-	// - We need references to the TEXTURES, not SHADER RESOURCE VIEWS!
-	// - Explicitly NOT generating mipmaps, as we don't need them for the sky!
-	// - Order matters here! +X, -X, +Y, -Y, +Z, -Z
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[6] = {};
-	CreateWICTextureFromFile(Graphics::Device.Get(), right, (ID3D11Resource**)textures[0].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), left, (ID3D11Resource**)textures[1].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), up, (ID3D11Resource**)textures[2].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), down, (ID3D11Resource**)textures[3].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), front, (ID3D11Resource**)textures[4].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), back, (ID3D11Resource**)textures[5].GetAddressOf(), 0);
-	// We'll assume all of the textures are the same color format and resolution,
-	// so get the description of the first texture
-	D3D11_TEXTURE2D_DESC faceDesc = {};
-	textures[0]->GetDesc(&faceDesc);
-	// Describe the resource for the cube map, which is simply
-	// a "texture 2d array" with the TEXTURECUBE flag set.
-	// This is a special GPU resource format, NOT just a
-	// C++ array of textures!!!
+	// Nothing to bake for the cube map
+	if (!m_procedural)
+		return;
+
+	m_sunDirection = sunDirection;
+	m_sunIlluminance = sunIlluminance;
+
+	if (!m_atmosphereBaker->Update(atmosphere, sunDirection.y))
+		return;
+
+	// The radii have to match the LUTs being drawn, not the newest settings
+	const AtmosphereLUTs& luts = m_atmosphereBaker->GetLUTs();
+	m_atmosphere = m_atmosphereBaker->GetAtmosphere();
+	if (m_atmosphereBaker->ScatteringChanged())
+	{
+		Graphics::Context->UpdateSubresource(m_transmittanceLUT.Get(), 0, 0,
+			luts.Transmittance.data(), TRANSMITTANCE_LUT_WIDTH * sizeof(XMFLOAT4), 0);
+	}
+	Graphics::Context->UpdateSubresource(m_skyViewLUT.Get(), 0, 0,
+		luts.SkyView.data(), SKY_VIEW_LUT_WIDTH * sizeof(XMFLOAT4), 0);
+}
+
+// --------------------------------------------------------
+// Creates a cube map from six decoded faces (read and
+// decoded off the main thread, so all that's left here is
+// the upload), and a shader resource view for it.  Faces
+// must all be the same size.
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(const std::vector<MipLevel>& faces)
+{
+	bool valid = faces.size() == 6 && faces[0].Width > 0 && faces[0].Height > 0;
+	for (size_t i = 0; valid && i < faces.size(); i++)
+	{
+		valid = faces[i].Width == faces[0].Width &&
+			faces[i].Height == faces[0].Height &&
+			faces[i].Pixels.size() == (size_t)faces[i].Width * faces[i].Height * 4;
+	}
+
+	if (!valid)
+	{
+		const char* error = "Sky faces are missing or aren't all the same size\n";
+		printf_s(error);
+		OutputDebugStringA(error);
+		return nullptr;
+	}
+
+	// Each face is one element of a "texture 2d array" with
+	// the TEXTURECUBE flag set - a special GPU resource format,
+	// NOT just a C++ array of textures!
+	//  - Order matters here! +X, -X, +Y, -Y, +Z, -Z
+	//  - Explicitly NOT generating mipmaps, as we don't need them for the sky!
+	D3D11_SUBRESOURCE_DATA faceData[6] = {};
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		faceData[i].pSysMem = faces[i].Pixels.data();
+		faceData[i].SysMemPitch = faces[i].Width * 4;
+	}
+
 	D3D11_TEXTURE2D_DESC cubeDesc = {};
 	cubeDesc.ArraySize = 6; // Cube map!
 	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE; // We'll be using as a texture in a shader
 	cubeDesc.CPUAccessFlags = 0; // No read back
-	cubeDesc.Format = faceDesc.Format; // Match the loaded texture's color format
-	cubeDesc.Width = faceDesc.Width; // Match the size
-	cubeDesc.Height = faceDesc.Height; // Match the size
+	cubeDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // Faces are decoded to RGBA
+	cubeDesc.Width = faces[0].Width;
+	cubeDesc.Height = faces[0].Height;
 	cubeDesc.MipLevels = 1; // Only need 1
 	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE; // A CUBE, not 6 separate textures
-	cubeDesc.Usage = D3D11_USAGE_DEFAULT; // Standard usage
+	cubeDesc.Usage = D3D11_USAGE_IMMUTABLE; // Filled once, right here
 	cubeDesc.SampleDesc.Count = 1;
 	cubeDesc.SampleDesc.Quality = 0;
-	// Create the final texture resource to hold the cube map
+
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
-	Graphics::Device->CreateTexture2D(&cubeDesc, 0, cubeMapTexture.GetAddressOf());
-	// Loop through the individual face textures and copy them,
-	// one at a time, to the cube map texure
-	for (int i = 0; i < 6; i++)
-	{
-		// Calculate the subresource position to copy into
-		unsigned int subresource = D3D11CalcSubresource(
-			0, // Which mip (zero, since there's only one)
-			i, // Which array element?
-			1); // How many mip levels are in the texture?
-		// Copy from one resource (texture) to another
-		Graphics::Context->CopySubresourceRegion(
-			cubeMapTexture.Get(), // Destination resource
-			subresource, // Dest subresource index (one of the array elements)
-			0, 0, 0, // XYZ location of copy
-			textures[i].Get(), // Source resource
-			0, // Source subresource index (we're assuming there's only one)
-			0); // Source subresource "box" of data to copy (zero means the whole thing)
-	}
-	// At this point, all of the faces have been copied into the
-	// cube map texture, so we can describe a shader resource view for it
+	if (FAILED(Graphics::Device->CreateTexture2D(&cubeDesc, faceData, cubeMapTexture.GetAddressOf())))
+		return nullptr;
+
+	// Describe a shader resource view for it
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Format = cubeDesc.Format; // Same format as texture
 	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE; // Treat this as a cube!
@@ -151,3 +218,97 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	// Send back the SRV, which is what we need for our shaders
 	return cubeSRV;
 }
+
+// --------------------------------------------------------
+// Loads the faces' specular bake from the cache, or bakes
+// (and caches) it if the faces or bake settings changed,
+// then uploads the prefiltered cube map and BRDF table
+// --------------------------------------------------------
+void Sky::CreateEnvironmentLighting(const std::vector<MipLevel>& faces, ThreadPool& threadPool, const std::wstring& cacheFile)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	PrefilteredEnvironment environment;
+	BRDFLookupTable brdf;
+	unsigned long long sourceHash = HashCubemapFaces(faces);
+	m_environmentCached = LoadEnvironmentBake(cacheFile, sourceHash, environment, brdf);
+	if (!m_environmentCached)
+	{
+		environment = PrefilterEnvironment(faces, threadPool);
+		brdf = BakeBRDFLookupTable(threadPool);
+		if (environment.Mips.empty())
+			return;
+
+		SaveEnvironmentBake(cacheFile, sourceHash, environment, brdf);
+	}
+
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_environmentBakeTime = elapsed.count();
+
+	// Subresources go mip by mip within each face
+	unsigned int mipLevels = (unsigned int)environment.Mips.size();
+	std::vector<D3D11_SUBRESOURCE_DATA> cubeData(6 * mipLevels);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int mip = 0; mip < mipLevels; mip++)
+		{
+			unsigned int size = environment.Size >> mip;
+			D3D11_SUBRESOURCE_DATA& data = cubeData[D3D11CalcSubresource(mip, face, mipLevels)];
+			data.pSysMem = &environment.Mips[mip][(size_t)face * size * size];
+			data.SysMemPitch = size * sizeof(DirectX::XMFLOAT4);
+		}
+	}
+
+	D3D11_TEXTURE2D_DESC cubeDesc = {};
+	cubeDesc.ArraySize = 6;
+	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	cubeDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT; // Linear, and brighter than 1 where the sky is
+	cubeDesc.Width = environment.Size;
+	cubeDesc.Height = environment.Size;
+	cubeDesc.MipLevels = mipLevels;
+	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+	cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	cubeDesc.SampleDesc.Count = 1;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeTexture;
+	if (SUCCEEDED(Graphics::Device->CreateTexture2D(&cubeDesc, cubeData.data(), cubeTexture.GetAddressOf())))
+		Graphics::Device->CreateShaderResourceView(cubeTexture.Get(), 0, m_specularSRV.GetAddressOf());
+
+	D3D11_SUBRESOURCE_DATA brdfData = {};
+	brdfData.pSysMem = brdf.Texels.data();
+	brdfData.SysMemPitch = brdf.Size * sizeof(DirectX::XMFLOAT2);
+
+	D3D11_TEXTURE2D_DESC brdfDesc = {};
+	brdfDesc.ArraySize = 1;
+	brdfDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	brdfDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+	brdfDesc.Width = brdf.Size;
+	brdfDesc.Height = brdf.Size;
+	brdfDesc.MipLevels = 1;
+	brdfDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	brdfDesc.SampleDesc.Count = 1;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> brdfTexture;
+	if (SUCCEEDED(Graphics::Device->CreateTexture2D(&brdfDesc, &brdfData, brdfTexture.GetAddressOf())))
+		Graphics::Device->CreateShaderResourceView(brdfTexture.Get(), 0, m_brdfLookupSRV.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Creates an empty float LUT for the procedural sky
+// --------------------------------------------------------
+void Sky::CreateLUT(unsigned int width, unsigned int height,
+	Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.ArraySize = 1;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.SampleDesc.Count = 1;
+
+	if (SUCCEEDED(Graphics::Device->CreateTexture2D(&desc, 0, texture.GetAddressOf())))
+		Graphics::Device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+}
@@ -3,44 +3,86 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <memory>
+#include <string>
 #include "Mesh.h"
 #include "SimpleShader.h"
 #include "Camera.h"
+#include "MipGenerator.h"
+#include "SphericalHarmonics.h"
+#include "EnvironmentBaker.h"
+#include "Atmosphere.h"
+#include "ThreadPool.h"
 
 class Sky
 {
 public:
+	// faces - the six decoded (RGBA) faces, in +X, -X, +Y, -Y, +Z, -Z order
+	// threadPool - projects the faces' light onto spherical harmonics,
+	//              and bakes their specular lighting
+	// environmentCacheFile - where the specular bake is kept between runs
 	Sky(const std::shared_ptr<Mesh> mesh,
 		const Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState,
-		const wchar_t* right,
-		const wchar_t* left,
-		const wchar_t* up,
-		const wchar_t* down,
-		const wchar_t* front,
-		const wchar_t* back,
+		const std::vector<MipLevel>& faces,
+		std::shared_ptr<ThreadPool> threadPool,
+		const std::wstring& environmentCacheFile,
 		std::shared_ptr<SimplePixelShader> ps,
 		std::shared_ptr<SimpleVertexShader> vs);
 	~Sky();
 
 	void Draw(std::shared_ptr<Camera> camera);
 
+	// Diffuse light from the whole sky, as constants for the pixel
+	// shader (see ComputeSH9DiffuseConstants)
+	const SH9Color& GetIrradianceSH() const;
+
+	// Specular light from the sky: the GGX prefiltered cube map (one
+	// roughness per mip) and the split-sum BRDF table
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSpecularSRV() const;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetBRDFLookupSRV() const;
+	bool IsEnvironmentCached() const; // Loaded rather than baked this run
+	float GetEnvironmentBakeTime() const; // Milliseconds, including the cache check
+
+	// Procedural sky - drawn from the atmosphere's LUTs instead of the cube
+	// map, once they're baked.  They bake in the background whenever the
+	// sun's height or the atmosphere changes (the sun's azimuth is free).
+	// sunDirection - toward the sun, unit length
+	void SetProcedural(bool procedural);
+	void UpdateAtmosphere(const DirectX::XMFLOAT3& sunDirection, float sunIlluminance, const AtmosphereParameters& atmosphere);
+	std::shared_ptr<AtmosphereBaker> GetAtmosphereBaker() const;
+
 private:
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_samplerState;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_cubeMapSRV;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> m_depthStencilState;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_rasterizerState;
+	SH9Color m_irradianceSH;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_specularSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_brdfLookupSRV;
+	bool m_environmentCached;
+	float m_environmentBakeTime;
+
+	bool m_procedural;
+	std::shared_ptr<AtmosphereBaker> m_atmosphereBaker;
+	AtmosphereParameters m_atmosphere; // What the drawn LUTs were baked with
+	DirectX::XMFLOAT3 m_sunDirection;
+	float m_sunIlluminance;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_transmittanceLUT;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_skyViewLUT;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_transmittanceSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_skyViewSRV;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_lutSampler;
 	
 	std::shared_ptr<Mesh> m_mesh;
 	std::shared_ptr<SimplePixelShader> m_ps;
 	std::shared_ptr<SimpleVertexShader> m_vs;
 
-	// Provided code
-	// Helper for creating a cubemap from 6 individual textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
-		const wchar_t* right,
-		const wchar_t* left,
-		const wchar_t* up,
-		const wchar_t* down,
-		const wchar_t* front,
-		const wchar_t* back);
+	// Helper for creating a cubemap from 6 decoded faces
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(const std::vector<MipLevel>& faces);
+
+	// Loads or bakes the specular lighting, and creates its textures
+	void CreateEnvironmentLighting(const std::vector<MipLevel>& faces, ThreadPool& threadPool, const std::wstring& cacheFile);
+
+	// Helper for the procedural sky's LUTs, filled in as bakes finish
+	void CreateLUT(unsigned int width, unsigned int height,
+		Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
 };
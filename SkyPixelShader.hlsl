@@ -1,11 +1,79 @@
 #include "ShaderIncludes.hlsli"
 
+cbuffer ExternalData : register(b0)
+{
+	// Procedural sky, drawn from the atmosphere's LUTs instead of the cube map
+	float3 sunDirection; // Toward the sun
+	int procedural;
+	float sunIlluminance;
+	float sunCosAngularRadius;
+	float bottomRadius; // Planet and atmosphere radii (km), to look up transmittance
+	float topRadius;
+	float viewerRadius;
+}
+
 TextureCube Skybox : register(t0);
+Texture2D TransmittanceLUT : register(t1);
+Texture2D SkyViewLUT : register(t2);
 SamplerState BasicSampler : register(s0);
+SamplerState LUTSampler : register(s1);
+
+// The LUTs' texel centers run from 0 to 1 inclusive (see Atmosphere.cpp)
+float2 LUTCoordinates(float2 unitRange, float2 size)
+{
+	return unitRange * (1.0f - 1.0f / size) + 0.5f / size;
+}
+
+// Transmittance from the viewer to the top of the atmosphere,
+// by the cosine of the view's zenith angle
+float3 Transmittance(float mu)
+{
+	float H = sqrt(topRadius * topRadius - bottomRadius * bottomRadius);
+	float rho = sqrt(max(viewerRadius * viewerRadius - bottomRadius * bottomRadius, 0.0f));
+	float discriminant = viewerRadius * viewerRadius * (mu * mu - 1.0f) + topRadius * topRadius;
+	float d = max(-viewerRadius * mu + sqrt(max(discriminant, 0.0f)), 0.0f);
+	float dMin = topRadius - viewerRadius;
+	float dMax = rho + H;
+
+	float2 uv = LUTCoordinates(float2((d - dMin) / (dMax - dMin), rho / H),
+		float2(ATMOSPHERE_TRANSMITTANCE_WIDTH, ATMOSPHERE_TRANSMITTANCE_HEIGHT));
+	return TransmittanceLUT.SampleLevel(LUTSampler, uv, 0).rgb;
+}
+
+// Linear sky color in a direction - one lookup, plus the sun's disk
+float3 ProceduralSky(float3 dir)
+{
+	// The sky is the same either side of the sun, so the LUT only covers
+	// azimuths from the sun up to pi, and the sun's azimuth is free
+	float horizontalLength = length(dir.xz) * length(sunDirection.xz);
+	float cosAzimuth = horizontalLength > 0.0001f ? dot(dir.xz, sunDirection.xz) / horizontalLength : 1.0f;
+	float azimuth = acos(clamp(cosAzimuth, -1.0f, 1.0f)) / PI;
+
+	// Rows are squeezed toward the horizon
+	float elevation = asin(clamp(dir.y, -1.0f, 1.0f)) / (PI * 0.5f);
+	float v = 0.5f + 0.5f * sign(elevation) * sqrt(abs(elevation));
+
+	float2 uv = LUTCoordinates(float2(azimuth, v), float2(ATMOSPHERE_SKY_VIEW_WIDTH, ATMOSPHERE_SKY_VIEW_HEIGHT));
+	float3 sky = SkyViewLUT.SampleLevel(LUTSampler, uv, 0).rgb;
+
+	// The sun, dimmed (and reddened) by the air in front of it, unless
+	// it's behind the ground
+	bool behindGround = dir.y < 0.0f &&
+		viewerRadius * viewerRadius * (dir.y * dir.y - 1.0f) + bottomRadius * bottomRadius >= 0.0f;
+	float edge = (1.0f - sunCosAngularRadius) * 0.2f;
+	float disk = smoothstep(sunCosAngularRadius - edge, sunCosAngularRadius + edge, dot(dir, sunDirection));
+	if (!behindGround)
+		sky += Transmittance(dir.y) * disk;
+
+	return sky * sunIlluminance;
+}
 
 float4 main(VertexToPixel_Sky input) : SV_TARGET
 {
+	if (procedural)
+		return float4(pow(ProceduralSky(normalize(input.sampleDir)), 1.0f / 2.2f), 1.0f);
+
 	float4 finalColor = Skybox.Sample(BasicSampler, input.sampleDir);
 
 	return finalColor;
-}
\ No newline at end of file
+}
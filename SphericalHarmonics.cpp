@@ -0,0 +1,207 @@
+#include "SphericalHarmonics.h"
+#include "CubeMap.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+// Each basis function's normalization constant
+static const float SH_BASIS_CONSTANTS[SH9_COEFFICIENTS] = {
+	0.282095f,
+	0.488603f, 0.488603f, 0.488603f,
+	1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+
+// Convolving with the cosine lobe scales each band by pi, 2pi/3
+// and pi/4, and Lambertian diffuse divides by pi
+static const float SH_DIFFUSE_BANDS[SH9_COEFFICIENTS] = {
+	1.0f,
+	2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f,
+	0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+// Per row: 9 coefficients times 3 channels, then the total weight
+#define ROW_SUMS (SH9_COEFFICIENTS * 3 + 1)
+
+// The basis functions without their constants, for 4 directions at once
+static void EvaluatePolynomials(XMVECTOR x, XMVECTOR y, XMVECTOR z, XMVECTOR polynomials[SH9_COEFFICIENTS])
+{
+	polynomials[0] = XMVectorSplatOne();
+	polynomials[1] = y;
+	polynomials[2] = z;
+	polynomials[3] = x;
+	polynomials[4] = x * y;
+	polynomials[5] = y * z;
+	polynomials[6] = XMVectorMultiplyAdd(z * z, XMVectorReplicate(3.0f), XMVectorReplicate(-1.0f));
+	polynomials[7] = x * z;
+	polynomials[8] = XMVectorNegativeMultiplySubtract(y, y, x * x);
+}
+
+static void EvaluatePolynomials(XMFLOAT3 d, float polynomials[SH9_COEFFICIENTS])
+{
+	polynomials[0] = 1.0f;
+	polynomials[1] = d.y;
+	polynomials[2] = d.z;
+	polynomials[3] = d.x;
+	polynomials[4] = d.x * d.y;
+	polynomials[5] = d.y * d.z;
+	polynomials[6] = 3.0f * d.z * d.z - 1.0f;
+	polynomials[7] = d.x * d.z;
+	polynomials[8] = d.x * d.x - d.y * d.y;
+}
+
+SH9Color ProjectCubemapSH9(const std::vector<MipLevel>& faces, ThreadPool& threadPool)
+{
+	SH9Color result = {};
+
+	bool valid = faces.size() == 6 && faces[0].Width > 0 && faces[0].Height > 0;
+	for (size_t i = 0; valid && i < faces.size(); i++)
+	{
+		valid = faces[i].Width == faces[0].Width &&
+			faces[i].Height == faces[0].Height &&
+			faces[i].Pixels.size() == (size_t)faces[i].Width * faces[i].Height * 4;
+	}
+	if (!valid)
+		return result;
+
+	unsigned int width = faces[0].Width;
+	unsigned int height = faces[0].Height;
+
+	// Same gamma the shaders decode with, per byte value
+	float gammaToLinear[256];
+	for (unsigned int i = 0; i < 256; i++)
+		gammaToLinear[i] = powf(i / 255.0f, 2.2f);
+
+	// Every row is summed on its own, then the rows are added up in order,
+	// so the result doesn't depend on which thread did what
+	std::vector<float> rowSums((size_t)6 * height * ROW_SUMS);
+	threadPool.ParallelFor(6 * height, [&](unsigned int row)
+	{
+		unsigned int face = row / height;
+		unsigned int y = row % height;
+		const unsigned char* pixels = &faces[face].Pixels[(size_t)y * width * 4];
+
+		// A texel's direction is the face's direction plus u and v along its
+		// axes (all in -1 to 1), and v is the same for the whole row
+		const XMFLOAT3* axes = CUBE_FACE_AXES[face];
+		float v = (y + 0.5f) * 2.0f / height - 1.0f;
+		XMVECTOR baseX = XMVectorReplicate(axes[0].x + v * axes[2].x);
+		XMVECTOR baseY = XMVectorReplicate(axes[0].y + v * axes[2].y);
+		XMVECTOR baseZ = XMVectorReplicate(axes[0].z + v * axes[2].z);
+		XMVECTOR uAxisX = XMVectorReplicate(axes[1].x);
+		XMVECTOR uAxisY = XMVectorReplicate(axes[1].y);
+		XMVECTOR uAxisZ = XMVectorReplicate(axes[1].z);
+
+		// Structure of arrays - each lane is one of 4 neighboring texels
+		XMVECTOR sums[ROW_SUMS];
+		for (unsigned int s = 0; s < ROW_SUMS; s++)
+			sums[s] = XMVectorZero();
+
+		for (unsigned int x = 0; x < width; x += 4)
+		{
+			// Lanes past the end of the row get no weight
+			float u[4], r[4], g[4], b[4], inRow[4];
+			for (unsigned int lane = 0; lane < 4; lane++)
+			{
+				bool inside = x + lane < width;
+				const unsigned char* texel = &pixels[(size_t)(inside ? x + lane : 0) * 4];
+				u[lane] = (x + lane + 0.5f) * 2.0f / width - 1.0f;
+				r[lane] = gammaToLinear[texel[0]];
+				g[lane] = gammaToLinear[texel[1]];
+				b[lane] = gammaToLinear[texel[2]];
+				inRow[lane] = inside ? 1.0f : 0.0f;
+			}
+
+			XMVECTOR uu = XMVectorSet(u[0], u[1], u[2], u[3]);
+			XMVECTOR dx = XMVectorMultiplyAdd(uu, uAxisX, baseX);
+			XMVECTOR dy = XMVectorMultiplyAdd(uu, uAxisY, baseY);
+			XMVECTOR dz = XMVectorMultiplyAdd(uu, uAxisZ, baseZ);
+
+			// A texel's solid angle shrinks with the cube of its distance
+			// from the center of the cube (its area is the same everywhere)
+			XMVECTOR inverseLength = XMVectorReciprocal(XMVectorSqrt(dx * dx + dy * dy + dz * dz));
+			XMVECTOR weight = inverseLength * inverseLength * inverseLength * XMVectorSet(inRow[0], inRow[1], inRow[2], inRow[3]);
+
+			XMVECTOR polynomials[SH9_COEFFICIENTS];
+			EvaluatePolynomials(dx * inverseLength, dy * inverseLength, dz * inverseLength, polynomials);
+
+			XMVECTOR red = XMVectorSet(r[0], r[1], r[2], r[3]);
+			XMVECTOR green = XMVectorSet(g[0], g[1], g[2], g[3]);
+			XMVECTOR blue = XMVectorSet(b[0], b[1], b[2], b[3]);
+			for (unsigned int k = 0; k < SH9_COEFFICIENTS; k++)
+			{
+				XMVECTOR weighted = polynomials[k] * weight;
+				sums[k * 3 + 0] = XMVectorMultiplyAdd(weighted, red, sums[k * 3 + 0]);
+				sums[k * 3 + 1] = XMVectorMultiplyAdd(weighted, green, sums[k * 3 + 1]);
+				sums[k * 3 + 2] = XMVectorMultiplyAdd(weighted, blue, sums[k * 3 + 2]);
+			}
+			sums[ROW_SUMS - 1] += weight;
+		}
+
+		// Add up the lanes
+		float* rowSum = &rowSums[(size_t)row * ROW_SUMS];
+		for (unsigned int s = 0; s < ROW_SUMS; s++)
+			rowSum[s] = XMVectorGetX(XMVector4Dot(sums[s], XMVectorSplatOne()));
+	});
+
+	double totals[ROW_SUMS] = {};
+	for (size_t row = 0; row < (size_t)6 * height; row++)
+	{
+		for (unsigned int s = 0; s < ROW_SUMS; s++)
+			totals[s] += rowSums[row * ROW_SUMS + s];
+	}
+
+	// The weights only need to be right relative to each other - scaling
+	// them to cover the whole sphere takes care of the texel area, and of
+	// any error in approximating each texel's solid angle
+	double scale = 4.0 * XM_PI / totals[ROW_SUMS - 1];
+	for (unsigned int k = 0; k < SH9_COEFFICIENTS; k++)
+	{
+		float constant = SH_BASIS_CONSTANTS[k];
+		result.Coefficients[k] = XMFLOAT3(
+			(float)(totals[k * 3 + 0] * scale) * constant,
+			(float)(totals[k * 3 + 1] * scale) * constant,
+			(float)(totals[k * 3 + 2] * scale) * constant);
+	}
+	return result;
+}
+
+XMFLOAT3 EvaluateSH9(const SH9Color& sh, XMFLOAT3 direction)
+{
+	float polynomials[SH9_COEFFICIENTS];
+	EvaluatePolynomials(direction, polynomials);
+
+	XMVECTOR radiance = XMVectorZero();
+	for (unsigned int k = 0; k < SH9_COEFFICIENTS; k++)
+	{
+		radiance = XMVectorMultiplyAdd(XMLoadFloat3(&sh.Coefficients[k]),
+			XMVectorReplicate(polynomials[k] * SH_BASIS_CONSTANTS[k]), radiance);
+	}
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, radiance);
+	return result;
+}
+
+SH9Color ComputeSH9DiffuseConstants(const SH9Color& radiance)
+{
+	SH9Color constants = {};
+	for (unsigned int k = 0; k < SH9_COEFFICIENTS; k++)
+	{
+		XMVECTOR coefficient = XMLoadFloat3(&radiance.Coefficients[k]);
+		XMStoreFloat3(&constants.Coefficients[k], coefficient * (SH_BASIS_CONSTANTS[k] * SH_DIFFUSE_BANDS[k]));
+	}
+	return constants;
+}
+
+XMFLOAT3 EvaluateSH9Diffuse(const SH9Color& constants, XMFLOAT3 normal)
+{
+	float polynomials[SH9_COEFFICIENTS];
+	EvaluatePolynomials(normal, polynomials);
+
+	XMVECTOR diffuse = XMVectorZero();
+	for (unsigned int k = 0; k < SH9_COEFFICIENTS; k++)
+		diffuse = XMVectorMultiplyAdd(XMLoadFloat3(&constants.Coefficients[k]), XMVectorReplicate(polynomials[k]), diffuse);
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, diffuse);
+	return result;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+// Coefficients in bands 0 to 2
+#define SH9_COEFFICIENTS 9
+
+// --------------------------------------------------------
+// Order 3 (9 coefficient) real spherical harmonics, for
+// lighting diffuse surfaces with a whole environment at
+// once.  Coefficients are in the usual order:
+//  0: 1          (band 0)
+//  1: y, 2: z, 3: x   (band 1)
+//  4: xy, 5: yz, 6: 3z^2 - 1, 7: xz, 8: x^2 - y^2   (band 2)
+//
+// Diffuse lighting only needs the low bands (Ramamoorthi and
+// Hanrahan, "An Efficient Representation for Irradiance
+// Environment Maps"), so 9 RGB values stand in for a full
+// convolved cube map.  Nothing in here touches Direct3D.
+// --------------------------------------------------------
+struct SH9Color
+{
+	DirectX::XMFLOAT3 Coefficients[SH9_COEFFICIENTS];
+};
+
+// --------------------------------------------------------
+// Projects a cube map's radiance onto SH9.  faces are RGBA8,
+// in +X, -X, +Y, -Y, +Z, -Z order, all the same size, and
+// decoded with the same 2.2 gamma the shaders use.  Each
+// texel is weighted by the solid angle it covers, since
+// texels near a face's corners cover less of the sphere.
+// Rows are spread over the thread pool, 4 texels at a time.
+// Returns all zeros if the faces don't fit.
+// --------------------------------------------------------
+SH9Color ProjectCubemapSH9(const std::vector<MipLevel>& faces, ThreadPool& threadPool);
+
+// Radiance from SH9 coefficients in a direction (unit length)
+DirectX::XMFLOAT3 EvaluateSH9(const SH9Color& sh, DirectX::XMFLOAT3 direction);
+
+// --------------------------------------------------------
+// Turns radiance coefficients into ones a shader can use for
+// Lambertian diffuse directly: convolved with the cosine
+// lobe, divided by pi, and with each basis function's
+// constant folded in.  For a unit normal n:
+//   diffuse = albedo * (c0 + c1 n.y + c2 n.z + c3 n.x
+//       + c4 n.x n.y + c5 n.y n.z + c6 (3 n.z^2 - 1)
+//       + c7 n.x n.z + c8 (n.x^2 - n.y^2))
+// --------------------------------------------------------
+SH9Color ComputeSH9DiffuseConstants(const SH9Color& radiance);
+
+// The same sum as above, on the CPU
+DirectX::XMFLOAT3 EvaluateSH9Diffuse(const SH9Color& constants, DirectX::XMFLOAT3 normal);
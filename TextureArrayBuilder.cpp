@@ -0,0 +1,107 @@
+#include "TextureArrayBuilder.h"
+
+// Biggest array D3D11 allows
+#define MAX_ARRAY_SLICES D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+
+TextureArrayBuilder::TextureArrayBuilder()
+{
+}
+
+unsigned int TextureArrayBuilder::Add(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	m_sources.push_back(srv);
+	return (unsigned int)m_sources.size() - 1;
+}
+
+bool TextureArrayBuilder::Build(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	// Gather each texture's description for the planner
+	std::vector<Microsoft::WRL::ComPtr<ID3D11Texture2D>> textures(m_sources.size());
+	std::vector<TextureArrayInput> inputs(m_sources.size());
+	for (size_t t = 0; t < m_sources.size(); t++)
+	{
+		if (!m_sources[t])
+			return false;
+
+		Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+		m_sources[t]->GetResource(resource.GetAddressOf());
+		if (FAILED(resource.As(&textures[t])))
+			return false;
+
+		D3D11_TEXTURE2D_DESC desc;
+		textures[t]->GetDesc(&desc);
+		if (desc.ArraySize != 1 || desc.SampleDesc.Count != 1)
+			return false;
+
+		inputs[t] = { desc.Width, desc.Height, (unsigned int)desc.Format, desc.MipLevels };
+	}
+
+	m_plan = PlanTextureArrays(inputs, MAX_ARRAY_SLICES);
+	m_arraySRVs.clear();
+	m_arraySRVs.resize(m_plan.Arrays.size());
+
+	for (size_t a = 0; a < m_plan.Arrays.size(); a++)
+	{
+		const TextureArrayBucket& bucket = m_plan.Arrays[a];
+
+		D3D11_TEXTURE2D_DESC arrayDesc = {};
+		arrayDesc.Width = bucket.Width;
+		arrayDesc.Height = bucket.Height;
+		arrayDesc.MipLevels = bucket.MipLevels;
+		arrayDesc.ArraySize = (UINT)bucket.Textures.size();
+		arrayDesc.Format = (DXGI_FORMAT)bucket.Format;
+		arrayDesc.SampleDesc.Count = 1;
+		arrayDesc.Usage = D3D11_USAGE_DEFAULT;
+		arrayDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> arrayTexture;
+		if (FAILED(device->CreateTexture2D(&arrayDesc, 0, arrayTexture.GetAddressOf())))
+			return false;
+
+		// Every mip of every slice, straight across on the GPU
+		for (unsigned int slice = 0; slice < (unsigned int)bucket.Textures.size(); slice++)
+		{
+			ID3D11Texture2D* source = textures[bucket.Textures[slice]].Get();
+			for (unsigned int mip = 0; mip < bucket.MipLevels; mip++)
+			{
+				context->CopySubresourceRegion(
+					arrayTexture.Get(), D3D11CalcSubresource(mip, slice, bucket.MipLevels), 0, 0, 0,
+					source, D3D11CalcSubresource(mip, 0, bucket.MipLevels), 0);
+			}
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = arrayDesc.Format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.MipLevels = bucket.MipLevels;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = arrayDesc.ArraySize;
+		if (FAILED(device->CreateShaderResourceView(arrayTexture.Get(), &srvDesc, m_arraySRVs[a].GetAddressOf())))
+			return false;
+	}
+
+	// The arrays hold their own copies now
+	m_sources.clear();
+	return true;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureArrayBuilder::GetArraySRV(unsigned int texture) const
+{
+	return m_arraySRVs[m_plan.Slots[texture].Array];
+}
+
+unsigned int TextureArrayBuilder::GetSlice(unsigned int texture) const
+{
+	return m_plan.Slots[texture].Slice;
+}
+
+unsigned int TextureArrayBuilder::GetArrayCount() const
+{
+	return (unsigned int)m_plan.Arrays.size();
+}
+
+const TextureArrayBucket& TextureArrayBuilder::GetArray(unsigned int index) const
+{
+	return m_plan.Arrays[index];
+}
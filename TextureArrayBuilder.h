@@ -0,0 +1,44 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+
+#include "TextureArrayPacker.h"
+
+// --------------------------------------------------------
+// Copies already loaded 2D textures into Texture2DArrays,
+// grouped by PlanTextureArrays(), so objects whose textures
+// share an array only differ by a slice index.
+//
+//   unsigned int albedo = builder.Add(albedoSRV);
+//   ...
+//   builder.Build(device, context);
+//   material->AddTextureSRV("Albedo", builder.GetArraySRV(albedo), builder.GetSlice(albedo));
+//
+// The original textures are only referenced until Build().
+// --------------------------------------------------------
+class TextureArrayBuilder
+{
+public:
+	TextureArrayBuilder();
+
+	// Returns the texture's index for the getters below
+	unsigned int Add(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+
+	// Creates the arrays and copies every mip of every texture into them.
+	// Returns false if a texture isn't a single 2D texture or creation failed.
+	bool Build(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	// Getters (valid after Build)
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetArraySRV(unsigned int texture) const;
+	unsigned int GetSlice(unsigned int texture) const;
+	unsigned int GetArrayCount() const;
+	const TextureArrayBucket& GetArray(unsigned int index) const;
+
+private:
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_sources;
+
+	TextureArrayPlan m_plan;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_arraySRVs;
+};
@@ -0,0 +1,51 @@
+#include "TextureArrayPacker.h"
+
+TextureArrayPlan PlanTextureArrays(const std::vector<TextureArrayInput>& textures, unsigned int maxSlices)
+{
+	TextureArrayPlan plan;
+	plan.Slots.resize(textures.size());
+
+	if (maxSlices == 0)
+		maxSlices = 1;
+
+	for (unsigned int t = 0; t < (unsigned int)textures.size(); t++)
+	{
+		const TextureArrayInput& texture = textures[t];
+
+		// Only the newest array for a bucket can have room, since older
+		// ones were full when it was started - a linear search is plenty
+		// for the handful of arrays a scene has
+		int arrayIndex = -1;
+		for (int a = (int)plan.Arrays.size() - 1; a >= 0; a--)
+		{
+			const TextureArrayBucket& bucket = plan.Arrays[a];
+			if (bucket.Width == texture.Width &&
+				bucket.Height == texture.Height &&
+				bucket.Format == texture.Format &&
+				bucket.MipLevels == texture.MipLevels)
+			{
+				if (bucket.Textures.size() < maxSlices)
+					arrayIndex = a;
+				break;
+			}
+		}
+
+		if (arrayIndex == -1)
+		{
+			TextureArrayBucket bucket;
+			bucket.Width = texture.Width;
+			bucket.Height = texture.Height;
+			bucket.Format = texture.Format;
+			bucket.MipLevels = texture.MipLevels;
+			plan.Arrays.push_back(bucket);
+			arrayIndex = (int)plan.Arrays.size() - 1;
+		}
+
+		TextureArrayBucket& bucket = plan.Arrays[arrayIndex];
+		plan.Slots[t].Array = (unsigned int)arrayIndex;
+		plan.Slots[t].Slice = (unsigned int)bucket.Textures.size();
+		bucket.Textures.push_back(t);
+	}
+
+	return plan;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// One texture to be packed into an array.  Format is a
+// DXGI_FORMAT, kept as a plain integer so the packer can be
+// used (and tested) without Direct3D.
+// --------------------------------------------------------
+struct TextureArrayInput
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int Format;
+	unsigned int MipLevels;
+};
+
+// --------------------------------------------------------
+// Where a texture ended up: which array, and which slice
+// --------------------------------------------------------
+struct TextureArraySlot
+{
+	unsigned int Array;
+	unsigned int Slice;
+};
+
+// --------------------------------------------------------
+// One planned Texture2DArray.  Every texture in it has the
+// same size, format and mip count, and Textures holds their
+// input indices in slice order.
+// --------------------------------------------------------
+struct TextureArrayBucket
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int Format;
+	unsigned int MipLevels;
+	std::vector<unsigned int> Textures;
+};
+
+struct TextureArrayPlan
+{
+	std::vector<TextureArrayBucket> Arrays; // In order of first use
+	std::vector<TextureArraySlot> Slots; // One per input texture
+};
+
+// --------------------------------------------------------
+// Groups textures into as few arrays as possible: one per
+// distinct size/format/mip count, split again whenever an
+// array reaches maxSlices.  Slices follow input order, so
+// the same inputs always give the same plan.
+// --------------------------------------------------------
+TextureArrayPlan PlanTextureArrays(const std::vector<TextureArrayInput>& textures, unsigned int maxSlices);
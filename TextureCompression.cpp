@@ -0,0 +1,730 @@
+#include "TextureCompression.h"
+
+#include <cmath>
+#include <cstring>
+
+unsigned int GetCompressedBlockSize(TextureCompressionFormat format)
+{
+	return format == TextureCompressionFormat::BC1 || format == TextureCompressionFormat::BC4 ? 8 : 16;
+}
+
+unsigned int GetCompressedDxgiFormat(TextureCompressionFormat format)
+{
+	switch (format)
+	{
+	case TextureCompressionFormat::BC1: return TEXTURE_DXGI_FORMAT_BC1_UNORM;
+	case TextureCompressionFormat::BC4: return TEXTURE_DXGI_FORMAT_BC4_UNORM;
+	case TextureCompressionFormat::BC5: return TEXTURE_DXGI_FORMAT_BC5_UNORM;
+	default: return TEXTURE_DXGI_FORMAT_BC7_UNORM;
+	}
+}
+
+static int ClampInt(int value, int low, int high)
+{
+	return value < low ? low : (value > high ? high : value);
+}
+
+// --------------------------------------------------------
+// The main axis of a set of points (up to 4 channels),
+// found with a few rounds of power iteration on their
+// covariance.  A zero axis means every point is the same.
+// --------------------------------------------------------
+static void ComputePrincipalAxis(const float points[16][4], unsigned int channels, float mean[4], float axis[4])
+{
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		mean[c] = 0.0f;
+		axis[c] = 0.0f;
+	}
+
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		for (unsigned int c = 0; c < channels; c++)
+			mean[c] += points[i][c] / 16.0f;
+	}
+
+	float covariance[4][4] = {};
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		for (unsigned int a = 0; a < channels; a++)
+		{
+			for (unsigned int b = 0; b < channels; b++)
+				covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+		}
+	}
+
+	// Start along the diagonal, which is close for most color blocks
+	float vector[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (unsigned int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (unsigned int a = 0; a < channels; a++)
+		{
+			for (unsigned int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * vector[b];
+			length += next[a] * next[a];
+		}
+
+		if (length < 1e-12f)
+			return;
+
+		length = sqrtf(length);
+		for (unsigned int c = 0; c < channels; c++)
+			vector[c] = next[c] / length;
+	}
+
+	for (unsigned int c = 0; c < channels; c++)
+		axis[c] = vector[c];
+}
+
+// --------------------------------------------------------
+// The two ends of the points' spread along the main axis
+// --------------------------------------------------------
+static void ComputeAxisEndpoints(const float points[16][4], unsigned int channels, float start[4], float end[4])
+{
+	float mean[4];
+	float axis[4];
+	ComputePrincipalAxis(points, channels, mean, axis);
+
+	float low = 0.0f;
+	float high = 0.0f;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (unsigned int c = 0; c < channels; c++)
+			t += (points[i][c] - mean[c]) * axis[c];
+
+		if (t < low) low = t;
+		if (t > high) high = t;
+	}
+
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		start[c] = mean[c] + axis[c] * low;
+		end[c] = mean[c] + axis[c] * high;
+	}
+}
+
+// --------------------------------------------------------
+// Least squares endpoints for fixed indices, where each
+// texel is start * (1 - weight) + end * weight.  Returns
+// false if the weights can't separate the two.
+// --------------------------------------------------------
+static bool FitEndpoints(const float points[16][4], const float weights[16], unsigned int channels, float start[4], float end[4])
+{
+	float aa = 0.0f;
+	float ab = 0.0f;
+	float bb = 0.0f;
+	float ax[4] = {};
+	float bx[4] = {};
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		float a = 1.0f - weights[i];
+		float b = weights[i];
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (unsigned int c = 0; c < channels; c++)
+		{
+			ax[c] += a * points[i][c];
+			bx[c] += b * points[i][c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+
+	for (unsigned int c = 0; c < channels; c++)
+	{
+		start[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+		end[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// BC1
+// --------------------------------------------------------
+static unsigned short PackColor565(const float color[4])
+{
+	int r = ClampInt((int)(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+	int g = ClampInt((int)(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+	int b = ClampInt((int)(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackColor565(unsigned short packed, int color[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// The four-color palette, in index order
+static void GetBC1Palette(unsigned short color0, unsigned short color1, int palette[4][3])
+{
+	UnpackColor565(color0, palette[0]);
+	UnpackColor565(color1, palette[1]);
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+}
+
+// Picks the nearest palette entry for each texel, returning the total error
+static int ChooseBC1Indices(const unsigned char texels[64], unsigned short color0, unsigned short color1, unsigned int indices[16])
+{
+	int palette[4][3];
+	GetBC1Palette(color0, color1, palette);
+
+	int totalError = 0;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		int bestError = 0x7FFFFFFF;
+		for (unsigned int p = 0; p < 4; p++)
+		{
+			int error = 0;
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				int difference = texels[i * 4 + c] - palette[p][c];
+				error += difference * difference;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = p;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+void EncodeBC1Block(const unsigned char texels[64], unsigned char block[8])
+{
+	float points[16][4] = {};
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		for (unsigned int c = 0; c < 3; c++)
+			points[i][c] = texels[i * 4 + c];
+	}
+
+	float start[4];
+	float end[4];
+	ComputeAxisEndpoints(points, 3, start, end);
+
+	unsigned short color0 = PackColor565(end);
+	unsigned short color1 = PackColor565(start);
+	unsigned int indices[16];
+	int error = ChooseBC1Indices(texels, color0, color1, indices);
+
+	// One refinement pass with the endpoints fit to the chosen indices
+	static const float indexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	float weights[16];
+	for (unsigned int i = 0; i < 16; i++)
+		weights[i] = indexWeights[indices[i]];
+
+	if (FitEndpoints(points, weights, 3, start, end))
+	{
+		unsigned short fitColor0 = PackColor565(start);
+		unsigned short fitColor1 = PackColor565(end);
+		unsigned int fitIndices[16];
+		int fitError = ChooseBC1Indices(texels, fitColor0, fitColor1, fitIndices);
+		if (fitError < error)
+		{
+			color0 = fitColor0;
+			color1 = fitColor1;
+			memcpy(indices, fitIndices, sizeof(indices));
+		}
+	}
+
+	// The four-color mode needs color0 > color1.  Swapping the
+	// endpoints swaps index 0 with 1 and 2 with 3.
+	if (color0 < color1)
+	{
+		unsigned short swap = color0;
+		color0 = color1;
+		color1 = swap;
+		for (unsigned int i = 0; i < 16; i++)
+			indices[i] ^= 1;
+	}
+	else if (color0 == color1)
+	{
+		// Three-color mode, where index 0 is still color0
+		memset(indices, 0, sizeof(indices));
+	}
+
+	unsigned int indexBits = 0;
+	for (unsigned int i = 0; i < 16; i++)
+		indexBits |= indices[i] << (i * 2);
+
+	block[0] = (unsigned char)(color0 & 0xFF);
+	block[1] = (unsigned char)(color0 >> 8);
+	block[2] = (unsigned char)(color1 & 0xFF);
+	block[3] = (unsigned char)(color1 >> 8);
+	for (unsigned int b = 0; b < 4; b++)
+		block[4 + b] = (unsigned char)(indexBits >> (b * 8));
+}
+
+void DecodeBC1Block(const unsigned char block[8], unsigned char texels[64])
+{
+	unsigned short color0 = (unsigned short)(block[0] | (block[1] << 8));
+	unsigned short color1 = (unsigned short)(block[2] | (block[3] << 8));
+	unsigned int indexBits = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+
+	int palette[4][4];
+	UnpackColor565(color0, palette[0]);
+	UnpackColor565(color1, palette[1]);
+	palette[0][3] = 255;
+	palette[1][3] = 255;
+	palette[2][3] = 255;
+	palette[3][3] = 255;
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		if (color0 > color1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	if (color0 <= color1)
+		palette[3][3] = 0;
+
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		unsigned int index = (indexBits >> (i * 2)) & 3;
+		for (unsigned int c = 0; c < 4; c++)
+			texels[i * 4 + c] = (unsigned char)palette[index][c];
+	}
+}
+
+// --------------------------------------------------------
+// BC4 and BC5
+// --------------------------------------------------------
+void EncodeBC4Block(const unsigned char texels[64], unsigned char block[8], unsigned int channel)
+{
+	int low = 255;
+	int high = 0;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		int value = texels[i * 4 + channel];
+		if (value < low) low = value;
+		if (value > high) high = value;
+	}
+
+	memset(block, 0, 8);
+	block[0] = (unsigned char)high;
+	block[1] = (unsigned char)low;
+
+	// A flat block can use index 0 everywhere (in either mode)
+	if (high == low)
+		return;
+
+	// Eight-value mode: endpoints then six evenly spaced values
+	int palette[8];
+	palette[0] = high;
+	palette[1] = low;
+	for (int p = 2; p < 8; p++)
+		palette[p] = ((8 - p) * high + (p - 1) * low + 3) / 7;
+
+	unsigned long long indexBits = 0;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		int value = texels[i * 4 + channel];
+		int bestError = 256;
+		unsigned long long bestIndex = 0;
+		for (unsigned int p = 0; p < 8; p++)
+		{
+			int error = value > palette[p] ? value - palette[p] : palette[p] - value;
+			if (error < bestError)
+			{
+				bestError = error;
+				bestIndex = p;
+			}
+		}
+		indexBits |= bestIndex << (i * 3);
+	}
+
+	for (unsigned int b = 0; b < 6; b++)
+		block[2 + b] = (unsigned char)(indexBits >> (b * 8));
+}
+
+// Decodes one channel's worth of BC4 into a stride-4 texel array
+static void DecodeBC4Channel(const unsigned char block[8], unsigned char* texels)
+{
+	int value0 = block[0];
+	int value1 = block[1];
+
+	int palette[8];
+	palette[0] = value0;
+	palette[1] = value1;
+	if (value0 > value1)
+	{
+		for (int p = 2; p < 8; p++)
+			palette[p] = ((8 - p) * value0 + (p - 1) * value1 + 3) / 7;
+	}
+	else
+	{
+		for (int p = 2; p < 6; p++)
+			palette[p] = ((6 - p) * value0 + (p - 1) * value1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	unsigned long long indexBits = 0;
+	for (unsigned int b = 0; b < 6; b++)
+		indexBits |= (unsigned long long)block[2 + b] << (b * 8);
+
+	for (unsigned int i = 0; i < 16; i++)
+		texels[i * 4] = (unsigned char)palette[(indexBits >> (i * 3)) & 7];
+}
+
+void DecodeBC4Block(const unsigned char block[8], unsigned char texels[64])
+{
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		texels[i * 4 + 1] = 0;
+		texels[i * 4 + 2] = 0;
+		texels[i * 4 + 3] = 255;
+	}
+	DecodeBC4Channel(block, texels);
+}
+
+void EncodeBC5Block(const unsigned char texels[64], unsigned char block[16])
+{
+	EncodeBC4Block(texels, block, 0);
+	EncodeBC4Block(texels, block + 8, 1);
+}
+
+void DecodeBC5Block(const unsigned char block[16], unsigned char texels[64])
+{
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		texels[i * 4 + 2] = 0;
+		texels[i * 4 + 3] = 255;
+	}
+	DecodeBC4Channel(block, texels);
+	DecodeBC4Channel(block + 8, texels + 1);
+}
+
+// --------------------------------------------------------
+// BC7 (mode 6 only)
+//
+// Mode 6 is one subset with RGBA endpoints of 7 bits plus a
+// shared low bit (the "p-bit") per endpoint, and a 4 bit
+// index per texel.  The first texel's index drops its top
+// bit, so it must be below 8.
+// --------------------------------------------------------
+static const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Writes and reads a 128 bit block, lowest bit first
+class BC7Bits
+{
+public:
+	BC7Bits(unsigned char* block) : m_block(block), m_position(0) {}
+
+	void Write(unsigned int value, unsigned int count)
+	{
+		for (unsigned int b = 0; b < count; b++, m_position++)
+		{
+			if ((value >> b) & 1)
+				m_block[m_position >> 3] |= (unsigned char)(1 << (m_position & 7));
+		}
+	}
+
+	unsigned int Read(unsigned int count)
+	{
+		unsigned int value = 0;
+		for (unsigned int b = 0; b < count; b++, m_position++)
+			value |= ((m_block[m_position >> 3] >> (m_position & 7)) & 1u) << b;
+		return value;
+	}
+
+private:
+	unsigned char* m_block;
+	unsigned int m_position;
+};
+
+// An endpoint as 7 bits per channel and its p-bit
+struct BC7Endpoint
+{
+	int Color[4];
+	int PBit;
+};
+
+// The quantized endpoint closest to a color, trying both p-bits
+static BC7Endpoint QuantizeBC7Endpoint(const float color[4])
+{
+	BC7Endpoint best = {};
+	float bestError = -1.0f;
+	for (int pBit = 0; pBit < 2; pBit++)
+	{
+		BC7Endpoint endpoint;
+		endpoint.PBit = pBit;
+		float error = 0.0f;
+		for (unsigned int c = 0; c < 4; c++)
+		{
+			endpoint.Color[c] = ClampInt((int)floorf((color[c] - pBit) / 2.0f + 0.5f), 0, 127);
+			float difference = (float)(endpoint.Color[c] * 2 + pBit) - color[c];
+			error += difference * difference;
+		}
+
+		if (bestError < 0.0f || error < bestError)
+		{
+			best = endpoint;
+			bestError = error;
+		}
+	}
+	return best;
+}
+
+static void GetBC7Palette(const BC7Endpoint& endpoint0, const BC7Endpoint& endpoint1, int palette[16][4])
+{
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		int value0 = endpoint0.Color[c] * 2 + endpoint0.PBit;
+		int value1 = endpoint1.Color[c] * 2 + endpoint1.PBit;
+		for (unsigned int p = 0; p < 16; p++)
+			palette[p][c] = ((64 - BC7_WEIGHTS4[p]) * value0 + BC7_WEIGHTS4[p] * value1 + 32) >> 6;
+	}
+}
+
+static int ChooseBC7Indices(const unsigned char texels[64], const BC7Endpoint& endpoint0, const BC7Endpoint& endpoint1, unsigned int indices[16])
+{
+	int palette[16][4];
+	GetBC7Palette(endpoint0, endpoint1, palette);
+
+	int totalError = 0;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		int bestError = 0x7FFFFFFF;
+		for (unsigned int p = 0; p < 16; p++)
+		{
+			int error = 0;
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				int difference = texels[i * 4 + c] - palette[p][c];
+				error += difference * difference;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = p;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+void EncodeBC7Block(const unsigned char texels[64], unsigned char block[16])
+{
+	float points[16][4];
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		for (unsigned int c = 0; c < 4; c++)
+			points[i][c] = texels[i * 4 + c];
+	}
+
+	float start[4];
+	float end[4];
+	ComputeAxisEndpoints(points, 4, start, end);
+
+	BC7Endpoint endpoint0 = QuantizeBC7Endpoint(start);
+	BC7Endpoint endpoint1 = QuantizeBC7Endpoint(end);
+	unsigned int indices[16];
+	int error = ChooseBC7Indices(texels, endpoint0, endpoint1, indices);
+
+	// A couple of refinement passes with the endpoints fit to the chosen indices
+	for (unsigned int pass = 0; pass < 2 && error > 0; pass++)
+	{
+		float weights[16];
+		for (unsigned int i = 0; i < 16; i++)
+			weights[i] = BC7_WEIGHTS4[indices[i]] / 64.0f;
+
+		if (!FitEndpoints(points, weights, 4, start, end))
+			break;
+
+		BC7Endpoint fitEndpoint0 = QuantizeBC7Endpoint(start);
+		BC7Endpoint fitEndpoint1 = QuantizeBC7Endpoint(end);
+		unsigned int fitIndices[16];
+		int fitError = ChooseBC7Indices(texels, fitEndpoint0, fitEndpoint1, fitIndices);
+		if (fitError >= error)
+			break;
+
+		endpoint0 = fitEndpoint0;
+		endpoint1 = fitEndpoint1;
+		memcpy(indices, fitIndices, sizeof(indices));
+		error = fitError;
+	}
+
+	// The anchor texel's top index bit is implied zero
+	if (indices[0] & 8)
+	{
+		BC7Endpoint swap = endpoint0;
+		endpoint0 = endpoint1;
+		endpoint1 = swap;
+		for (unsigned int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(block, 0, 16);
+	BC7Bits bits(block);
+	bits.Write(1 << 6, 7); // Mode 6
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		bits.Write(endpoint0.Color[c], 7);
+		bits.Write(endpoint1.Color[c], 7);
+	}
+	bits.Write(endpoint0.PBit, 1);
+	bits.Write(endpoint1.PBit, 1);
+	bits.Write(indices[0], 3);
+	for (unsigned int i = 1; i < 16; i++)
+		bits.Write(indices[i], 4);
+}
+
+bool DecodeBC7Block(const unsigned char block[16], unsigned char texels[64])
+{
+	if ((block[0] & 0x7F) != (1 << 6))
+	{
+		memset(texels, 0, 64);
+		return false;
+	}
+
+	BC7Bits bits(const_cast<unsigned char*>(block));
+	bits.Read(7);
+
+	BC7Endpoint endpoint0;
+	BC7Endpoint endpoint1;
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		endpoint0.Color[c] = (int)bits.Read(7);
+		endpoint1.Color[c] = (int)bits.Read(7);
+	}
+	endpoint0.PBit = (int)bits.Read(1);
+	endpoint1.PBit = (int)bits.Read(1);
+
+	int palette[16][4];
+	GetBC7Palette(endpoint0, endpoint1, palette);
+
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		unsigned int index = bits.Read(i == 0 ? 3 : 4);
+		for (unsigned int c = 0; c < 4; c++)
+			texels[i * 4 + c] = (unsigned char)palette[index][c];
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Whole images
+// --------------------------------------------------------
+std::vector<unsigned char> CompressImage(const unsigned char* rgba, unsigned int width, unsigned int height, TextureCompressionFormat format)
+{
+	unsigned int blocksWide = (width + 3) / 4;
+	unsigned int blocksHigh = (height + 3) / 4;
+	unsigned int blockSize = GetCompressedBlockSize(format);
+
+	std::vector<unsigned char> blocks(blocksWide * blocksHigh * blockSize);
+	if (width == 0 || height == 0)
+		return blocks;
+
+	unsigned char texels[64];
+	for (unsigned int by = 0; by < blocksHigh; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksWide; bx++)
+		{
+			// Gather the block, repeating the last row/column past the edge
+			for (unsigned int y = 0; y < 4; y++)
+			{
+				unsigned int sourceY = by * 4 + y < height ? by * 4 + y : height - 1;
+				for (unsigned int x = 0; x < 4; x++)
+				{
+					unsigned int sourceX = bx * 4 + x < width ? bx * 4 + x : width - 1;
+					memcpy(&texels[(y * 4 + x) * 4], &rgba[(sourceY * width + sourceX) * 4], 4);
+				}
+			}
+
+			unsigned char* block = &blocks[(by * blocksWide + bx) * blockSize];
+			switch (format)
+			{
+			case TextureCompressionFormat::BC1: EncodeBC1Block(texels, block); break;
+			case TextureCompressionFormat::BC4: EncodeBC4Block(texels, block); break;
+			case TextureCompressionFormat::BC5: EncodeBC5Block(texels, block); break;
+			case TextureCompressionFormat::BC7: EncodeBC7Block(texels, block); break;
+			}
+		}
+	}
+
+	return blocks;
+}
+
+std::vector<unsigned char> DecompressImage(const unsigned char* blocks, unsigned int width, unsigned int height, TextureCompressionFormat format)
+{
+	unsigned int blocksWide = (width + 3) / 4;
+	unsigned int blocksHigh = (height + 3) / 4;
+	unsigned int blockSize = GetCompressedBlockSize(format);
+
+	std::vector<unsigned char> rgba(width * height * 4);
+
+	unsigned char texels[64];
+	for (unsigned int by = 0; by < blocksHigh; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksWide; bx++)
+		{
+			const unsigned char* block = &blocks[(by * blocksWide + bx) * blockSize];
+			switch (format)
+			{
+			case TextureCompressionFormat::BC1: DecodeBC1Block(block, texels); break;
+			case TextureCompressionFormat::BC4: DecodeBC4Block(block, texels); break;
+			case TextureCompressionFormat::BC5: DecodeBC5Block(block, texels); break;
+			case TextureCompressionFormat::BC7: DecodeBC7Block(block, texels); break;
+			}
+
+			for (unsigned int y = 0; y < 4 && by * 4 + y < height; y++)
+			{
+				for (unsigned int x = 0; x < 4 && bx * 4 + x < width; x++)
+					memcpy(&rgba[((by * 4 + y) * width + bx * 4 + x) * 4], &texels[(y * 4 + x) * 4], 4);
+			}
+		}
+	}
+
+	return rgba;
+}
+
+double ComputeImagePSNR(const unsigned char* a, const unsigned char* b, unsigned int width, unsigned int height, unsigned int channelMask)
+{
+	double squaredError = 0.0;
+	unsigned long long samples = 0;
+	for (unsigned long long i = 0; i < (unsigned long long)width * height; i++)
+	{
+		for (unsigned int c = 0; c < 4; c++)
+		{
+			if (!(channelMask & (1 << c)))
+				continue;
+
+			double difference = (double)a[i * 4 + c] - (double)b[i * 4 + c];
+			squaredError += difference * difference;
+			samples++;
+		}
+	}
+
+	if (samples == 0 || squaredError == 0.0)
+		return 999.0;
+
+	double meanSquaredError = squaredError / samples;
+	return 10.0 * log10(255.0 * 255.0 / meanSquaredError);
+}
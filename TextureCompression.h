@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// CPU encoders (and decoders, for measuring quality) for
+// the block compressed formats textures are cooked into.
+// Every format works on 4x4 blocks of RGBA8 texels:
+//
+//  BC1 - RGB at 4 bits per texel (alpha ignored)
+//  BC4 - One channel (red) at 4 bits per texel
+//  BC5 - Two channels (red, green) at 8 bits per texel,
+//        for normal maps with Z rebuilt in the shader
+//  BC7 - RGBA at 8 bits per texel.  Only mode 6 (one
+//        subset, 4 bit indices) is encoded, which is fast
+//        and does well on smooth color; decoding handles
+//        just that mode too.
+//
+// Nothing in here touches Direct3D.
+// --------------------------------------------------------
+enum class TextureCompressionFormat
+{
+	BC1,
+	BC4,
+	BC5,
+	BC7
+};
+
+// DXGI_FORMAT values, so cooked files can be written without Direct3D
+#define TEXTURE_DXGI_FORMAT_BC1_UNORM 71
+#define TEXTURE_DXGI_FORMAT_BC4_UNORM 80
+#define TEXTURE_DXGI_FORMAT_BC5_UNORM 83
+#define TEXTURE_DXGI_FORMAT_BC7_UNORM 98
+
+// Bytes in one compressed 4x4 block (8 or 16)
+unsigned int GetCompressedBlockSize(TextureCompressionFormat format);
+unsigned int GetCompressedDxgiFormat(TextureCompressionFormat format);
+
+// One block.  Texels are 16 RGBA8 values in row order.
+void EncodeBC1Block(const unsigned char texels[64], unsigned char block[8]);
+void EncodeBC4Block(const unsigned char texels[64], unsigned char block[8], unsigned int channel = 0);
+void EncodeBC5Block(const unsigned char texels[64], unsigned char block[16]);
+void EncodeBC7Block(const unsigned char texels[64], unsigned char block[16]);
+
+// Decoding fills all four channels: BC4 gives (r, 0, 0, 255)
+// and BC5 gives (r, g, 0, 255), like the GPU does
+void DecodeBC1Block(const unsigned char block[8], unsigned char texels[64]);
+void DecodeBC4Block(const unsigned char block[8], unsigned char texels[64]);
+void DecodeBC5Block(const unsigned char block[16], unsigned char texels[64]);
+bool DecodeBC7Block(const unsigned char block[16], unsigned char texels[64]); // False for modes other than 6
+
+// --------------------------------------------------------
+// Whole images (RGBA8, rows tightly packed).  Sizes that
+// aren't a multiple of 4 repeat their last row and column
+// to fill the edge blocks.
+// --------------------------------------------------------
+std::vector<unsigned char> CompressImage(const unsigned char* rgba, unsigned int width, unsigned int height, TextureCompressionFormat format);
+std::vector<unsigned char> DecompressImage(const unsigned char* blocks, unsigned int width, unsigned int height, TextureCompressionFormat format);
+
+// Peak signal to noise ratio (dB) over the given channels (bit 0 = red),
+// or a very large number if the images are identical
+double ComputeImagePSNR(const unsigned char* a, const unsigned char* b, unsigned int width, unsigned int height, unsigned int channelMask);
@@ -0,0 +1,233 @@
+#include "TextureCooker.h"
+#include "DDSFile.h"
+#include "PathHelpers.h"
+
+#include <chrono>
+#include <filesystem>
+
+ORMSourceFiles GetORMSourceFiles(const std::wstring& materialPath)
+{
+	ORMSourceFiles files;
+	files.Roughness = materialPath + L"_roughness.png";
+	files.Metalness = materialPath + L"_metal.png";
+	if (std::filesystem::exists(materialPath + L"_ao.png"))
+		files.Occlusion = materialPath + L"_ao.png";
+	return files;
+}
+
+std::wstring GetORMTexturePath(const std::wstring& materialPath)
+{
+	return materialPath + L"_orm.dds";
+}
+
+bool LoadORMImage(const ORMSourceFiles& files, unsigned int& width, unsigned int& height, std::vector<unsigned char>& rgba, std::string& error)
+{
+	if (files.Roughness.empty() || files.Metalness.empty())
+	{
+		error = "ORM textures need both a roughness and a metalness map";
+		return false;
+	}
+
+	// By channel, in ORM order
+	const std::wstring* channelFiles[3] = { &files.Occlusion, &files.Roughness, &files.Metalness };
+	unsigned int channelWidths[3] = {};
+	unsigned int channelHeights[3] = {};
+	std::vector<unsigned char> channelPixels[3];
+
+	width = 0;
+	height = 0;
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		if (channelFiles[c]->empty())
+			continue;
+
+		if (!LoadImageRGBA(*channelFiles[c], channelWidths[c], channelHeights[c], channelPixels[c]))
+		{
+			error = "Couldn't read " + WideToNarrow(*channelFiles[c]);
+			return false;
+		}
+
+		if (channelWidths[c] > width) width = channelWidths[c];
+		if (channelHeights[c] > height) height = channelHeights[c];
+	}
+
+	// Smaller maps have to scale up evenly to the largest
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		if (channelPixels[c].empty())
+			continue;
+
+		if (width % channelWidths[c] != 0 ||
+			height % channelHeights[c] != 0 ||
+			width / channelWidths[c] != height / channelHeights[c])
+		{
+			error = WideToNarrow(*channelFiles[c]) + " is " +
+				std::to_string(channelWidths[c]) + "x" + std::to_string(channelHeights[c]) +
+				", which doesn't scale evenly to the " +
+				std::to_string(width) + "x" + std::to_string(height) + " of the other maps";
+			return false;
+		}
+	}
+
+	// Single-channel maps decode as gray, so red holds the value
+	rgba.assign((size_t)width * height * 4, 255);
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		if (channelPixels[c].empty())
+			continue;
+
+		unsigned int scale = width / channelWidths[c];
+		for (unsigned int y = 0; y < height; y++)
+		{
+			const unsigned char* sourceRow = &channelPixels[c][(size_t)(y / scale) * channelWidths[c] * 4];
+			unsigned char* destRow = &rgba[(size_t)y * width * 4];
+			for (unsigned int x = 0; x < width; x++)
+				destRow[x * 4 + c] = sourceRow[(x / scale) * 4];
+		}
+	}
+
+	return true;
+}
+
+std::vector<TextureCookJob> GetTextureCookJobs(const std::wstring& folder)
+{
+	std::vector<TextureCookJob> jobs;
+
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(folder, error))
+	{
+		std::filesystem::path path = entry.path();
+		if (!entry.is_regular_file() || path.extension() != L".png")
+			continue;
+
+		std::wstring name = path.stem().wstring();
+		auto endsWith = [&name](const std::wstring& suffix)
+		{
+			return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+		};
+
+		// The path shared by all of a material's textures
+		auto materialPath = [&path, &name](const std::wstring& suffix)
+		{
+			std::filesystem::path base = path;
+			base.replace_filename(name.substr(0, name.size() - suffix.size()));
+			return base.wstring();
+		};
+
+		// Roughness and metalness are packed together when they're both there
+		auto hasORMPair = [](const std::wstring& base)
+		{
+			return std::filesystem::exists(base + L"_roughness.png") && std::filesystem::exists(base + L"_metal.png");
+		};
+
+		TextureCookJob job;
+		job.Source = path.wstring();
+		job.Destination = GetCookedTexturePath(job.Source);
+		if (endsWith(L"_normals"))
+		{
+			job.Format = TextureCompressionFormat::BC5;
+			job.Content = MipContent::NormalMap;
+		}
+		else if (endsWith(L"_roughness"))
+		{
+			std::wstring base = materialPath(L"_roughness");
+			if (hasORMPair(base))
+			{
+				job.ORM = GetORMSourceFiles(base);
+				job.Destination = GetORMTexturePath(base);
+				job.Format = TextureCompressionFormat::BC7;
+			}
+			else
+			{
+				job.Format = TextureCompressionFormat::BC4;
+			}
+			job.Content = MipContent::Data;
+
+			if (std::filesystem::exists(base + L"_normals.png"))
+				job.NormalMapSource = base + L"_normals.png";
+		}
+		else if (endsWith(L"_metal") || endsWith(L"_ao"))
+		{
+			// Cooked with the roughness map instead
+			if (hasORMPair(materialPath(endsWith(L"_ao") ? L"_ao" : L"_metal")))
+				continue;
+
+			job.Format = TextureCompressionFormat::BC4;
+			job.Content = MipContent::Data;
+		}
+		else
+		{
+			job.Format = TextureCompressionFormat::BC7;
+			job.Content = MipContent::SRGBColor;
+		}
+
+		jobs.push_back(job);
+	}
+
+	return jobs;
+}
+
+bool CookTexture(const TextureCookJob& job, TextureCookResult& result)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	result = {};
+
+	std::vector<unsigned char> rgba;
+	bool loaded = job.ORM.Roughness.empty() ?
+		LoadImageRGBA(job.Source, result.Width, result.Height, rgba) :
+		LoadORMImage(job.ORM, result.Width, result.Height, rgba, result.Error);
+	if (!loaded)
+	{
+		if (result.Error.empty())
+			result.Error = "Couldn't read " + WideToNarrow(job.Source);
+		return false;
+	}
+
+	std::vector<MipLevel> mips = GenerateMipChain(rgba.data(), result.Width, result.Height, job.Content);
+
+	// Roughness picks up the normal map's lost detail in the smaller mips
+	std::vector<unsigned char> normals;
+	unsigned int normalsWidth = 0;
+	unsigned int normalsHeight = 0;
+	if (!job.NormalMapSource.empty() &&
+		LoadImageRGBA(job.NormalMapSource, normalsWidth, normalsHeight, normals) &&
+		normalsWidth == result.Width &&
+		normalsHeight == result.Height)
+	{
+		AdjustRoughnessForNormalVariance(
+			mips,
+			GenerateMipChain(normals.data(), normalsWidth, normalsHeight, MipContent::NormalMap),
+			job.ORM.Roughness.empty() ? 0 : ORM_ROUGHNESS_CHANNEL);
+	}
+
+	DDSImage image;
+	image.Width = result.Width;
+	image.Height = result.Height;
+	image.Format = GetCompressedDxgiFormat(job.Format);
+	for (const MipLevel& mip : mips)
+	{
+		image.Mips.push_back(CompressImage(mip.Pixels.data(), mip.Width, mip.Height, job.Format));
+	}
+
+	// Quality of the top mip, over the channels the format keeps
+	std::vector<unsigned char> decoded = DecompressImage(image.Mips[0].data(), result.Width, result.Height, job.Format);
+	unsigned int channelMask =
+		job.Format == TextureCompressionFormat::BC1 ? 0x7 :
+		job.Format == TextureCompressionFormat::BC4 ? 0x1 :
+		job.Format == TextureCompressionFormat::BC5 ? 0x3 : 0xF;
+	result.PSNR = ComputeImagePSNR(rgba.data(), decoded.data(), result.Width, result.Height, channelMask);
+
+	result.MipLevels = (unsigned int)image.Mips.size();
+	result.Succeeded = WriteDDS(job.Destination, image);
+	if (!result.Succeeded)
+		result.Error = "Couldn't write " + WideToNarrow(job.Destination);
+
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	result.Milliseconds = elapsed.count();
+	return result.Succeeded;
+}
+
+std::wstring GetCookedTexturePath(const std::wstring& sourceFile)
+{
+	return std::filesystem::path(sourceFile).replace_extension(L".dds").wstring();
+}
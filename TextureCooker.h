@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "TextureCompression.h"
+#include "MipGenerator.h"
+
+// --------------------------------------------------------
+// The offline texture cook: decodes a source image (PNG,
+// JPG, anything WIC reads), builds its mip chain, block
+// compresses every mip and writes a .dds next to it, which
+// the game then loads instead of the source image.
+//
+// Run with:  TextureCook [folder]
+// (the portable build in CMakeLists.txt)
+// --------------------------------------------------------
+
+// --------------------------------------------------------
+// ORM textures pack a material's single-channel maps into
+// one, so the shader reads them all with a single fetch:
+//  R - ambient occlusion (white without an _ao map)
+//  G - roughness
+//  B - metalness
+// --------------------------------------------------------
+#define ORM_OCCLUSION_CHANNEL 0
+#define ORM_ROUGHNESS_CHANNEL 1
+#define ORM_METALNESS_CHANNEL 2
+
+struct ORMSourceFiles
+{
+	std::wstring Occlusion; // Optional
+	std::wstring Roughness;
+	std::wstring Metalness;
+};
+
+struct TextureCookJob
+{
+	std::wstring Source;
+	std::wstring Destination;
+	TextureCompressionFormat Format;
+	MipContent Content; // How mips are averaged
+
+	// Roughness maps only: the matching normal map, whose variance
+	// widens roughness in the smaller mips (empty for none)
+	std::wstring NormalMapSource;
+
+	// ORM jobs only: the maps packed together (Source is the roughness map)
+	ORMSourceFiles ORM;
+};
+
+struct TextureCookResult
+{
+	bool Succeeded;
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int MipLevels;
+	double PSNR; // Top mip, over the channels the format keeps
+	float Milliseconds;
+	std::string Error; // Why it failed, if it did
+};
+
+// Decodes any WIC-readable image to RGBA8
+bool LoadImageRGBA(const std::wstring& file, unsigned int& width, unsigned int& height, std::vector<unsigned char>& rgba);
+
+// The ORM maps of a material, from the path shared by its textures
+// (e.g. "Textures/wood" for wood_roughness.png and wood_metal.png)
+ORMSourceFiles GetORMSourceFiles(const std::wstring& materialPath);
+std::wstring GetORMTexturePath(const std::wstring& materialPath);
+
+// Decodes and packs a material's ORM maps.  They must all be the same
+// size, except that a map may be a whole fraction of the largest (like
+// a small, flat metalness mask), which is scaled up by repeating texels.
+bool LoadORMImage(const ORMSourceFiles& files, unsigned int& width, unsigned int& height, std::vector<unsigned char>& rgba, std::string& error);
+
+// One job per .png in a folder, with the format picked from its name:
+//  *_normals   -> BC5, renormalized mips
+//  *_roughness -> BC4, adjusted by *_normals if there is one
+//  *_metal     -> BC4
+//  anything else is color -> BC7, with mips averaged in linear space
+// except that a *_roughness and *_metal pair (and *_ao, if there is
+// one) cook together to a BC7 *_orm texture instead
+std::vector<TextureCookJob> GetTextureCookJobs(const std::wstring& folder);
+
+bool CookTexture(const TextureCookJob& job, TextureCookResult& result);
+
+// The .dds a source image cooks to
+std::wstring GetCookedTexturePath(const std::wstring& sourceFile);
@@ -0,0 +1,284 @@
+#include "TextureStreamer.h"
+#include "DDSFile.h"
+
+#include <thread>
+#include <utility>
+
+// Biggest array D3D11 allows
+#define MAX_ARRAY_SLICES D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+
+// --------------------------------------------------------
+// Creates a texture array holding mips [firstMip, end) of
+// a bucket, optionally filled with initial data (one entry
+// per subresource), and a view of all of it
+// --------------------------------------------------------
+static bool CreateStreamedArray(
+	ID3D11Device* device,
+	const TextureArrayBucket& bucket,
+	unsigned int firstMip,
+	const D3D11_SUBRESOURCE_DATA* initialData,
+	Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	unsigned int width = bucket.Width >> firstMip;
+	unsigned int height = bucket.Height >> firstMip;
+
+	D3D11_TEXTURE2D_DESC arrayDesc = {};
+	arrayDesc.Width = width > 0 ? width : 1;
+	arrayDesc.Height = height > 0 ? height : 1;
+	arrayDesc.MipLevels = bucket.MipLevels - firstMip;
+	arrayDesc.ArraySize = (UINT)bucket.Textures.size();
+	arrayDesc.Format = (DXGI_FORMAT)bucket.Format;
+	arrayDesc.SampleDesc.Count = 1;
+	arrayDesc.Usage = D3D11_USAGE_DEFAULT;
+	arrayDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	if (FAILED(device->CreateTexture2D(&arrayDesc, initialData, texture.ReleaseAndGetAddressOf())))
+		return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = arrayDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.MipLevels = arrayDesc.MipLevels;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = arrayDesc.ArraySize;
+	return SUCCEEDED(device->CreateShaderResourceView(texture.Get(), &srvDesc, srv.ReleaseAndGetAddressOf()));
+}
+
+// Bytes in one row of 4x4 blocks
+static unsigned int GetBlockRowPitch(const TextureArrayBucket& bucket, unsigned int mip)
+{
+	unsigned int width = bucket.Width >> mip;
+	return ((width > 0 ? width : 1) + 3) / 4 * GetDDSBlockSize(bucket.Format);
+}
+
+TextureStreamer::TextureStreamer(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	std::shared_ptr<ThreadPool> threadPool,
+	unsigned long long budgetBytes) :
+	m_device(device),
+	m_context(context),
+	m_planner(budgetBytes),
+	m_threadPool(threadPool),
+	m_loadsRunning(0)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Running loads read the plan and push into the queue
+	while (m_loadsRunning.load() > 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+unsigned int TextureStreamer::Add(const std::wstring& ddsFile)
+{
+	m_files.push_back(ddsFile);
+	return (unsigned int)m_files.size() - 1;
+}
+
+bool TextureStreamer::Build()
+{
+	// Group by full size, read from the headers alone
+	std::vector<TextureArrayInput> inputs(m_files.size());
+	for (size_t t = 0; t < m_files.size(); t++)
+	{
+		DDSImage header;
+		if (!ReadDDS(m_files[t], header, 0, 0))
+			return false;
+
+		inputs[t] = { header.Width, header.Height, header.Format, (unsigned int)header.Mips.size() };
+	}
+
+	m_plan = PlanTextureArrays(inputs, MAX_ARRAY_SLICES);
+	m_arrays.clear();
+	m_arrays.resize(m_plan.Arrays.size());
+
+	for (unsigned int a = 0; a < (unsigned int)m_plan.Arrays.size(); a++)
+	{
+		const TextureArrayBucket& bucket = m_plan.Arrays[a];
+
+		StreamingTextureInfo info = {};
+		info.Width = bucket.Width;
+		info.Height = bucket.Height;
+		info.MipLevels = bucket.MipLevels;
+		info.Slices = (unsigned int)bucket.Textures.size();
+		info.BlockBytes = GetDDSBlockSize(bucket.Format);
+		m_planner.AddTexture(info);
+		m_arrays[a].Loading = false;
+
+		// Every array starts out with just its tail
+		unsigned int tailMip = m_planner.GetTailMip(a);
+		unsigned int tailLevels = bucket.MipLevels - tailMip;
+		std::vector<DDSImage> tails(bucket.Textures.size());
+		std::vector<D3D11_SUBRESOURCE_DATA> initialData(bucket.Textures.size() * tailLevels);
+		for (unsigned int slice = 0; slice < (unsigned int)bucket.Textures.size(); slice++)
+		{
+			if (!ReadDDS(m_files[bucket.Textures[slice]], tails[slice], tailMip))
+				return false;
+
+			for (unsigned int mip = tailMip; mip < bucket.MipLevels; mip++)
+			{
+				D3D11_SUBRESOURCE_DATA& data = initialData[D3D11CalcSubresource(mip - tailMip, slice, tailLevels)];
+				data.pSysMem = tails[slice].Mips[mip].data();
+				data.SysMemPitch = GetBlockRowPitch(bucket, mip);
+			}
+		}
+
+		if (!CreateStreamedArray(m_device.Get(), bucket, tailMip, initialData.data(), m_arrays[a].Texture, m_arrays[a].SRV))
+			return false;
+	}
+
+	return true;
+}
+
+void TextureStreamer::RequestMip(unsigned int texture, float mip)
+{
+	// Arrays stream as a whole, so they follow their neediest slice
+	m_planner.RequestMip(m_plan.Slots[texture].Array, mip);
+}
+
+bool TextureStreamer::Update(unsigned int maxUploads)
+{
+	m_planner.Update();
+	bool changed = false;
+
+	// Finished loads go in if they're still the next mip up and still wanted.
+	// The rest wait in the queue for a later update.
+	MipLoad load;
+	for (unsigned int uploads = 0; uploads < maxUploads && m_finishedLoads.TryPop(load); uploads++)
+	{
+		m_arrays[load.Array].Loading = false;
+		if (load.Succeeded &&
+			m_planner.GetResidentMip(load.Array) == load.Mip + 1 &&
+			m_planner.GetTargetMip(load.Array) <= load.Mip)
+		{
+			changed = ResizeArray(load.Array, load.Mip, &load) || changed;
+		}
+	}
+	load = MipLoad(); // Frees the last one's pixels
+
+	// Evict right away, and load one level at a time
+	for (unsigned int a = 0; a < (unsigned int)m_arrays.size(); a++)
+	{
+		unsigned int target = m_planner.GetTargetMip(a);
+		unsigned int resident = m_planner.GetResidentMip(a);
+		if (target > resident)
+		{
+			changed = ResizeArray(a, target, nullptr) || changed;
+		}
+		else if (target < resident && !m_arrays[a].Loading)
+		{
+			MipLoad request = {};
+			request.Array = a;
+			request.Mip = resident - 1;
+			for (unsigned int texture : m_plan.Arrays[a].Textures)
+				request.Files.push_back(m_files[texture]);
+
+			m_arrays[a].Loading = true;
+			m_loadsRunning++;
+			m_threadPool->Submit([this, request = std::move(request)]() mutable
+			{
+				LoadMip(request);
+				m_finishedLoads.Push(std::move(request));
+				m_loadsRunning--;
+			});
+		}
+	}
+
+	return changed;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureStreamer::GetArraySRV(unsigned int texture) const
+{
+	return m_arrays[m_plan.Slots[texture].Array].SRV;
+}
+
+unsigned int TextureStreamer::GetSlice(unsigned int texture) const { return m_plan.Slots[texture].Slice; }
+unsigned int TextureStreamer::GetArrayIndex(unsigned int texture) const { return m_plan.Slots[texture].Array; }
+unsigned int TextureStreamer::GetArrayCount() const { return (unsigned int)m_arrays.size(); }
+unsigned int TextureStreamer::GetWidth(unsigned int texture) const { return m_plan.Arrays[m_plan.Slots[texture].Array].Width; }
+const TextureStreamingPlanner& TextureStreamer::GetPlanner() const { return m_planner; }
+
+unsigned int TextureStreamer::GetPendingLoadCount() const
+{
+	unsigned int pending = 0;
+	for (const StreamedArray& array : m_arrays)
+	{
+		if (array.Loading)
+			pending++;
+	}
+	return pending;
+}
+
+void TextureStreamer::SetBudget(unsigned long long budgetBytes)
+{
+	m_planner.SetBudget(budgetBytes);
+}
+
+void TextureStreamer::LoadMip(MipLoad& load) const
+{
+	// The files could have been re-cooked since, so check they still fit
+	const TextureArrayBucket& bucket = m_plan.Arrays[load.Array];
+	unsigned int width = bucket.Width >> load.Mip;
+	unsigned int height = bucket.Height >> load.Mip;
+	size_t expectedSize = GetDDSMipSize(bucket.Format, width > 0 ? width : 1, height > 0 ? height : 1);
+
+	load.Succeeded = true;
+	load.Slices.resize(load.Files.size());
+	for (size_t slice = 0; slice < load.Files.size(); slice++)
+	{
+		DDSImage image;
+		if (!ReadDDS(load.Files[slice], image, load.Mip, 1) ||
+			image.Mips.size() != bucket.MipLevels ||
+			image.Mips[load.Mip].size() != expectedSize)
+		{
+			load.Succeeded = false;
+			return;
+		}
+		load.Slices[slice] = std::move(image.Mips[load.Mip]);
+	}
+}
+
+bool TextureStreamer::ResizeArray(unsigned int array, unsigned int firstMip, const MipLoad* newMip)
+{
+	const TextureArrayBucket& bucket = m_plan.Arrays[array];
+	StreamedArray& streamed = m_arrays[array];
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (!CreateStreamedArray(m_device.Get(), bucket, firstMip, 0, texture, srv))
+		return false;
+
+	unsigned int oldFirstMip = m_planner.GetResidentMip(array);
+	unsigned int oldLevels = bucket.MipLevels - oldFirstMip;
+	unsigned int newLevels = bucket.MipLevels - firstMip;
+	unsigned int keptMip = firstMip > oldFirstMip ? firstMip : oldFirstMip;
+
+	for (unsigned int slice = 0; slice < (unsigned int)bucket.Textures.size(); slice++)
+	{
+		// Whatever both arrays hold is copied straight across on the GPU
+		for (unsigned int mip = keptMip; mip < bucket.MipLevels; mip++)
+		{
+			m_context->CopySubresourceRegion(
+				texture.Get(), D3D11CalcSubresource(mip - firstMip, slice, newLevels), 0, 0, 0,
+				streamed.Texture.Get(), D3D11CalcSubresource(mip - oldFirstMip, slice, oldLevels), 0);
+		}
+
+		if (newMip)
+		{
+			m_context->UpdateSubresource(
+				texture.Get(), D3D11CalcSubresource(newMip->Mip - firstMip, slice, newLevels), 0,
+				newMip->Slices[slice].data(), GetBlockRowPitch(bucket, newMip->Mip), 0);
+		}
+	}
+
+	streamed.Texture = texture;
+	streamed.SRV = srv;
+	m_planner.SetResidentMip(array, firstMip);
+	return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MPSCQueue.h"
+#include "TextureArrayPacker.h"
+#include "TextureStreaming.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Streams the mips of cooked (.dds) textures in and out of
+// Texture2DArrays as they're needed, within a memory budget.
+//
+// Arrays are grouped like TextureArrayBuilder's, but by each
+// texture's full size, and start out with just their mip
+// tails.  Each array then streams as one texture: its lowest
+// wanted mip over every slice decides what it loads.
+//
+//   unsigned int albedo = streamer.Add(L"wood_albedo.dds");
+//   ...
+//   streamer.Build();
+//   material->AddTextureSRV("Albedo", streamer.GetArraySRV(albedo), streamer.GetSlice(albedo));
+//
+//   // Every frame
+//   streamer.RequestMip(albedo, mip); // For each visible use
+//   if (streamer.Update(maxUploads))
+//       // Re-fetch GetArraySRV() for anything using the arrays
+//
+// Mips are read on the thread pool one level at a time, so
+// detail sharpens in steps, and come back through a lock-free
+// queue.  D3D11 textures can't change
+// their mip count, so each step (or eviction) re-creates the
+// array and copies the mips it keeps across on the GPU.
+// --------------------------------------------------------
+class TextureStreamer
+{
+public:
+	TextureStreamer(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		std::shared_ptr<ThreadPool> threadPool,
+		unsigned long long budgetBytes);
+	~TextureStreamer();
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// Returns the texture's index for the functions below
+	unsigned int Add(const std::wstring& ddsFile);
+
+	// Reads each file's header and mip tail, and creates the arrays.
+	// Returns false if a file couldn't be read or a texture created.
+	bool Build();
+
+	// The (fractional) mip a texture is needed at this frame
+	void RequestMip(unsigned int texture, float mip);
+
+	// Plans residency, then evicts and applies up to maxUploads
+	// finished loads.  Returns true if any array SRVs changed.
+	bool Update(unsigned int maxUploads);
+
+	// Getters
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetArraySRV(unsigned int texture) const;
+	unsigned int GetSlice(unsigned int texture) const;
+	unsigned int GetArrayIndex(unsigned int texture) const;
+	unsigned int GetArrayCount() const;
+	unsigned int GetWidth(unsigned int texture) const; // Of its full size mip
+	unsigned int GetPendingLoadCount() const;
+	const TextureStreamingPlanner& GetPlanner() const;
+
+	// Setters
+	void SetBudget(unsigned long long budgetBytes);
+
+private:
+	struct StreamedArray
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+		bool Loading; // A mip is on its way from the thread pool
+	};
+
+	// One mip of every slice of an array
+	struct MipLoad
+	{
+		unsigned int Array;
+		unsigned int Mip;
+		std::vector<std::wstring> Files;
+		std::vector<std::vector<unsigned char>> Slices;
+		bool Succeeded;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+
+	std::vector<std::wstring> m_files;
+	TextureArrayPlan m_plan;
+	std::vector<StreamedArray> m_arrays;
+	TextureStreamingPlanner m_planner; // One texture per array
+
+	// Loads run as pool tasks, and come back through the queue
+	std::shared_ptr<ThreadPool> m_threadPool;
+	MPSCQueue<MipLoad> m_finishedLoads;
+	std::atomic<unsigned int> m_loadsRunning;
+
+	// Reads one mip of every slice (on a worker)
+	void LoadMip(MipLoad& load) const;
+
+	// Swaps an array for one holding mips [firstMip, end), copying the
+	// ones it already has and uploading newMip (if given) on top
+	bool ResizeArray(unsigned int array, unsigned int firstMip, const MipLoad* newMip);
+};
@@ -0,0 +1,219 @@
+#include "TextureStreaming.h"
+
+#include <cfloat>
+#include <cmath>
+
+float ComputeMeshUVDensity(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount)
+{
+	double surfaceArea = 0.0;
+	double uvArea = 0.0;
+	for (unsigned int ii = 0; ii + 2 < indexCount; ii += 3)
+	{
+		const Vertex& v0 = vertices[indices[ii]];
+		const Vertex& v1 = vertices[indices[ii + 1]];
+		const Vertex& v2 = vertices[indices[ii + 2]];
+
+		// Half the length of the edges' cross product
+		float e1x = v1.Position.x - v0.Position.x;
+		float e1y = v1.Position.y - v0.Position.y;
+		float e1z = v1.Position.z - v0.Position.z;
+		float e2x = v2.Position.x - v0.Position.x;
+		float e2y = v2.Position.y - v0.Position.y;
+		float e2z = v2.Position.z - v0.Position.z;
+		float cx = e1y * e2z - e1z * e2y;
+		float cy = e1z * e2x - e1x * e2z;
+		float cz = e1x * e2y - e1y * e2x;
+		surfaceArea += 0.5 * sqrt((double)cx * cx + (double)cy * cy + (double)cz * cz);
+
+		// Same in 2D, where mirrored UVs still count as positive area
+		float u1 = v1.UV.x - v0.UV.x;
+		float w1 = v1.UV.y - v0.UV.y;
+		float u2 = v2.UV.x - v0.UV.x;
+		float w2 = v2.UV.y - v0.UV.y;
+		uvArea += 0.5 * fabs((double)u1 * w2 - (double)w1 * u2);
+	}
+
+	if (surfaceArea <= 0.0 || uvArea <= 0.0)
+		return 0.0f;
+
+	return (float)sqrt(uvArea / surfaceArea);
+}
+
+float ComputeRequiredMip(float textureSize, float uvPerWorldUnit, float distance, float screenScale)
+{
+	// Nothing to go on, so ask for full resolution
+	if (uvPerWorldUnit <= 0.0f || screenScale <= 0.0f)
+		return 0.0f;
+
+	// Texels covered by one pixel, where each mip halves the texels
+	float texelsPerPixel = textureSize * uvPerWorldUnit * fmaxf(distance, 1e-3f) / screenScale;
+	return fmaxf(log2f(texelsPerPixel), 0.0f);
+}
+
+unsigned int GetStreamingTailMip(unsigned int width, unsigned int height, unsigned int mipLevels)
+{
+	// No chain at all, so the only thing there could be is mip 0
+	if (mipLevels == 0)
+		return 0;
+
+	// Shifting by 32 or more is undefined, and every size is 0 by then anyway
+	if (mipLevels > 32)
+		mipLevels = 32;
+
+	for (unsigned int mip = 0; mip < mipLevels; mip++)
+	{
+		unsigned int mipWidth = width >> mip;
+		unsigned int mipHeight = height >> mip;
+		if (mipWidth <= STREAMING_TAIL_SIZE && mipHeight <= STREAMING_TAIL_SIZE)
+			return mip;
+	}
+	return mipLevels - 1;
+}
+
+TextureStreamingPlanner::TextureStreamingPlanner(unsigned long long budgetBytes) :
+	m_budget(budgetBytes)
+{
+}
+
+unsigned int TextureStreamingPlanner::AddTexture(const StreamingTextureInfo& info)
+{
+	TextureState texture = {};
+	texture.Info = info;
+
+	// A texture always has at least its top mip, like a DDS file without a count
+	if (texture.Info.MipLevels == 0)
+		texture.Info.MipLevels = 1;
+
+	texture.TailMip = GetStreamingTailMip(info.Width, info.Height, texture.Info.MipLevels);
+	texture.RequestedMip = FLT_MAX;
+	texture.KeptMip = (float)texture.TailMip;
+	texture.KeptUpdates = 0;
+	texture.WantedMip = texture.TailMip;
+	texture.TargetMip = texture.TailMip;
+	texture.ResidentMip = texture.TailMip;
+
+	m_textures.push_back(texture);
+	return (unsigned int)m_textures.size() - 1;
+}
+
+void TextureStreamingPlanner::RequestMip(unsigned int texture, float mip)
+{
+	TextureState& state = m_textures[texture];
+	if (mip < state.RequestedMip)
+		state.RequestedMip = mip;
+}
+
+void TextureStreamingPlanner::Update()
+{
+	unsigned long long totalBytes = 0;
+	for (unsigned int t = 0; t < m_textures.size(); t++)
+	{
+		TextureState& texture = m_textures[t];
+
+		// A finer request takes over right away, and a coarser one (or
+		// none at all) only once the finer one has gone unused a while
+		float requested = fminf(texture.RequestedMip, (float)texture.TailMip);
+		if (requested <= texture.KeptMip || texture.KeptUpdates == 0)
+		{
+			texture.KeptMip = requested;
+			texture.KeptUpdates = STREAMING_KEEP_UPDATES;
+		}
+		else
+		{
+			texture.KeptUpdates--;
+		}
+		texture.RequestedMip = FLT_MAX;
+
+		// Round down, so there's never fewer texels than pixels
+		texture.WantedMip = (unsigned int)floorf(texture.KeptMip);
+		texture.TargetMip = texture.WantedMip;
+		totalBytes += GetMipChainBytes(t, texture.TargetMip);
+	}
+
+	// Over budget, so drop whichever top mip is biggest until it fits
+	while (totalBytes > m_budget)
+	{
+		TextureState* largest = nullptr;
+		unsigned long long largestBytes = 0;
+		for (TextureState& texture : m_textures)
+		{
+			if (texture.TargetMip >= texture.TailMip)
+				continue;
+
+			unsigned long long bytes = GetMipBytes(texture, texture.TargetMip);
+			if (bytes > largestBytes)
+			{
+				largest = &texture;
+				largestBytes = bytes;
+			}
+		}
+
+		// Only tails are left
+		if (!largest)
+			break;
+
+		largest->TargetMip++;
+		totalBytes -= largestBytes;
+	}
+}
+
+unsigned int TextureStreamingPlanner::GetTextureCount() const { return (unsigned int)m_textures.size(); }
+const StreamingTextureInfo& TextureStreamingPlanner::GetInfo(unsigned int texture) const { return m_textures[texture].Info; }
+unsigned int TextureStreamingPlanner::GetTailMip(unsigned int texture) const { return m_textures[texture].TailMip; }
+unsigned int TextureStreamingPlanner::GetWantedMip(unsigned int texture) const { return m_textures[texture].WantedMip; }
+unsigned int TextureStreamingPlanner::GetTargetMip(unsigned int texture) const { return m_textures[texture].TargetMip; }
+unsigned int TextureStreamingPlanner::GetResidentMip(unsigned int texture) const { return m_textures[texture].ResidentMip; }
+unsigned long long TextureStreamingPlanner::GetBudget() const { return m_budget; }
+
+unsigned long long TextureStreamingPlanner::GetResidentBytes() const
+{
+	unsigned long long bytes = 0;
+	for (unsigned int t = 0; t < m_textures.size(); t++)
+		bytes += GetMipChainBytes(t, m_textures[t].ResidentMip);
+	return bytes;
+}
+
+unsigned long long TextureStreamingPlanner::GetWantedBytes() const
+{
+	unsigned long long bytes = 0;
+	for (unsigned int t = 0; t < m_textures.size(); t++)
+		bytes += GetMipChainBytes(t, m_textures[t].WantedMip);
+	return bytes;
+}
+
+unsigned long long TextureStreamingPlanner::GetTargetBytes() const
+{
+	unsigned long long bytes = 0;
+	for (unsigned int t = 0; t < m_textures.size(); t++)
+		bytes += GetMipChainBytes(t, m_textures[t].TargetMip);
+	return bytes;
+}
+
+unsigned long long TextureStreamingPlanner::GetMipChainBytes(unsigned int texture, unsigned int firstMip) const
+{
+	const TextureState& state = m_textures[texture];
+
+	unsigned long long bytes = 0;
+	for (unsigned int mip = firstMip; mip < state.Info.MipLevels; mip++)
+		bytes += GetMipBytes(state, mip);
+	return bytes;
+}
+
+void TextureStreamingPlanner::SetResidentMip(unsigned int texture, unsigned int mip)
+{
+	m_textures[texture].ResidentMip = mip;
+}
+
+void TextureStreamingPlanner::SetBudget(unsigned long long budgetBytes)
+{
+	m_budget = budgetBytes;
+}
+
+unsigned long long TextureStreamingPlanner::GetMipBytes(const TextureState& texture, unsigned int mip) const
+{
+	unsigned int width = mip < 32 ? texture.Info.Width >> mip : 0;
+	unsigned int height = mip < 32 ? texture.Info.Height >> mip : 0;
+	unsigned long long blocksWide = ((width > 0 ? width : 1) + 3) / 4;
+	unsigned long long blocksHigh = ((height > 0 ? height : 1) + 3) / 4;
+	return blocksWide * blocksHigh * texture.Info.BlockBytes * texture.Info.Slices;
+}
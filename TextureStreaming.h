@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+
+#include "Vertex.h"
+
+// Mips this small and smaller are always resident, so there's
+// always something to sample while the rest stream in
+#define STREAMING_TAIL_SIZE 64
+
+// How long (in updates) a texture keeps its mips after it was
+// last seen, so turning the camera away and back doesn't thrash
+#define STREAMING_KEEP_UPDATES 120
+
+// --------------------------------------------------------
+// Average UV units per object space unit over a mesh's
+// triangles, sqrt(UV area / surface area), or 0 for a mesh
+// with no UV or surface area.  Precomputed per mesh and used
+// to turn an object's size on screen into texels.
+// --------------------------------------------------------
+float ComputeMeshUVDensity(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount);
+
+// --------------------------------------------------------
+// The (fractional) mip of a textureSize-texel texture that
+// matches the screen's pixel density:
+//  uvPerWorldUnit - the mesh's UV density, times the material's
+//                   UV scale, over the object's world scale
+//  distance       - from the camera to the object's closest point
+//  screenScale    - pixels per world unit at a distance of 1:
+//                   viewport height / (2 * tan(fov / 2))
+// Never below 0.
+// --------------------------------------------------------
+float ComputeRequiredMip(float textureSize, float uvPerWorldUnit, float distance, float screenScale);
+
+// First mip at or below STREAMING_TAIL_SIZE, or the last mip if none
+// are that small (0 when there are no mips at all)
+unsigned int GetStreamingTailMip(unsigned int width, unsigned int height, unsigned int mipLevels);
+
+// --------------------------------------------------------
+// One streamed texture (a whole texture array streams
+// together, so Slices counts them).  Only block compressed
+// formats are streamed, so sizes come from BlockBytes.
+// --------------------------------------------------------
+struct StreamingTextureInfo
+{
+	unsigned int Width; // Of mip 0
+	unsigned int Height;
+	unsigned int MipLevels; // Full chain
+	unsigned int Slices;
+	unsigned int BlockBytes; // Per 4x4 block
+};
+
+// --------------------------------------------------------
+// Decides which mips of each texture should be resident.
+// Nothing in here touches Direct3D or files, so the policy
+// can be run (and tested) on its own:
+//
+//   planner.RequestMip(texture, mip); // Per visible use, per frame
+//   planner.Update();                 // Once per frame
+//   planner.GetTargetMip(texture);    // What to load or evict down to
+//   planner.SetResidentMip(texture, mip); // Once it's done
+//
+// Each texture wants the lowest mip requested of it over the
+// last STREAMING_KEEP_UPDATES updates, or just its tail.  If
+// that doesn't fit the budget, the largest top mip anywhere
+// is dropped, over and over, until it does.  Tails are never
+// dropped, even past the budget.
+// --------------------------------------------------------
+class TextureStreamingPlanner
+{
+public:
+	TextureStreamingPlanner(unsigned long long budgetBytes);
+
+	// Starts out with only its tail resident, and returns its index.
+	// A MipLevels of 0 is taken to mean just the top mip.
+	unsigned int AddTexture(const StreamingTextureInfo& info);
+
+	void RequestMip(unsigned int texture, float mip);
+	void Update();
+
+	// Getters
+	unsigned int GetTextureCount() const;
+	const StreamingTextureInfo& GetInfo(unsigned int texture) const;
+	unsigned int GetTailMip(unsigned int texture) const;
+	unsigned int GetWantedMip(unsigned int texture) const; // Before the budget
+	unsigned int GetTargetMip(unsigned int texture) const; // After the budget
+	unsigned int GetResidentMip(unsigned int texture) const;
+	unsigned long long GetBudget() const;
+
+	// Totals, over every texture
+	unsigned long long GetResidentBytes() const;
+	unsigned long long GetWantedBytes() const;
+	unsigned long long GetTargetBytes() const;
+
+	// Bytes of every slice of mips [firstMip, end)
+	unsigned long long GetMipChainBytes(unsigned int texture, unsigned int firstMip) const;
+
+	// Setters
+	void SetResidentMip(unsigned int texture, unsigned int mip);
+	void SetBudget(unsigned long long budgetBytes);
+
+private:
+	struct TextureState
+	{
+		StreamingTextureInfo Info;
+		unsigned int TailMip;
+
+		float RequestedMip; // Lowest asked for since the last update
+		float KeptMip; // Lowest asked for recently
+		unsigned int KeptUpdates; // Updates left before KeptMip lapses
+
+		unsigned int WantedMip;
+		unsigned int TargetMip;
+		unsigned int ResidentMip;
+	};
+
+	std::vector<TextureState> m_textures;
+	unsigned long long m_budget;
+
+	unsigned long long GetMipBytes(const TextureState& texture, unsigned int mip) const;
+};
@@ -0,0 +1,139 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int numThreads) :
+	m_job(nullptr),
+	m_jobCount(0),
+	m_nextIndex(0),
+	m_activeWorkers(0),
+	m_generation(0),
+	m_shuttingDown(false)
+{
+	if (numThreads == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		numThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	m_workers.reserve(numThreads);
+	for (unsigned int ii = 0; ii < numThreads; ii++)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shuttingDown = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return static_cast<unsigned int>(m_workers.size()) + 1;
+}
+
+void ThreadPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Not worth waking anyone up for a single item
+	if (count == 1)
+	{
+		job(0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &job;
+		m_jobCount = count;
+		m_nextIndex = 0;
+		m_activeWorkers = 0;
+		m_generation++;
+	}
+	m_wakeCondition.notify_all();
+
+	// The calling thread helps out instead of idling
+	RunJobs();
+
+	// Wait for the workers that joined in, so the job can safely go out
+	// of scope.  Clearing it under the same lock stops any more joining.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this] { return m_activeWorkers == 0; });
+	m_job = nullptr;
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_wakeCondition.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	unsigned long long seenGeneration = 0;
+
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [&]
+			{
+				return m_shuttingDown || !m_tasks.empty() || (m_job && m_generation != seenGeneration);
+			});
+
+			// Join the running ParallelFor(), if there is one
+			if (m_job && m_generation != seenGeneration)
+			{
+				seenGeneration = m_generation;
+				m_activeWorkers++;
+				lock.unlock();
+
+				RunJobs();
+
+				lock.lock();
+				m_activeWorkers--;
+				lock.unlock();
+				m_doneCondition.notify_one();
+				continue;
+			}
+
+			// Otherwise take a task, finishing them all before shutting down
+			if (m_tasks.empty())
+			{
+				return;
+			}
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+void ThreadPool::RunJobs()
+{
+	const std::function<void(unsigned int)>& job = *m_job;
+	unsigned int count = m_jobCount;
+
+	for (unsigned int ii = m_nextIndex++; ii < count; ii = m_nextIndex++)
+	{
+		job(ii);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A small fixed-size pool of worker threads used for
+// data-parallel CPU work (culling, baking, etc.)
+//
+// ParallelFor() splits a range of indices across the workers
+// and the calling thread, and returns once every index is done
+//
+// Submit() queues a task to run on a worker whenever one is
+// free, without waiting for it (file loading, decoding).
+// Workers take ParallelFor() jobs first, and a ParallelFor()
+// never waits on a worker that's busy with a task - the
+// calling thread just does more of the indices itself.
+// Queued tasks are all run before the pool shuts down.
+// --------------------------------------------------------
+class ThreadPool
+{
+public:
+	// numThreads - worker count, or 0 to use (hardware threads - 1)
+	ThreadPool(unsigned int numThreads = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& job);
+	void Submit(std::function<void()> task);
+
+	// Worker threads plus the calling thread
+	unsigned int GetThreadCount() const;
+
+private:
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+
+	// Current job - only valid while a ParallelFor() is running
+	const std::function<void(unsigned int)>* m_job;
+	unsigned int m_jobCount;
+	std::atomic<unsigned int> m_nextIndex;
+	unsigned int m_activeWorkers; // Workers that joined the current job
+	unsigned long long m_generation;
+	bool m_shuttingDown;
+
+	// Submitted tasks, oldest first
+	std::deque<std::function<void()>> m_tasks;
+
+	void WorkerLoop();
+	void RunJobs();
+};
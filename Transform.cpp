@@ -1,5 +1,7 @@
 #include "Transform.h"
 
+#include <cstring>
+
 using namespace DirectX;
 
 Transform::Transform() :
@@ -10,7 +12,8 @@ Transform::Transform() :
 	m_up(0.0f, 1.0f, 0.0f),
 	m_forward(0.0f, 0.0f, 1.0f),
 	m_isDirty(false),
-	m_isRotationDirty(false)
+	m_isRotationDirty(false),
+	m_version(0)
 {
 	XMStoreFloat4x4(&m_worldMatrix, XMMatrixIdentity());
 	XMStoreFloat4x4(&m_worldInverseTransposeMatrix, XMMatrixIdentity());
@@ -103,6 +106,12 @@ XMFLOAT3 Transform::GetForward()
 	return m_forward;
 }
 
+unsigned long long Transform::GetVersion()
+{
+	UpdateWorldMatrix();
+	return m_version;
+}
+
 void Transform::UpdateLocalVectors()
 {
 	if (m_isRotationDirty)
@@ -134,7 +143,14 @@ void Transform::UpdateWorldMatrix()
 
 		XMMATRIX worldMatrix = scaleMat * rotateMat * translateMat;
 
-		XMStoreFloat4x4(&m_worldMatrix, worldMatrix);
+		XMFLOAT4X4 newWorldMatrix;
+		XMStoreFloat4x4(&newWorldMatrix, worldMatrix);
+		if (memcmp(&newWorldMatrix, &m_worldMatrix, sizeof(XMFLOAT4X4)) != 0)
+		{
+			m_version++;
+		}
+
+		m_worldMatrix = newWorldMatrix;
 
 		XMStoreFloat4x4(&m_worldInverseTransposeMatrix,
 			XMMatrixInverse(0, XMMatrixTranspose(worldMatrix)));
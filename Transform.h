@@ -24,6 +24,7 @@ public:
 	DirectX::XMFLOAT3 GetRight();
 	DirectX::XMFLOAT3 GetUp();
 	DirectX::XMFLOAT3 GetForward();
+	unsigned long long GetVersion(); // Changes whenever the world matrix actually changes
 
 	// Transformers
 	void MoveAbsolute(float x, float y, float z);
@@ -56,6 +57,10 @@ private:
 	bool m_isDirty;
 	bool m_isRotationDirty;
 
+	// Bumped only when the rebuilt world matrix differs from the last one,
+	// so re-setting the same values every frame doesn't count as a change
+	unsigned long long m_version;
+
 	void UpdateWorldMatrix();
 	void UpdateLocalVectors();
 };
\ No newline at end of file
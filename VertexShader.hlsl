@@ -1,13 +1,17 @@
 #include "ShaderIncludes.hlsli"
 
-cbuffer ExternalData : register(b0)
+// Constants are grouped by how often they change
+
+cbuffer PerFrame : register(b0)
 {
-	matrix world;
 	matrix view;
 	matrix projection;
+}
+
+cbuffer PerObject : register(b2)
+{
+	matrix world;
 	matrix worldInvTranspose;
-	matrix lightView;
-	matrix lightProjection;
 }
 
 // --------------------------------------------------------
@@ -38,9 +42,8 @@ VertexToPixel main( VertexShaderInput input )
 	output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
 	output.tangent = mul((float3x3)world, input.tangent);
 
-	// WVP Calculation for shadow map
-	matrix shadowWVP = mul(lightProjection, mul(lightView, world));
-	output.shadowMapPos = mul(shadowWVP, float4(input.localPosition, 1.0f));
+	// View space depth picks the shadow cascade in the pixel shader
+	output.viewDepth = mul(view, float4(output.worldPosition, 1.0f)).z;
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
@@ -0,0 +1,232 @@
+#include "VirtualShadowMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+VirtualShadowMap::VirtualShadowMap() :
+	m_frame(0),
+	m_pageTableChanged(true),
+	m_residentPageCount(0),
+	m_evictionCount(0),
+	m_unmappedPageCount(0)
+{
+	m_virtualPages.resize(VSM_PAGES_PER_SIDE * VSM_PAGES_PER_SIDE, { VSM_INVALID_PAGE, false, false });
+	m_physicalPages.resize(VSM_PHYSICAL_PAGES_PER_SIDE * VSM_PHYSICAL_PAGES_PER_SIDE, { VSM_INVALID_PAGE, 0 });
+	m_pageTable.resize(m_virtualPages.size(), VSM_INVALID_PAGE);
+}
+
+void VirtualShadowMap::BeginFrame()
+{
+	m_frame++;
+
+	for (unsigned int page : m_neededPages)
+	{
+		m_virtualPages[page].Needed = false;
+	}
+	m_neededPages.clear();
+	m_pagesToRender.clear();
+	m_pageTableChanged = false;
+}
+
+bool VirtualShadowMap::GetPageRange(const XMFLOAT2& uvMin, const XMFLOAT2& uvMax,
+	unsigned int& minX, unsigned int& minY, unsigned int& maxX, unsigned int& maxY) const
+{
+	if (uvMax.x < 0.0f || uvMax.y < 0.0f || uvMin.x > 1.0f || uvMin.y > 1.0f ||
+		uvMin.x > uvMax.x || uvMin.y > uvMax.y)
+	{
+		return false;
+	}
+
+	// Clamp in float first - huge values don't survive a cast to int
+	const float lastPage = (float)(VSM_PAGES_PER_SIDE - 1);
+	minX = (unsigned int)std::clamp(std::floor(uvMin.x * VSM_PAGES_PER_SIDE), 0.0f, lastPage);
+	minY = (unsigned int)std::clamp(std::floor(uvMin.y * VSM_PAGES_PER_SIDE), 0.0f, lastPage);
+	maxX = (unsigned int)std::clamp(std::floor(uvMax.x * VSM_PAGES_PER_SIDE), 0.0f, lastPage);
+	maxY = (unsigned int)std::clamp(std::floor(uvMax.y * VSM_PAGES_PER_SIDE), 0.0f, lastPage);
+	return true;
+}
+
+void VirtualShadowMap::MarkNeeded(const XMFLOAT2& uvMin, const XMFLOAT2& uvMax)
+{
+	unsigned int minX, minY, maxX, maxY;
+	if (!GetPageRange(uvMin, uvMax, minX, minY, maxX, maxY))
+	{
+		return;
+	}
+
+	for (unsigned int y = minY; y <= maxY; y++)
+	{
+		for (unsigned int x = minX; x <= maxX; x++)
+		{
+			unsigned int page = y * VSM_PAGES_PER_SIDE + x;
+			if (!m_virtualPages[page].Needed)
+			{
+				m_virtualPages[page].Needed = true;
+				m_neededPages.push_back(page);
+			}
+		}
+	}
+}
+
+void VirtualShadowMap::UpdateCaster(const unsigned int casterId,
+	const XMFLOAT2& uvMin,
+	const XMFLOAT2& uvMax,
+	const unsigned long long version)
+{
+	if (casterId >= m_casters.size())
+	{
+		m_casters.resize(casterId + 1, { XMFLOAT2(), XMFLOAT2(), 0, false });
+	}
+
+	CasterRecord& caster = m_casters[casterId];
+	if (caster.Valid && caster.Version == version)
+	{
+		return;
+	}
+
+	// Both where it was and where it is now have changed depths
+	if (caster.Valid)
+	{
+		Invalidate(caster.UVMin, caster.UVMax);
+	}
+	Invalidate(uvMin, uvMax);
+
+	caster = { uvMin, uvMax, version, true };
+}
+
+void VirtualShadowMap::Invalidate(const XMFLOAT2& uvMin, const XMFLOAT2& uvMax)
+{
+	unsigned int minX, minY, maxX, maxY;
+	if (!GetPageRange(uvMin, uvMax, minX, minY, maxX, maxY))
+	{
+		return;
+	}
+
+	// Unmapped pages get rendered when they're mapped anyway
+	for (unsigned int y = minY; y <= maxY; y++)
+	{
+		for (unsigned int x = minX; x <= maxX; x++)
+		{
+			VirtualPage& page = m_virtualPages[y * VSM_PAGES_PER_SIDE + x];
+			if (page.PhysicalPage != VSM_INVALID_PAGE)
+			{
+				page.Dirty = true;
+			}
+		}
+	}
+}
+
+void VirtualShadowMap::InvalidateAll()
+{
+	for (VirtualPage& page : m_virtualPages)
+	{
+		page.Dirty = page.PhysicalPage != VSM_INVALID_PAGE;
+	}
+
+	// Caster footprints are meaningless once everything moves
+	m_casters.clear();
+}
+
+void VirtualShadowMap::Update()
+{
+	// Physical pages that can be handed out, least recently used first.
+	// Free pages have never been used, so they sort to the front.
+	std::vector<unsigned int> evictable;
+	for (unsigned int ii = 0; ii < m_physicalPages.size(); ii++)
+	{
+		unsigned int virtualPage = m_physicalPages[ii].VirtualPage;
+		if (virtualPage == VSM_INVALID_PAGE || !m_virtualPages[virtualPage].Needed)
+		{
+			evictable.push_back(ii);
+		}
+	}
+	std::sort(evictable.begin(), evictable.end(), [this](unsigned int a, unsigned int b) {
+		return m_physicalPages[a].LastUsedFrame < m_physicalPages[b].LastUsedFrame;
+	});
+	size_t nextEvictable = 0;
+
+	m_unmappedPageCount = 0;
+	for (unsigned int virtualIndex : m_neededPages)
+	{
+		VirtualPage& page = m_virtualPages[virtualIndex];
+
+		if (page.PhysicalPage == VSM_INVALID_PAGE)
+		{
+			if (nextEvictable == evictable.size())
+			{
+				m_unmappedPageCount++;
+				continue;
+			}
+
+			unsigned int physicalIndex = evictable[nextEvictable++];
+			PhysicalPage& physical = m_physicalPages[physicalIndex];
+
+			if (physical.VirtualPage != VSM_INVALID_PAGE)
+			{
+				m_virtualPages[physical.VirtualPage].PhysicalPage = VSM_INVALID_PAGE;
+				m_virtualPages[physical.VirtualPage].Dirty = false;
+				m_pageTable[physical.VirtualPage] = VSM_INVALID_PAGE;
+				m_evictionCount++;
+			}
+			else
+			{
+				m_residentPageCount++;
+			}
+
+			physical.VirtualPage = virtualIndex;
+			page.PhysicalPage = physicalIndex;
+			page.Dirty = true;
+			m_pageTable[virtualIndex] = physicalIndex;
+			m_pageTableChanged = true;
+		}
+
+		m_physicalPages[page.PhysicalPage].LastUsedFrame = m_frame;
+
+		if (page.Dirty)
+		{
+			m_pagesToRender.push_back({
+				virtualIndex % VSM_PAGES_PER_SIDE,
+				virtualIndex / VSM_PAGES_PER_SIDE,
+				page.PhysicalPage % VSM_PHYSICAL_PAGES_PER_SIDE,
+				page.PhysicalPage / VSM_PHYSICAL_PAGES_PER_SIDE });
+			page.Dirty = false;
+		}
+	}
+}
+
+const std::vector<VirtualShadowMap::PageRender>& VirtualShadowMap::GetPagesToRender() const
+{
+	return m_pagesToRender;
+}
+
+const std::vector<unsigned int>& VirtualShadowMap::GetPageTable() const
+{
+	return m_pageTable;
+}
+
+bool VirtualShadowMap::IsPageTableChanged() const
+{
+	return m_pageTableChanged;
+}
+
+unsigned int VirtualShadowMap::GetNeededPageCount() const
+{
+	return static_cast<unsigned int>(m_neededPages.size());
+}
+
+unsigned int VirtualShadowMap::GetResidentPageCount() const
+{
+	return m_residentPageCount;
+}
+
+unsigned int VirtualShadowMap::GetEvictionCount() const
+{
+	return m_evictionCount;
+}
+
+unsigned int VirtualShadowMap::GetUnmappedPageCount() const
+{
+	return m_unmappedPageCount;
+}
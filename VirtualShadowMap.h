@@ -0,0 +1,102 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Must match the VSM_ defines in ShaderIncludes.hlsli
+#define VSM_VIRTUAL_SIZE (16384)
+#define VSM_PAGE_SIZE (128)
+#define VSM_PAGES_PER_SIDE (VSM_VIRTUAL_SIZE / VSM_PAGE_SIZE)
+#define VSM_PHYSICAL_PAGES_PER_SIDE (32)
+#define VSM_INVALID_PAGE (0xFFFFFFFF)
+
+// --------------------------------------------------------
+// Bookkeeping for a virtual shadow map: a huge virtual depth
+// texture split into pages, only some of which are backed by
+// a smaller pool of physical pages at any time.
+//
+// Each frame:
+//  - BeginFrame()
+//  - MarkNeeded() for whatever receivers the camera can see
+//  - UpdateCaster() for every caster, which invalidates the
+//    pages it covered and now covers when it changes
+//  - Update() maps needed pages (evicting the least recently
+//    used ones) and lists which pages must be re-rendered
+//
+// Rects are given in virtual UV space ([0,1] across the whole
+// virtual texture). Nothing in here touches Direct3D.
+// --------------------------------------------------------
+class VirtualShadowMap
+{
+public:
+	// A page that has to be drawn this frame, and where it lives in the pool
+	struct PageRender
+	{
+		unsigned int VirtualX;
+		unsigned int VirtualY;
+		unsigned int PhysicalX;
+		unsigned int PhysicalY;
+	};
+
+	VirtualShadowMap();
+
+	void BeginFrame();
+	void MarkNeeded(const DirectX::XMFLOAT2& uvMin, const DirectX::XMFLOAT2& uvMax);
+	void UpdateCaster(const unsigned int casterId,
+		const DirectX::XMFLOAT2& uvMin,
+		const DirectX::XMFLOAT2& uvMax,
+		const unsigned long long version);
+	void Invalidate(const DirectX::XMFLOAT2& uvMin, const DirectX::XMFLOAT2& uvMax);
+	void InvalidateAll();
+	void Update();
+
+	// Getters
+	const std::vector<PageRender>& GetPagesToRender() const;
+	const std::vector<unsigned int>& GetPageTable() const; // Physical page index per virtual page, row major
+	bool IsPageTableChanged() const;
+	unsigned int GetNeededPageCount() const;
+	unsigned int GetResidentPageCount() const;
+	unsigned int GetEvictionCount() const;
+	unsigned int GetUnmappedPageCount() const; // Needed this frame but the pool was full
+
+private:
+	struct VirtualPage
+	{
+		unsigned int PhysicalPage;
+		bool Dirty;
+		bool Needed;
+	};
+
+	struct PhysicalPage
+	{
+		unsigned int VirtualPage;
+		unsigned long long LastUsedFrame;
+	};
+
+	struct CasterRecord
+	{
+		DirectX::XMFLOAT2 UVMin;
+		DirectX::XMFLOAT2 UVMax;
+		unsigned long long Version;
+		bool Valid;
+	};
+
+	unsigned long long m_frame;
+
+	std::vector<VirtualPage> m_virtualPages;
+	std::vector<PhysicalPage> m_physicalPages;
+	std::vector<CasterRecord> m_casters;
+
+	std::vector<unsigned int> m_neededPages;
+	std::vector<PageRender> m_pagesToRender;
+	std::vector<unsigned int> m_pageTable;
+	bool m_pageTableChanged;
+
+	unsigned int m_residentPageCount;
+	unsigned int m_evictionCount;
+	unsigned int m_unmappedPageCount;
+
+	// Inclusive range of pages overlapped by a UV rect, false if it misses entirely
+	bool GetPageRange(const DirectX::XMFLOAT2& uvMin, const DirectX::XMFLOAT2& uvMax,
+		unsigned int& minX, unsigned int& minY, unsigned int& maxX, unsigned int& maxY) const;
+};
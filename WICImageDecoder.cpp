@@ -0,0 +1,42 @@
+#include "TextureCooker.h"
+
+#include <Windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+// --------------------------------------------------------
+// Image decoding for the cook and the image loader, through
+// WIC.  Kept apart from the rest of the cook so that the
+// portable build can supply its own decoder.
+// --------------------------------------------------------
+bool LoadImageRGBA(const std::wstring& file, unsigned int& width, unsigned int& height, std::vector<unsigned char>& rgba)
+{
+	// Cooking runs on worker threads, which need COM set up themselves
+	HRESULT comResult = CoInitializeEx(0, COINIT_MULTITHREADED);
+
+	bool loaded = false;
+	{
+		Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+		Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+		Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+		Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+
+		if (SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) &&
+			SUCCEEDED(factory->CreateDecoderFromFilename(file.c_str(), 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) &&
+			SUCCEEDED(decoder->GetFrame(0, frame.GetAddressOf())) &&
+			SUCCEEDED(factory->CreateFormatConverter(converter.GetAddressOf())) &&
+			SUCCEEDED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, 0, 0.0, WICBitmapPaletteTypeCustom)) &&
+			SUCCEEDED(converter->GetSize(&width, &height)))
+		{
+			rgba.resize((size_t)width * height * 4);
+			loaded = SUCCEEDED(converter->CopyPixels(0, width * 4, (UINT)rgba.size(), rgba.data()));
+		}
+	}
+
+	if (SUCCEEDED(comResult))
+		CoUninitialize();
+
+	return loaded;
+}
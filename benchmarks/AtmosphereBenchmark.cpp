@@ -0,0 +1,54 @@
+#include "Benchmark.h"
+#include "Atmosphere.h"
+
+// --------------------------------------------------------
+// The procedural sky's LUT bakes, which used to be the
+// game's -benchmark-atmosphere mode: full bakes (after the
+// atmosphere changes) and sky view only bakes (after the sun
+// moves) on the whole thread pool, with a different sun each
+// run, then each LUT on its own on one thread
+// --------------------------------------------------------
+BENCHMARK(AtmosphereBakes)
+{
+	const unsigned int runs = 10;
+	ThreadPool threadPool;
+	AtmosphereParameters atmosphere = GetEarthAtmosphere();
+	AtmosphereLUTs luts;
+	ResizeAtmosphereLUTs(luts);
+
+	printf("%u threads\n", threadPool.GetThreadCount());
+	printf("%16s %10s %10s\n", "bake", "best ms", "avg ms");
+	for (int scattering = 1; scattering >= 0; scattering--)
+	{
+		// As if the sun were setting
+		unsigned int run = 0;
+		BenchmarkTiming timing = TimeBenchmark(runs, [&]()
+		{
+			ComputeAtmosphereLUTs(atmosphere, 1.0f - (float)(run++ % runs) / runs, scattering != 0, threadPool, luts);
+		});
+		printf("%16s %10.2f %10.2f\n", scattering ? "All LUTs" : "Sky view only", timing.BestMs, timing.AverageMs);
+	}
+
+	// Each LUT reads the ones before it, which the bakes above left behind
+	BenchmarkTiming transmittance = TimeBenchmark(runs, [&]()
+	{
+		for (unsigned int row = 0; row < TRANSMITTANCE_LUT_HEIGHT; row++)
+			ComputeTransmittanceRow(atmosphere, row, luts);
+	});
+	BenchmarkTiming multipleScattering = TimeBenchmark(runs, [&]()
+	{
+		for (unsigned int row = 0; row < MULTIPLE_SCATTERING_LUT_SIZE; row++)
+			ComputeMultipleScatteringRow(atmosphere, row, luts);
+	});
+	BenchmarkTiming skyView = TimeBenchmark(runs, [&]()
+	{
+		for (unsigned int row = 0; row < SKY_VIEW_LUT_HEIGHT; row++)
+			ComputeSkyViewRow(atmosphere, 0.5f, row, luts);
+	});
+
+	printf("\nOne thread:\n");
+	printf("%20s %10s %10s\n", "LUT", "best ms", "avg ms");
+	printf("%20s %10.2f %10.2f\n", "transmittance", transmittance.BestMs, transmittance.AverageMs);
+	printf("%20s %10.2f %10.2f\n", "multiple scattering", multipleScattering.BestMs, multipleScattering.AverageMs);
+	printf("%20s %10.2f %10.2f\n", "sky view", skyView.BestMs, skyView.AverageMs);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// --------------------------------------------------------
+// Registers a benchmark with the EngineBenchmarks runner,
+// which runs every one (or just the ones named on its
+// command line) and prints what they report:
+//
+//   BENCHMARK(LightClusters)
+//   {
+//       BenchmarkTiming timing = TimeBenchmark(20, [&]() { builder.Build(...); });
+//       printf("%.3f ms\n", timing.BestMs);
+//   }
+// --------------------------------------------------------
+struct BenchmarkCase
+{
+	const char* Name;
+	void (*Run)();
+};
+
+inline std::vector<BenchmarkCase>& GetBenchmarkCases()
+{
+	static std::vector<BenchmarkCase> benchmarks;
+	return benchmarks;
+}
+
+struct BenchmarkRegistration
+{
+	BenchmarkRegistration(const char* name, void (*run)()) { GetBenchmarkCases().push_back({ name, run }); }
+};
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static BenchmarkRegistration name##Registration(#name, name); \
+	static void name()
+
+// Fastest and average of several runs, in milliseconds
+struct BenchmarkTiming
+{
+	double BestMs;
+	double AverageMs;
+};
+
+// Runs once to warm up, then times each of the given runs
+template<typename Function>
+BenchmarkTiming TimeBenchmark(unsigned int runs, Function&& function)
+{
+	function();
+
+	BenchmarkTiming timing = { 1e300, 0.0 };
+	for (unsigned int ii = 0; ii < runs; ii++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		function();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		timing.BestMs = ms < timing.BestMs ? ms : timing.BestMs;
+		timing.AverageMs += ms / runs;
+	}
+	return timing;
+}
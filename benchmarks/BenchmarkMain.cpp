@@ -0,0 +1,41 @@
+#include "Benchmark.h"
+
+#include <cstring>
+
+// --------------------------------------------------------
+// EngineBenchmarks [name...]
+//
+// Runs the named benchmarks, or all of them with no names.
+// -list prints what there is.
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && strcmp(argv[1], "-list") == 0)
+	{
+		for (const BenchmarkCase& benchmark : GetBenchmarkCases())
+			printf("%s\n", benchmark.Name);
+		return 0;
+	}
+
+	int ran = 0;
+	for (const BenchmarkCase& benchmark : GetBenchmarkCases())
+	{
+		bool wanted = argc == 1;
+		for (int ii = 1; ii < argc; ii++)
+			wanted |= strcmp(argv[ii], benchmark.Name) == 0;
+		if (!wanted)
+			continue;
+
+		printf("== %s\n", benchmark.Name);
+		benchmark.Run();
+		printf("\n");
+		ran++;
+	}
+
+	if (ran == 0)
+	{
+		printf("No benchmark matches - run with -list to see them\n");
+		return 1;
+	}
+	return 0;
+}
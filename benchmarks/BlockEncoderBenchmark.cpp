@@ -0,0 +1,48 @@
+#include "Benchmark.h"
+#include "PathHelpers.h"
+#include "TextureCooker.h"
+
+// --------------------------------------------------------
+// Each block encoder on its own, single threaded, over the
+// same albedo texture decoded up front: quality over the
+// channels the format keeps, and megatexels encoded per
+// second.  Everything stays in memory - cooking the game's
+// textures to disk is the TextureCook tool's job.
+// --------------------------------------------------------
+BENCHMARK(BlockEncoders)
+{
+	std::wstring source = NarrowToWide(COOK_TEXTURE_FOLDER) + L"cobblestone_albedo.png";
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<unsigned char> rgba;
+	if (!LoadImageRGBA(source, width, height, rgba))
+	{
+		printf("Couldn't read %s\n", WideToNarrow(source).c_str());
+		return;
+	}
+
+	struct EncoderCase
+	{
+		const char* Name;
+		TextureCompressionFormat Format;
+		unsigned int ChannelMask;
+	};
+	const EncoderCase encoders[] = {
+		{ "BC1", TextureCompressionFormat::BC1, 0x7 },
+		{ "BC4", TextureCompressionFormat::BC4, 0x1 },
+		{ "BC5", TextureCompressionFormat::BC5, 0x3 },
+		{ "BC7", TextureCompressionFormat::BC7, 0xF } };
+
+	printf("%ux%u albedo\n", width, height);
+	printf("%8s %10s %10s %10s %10s\n", "format", "best ms", "avg ms", "MTexel/s", "PSNR dB");
+	for (const EncoderCase& encoder : encoders)
+	{
+		std::vector<unsigned char> blocks;
+		BenchmarkTiming timing = TimeBenchmark(3, [&]() { blocks = CompressImage(rgba.data(), width, height, encoder.Format); });
+
+		std::vector<unsigned char> decoded = DecompressImage(blocks.data(), width, height, encoder.Format);
+		double psnr = ComputeImagePSNR(rgba.data(), decoded.data(), width, height, encoder.ChannelMask);
+		double megatexels = (double)width * height / 1e6;
+		printf("%8s %10.1f %10.1f %10.1f %10.2f\n", encoder.Name, timing.BestMs, timing.AverageMs, megatexels / (timing.BestMs / 1000.0), psnr);
+	}
+}
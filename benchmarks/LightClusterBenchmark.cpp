@@ -0,0 +1,50 @@
+#include "Benchmark.h"
+#include "LightClusterBuilder.h"
+
+#include <random>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Clustered light culling with 1k to 10k point lights
+// scattered through the view, like the Light Data panel's
+// slider, on the whole thread pool
+// --------------------------------------------------------
+BENCHMARK(LightClusters)
+{
+	const float cameraNear = 0.1f;
+	const float cameraFar = 200.0f;
+
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&view, XMMatrixIdentity());
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, cameraNear, cameraFar));
+
+	std::shared_ptr<ThreadPool> threadPool = std::make_shared<ThreadPool>();
+	LightClusterBuilder builder(threadPool);
+	printf("%u threads, %dx%dx%d clusters\n", threadPool->GetThreadCount(), CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z);
+	printf("%8s %10s %10s %12s\n", "lights", "best ms", "avg ms", "indices");
+
+	const unsigned int lightCounts[] = { 1000, 2500, 5000, 10000 };
+	for (unsigned int lightCount : lightCounts)
+	{
+		// Scattered through the frustum, with the same seed every time
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		std::vector<Light> lights(lightCount);
+		for (Light& light : lights)
+		{
+			float z = 2.0f + unit(random) * 100.0f;
+			light = {};
+			light.Type = LIGHT_TYPE_POINT;
+			light.Position = XMFLOAT3((unit(random) * 2 - 1) * z * 0.7f, (unit(random) * 2 - 1) * z * 0.4f, z);
+			light.Range = 1.0f + unit(random) * 4.0f;
+			light.Intensity = 1.0f;
+			light.ShadowIndex = -1;
+		}
+
+		BenchmarkTiming timing = TimeBenchmark(20, [&]() { builder.Build(lights, view, projection, cameraNear, cameraFar); });
+		printf("%8u %10.3f %10.3f %12zu\n", lightCount, timing.BestMs, timing.AverageMs, builder.GetLightIndices().size());
+	}
+}
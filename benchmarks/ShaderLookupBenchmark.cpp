@@ -0,0 +1,281 @@
+#include "Benchmark.h"
+#include "SimpleShaderLookup.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --------------------------------------------------------
+// The names the game's two shaders reflect, as recorded for
+// the reflection cache tests: every variable, texture and
+// sampler, in reflection order
+// --------------------------------------------------------
+static const std::vector<const char*> VERTEX_VARIABLES = {
+	"view", "projection", "world", "worldInvTranspose" };
+
+static const std::vector<const char*> PIXEL_VARIABLES = {
+	"camPos", "numDirectionalLights", "clusterParams", "perObjectLights",
+	"shadowViewProjections", "shadowAtlasRects", "cascadeSplits", "numCascades",
+	"virtualShadowViewProjection", "skyIrradianceSH", "skyAmbientIntensity",
+	"colorTint", "uvScale", "uvOffset", "roughness", "textureSlices",
+	"objectLights", "objectLightCounts" };
+
+static const std::vector<const char*> PIXEL_TEXTURES = {
+	"Albedo", "NormalMap", "ORMMap", "ShadowAtlas", "VirtualPageTable",
+	"VirtualShadowPool", "Lights", "ClusterRanges", "ClusterLightIndices",
+	"SpecularEnvironment", "BRDFLookup" };
+
+static const std::vector<const char*> PIXEL_SAMPLERS = {
+	"BasicSampler", "ShadowSampler", "ClampSampler" };
+
+// What Entity::Draw() looks up per draw: the object's matrices on
+// the vertex shader, then its material and lights on the pixel shader
+static const std::vector<const char*> DRAW_VERTEX_VARIABLES = { "world", "worldInvTranspose" };
+static const std::vector<const char*> DRAW_PIXEL_VARIABLES = {
+	"colorTint", "uvScale", "uvOffset", "roughness", "textureSlices",
+	"objectLights", "objectLightCounts" };
+static const std::vector<const char*> DRAW_PIXEL_TEXTURES = { "Albedo", "NormalMap", "ORMMap" };
+static const std::vector<const char*> DRAW_PIXEL_SAMPLERS = { "BasicSampler" };
+
+static const unsigned int LOOKUPS_PER_DRAW = (unsigned int)(
+	DRAW_VERTEX_VARIABLES.size() + DRAW_PIXEL_VARIABLES.size() +
+	DRAW_PIXEL_TEXTURES.size() + DRAW_PIXEL_SAMPLERS.size());
+
+// Stand-ins for SimpleShaderVariable, SimpleSRV and SimpleSampler
+struct BenchVariable
+{
+	unsigned int ByteOffset;
+	unsigned int Size;
+	unsigned int ConstantBufferIndex;
+};
+
+struct BenchResource
+{
+	unsigned int Index;
+	unsigned int BindIndex;
+};
+
+// --------------------------------------------------------
+// The original layout: maps keyed by std::string, variables
+// stored in the map nodes, and one heap allocation for each
+// texture and sampler
+// --------------------------------------------------------
+struct StringMapShader
+{
+	std::unordered_map<std::string, BenchVariable> varTable;
+	std::unordered_map<std::string, BenchResource*> textureTable;
+	std::unordered_map<std::string, BenchResource*> samplerTable;
+
+	StringMapShader() = default;
+	StringMapShader(const StringMapShader&) = delete;
+	~StringMapShader()
+	{
+		for (auto& entry : textureTable) delete entry.second;
+		for (auto& entry : samplerTable) delete entry.second;
+	}
+
+	// The old setters took the name as a std::string
+	const BenchVariable* FindVariable(const std::string& name) const
+	{
+		auto result = varTable.find(name);
+		return result == varTable.end() ? 0 : &result->second;
+	}
+
+	const BenchResource* FindTexture(const std::string& name) const
+	{
+		auto result = textureTable.find(name);
+		return result == textureTable.end() ? 0 : result->second;
+	}
+
+	const BenchResource* FindSampler(const std::string& name) const
+	{
+		auto result = samplerTable.find(name);
+		return result == samplerTable.end() ? 0 : result->second;
+	}
+};
+
+// --------------------------------------------------------
+// The single arena: flat arrays and their sorted lookup
+// tables in one allocation, searched with FindLookup()
+// --------------------------------------------------------
+struct ArenaShader
+{
+	std::unique_ptr<unsigned char[]> arena;
+	BenchVariable* variables = 0;
+	BenchResource* textures = 0;
+	BenchResource* samplers = 0;
+	SimpleShaderLookup* varTable = 0;
+	SimpleShaderLookup* textureTable = 0;
+	SimpleShaderLookup* samplerTable = 0;
+	size_t variableCount = 0;
+	size_t textureCount = 0;
+	size_t samplerCount = 0;
+
+	const BenchVariable* FindVariable(unsigned long long hash) const
+	{
+		int index = FindLookup(varTable, variableCount, hash);
+		return index == -1 ? 0 : &variables[index];
+	}
+
+	const BenchResource* FindTexture(unsigned long long hash) const
+	{
+		int index = FindLookup(textureTable, textureCount, hash);
+		return index == -1 ? 0 : &textures[index];
+	}
+
+	const BenchResource* FindSampler(unsigned long long hash) const
+	{
+		int index = FindLookup(samplerTable, samplerCount, hash);
+		return index == -1 ? 0 : &samplers[index];
+	}
+};
+
+static void BuildStringMapShader(StringMapShader& shader,
+	const std::vector<const char*>& variables,
+	const std::vector<const char*>& textures,
+	const std::vector<const char*>& samplers)
+{
+	for (unsigned int ii = 0; ii < variables.size(); ii++)
+		shader.varTable.insert({ variables[ii], { ii * 16, 16, 0 } });
+	for (unsigned int ii = 0; ii < textures.size(); ii++)
+		shader.textureTable.insert({ textures[ii], new BenchResource{ ii, ii } });
+	for (unsigned int ii = 0; ii < samplers.size(); ii++)
+		shader.samplerTable.insert({ samplers[ii], new BenchResource{ ii, ii } });
+}
+
+static void BuildArenaShader(ArenaShader& shader,
+	const std::vector<const char*>& variables,
+	const std::vector<const char*>& textures,
+	const std::vector<const char*>& samplers)
+{
+	size_t variableCount = variables.size();
+	size_t textureCount = textures.size();
+	size_t samplerCount = samplers.size();
+
+	// Every member here is 8 or 4 byte aligned, and the tables come last
+	size_t tableOffset = sizeof(BenchVariable) * variableCount + sizeof(BenchResource) * (textureCount + samplerCount);
+	tableOffset = (tableOffset + alignof(SimpleShaderLookup) - 1) / alignof(SimpleShaderLookup) * alignof(SimpleShaderLookup);
+	shader.arena.reset(new unsigned char[tableOffset + sizeof(SimpleShaderLookup) * (variableCount + textureCount + samplerCount)]);
+
+	shader.variables = (BenchVariable*)shader.arena.get();
+	shader.textures = (BenchResource*)(shader.variables + variableCount);
+	shader.samplers = shader.textures + textureCount;
+	shader.varTable = (SimpleShaderLookup*)(shader.arena.get() + tableOffset);
+	shader.textureTable = shader.varTable + variableCount;
+	shader.samplerTable = shader.textureTable + textureCount;
+	shader.variableCount = variableCount;
+	shader.textureCount = textureCount;
+	shader.samplerCount = samplerCount;
+
+	for (unsigned int ii = 0; ii < variableCount; ii++)
+	{
+		shader.variables[ii] = { ii * 16, 16, 0 };
+		shader.varTable[ii] = { SimpleShaderHash(variables[ii]), ii };
+	}
+	for (unsigned int ii = 0; ii < textureCount; ii++)
+	{
+		shader.textures[ii] = { ii, ii };
+		shader.textureTable[ii] = { SimpleShaderHash(textures[ii]), ii };
+	}
+	for (unsigned int ii = 0; ii < samplerCount; ii++)
+	{
+		shader.samplers[ii] = { ii, ii };
+		shader.samplerTable[ii] = { SimpleShaderHash(samplers[ii]), ii };
+	}
+
+	SortLookupTable(shader.varTable, variableCount);
+	SortLookupTable(shader.textureTable, textureCount);
+	SortLookupTable(shader.samplerTable, samplerCount);
+}
+
+// --------------------------------------------------------
+// Name lookups for a frame of draws, spread over a few
+// dozen materials that each have their own vertex and pixel
+// shader, with the old string-keyed maps and the arena's
+// sorted tables (hashing the name at the call, like the
+// string_view setters do, and with hashes made up front)
+// --------------------------------------------------------
+BENCHMARK(ShaderLookups)
+{
+	const unsigned int shaderPairs = 32;
+	const unsigned int drawCounts[] = { 1000, 10000 };
+	const std::vector<const char*> none;
+
+	std::vector<StringMapShader> stringVertex(shaderPairs);
+	std::vector<StringMapShader> stringPixel(shaderPairs);
+	std::vector<ArenaShader> arenaVertex(shaderPairs);
+	std::vector<ArenaShader> arenaPixel(shaderPairs);
+	for (unsigned int ii = 0; ii < shaderPairs; ii++)
+	{
+		// Built in turn, the way shaders load, so their allocations interleave
+		BuildStringMapShader(stringVertex[ii], VERTEX_VARIABLES, none, none);
+		BuildStringMapShader(stringPixel[ii], PIXEL_VARIABLES, PIXEL_TEXTURES, PIXEL_SAMPLERS);
+		BuildArenaShader(arenaVertex[ii], VERTEX_VARIABLES, none, none);
+		BuildArenaShader(arenaPixel[ii], PIXEL_VARIABLES, PIXEL_TEXTURES, PIXEL_SAMPLERS);
+	}
+
+	// What a handle or a constexpr SimpleShaderHash() at the call site gives
+	std::vector<unsigned long long> vertexHashes;
+	std::vector<unsigned long long> pixelHashes;
+	std::vector<unsigned long long> textureHashes;
+	std::vector<unsigned long long> samplerHashes;
+	for (const char* name : DRAW_VERTEX_VARIABLES) vertexHashes.push_back(SimpleShaderHash(name));
+	for (const char* name : DRAW_PIXEL_VARIABLES) pixelHashes.push_back(SimpleShaderHash(name));
+	for (const char* name : DRAW_PIXEL_TEXTURES) textureHashes.push_back(SimpleShaderHash(name));
+	for (const char* name : DRAW_PIXEL_SAMPLERS) samplerHashes.push_back(SimpleShaderHash(name));
+
+	printf("%u shader pairs, %u lookups per draw\n", shaderPairs, LOOKUPS_PER_DRAW);
+	printf("%8s %-24s %10s %10s %12s\n", "draws", "layout", "best ms", "avg ms", "ns/lookup");
+
+	// Summed so none of the lookups can be optimized away
+	unsigned long long checksum = 0;
+	for (unsigned int drawCount : drawCounts)
+	{
+		auto report = [&](const char* layout, const BenchmarkTiming& timing)
+		{
+			printf("%8u %-24s %10.3f %10.3f %12.1f\n", drawCount, layout, timing.BestMs, timing.AverageMs,
+				timing.BestMs * 1e6 / ((double)drawCount * LOOKUPS_PER_DRAW));
+		};
+
+		report("unordered_map<string>", TimeBenchmark(20, [&]()
+		{
+			for (unsigned int draw = 0; draw < drawCount; draw++)
+			{
+				const StringMapShader& vs = stringVertex[draw % shaderPairs];
+				const StringMapShader& ps = stringPixel[draw % shaderPairs];
+				for (const char* name : DRAW_VERTEX_VARIABLES) checksum += vs.FindVariable(name)->ByteOffset;
+				for (const char* name : DRAW_PIXEL_VARIABLES) checksum += ps.FindVariable(name)->ByteOffset;
+				for (const char* name : DRAW_PIXEL_TEXTURES) checksum += ps.FindTexture(name)->BindIndex;
+				for (const char* name : DRAW_PIXEL_SAMPLERS) checksum += ps.FindSampler(name)->BindIndex;
+			}
+		}));
+
+		report("arena, hashed per call", TimeBenchmark(20, [&]()
+		{
+			for (unsigned int draw = 0; draw < drawCount; draw++)
+			{
+				const ArenaShader& vs = arenaVertex[draw % shaderPairs];
+				const ArenaShader& ps = arenaPixel[draw % shaderPairs];
+				for (const char* name : DRAW_VERTEX_VARIABLES) checksum += vs.FindVariable(SimpleShaderHash(name))->ByteOffset;
+				for (const char* name : DRAW_PIXEL_VARIABLES) checksum += ps.FindVariable(SimpleShaderHash(name))->ByteOffset;
+				for (const char* name : DRAW_PIXEL_TEXTURES) checksum += ps.FindTexture(SimpleShaderHash(name))->BindIndex;
+				for (const char* name : DRAW_PIXEL_SAMPLERS) checksum += ps.FindSampler(SimpleShaderHash(name))->BindIndex;
+			}
+		}));
+
+		report("arena, hashed up front", TimeBenchmark(20, [&]()
+		{
+			for (unsigned int draw = 0; draw < drawCount; draw++)
+			{
+				const ArenaShader& vs = arenaVertex[draw % shaderPairs];
+				const ArenaShader& ps = arenaPixel[draw % shaderPairs];
+				for (unsigned long long hash : vertexHashes) checksum += vs.FindVariable(hash)->ByteOffset;
+				for (unsigned long long hash : pixelHashes) checksum += ps.FindVariable(hash)->ByteOffset;
+				for (unsigned long long hash : textureHashes) checksum += ps.FindTexture(hash)->BindIndex;
+				for (unsigned long long hash : samplerHashes) checksum += ps.FindSampler(hash)->BindIndex;
+			}
+		}));
+	}
+	printf("(checksum %llu)\n", checksum);
+}
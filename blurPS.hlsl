@@ -1,8 +1,16 @@
+// Which pass this is - must match the BLUR_PASS_ defines in Blur.h
+#define BLUR_PASS_BOX 0
+#define BLUR_PASS_HORIZONTAL 1
+#define BLUR_PASS_VERTICAL 2
+#define BLUR_PASS_DOWNSAMPLE 3
+#define BLUR_PASS_UPSAMPLE 4
+
 cbuffer ExternalData : register(b0)
 {
 	int blurRadius;
-	float pixelWidth;
+	float pixelWidth; // Of the texture being read
 	float pixelHeight;
+	int blurPass;
 }
 
 struct VertexToPixel
@@ -14,27 +22,82 @@ struct VertexToPixel
 Texture2D Pixels : register(t0);
 SamplerState ClampSampler : register(s0);
 
-float4 main(VertexToPixel input) : SV_TARGET
+// Byte values of a texel, with clamped coordinates - summing these
+// is exact, so every pass of the box blur rounds only once
+float4 LoadBytes(int2 pixel, int2 size)
+{
+	return round(Pixels.Load(int3(clamp(pixel, 0, size - 1), 0)) * 255.0f);
+}
+
+// A box of (2r+1)^2 texels, or one row or column of it
+float4 BoxBlur(int2 pixel, int2 step)
 {
+	int2 size;
+	Pixels.GetDimensions(size.x, size.y);
+
 	// Track the total color and number of samples
 	float4 total = 0;
 	int sampleCount = 0;
 
-	// Loop through the "box"
-	for (int x = -blurRadius; x <= blurRadius; x++)
+	// Loop through the "box" (the second loop is skipped for a single axis)
+	int2 extent = blurRadius * step;
+	for (int x = -extent.x; x <= extent.x; x++)
 	{
-		for (int y = -blurRadius; y <= blurRadius; y++)
+		for (int y = -extent.y; y <= extent.y; y++)
 		{
-			// Calculate the uv for this sample
-			float2 uv = input.uv;
-			uv += float2(x * pixelWidth, y * pixelHeight);
-
-			// Add this color to the running total
-			total += Pixels.Sample(ClampSampler, uv);
+			total += LoadBytes(pixel + int2(x, y), size);
 			sampleCount++;
 		}
 	}
 
 	// Return the average
-	return total / sampleCount;
-}
\ No newline at end of file
+	return total / (255.0f * sampleCount);
+}
+
+// One bilinear sample - the textures have no mips, and the level
+// is explicit so sampling inside the pass switch needs no gradients
+float4 Tap(float2 uv)
+{
+	return Pixels.SampleLevel(ClampSampler, uv, 0);
+}
+
+// Dual filter (Marius Bjorge, "Bandwidth-Efficient Rendering"),
+// sampling between texels so each bilinear tap averages four
+float4 DualFilter(float2 uv, bool upsample)
+{
+	float2 texel = float2(pixelWidth, pixelHeight);
+	if (upsample)
+	{
+		float4 edges =
+			Tap(uv + float2(-1, 0) * texel) +
+			Tap(uv + float2(1, 0) * texel) +
+			Tap(uv + float2(0, -1) * texel) +
+			Tap(uv + float2(0, 1) * texel);
+		float4 corners =
+			Tap(uv + float2(-0.5f, -0.5f) * texel) +
+			Tap(uv + float2(0.5f, -0.5f) * texel) +
+			Tap(uv + float2(-0.5f, 0.5f) * texel) +
+			Tap(uv + float2(0.5f, 0.5f) * texel);
+		return (edges + corners * 2.0f) / 12.0f;
+	}
+
+	float4 corners =
+		Tap(uv + float2(-1, -1) * texel) +
+		Tap(uv + float2(1, -1) * texel) +
+		Tap(uv + float2(-1, 1) * texel) +
+		Tap(uv + float2(1, 1) * texel);
+	return (Tap(uv) * 4.0f + corners) / 8.0f;
+}
+
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	int2 pixel = int2(input.position.xy);
+	switch (blurPass)
+	{
+	case BLUR_PASS_HORIZONTAL: return BoxBlur(pixel, int2(1, 0));
+	case BLUR_PASS_VERTICAL: return BoxBlur(pixel, int2(0, 1));
+	case BLUR_PASS_DOWNSAMPLE: return DualFilter(input.uv, false);
+	case BLUR_PASS_UPSAMPLE: return DualFilter(input.uv, true);
+	default: return BoxBlur(pixel, int2(1, 1));
+	}
+}
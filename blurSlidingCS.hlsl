@@ -0,0 +1,46 @@
+cbuffer ExternalData : register(b0)
+{
+	int blurRadius;
+	int vertical; // 0 blurs rows, 1 blurs columns
+}
+
+Texture2D Pixels : register(t0);
+RWTexture2D<unorm float4> Output : register(u0);
+
+// --------------------------------------------------------
+// One axis of a box blur as a sliding window: each thread
+// walks a whole row (or column), adding the texel entering
+// the window and subtracting the one leaving it, so every
+// texel costs two reads no matter the radius.  The sums are
+// whole byte values, so this matches blurPS's separable
+// passes exactly.
+// --------------------------------------------------------
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+	int2 size;
+	Pixels.GetDimensions(size.x, size.y);
+
+	// Which line this thread walks, and in which direction
+	int2 step = vertical ? int2(0, 1) : int2(1, 0);
+	int2 start = vertical ? int2(id.x, 0) : int2(0, id.x);
+	int length = vertical ? size.y : size.x;
+	if (any(start >= size))
+		return;
+
+	// Fill the window for the first texel (clamping at the edge)
+	uint4 total = 0;
+	for (int i = -blurRadius; i <= blurRadius; i++)
+		total += uint4(round(Pixels.Load(int3(clamp(start + step * i, 0, size - 1), 0)) * 255.0f));
+
+	for (int j = 0; j < length; j++)
+	{
+		int2 pixel = start + step * j;
+		Output[pixel] = float4(total) / (255.0f * (2 * blurRadius + 1));
+
+		// Slide the window along: one texel in, one out
+		uint4 entering = uint4(round(Pixels.Load(int3(clamp(pixel + step * (blurRadius + 1), 0, size - 1), 0)) * 255.0f));
+		uint4 leaving = uint4(round(Pixels.Load(int3(clamp(pixel - step * blurRadius, 0, size - 1), 0)) * 255.0f));
+		total += entering - leaving;
+	}
+}
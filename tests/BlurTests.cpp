@@ -0,0 +1,434 @@
+#include "TestFramework.h"
+#include "Blur.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// --------------------------------------------------------
+// Golden images in Golden/Blur: what each mode should give
+// for the test image below (also there, as source.pam), as
+// binary PAM files (any image viewer that knows netpbm
+// opens them).  They're written by the straightforward
+// reference blurs in this file, not by BlurImage(), with:
+//
+//   BlurTests -write-goldens
+//
+// run from the tests folder.
+// --------------------------------------------------------
+static const char* GOLDEN_FOLDER = "Golden/Blur/";
+
+struct GoldenCase
+{
+	const char* Name;
+	BlurMode Mode;
+	int Radius;
+};
+
+// Separable and sliding window share goldens, since both round the
+// horizontal pass to 8 bits the same way.  The biggest radii reach past
+// the image, so most taps come from the clamped edges.
+static const GoldenCase GOLDEN_CASES[] = {
+	{ "box_r1", BlurMode::Box, 1 },
+	{ "box_r3", BlurMode::Box, 3 },
+	{ "box_r8", BlurMode::Box, 8 },
+	{ "box_r50", BlurMode::Box, 50 },
+	{ "separable_r1", BlurMode::Separable, 1 },
+	{ "separable_r3", BlurMode::Separable, 3 },
+	{ "separable_r8", BlurMode::Separable, 8 },
+	{ "separable_r50", BlurMode::Separable, 50 },
+	{ "dual_r1", BlurMode::DualFilter, 1 },
+	{ "dual_r4", BlurMode::DualFilter, 4 },
+	{ "dual_r16", BlurMode::DualFilter, 16 } };
+
+// --------------------------------------------------------
+// A small image with something in it for every mode to get
+// wrong: hard edges, a checkerboard, gradients, noise and
+// alpha, in a size that isn't a power of two (so the dual
+// filter's levels round down).  Integer math only, so it's
+// the same on every compiler.
+// --------------------------------------------------------
+static MipLevel MakeTestImage()
+{
+	MipLevel image = {};
+	image.Width = 48;
+	image.Height = 37;
+	image.Pixels.resize((size_t)image.Width * image.Height * 4);
+	for (unsigned int y = 0; y < image.Height; y++)
+	{
+		for (unsigned int x = 0; x < image.Width; x++)
+		{
+			unsigned int noise = (x * 73856093u) ^ (y * 19349663u);
+			noise = (noise ^ (noise >> 13)) * 0x5BD1E995u;
+
+			unsigned char* texel = &image.Pixels[((size_t)y * image.Width + x) * 4];
+			texel[0] = (unsigned char)(x < 20 ? x * 12 : 255 - (x - 20) * 4);
+			texel[1] = ((x / 5) + (y / 5)) % 2 ? 220 : 30;
+			texel[2] = (unsigned char)(noise >> 24);
+			texel[3] = (unsigned char)(y * 6 + 15);
+		}
+	}
+	return image;
+}
+
+// --------------------------------------------------------
+// Binary PAM (netpbm's P7), RGBA8
+// --------------------------------------------------------
+static bool WritePAM(const std::string& file, const MipLevel& image)
+{
+	std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+	stream << "P7\nWIDTH " << image.Width << "\nHEIGHT " << image.Height << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+	stream.write(reinterpret_cast<const char*>(image.Pixels.data()), image.Pixels.size());
+	return stream.good();
+}
+
+static bool ReadPAM(const std::string& file, MipLevel& image)
+{
+	std::ifstream stream(file, std::ios::binary);
+	std::string token;
+	stream >> token;
+	if (token != "P7")
+		return false;
+
+	image = {};
+	unsigned int depth = 0;
+	unsigned int maxValue = 0;
+	while (stream >> token && token != "ENDHDR")
+	{
+		if (token == "WIDTH") stream >> image.Width;
+		else if (token == "HEIGHT") stream >> image.Height;
+		else if (token == "DEPTH") stream >> depth;
+		else if (token == "MAXVAL") stream >> maxValue;
+		else if (token == "TUPLTYPE") stream >> token;
+	}
+	if (token != "ENDHDR" || depth != 4 || maxValue != 255 || image.Width == 0 || image.Height == 0)
+		return false;
+
+	stream.get(); // The newline after ENDHDR
+	image.Pixels.resize((size_t)image.Width * image.Height * 4);
+	stream.read(reinterpret_cast<char*>(image.Pixels.data()), image.Pixels.size());
+	return stream.gcount() == (std::streamsize)image.Pixels.size();
+}
+
+// --------------------------------------------------------
+// Reference blurs, written from the definitions rather than
+// from Blur.cpp: integer sums for the boxes, doubles for the
+// dual filter, one texel at a time
+// --------------------------------------------------------
+static int Clamp(int value, int size)
+{
+	return value < 0 ? 0 : (value >= size ? size - 1 : value);
+}
+
+static unsigned char GetByte(const MipLevel& image, int x, int y, unsigned int channel)
+{
+	return image.Pixels[((size_t)Clamp(y, image.Height) * image.Width + Clamp(x, image.Width)) * 4 + channel];
+}
+
+static unsigned char RoundAverage(unsigned int sum, unsigned int count)
+{
+	// count is odd, so this is never halfway
+	return (unsigned char)((2 * sum + count) / (2 * count));
+}
+
+static MipLevel ReferenceBox(const MipLevel& source, int radiusX, int radiusY)
+{
+	MipLevel result = source;
+	unsigned int count = (2 * radiusX + 1) * (2 * radiusY + 1);
+	for (unsigned int y = 0; y < source.Height; y++)
+	{
+		for (unsigned int x = 0; x < source.Width; x++)
+		{
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				unsigned int sum = 0;
+				for (int dy = -radiusY; dy <= radiusY; dy++)
+					for (int dx = -radiusX; dx <= radiusX; dx++)
+						sum += GetByte(source, x + dx, y + dy, c);
+				result.Pixels[((size_t)y * source.Width + x) * 4 + c] = RoundAverage(sum, count);
+			}
+		}
+	}
+	return result;
+}
+
+static double SampleBilinearReference(const MipLevel& image, double u, double v, unsigned int channel)
+{
+	double x = u * image.Width - 0.5;
+	double y = v * image.Height - 0.5;
+	int ix = (int)floor(x);
+	int iy = (int)floor(y);
+	double fx = x - ix;
+	double fy = y - iy;
+	double upper = GetByte(image, ix, iy, channel) * (1 - fx) + GetByte(image, ix + 1, iy, channel) * fx;
+	double lower = GetByte(image, ix, iy + 1, channel) * (1 - fx) + GetByte(image, ix + 1, iy + 1, channel) * fx;
+	return (upper * (1 - fy) + lower * fy) / 255.0;
+}
+
+// One of Bjorge's passes from source into a width x height image
+static MipLevel ReferenceDualPass(const MipLevel& source, unsigned int width, unsigned int height, bool upsample)
+{
+	MipLevel result = {};
+	result.Width = width;
+	result.Height = height;
+	result.Pixels.resize((size_t)width * height * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			double u = (x + 0.5) / width;
+			double v = (y + 0.5) / height;
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				auto tap = [&](double offsetX, double offsetY)
+				{
+					return SampleBilinearReference(source, u + offsetX / source.Width, v + offsetY / source.Height, c);
+				};
+
+				double color = upsample ?
+					(tap(-1, 0) + tap(1, 0) + tap(0, -1) + tap(0, 1) +
+					 2 * (tap(-0.5, -0.5) + tap(0.5, -0.5) + tap(-0.5, 0.5) + tap(0.5, 0.5))) / 12 :
+					(4 * tap(0, 0) + tap(-1, -1) + tap(1, -1) + tap(-1, 1) + tap(1, 1)) / 8;
+				color = color < 0 ? 0 : (color > 1 ? 1 : color);
+				result.Pixels[((size_t)y * width + x) * 4 + c] = (unsigned char)floor(color * 255 + 0.5);
+			}
+		}
+	}
+	return result;
+}
+
+static MipLevel ReferenceBlur(const MipLevel& source, BlurMode mode, int radius)
+{
+	if (mode == BlurMode::Box)
+		return ReferenceBox(source, radius, radius);
+	if (mode == BlurMode::Separable || mode == BlurMode::SlidingWindow)
+		return ReferenceBox(ReferenceBox(source, radius, 0), 0, radius);
+
+	// Dual filter: halve the size once per level, then come back up
+	std::vector<MipLevel> levels;
+	for (unsigned int size = 1; (int)size <= radius && levels.size() < MAX_BLUR_LEVELS; size *= 2)
+	{
+		const MipLevel& from = levels.empty() ? source : levels.back();
+		unsigned int width = source.Width >> (levels.size() + 1);
+		unsigned int height = source.Height >> (levels.size() + 1);
+		levels.push_back(ReferenceDualPass(from, width > 0 ? width : 1, height > 0 ? height : 1, false));
+	}
+	if (levels.empty())
+		return source;
+	for (size_t i = levels.size() - 1; i > 0; i--)
+		levels[i - 1] = ReferenceDualPass(levels[i], levels[i - 1].Width, levels[i - 1].Height, true);
+	return ReferenceDualPass(levels[0], source.Width, source.Height, true);
+}
+
+// The GPU's bilinear weights aren't exact, so the dual filter can be 1 off
+static unsigned int GetTolerance(BlurMode mode)
+{
+	return mode == BlurMode::DualFilter ? 1 : 0;
+}
+
+// --------------------------------------------------------
+// BlurImage() against the goldens
+// --------------------------------------------------------
+TEST(GoldensAreThere)
+{
+	for (const GoldenCase& golden : GOLDEN_CASES)
+	{
+		MipLevel image;
+		bool read = ReadPAM(std::string(GOLDEN_FOLDER) + golden.Name + ".pam", image);
+		if (!read)
+			printf("  Couldn't read %s%s.pam\n", GOLDEN_FOLDER, golden.Name);
+		CHECK(read && image.Width == 48 && image.Height == 37);
+	}
+}
+
+TEST(EveryModeMatchesItsGolden)
+{
+	ThreadPool threadPool;
+	MipLevel source = MakeTestImage();
+	for (const GoldenCase& golden : GOLDEN_CASES)
+	{
+		MipLevel expected;
+		if (!ReadPAM(std::string(GOLDEN_FOLDER) + golden.Name + ".pam", expected))
+			continue; // Reported above
+
+		// The sliding window is checked against the separable goldens too
+		std::vector<BlurMode> modes = { golden.Mode };
+		if (golden.Mode == BlurMode::Separable)
+			modes.push_back(BlurMode::SlidingWindow);
+
+		for (BlurMode mode : modes)
+		{
+			unsigned int differentPixels = 0;
+			unsigned int difference = CompareImages(BlurImage(source, mode, golden.Radius, threadPool), expected, differentPixels);
+			if (difference > GetTolerance(mode))
+				printf("  %s radius %d: off by up to %u in %u pixels\n", GetBlurModeName(mode), golden.Radius, difference, differentPixels);
+			CHECK(difference <= GetTolerance(mode));
+		}
+	}
+}
+
+// The goldens are what the reference blurs give today - if this fails,
+// the goldens or the references changed without the other
+TEST(GoldensMatchTheReference)
+{
+	MipLevel source = MakeTestImage();
+	for (const GoldenCase& golden : GOLDEN_CASES)
+	{
+		MipLevel expected;
+		if (!ReadPAM(std::string(GOLDEN_FOLDER) + golden.Name + ".pam", expected))
+			continue;
+
+		unsigned int differentPixels = 0;
+		CHECK(CompareImages(ReferenceBlur(source, golden.Mode, golden.Radius), expected, differentPixels) == 0);
+	}
+}
+
+// Blurs of a flat image are the same flat image, right out to the edges
+TEST(FlatImagesStayFlat)
+{
+	ThreadPool threadPool;
+	MipLevel flat = MakeTestImage();
+	for (size_t i = 0; i < flat.Pixels.size(); i += 4)
+	{
+		flat.Pixels[i + 0] = 200;
+		flat.Pixels[i + 1] = 17;
+		flat.Pixels[i + 2] = 128;
+		flat.Pixels[i + 3] = 255;
+	}
+
+	for (int mode = 0; mode < (int)BlurMode::Count; mode++)
+	{
+		unsigned int differentPixels = 0;
+		CHECK(CompareImages(BlurImage(flat, (BlurMode)mode, 6, threadPool), flat, differentPixels) == 0);
+	}
+}
+
+TEST(ZeroRadiusIsACopy)
+{
+	ThreadPool threadPool;
+	MipLevel source = MakeTestImage();
+	for (int mode = 0; mode < (int)BlurMode::Count; mode++)
+	{
+		MipLevel result = BlurImage(source, (BlurMode)mode, 0, threadPool);
+		CHECK(result.Width == source.Width && result.Height == source.Height && result.Pixels == source.Pixels);
+	}
+}
+
+TEST(ResultDoesNotDependOnThreadCount)
+{
+	ThreadPool oneThread(1);
+	ThreadPool manyThreads(5);
+	MipLevel source = MakeTestImage();
+	for (int mode = 0; mode < (int)BlurMode::Count; mode++)
+		CHECK(BlurImage(source, (BlurMode)mode, 5, oneThread).Pixels == BlurImage(source, (BlurMode)mode, 5, manyThreads).Pixels);
+}
+
+// One pixel wide or tall images clamp in every direction
+TEST(ThinImagesBlur)
+{
+	ThreadPool threadPool;
+	MipLevel column = {};
+	column.Width = 1;
+	column.Height = 9;
+	for (unsigned int y = 0; y < column.Height; y++)
+	{
+		unsigned char value = y == 4 ? 255 : 0;
+		column.Pixels.insert(column.Pixels.end(), { value, value, value, 255 });
+	}
+
+	for (int mode = 0; mode < (int)BlurMode::Count; mode++)
+	{
+		MipLevel result = BlurImage(column, (BlurMode)mode, 2, threadPool);
+		unsigned int differentPixels = 0;
+		unsigned int difference = CompareImages(result, ReferenceBlur(column, (BlurMode)mode, 2), differentPixels);
+		CHECK(difference <= GetTolerance((BlurMode)mode));
+	}
+}
+
+TEST(BadImagesGiveNothing)
+{
+	ThreadPool threadPool;
+	MipLevel empty = {};
+	MipLevel truncated = MakeTestImage();
+	truncated.Pixels.pop_back();
+
+	CHECK(BlurImage(empty, BlurMode::Box, 3, threadPool).Pixels.empty());
+	CHECK(BlurImage(truncated, BlurMode::Separable, 3, threadPool).Pixels.empty());
+}
+
+// --------------------------------------------------------
+// The helpers
+// --------------------------------------------------------
+TEST(CompareImagesCountsDifferences)
+{
+	MipLevel a = MakeTestImage();
+	MipLevel b = a;
+	unsigned int differentPixels = 99;
+	CHECK(CompareImages(a, b, differentPixels) == 0);
+	CHECK(differentPixels == 0);
+
+	b.Pixels[3] ^= 0x10; // Alpha of the first pixel
+	b.Pixels[9] = a.Pixels[9] > 128 ? a.Pixels[9] - 2 : a.Pixels[9] + 2;
+	b.Pixels[10] = a.Pixels[10] > 128 ? a.Pixels[10] - 1 : a.Pixels[10] + 1;
+	CHECK(CompareImages(a, b, differentPixels) == 16);
+	CHECK(differentPixels == 2);
+
+	MipLevel smaller = MakeTestImage();
+	smaller.Width--;
+	CHECK(CompareImages(a, smaller, differentPixels) == ~0u);
+}
+
+TEST(DualFilterLevelsDoubleWithTheRadius)
+{
+	CHECK(GetDualFilterLevels(0) == 0);
+	CHECK(GetDualFilterLevels(1) == 1);
+	CHECK(GetDualFilterLevels(2) == 2);
+	CHECK(GetDualFilterLevels(3) == 2);
+	CHECK(GetDualFilterLevels(4) == 3);
+	CHECK(GetDualFilterLevels(16) == MAX_BLUR_LEVELS);
+	CHECK(GetDualFilterLevels(1000) == MAX_BLUR_LEVELS);
+
+	CHECK(GetBlurLevelSize(48, 0) == 24);
+	CHECK(GetBlurLevelSize(37, 1) == 9);
+	CHECK(GetBlurLevelSize(37, 4) == 1);
+	CHECK(GetBlurLevelSize(37, 9) == 1);
+}
+
+TEST(SamplesPerPixelFollowTheCost)
+{
+	// Box grows with the square of the radius, separable with the radius...
+	CHECK(GetBlurSamplesPerPixel(BlurMode::Box, 3, 1920, 1080) == 49.0f);
+	CHECK(GetBlurSamplesPerPixel(BlurMode::Separable, 3, 1920, 1080) == 14.0f);
+
+	// ...and the sliding window and dual filter barely at all
+	float slidingSmall = GetBlurSamplesPerPixel(BlurMode::SlidingWindow, 2, 1920, 1080);
+	float slidingLarge = GetBlurSamplesPerPixel(BlurMode::SlidingWindow, 60, 1920, 1080);
+	CHECK(slidingSmall > 3.9f && slidingLarge < 4.2f);
+
+	float dualSmall = GetBlurSamplesPerPixel(BlurMode::DualFilter, 1, 1920, 1080);
+	float dualLarge = GetBlurSamplesPerPixel(BlurMode::DualFilter, 60, 1920, 1080);
+	CHECK(dualSmall < dualLarge);
+
+	// Each level has a quarter of the area of the one before, so the dual
+	// filter never needs more than 8 + 13/3 reads, however many levels
+	CHECK(dualLarge < 8.0f + 13.0f / 3.0f);
+
+	for (int mode = 0; mode < (int)BlurMode::Count; mode++)
+		CHECK(GetBlurSamplesPerPixel((BlurMode)mode, 0, 1920, 1080) == 1.0f);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && strcmp(argv[1], "-write-goldens") == 0)
+	{
+		MipLevel source = MakeTestImage();
+		bool written = WritePAM(std::string(GOLDEN_FOLDER) + "source.pam", source);
+		for (const GoldenCase& golden : GOLDEN_CASES)
+			written = WritePAM(std::string(GOLDEN_FOLDER) + golden.Name + ".pam", ReferenceBlur(source, golden.Mode, golden.Radius)) && written;
+
+		printf(written ? "Goldens written to %s\n" : "Couldn't write the goldens to %s\n", GOLDEN_FOLDER);
+		return written ? 0 : 1;
+	}
+
+	return RunAllTests();
+}
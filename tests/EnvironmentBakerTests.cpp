@@ -0,0 +1,403 @@
+#include "TestFramework.h"
+#include "CubeMap.h"
+#include "EnvironmentBaker.h"
+#include "TestScenes.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// The test environments pick one byte per direction, which
+// goes to the faces as a different value in each channel
+// --------------------------------------------------------
+static float Decode(unsigned char value) { return powf(value / 255.0f, 2.2f); }
+
+static Environment Tinted(unsigned char (*environment)(XMFLOAT3 direction))
+{
+	return [environment](XMFLOAT3 direction)
+	{
+		unsigned char value = environment(direction);
+		return XMFLOAT3(Decode(value), Decode(value / 2), Decode(255 - value));
+	};
+}
+
+// A small bright cap around +Z on black
+static unsigned char SmallLight(XMFLOAT3 direction)
+{
+	return direction.z > 0.95f ? 255 : 0;
+}
+
+// Smooth enough that a mirror reflection of it should be the same image
+static unsigned char SoftGradient(XMFLOAT3 direction)
+{
+	return (unsigned char)(128.0f + 100.0f * direction.x * direction.y + 20.0f * direction.z);
+}
+
+static unsigned int GetMipSize(unsigned int mip) { return PREFILTERED_ENVIRONMENT_SIZE >> mip; }
+
+static const XMFLOAT4& GetTexel(const PrefilteredEnvironment& environment, unsigned int mip, unsigned int face, unsigned int x, unsigned int y)
+{
+	unsigned int size = GetMipSize(mip);
+	return environment.Mips[mip][((size_t)face * size + y) * size + x];
+}
+
+static bool AreIdentical(const PrefilteredEnvironment& a, const PrefilteredEnvironment& b)
+{
+	if (a.Size != b.Size || a.Mips.size() != b.Mips.size())
+		return false;
+	for (size_t mip = 0; mip < a.Mips.size(); mip++)
+	{
+		if (a.Mips[mip].size() != b.Mips[mip].size() ||
+			memcmp(a.Mips[mip].data(), b.Mips[mip].data(), a.Mips[mip].size() * sizeof(XMFLOAT4)) != 0)
+			return false;
+	}
+	return true;
+}
+
+static bool AreIdentical(const BRDFLookupTable& a, const BRDFLookupTable& b)
+{
+	return a.Size == b.Size &&
+		a.Texels.size() == b.Texels.size() &&
+		memcmp(a.Texels.data(), b.Texels.data(), a.Texels.size() * sizeof(XMFLOAT2)) == 0;
+}
+
+// --------------------------------------------------------
+// The prefiltered environment
+// --------------------------------------------------------
+TEST(MipRoughnessGoesFromMirrorToFullyRough)
+{
+	CHECK(GetPrefilteredMipRoughness(0) == 0.0f);
+	CHECK(GetPrefilteredMipRoughness(PREFILTERED_ENVIRONMENT_MIPS - 1) == 1.0f);
+	for (unsigned int mip = 1; mip < PREFILTERED_ENVIRONMENT_MIPS; mip++)
+		CHECK(GetPrefilteredMipRoughness(mip) > GetPrefilteredMipRoughness(mip - 1));
+}
+
+TEST(PrefilteredMipsHaveTheRightSizes)
+{
+	ThreadPool threadPool;
+	PrefilteredEnvironment environment = PrefilterEnvironment(RenderCubemap(Tinted(SmallLight), 16), threadPool);
+	CHECK(environment.Size == PREFILTERED_ENVIRONMENT_SIZE);
+	CHECK(environment.Mips.size() == PREFILTERED_ENVIRONMENT_MIPS);
+	for (unsigned int mip = 0; mip < environment.Mips.size(); mip++)
+		CHECK(environment.Mips[mip].size() == (size_t)6 * GetMipSize(mip) * GetMipSize(mip));
+}
+
+// Every lobe averages its samples, so a flat environment stays flat at every roughness
+TEST(ConstantEnvironmentStaysConstant)
+{
+	ThreadPool threadPool;
+	PrefilteredEnvironment environment = PrefilterEnvironment(RenderCubemap(Tinted([](XMFLOAT3) { return (unsigned char)180; }), 32), threadPool);
+
+	float red = powf(180 / 255.0f, 2.2f);
+	float green = powf(90 / 255.0f, 2.2f);
+	float blue = powf(75 / 255.0f, 2.2f);
+	float worst = 0.0f;
+	for (const std::vector<XMFLOAT4>& mip : environment.Mips)
+	{
+		for (const XMFLOAT4& texel : mip)
+		{
+			worst = fmaxf(worst, fabsf(texel.x - red));
+			worst = fmaxf(worst, fabsf(texel.y - green));
+			worst = fmaxf(worst, fabsf(texel.z - blue));
+			worst = fmaxf(worst, fabsf(texel.w - 1.0f));
+		}
+	}
+	CHECK(worst < 1e-5f);
+}
+
+// With a source the same size as mip 0, the mirror mip is the source itself
+TEST(MirrorMipIsTheSource)
+{
+	ThreadPool threadPool;
+	std::vector<MipLevel> faces = RenderCubemap(Tinted(SoftGradient), PREFILTERED_ENVIRONMENT_SIZE);
+	PrefilteredEnvironment environment = PrefilterEnvironment(faces, threadPool);
+
+	float worst = 0.0f;
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < PREFILTERED_ENVIRONMENT_SIZE; y++)
+		{
+			for (unsigned int x = 0; x < PREFILTERED_ENVIRONMENT_SIZE; x++)
+			{
+				const unsigned char* source = &faces[face].Pixels[((size_t)y * PREFILTERED_ENVIRONMENT_SIZE + x) * 4];
+				const XMFLOAT4& texel = GetTexel(environment, 0, face, x, y);
+				worst = fmaxf(worst, fabsf(texel.x - powf(source[0] / 255.0f, 2.2f)));
+				worst = fmaxf(worst, fabsf(texel.z - powf(source[2] / 255.0f, 2.2f)));
+			}
+		}
+	}
+	CHECK(worst < 1e-4f);
+}
+
+// A small light seen in rougher and rougher mirrors: dimmer where it's
+// reflected head on, wider around it, and (apart from the little the
+// blurrier source mips bleed) not on the far side of the sphere, since
+// the lobe only reaches the hemisphere around each direction
+TEST(RougherMipsSpreadASmallLight)
+{
+	ThreadPool threadPool;
+	PrefilteredEnvironment environment = PrefilterEnvironment(RenderCubemap(Tinted(SmallLight), 64), threadPool);
+
+	float previousPeak = 2.0f;
+	float previousSpread = -1.0f;
+	bool peakFalls = true;
+	bool spreadGrows = true;
+	bool farSideDark = true;
+	for (unsigned int mip = 0; mip < PREFILTERED_ENVIRONMENT_MIPS; mip++)
+	{
+		// +Z's center, and about 35 degrees off it on the same face
+		unsigned int size = GetMipSize(mip);
+		float peak = GetTexel(environment, mip, 4, size / 2, size / 2).x;
+		float offAxis = GetTexel(environment, mip, 4, size / 2 + size * 7 / 20, size / 2).x;
+
+		peakFalls = peakFalls && peak < previousPeak;
+		spreadGrows = spreadGrows && offAxis / peak > previousSpread;
+		previousPeak = peak;
+		previousSpread = offAxis / peak;
+
+		// -Z
+		farSideDark = farSideDark && GetTexel(environment, mip, 5, size / 2, size / 2).x == 0.0f;
+		for (unsigned int y = 0; y < size; y++)
+			for (unsigned int x = 0; x < size; x++)
+				farSideDark = farSideDark && GetTexel(environment, mip, 5, x, y).x < 1e-3f;
+	}
+
+	CHECK(GetTexel(environment, 0, 4, PREFILTERED_ENVIRONMENT_SIZE / 2, PREFILTERED_ENVIRONMENT_SIZE / 2).x == 1.0f);
+	CHECK(peakFalls);
+	CHECK(spreadGrows);
+	CHECK(farSideDark);
+}
+
+TEST(PrefilterIsTheSameOnAnyThreadCount)
+{
+	std::vector<MipLevel> faces = RenderCubemap(Tinted(SoftGradient), 32);
+	faces[4] = RenderCubemap(Tinted(SmallLight), 32)[4];
+
+	ThreadPool oneThread(1);
+	ThreadPool manyThreads(5);
+	PrefilteredEnvironment a = PrefilterEnvironment(faces, oneThread);
+	PrefilteredEnvironment b = PrefilterEnvironment(faces, manyThreads);
+	PrefilteredEnvironment c = PrefilterEnvironment(faces, manyThreads);
+	CHECK(AreIdentical(a, b));
+	CHECK(AreIdentical(b, c));
+}
+
+TEST(FacesThatDoNotFitGiveNoMips)
+{
+	ThreadPool threadPool;
+	std::vector<MipLevel> faces = RenderCubemap(Tinted(SmallLight), 8);
+
+	std::vector<MipLevel> missing(faces.begin(), faces.begin() + 5);
+	std::vector<MipLevel> notSquare = faces;
+	for (MipLevel& face : notSquare)
+	{
+		face.Height = 4;
+		face.Pixels.resize((size_t)face.Width * face.Height * 4);
+	}
+	std::vector<MipLevel> mismatched = faces;
+	mismatched[2] = RenderCubemap(Tinted(SmallLight), 16)[2];
+	std::vector<MipLevel> truncated = faces;
+	truncated[5].Pixels.pop_back();
+
+	for (const std::vector<MipLevel>* bad : { &missing, &notSquare, &mismatched, &truncated })
+		CHECK(PrefilterEnvironment(*bad, threadPool).Mips.empty());
+}
+
+// --------------------------------------------------------
+// The split-sum BRDF table
+// --------------------------------------------------------
+
+// The same BRDF, integrated by brute force over the hemisphere rather than
+// by importance sampling: scale and bias of F0 at one NdotV and roughness
+static XMFLOAT2 IntegrateBRDFReference(float NdotV, float roughness)
+{
+	float a = roughness * roughness;
+	float alpha2 = a * a;
+	float k = (roughness + 1.0f) * (roughness + 1.0f) / 8.0f;
+	XMVECTOR v = XMVectorSet(sqrtf(1.0f - NdotV * NdotV), 0.0f, NdotV, 0.0f);
+
+	const unsigned int thetaSteps = 1024;
+	const unsigned int phiSteps = 512;
+	double scale = 0.0;
+	double bias = 0.0;
+	for (unsigned int t = 0; t < thetaSteps; t++)
+	{
+		float theta = (t + 0.5f) / thetaSteps * XM_PIDIV2;
+		float NdotL = cosf(theta);
+		float solidAngle = sinf(theta) * (XM_PIDIV2 / thetaSteps) * (XM_2PI / phiSteps);
+		for (unsigned int p = 0; p < phiSteps; p++)
+		{
+			float phi = (p + 0.5f) / phiSteps * XM_2PI;
+			XMVECTOR l = XMVectorSet(sinf(theta) * cosf(phi), sinf(theta) * sinf(phi), NdotL, 0.0f);
+			XMVECTOR h = XMVector3Normalize(v + l);
+			float NdotH = XMVectorGetZ(h);
+			float VdotH = XMVectorGetX(XMVector3Dot(v, h));
+
+			float denomToSquare = NdotH * NdotH * (alpha2 - 1.0f) + 1.0f;
+			float d = alpha2 / (XM_PI * denomToSquare * denomToSquare);
+			float g = NdotV / (NdotV * (1.0f - k) + k) * NdotL / (NdotL * (1.0f - k) + k);
+			float specular = d * g / (4.0f * NdotV * NdotL);
+			float fresnel = powf(1.0f - VdotH, 5.0f);
+
+			scale += (1.0f - fresnel) * specular * NdotL * solidAngle;
+			bias += fresnel * specular * NdotL * solidAngle;
+		}
+	}
+	return XMFLOAT2((float)scale, (float)bias);
+}
+
+TEST(BRDFTableMatchesBruteForceIntegration)
+{
+	ThreadPool threadPool;
+	BRDFLookupTable table = BakeBRDFLookupTable(threadPool);
+	CHECK(table.Size == BRDF_LUT_SIZE);
+	CHECK(table.Texels.size() == (size_t)BRDF_LUT_SIZE * BRDF_LUT_SIZE);
+
+	// Rough enough that the brute force grid resolves the lobe
+	const unsigned int rows[] = { BRDF_LUT_SIZE / 4, BRDF_LUT_SIZE / 2, BRDF_LUT_SIZE - 1 };
+	const unsigned int columns[] = { BRDF_LUT_SIZE / 8, BRDF_LUT_SIZE / 2, BRDF_LUT_SIZE - 1 };
+	for (unsigned int row : rows)
+	{
+		for (unsigned int column : columns)
+		{
+			XMFLOAT2 expected = IntegrateBRDFReference((column + 0.5f) / BRDF_LUT_SIZE, (row + 0.5f) / BRDF_LUT_SIZE);
+			const XMFLOAT2& texel = table.Texels[(size_t)row * BRDF_LUT_SIZE + column];
+			CHECK_NEAR(texel.x, expected.x, 0.02f);
+			CHECK_NEAR(texel.y, expected.y, 0.01f);
+		}
+	}
+}
+
+TEST(BRDFTableBehavesLikeASpecularLobe)
+{
+	ThreadPool threadPool;
+	BRDFLookupTable table = BakeBRDFLookupTable(threadPool);
+	auto texel = [&table](unsigned int row, unsigned int column) { return table.Texels[(size_t)row * BRDF_LUT_SIZE + column]; };
+
+	// Never reflects more than comes in
+	bool bounded = true;
+	for (const XMFLOAT2& t : table.Texels)
+		bounded = bounded && t.x >= 0.0f && t.y >= 0.0f && t.x + t.y <= 1.0f;
+	CHECK(bounded);
+
+	// A smooth surface seen head on reflects (nearly) everything, all of it F0's...
+	XMFLOAT2 smoothHeadOn = texel(0, BRDF_LUT_SIZE - 1);
+	CHECK(smoothHeadOn.x + smoothHeadOn.y > 0.95f);
+	CHECK(smoothHeadOn.y < 0.01f);
+
+	// ...and more and more of it Fresnel's toward grazing angles, until
+	// masking takes over right at the edge
+	bool fresnelGrows = true;
+	for (unsigned int column = BRDF_LUT_SIZE / 4; column < BRDF_LUT_SIZE; column++)
+		fresnelGrows = fresnelGrows && texel(0, column).y <= texel(0, column - 1).y;
+	CHECK(fresnelGrows);
+
+	// Rougher surfaces shadow and mask more of their own light
+	bool roughnessDarkens = true;
+	for (unsigned int row = 1; row < BRDF_LUT_SIZE; row++)
+	{
+		XMFLOAT2 rougher = texel(row, BRDF_LUT_SIZE / 2);
+		XMFLOAT2 smoother = texel(row - 1, BRDF_LUT_SIZE / 2);
+		roughnessDarkens = roughnessDarkens && rougher.x + rougher.y <= smoother.x + smoother.y;
+	}
+	CHECK(roughnessDarkens);
+}
+
+TEST(BRDFTableIsTheSameOnAnyThreadCount)
+{
+	ThreadPool oneThread(1);
+	ThreadPool manyThreads(5);
+	CHECK(AreIdentical(BakeBRDFLookupTable(oneThread), BakeBRDFLookupTable(manyThreads)));
+}
+
+// --------------------------------------------------------
+// The cache
+// --------------------------------------------------------
+TEST(HashFollowsEveryByteAndSize)
+{
+	std::vector<MipLevel> faces = RenderCubemap(Tinted(SoftGradient), 8);
+	unsigned long long hash = HashCubemapFaces(faces);
+	CHECK(HashCubemapFaces(faces) == hash);
+
+	std::vector<MipLevel> onePixel = faces;
+	onePixel[5].Pixels.back() ^= 1;
+	CHECK(HashCubemapFaces(onePixel) != hash);
+
+	// Same bytes, read as a different shape
+	std::vector<MipLevel> reshaped = faces;
+	reshaped[0].Width = 16;
+	reshaped[0].Height = 4;
+	CHECK(HashCubemapFaces(reshaped) != hash);
+
+	std::vector<MipLevel> reordered = faces;
+	std::swap(reordered[0], reordered[1]);
+	CHECK(HashCubemapFaces(reordered) != hash);
+}
+
+TEST(BakeRoundTripsThroughTheCache)
+{
+	ThreadPool threadPool;
+	std::vector<MipLevel> faces = RenderCubemap(Tinted(SmallLight), 16);
+	unsigned long long hash = HashCubemapFaces(faces);
+	PrefilteredEnvironment environment = PrefilterEnvironment(faces, threadPool);
+	BRDFLookupTable brdf = BakeBRDFLookupTable(threadPool);
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "EnvironmentBakerTests.bake";
+	CHECK(SaveEnvironmentBake(path.wstring(), hash, environment, brdf));
+
+	PrefilteredEnvironment loadedEnvironment = {};
+	BRDFLookupTable loadedBRDF = {};
+	CHECK(LoadEnvironmentBake(path.wstring(), hash, loadedEnvironment, loadedBRDF));
+	CHECK(AreIdentical(environment, loadedEnvironment));
+	CHECK(AreIdentical(brdf, loadedBRDF));
+
+	// Different faces mean a new bake, and the outputs are left alone
+	PrefilteredEnvironment untouched = {};
+	BRDFLookupTable untouchedBRDF = {};
+	CHECK(!LoadEnvironmentBake(path.wstring(), hash + 1, untouched, untouchedBRDF));
+	CHECK(untouched.Mips.empty() && untouchedBRDF.Texels.empty());
+
+	// As do damaged files, short or long
+	uintmax_t fileSize = std::filesystem::file_size(path);
+	std::filesystem::resize_file(path, fileSize - 1);
+	CHECK(!LoadEnvironmentBake(path.wstring(), hash, untouched, untouchedBRDF));
+	std::filesystem::resize_file(path, fileSize + 4);
+	CHECK(!LoadEnvironmentBake(path.wstring(), hash, untouched, untouchedBRDF));
+
+	// Or one with the wrong settings in its header
+	CHECK(SaveEnvironmentBake(path.wstring(), hash, environment, brdf));
+	{
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(16); // Past the magic, version and hash, onto the size
+		unsigned int size = PREFILTERED_ENVIRONMENT_SIZE * 2;
+		file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	}
+	CHECK(!LoadEnvironmentBake(path.wstring(), hash, untouched, untouchedBRDF));
+	CHECK(untouched.Mips.empty());
+
+	std::filesystem::remove(path);
+	CHECK(!LoadEnvironmentBake(path.wstring(), hash, untouched, untouchedBRDF));
+}
+
+TEST(OnlyCompleteBakesAreSaved)
+{
+	ThreadPool threadPool;
+	BRDFLookupTable brdf = BakeBRDFLookupTable(threadPool);
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "EnvironmentBakerTests.rejected.bake";
+	std::filesystem::remove(path);
+
+	// What PrefilterEnvironment() gives back for faces that don't fit
+	PrefilteredEnvironment empty = PrefilterEnvironment({}, threadPool);
+	CHECK(!SaveEnvironmentBake(path.wstring(), 1, empty, brdf));
+
+	PrefilteredEnvironment environment = PrefilterEnvironment(RenderCubemap(Tinted(SmallLight), 8), threadPool);
+	BRDFLookupTable wrongBRDF = brdf;
+	wrongBRDF.Size = BRDF_LUT_SIZE / 2;
+	CHECK(!SaveEnvironmentBake(path.wstring(), 1, environment, wrongBRDF));
+	CHECK(!std::filesystem::exists(path));
+}
+
+int main() { return RunAllTests(); }
@@ -0,0 +1,193 @@
+#include "TestFramework.h"
+#include "ConstantBufferLayout.h"
+#include "HlslPacking.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace HlslPacking;
+
+// --------------------------------------------------------
+// The game's constant buffers as shader reflection reported
+// them when ShaderConstants.h was last generated: names,
+// HLSL types, offsets and sizes, in declaration order
+// --------------------------------------------------------
+struct RecordedShader
+{
+	const char* Prefix;
+	std::vector<ConstantBufferDesc> Buffers;
+};
+
+static ConstantBufferVariableDesc Variable(const char* name, const char* hlslType, const char* cppType, unsigned int offset, unsigned int size, unsigned int elements = 0)
+{
+	return { name, hlslType, cppType, offset, size, elements };
+}
+
+static std::vector<RecordedShader> GetRecordedShaders()
+{
+	return {
+		{ "VertexShader", {
+			{ "PerFrame", 0, 128, {
+				Variable("view", "float4x4", "DirectX::XMFLOAT4X4", 0, 64),
+				Variable("projection", "float4x4", "DirectX::XMFLOAT4X4", 64, 64) } },
+			{ "PerObject", 2, 128, {
+				Variable("world", "float4x4", "DirectX::XMFLOAT4X4", 0, 64),
+				Variable("worldInvTranspose", "float4x4", "DirectX::XMFLOAT4X4", 64, 64) } } } },
+		{ "PixelShader", {
+			{ "PerFrame", 0, 1584, {
+				Variable("camPos", "float3", "DirectX::XMFLOAT3", 0, 12),
+				Variable("numDirectionalLights", "int", "int", 12, 4),
+				Variable("clusterParams", "float4", "DirectX::XMFLOAT4", 16, 16),
+				Variable("perObjectLights", "int", "int", 32, 4),
+				Variable("shadowViewProjections", "float4x4", "DirectX::XMFLOAT4X4", 48, 1024, 16),
+				Variable("shadowAtlasRects", "float4", "DirectX::XMFLOAT4", 1072, 256, 16),
+				Variable("cascadeSplits", "float4", "DirectX::XMFLOAT4", 1328, 16),
+				Variable("numCascades", "int", "int", 1344, 4),
+				Variable("virtualShadowViewProjection", "float4x4", "DirectX::XMFLOAT4X4", 1360, 64),
+				Variable("skyIrradianceSH", "float4", "DirectX::XMFLOAT4", 1424, 144, 9),
+				Variable("skyAmbientIntensity", "float", "float", 1568, 4) } },
+			{ "PerMaterial", 1, 64, {
+				Variable("colorTint", "float4", "DirectX::XMFLOAT4", 0, 16),
+				Variable("uvScale", "float2", "DirectX::XMFLOAT2", 16, 8),
+				Variable("uvOffset", "float2", "DirectX::XMFLOAT2", 24, 8),
+				Variable("roughness", "float", "float", 32, 4),
+				Variable("textureSlices", "uint4", "DirectX::XMUINT4", 48, 16) } },
+			{ "PerObject", 2, 48, {
+				Variable("objectLights", "uint4", "DirectX::XMUINT4", 0, 32, 2),
+				Variable("objectLightCounts", "uint3", "DirectX::XMUINT3", 32, 12) } } } } };
+}
+
+// The packing rules' idea of an HLSL type, like "float3" or "float4x4"
+static Member GetMember(const ConstantBufferVariableDesc& variable)
+{
+	size_t digits = variable.HlslType.find_first_of("1234");
+	Member member = Scalar();
+	if (digits != std::string::npos)
+	{
+		unsigned int rows = variable.HlslType[digits] - '0';
+		size_t x = variable.HlslType.find('x', digits);
+		member = x == std::string::npos ? Vector(rows) : Matrix(rows, variable.HlslType[x + 1] - '0');
+	}
+	return variable.Elements > 0 ? Array(member, variable.Elements) : member;
+}
+
+static std::string ReadTextFile(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// --------------------------------------------------------
+// The packing rules, at run time
+// --------------------------------------------------------
+TEST(ScalarsAndVectorsShareRegistersUntilTheyDontFit)
+{
+	CHECK(Place(12, Scalar()) == 12);
+	CHECK(Place(12, Vector(2)) == 16);
+	CHECK(Place(8, Vector(2)) == 8);
+	CHECK(Place(4, Vector(3)) == 4);
+	CHECK(Place(8, Vector(3)) == 16);
+	CHECK(Place(4, Vector(4)) == 16);
+	CHECK(Place(0, Vector(4)) == 0);
+}
+
+TEST(ArraysMatricesAndStructsStartARegister)
+{
+	CHECK(Place(4, Array(Scalar(), 2)) == 16);
+	CHECK(Place(4, Matrix()) == 16);
+	CHECK(Place(4, Struct(4)) == 16);
+	CHECK(Place(32, Matrix()) == 32);
+}
+
+TEST(ArrayElementsArePaddedExceptTheLast)
+{
+	CHECK(Array(Scalar(), 1).Size == 4);
+	CHECK(Array(Scalar(), 4).Size == 52);
+	CHECK(Array(Vector(2), 3).Size == 40);
+	CHECK(Array(Vector(4), 9).Size == 144);
+	CHECK(Array(Matrix(), 16).Size == 1024);
+	CHECK(Array(Matrix(3, 3), 2).Size == 16 * 3 + 44);
+}
+
+TEST(MatricesTakeARegisterPerColumn)
+{
+	CHECK(Matrix().Size == 64);
+	CHECK(Matrix(4, 3).Size == 48);
+	CHECK(Matrix(3, 4).Size == 60);
+	CHECK(Matrix(2, 2).Size == 24);
+}
+
+TEST(RulesMatchRecordedReflection)
+{
+	for (const RecordedShader& shader : GetRecordedShaders())
+	{
+		for (const ConstantBufferDesc& buffer : shader.Buffers)
+		{
+			unsigned int end = 0;
+			for (const ConstantBufferVariableDesc& variable : buffer.Variables)
+			{
+				Member member = GetMember(variable);
+				CHECK(member.Size == variable.Size);
+
+				unsigned int offset = Place(end, member);
+				CHECK(offset == variable.StartOffset);
+				if (offset != variable.StartOffset)
+					printf("    %s%s::%s\n", shader.Prefix, buffer.Name.c_str(), variable.Name.c_str());
+				end = offset + member.Size;
+			}
+			CHECK(AlignToRegister(end) == buffer.Size);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// The struct writer
+// --------------------------------------------------------
+TEST(GeneratedHeaderMatchesShaderConstants)
+{
+	std::string structs;
+	for (const RecordedShader& shader : GetRecordedShaders())
+	{
+		for (const ConstantBufferDesc& buffer : shader.Buffers)
+			structs += GenerateConstantBufferStruct(buffer, shader.Prefix);
+	}
+
+	// Regenerating from the same reflection gives back the checked in header, byte for byte
+	std::string expected = ReadTextFile("../ShaderConstants.h");
+	CHECK(!expected.empty());
+	CHECK(GenerateConstantBufferHeader(structs) == expected);
+}
+
+TEST(GapsBecomeExplicitPadding)
+{
+	ConstantBufferDesc buffer = { "Gaps", 3, 48, {
+		Variable("intensity", "float", "float", 0, 4),
+		Variable("color", "float4", "DirectX::XMFLOAT4", 16, 16),
+		Variable("range", "float", "float", 32, 4) } };
+
+	std::string text = GenerateConstantBufferStruct(buffer, "Test");
+	CHECK(text.find("// Test - cbuffer Gaps : register(b3)") != std::string::npos);
+	CHECK(text.find("struct alignas(16) TestGaps\n{\n\tfloat intensity;\n\tunsigned char Padding0[12];\n\tDirectX::XMFLOAT4 color;\n\tfloat range;\n};") != std::string::npos);
+	CHECK(text.find("static_assert(offsetof(TestGaps, range) == 32);") != std::string::npos);
+	CHECK(text.find("static_assert(sizeof(TestGaps) == 48);") != std::string::npos);
+}
+
+TEST(MismatchedTypesBecomeByteArrays)
+{
+	// A float array's elements are padded to 16 bytes, which float[4] isn't,
+	// and there's no C++ type for a 3x3 matrix
+	ConstantBufferDesc buffer = { "Odd", 0, 112, {
+		Variable("weights", "float", "float", 0, 52, 4),
+		Variable("rotation", "float3x3", "", 64, 44) } };
+
+	std::string text = GenerateConstantBufferStruct(buffer, "Test");
+	CHECK(text.find("\tunsigned char weights[52]; // HLSL float[4]\n") != std::string::npos);
+	CHECK(text.find("\tunsigned char Padding0[12];\n") != std::string::npos);
+	CHECK(text.find("\tunsigned char rotation[44]; // HLSL float3x3\n") != std::string::npos);
+}
+
+int main()
+{
+	return RunAllTests();
+}
@@ -0,0 +1,297 @@
+#include "TestFramework.h"
+#include "ImageLoader.h"
+#include "TextureCooker.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+// --------------------------------------------------------
+// Counts live instances, so tests can see that everything
+// pushed through a queue or loader is freed again
+// --------------------------------------------------------
+static std::atomic<int> liveTrackedItems(0);
+
+struct TrackedItem
+{
+	unsigned int Producer = 0;
+	unsigned int Sequence = 0;
+
+	TrackedItem() { liveTrackedItems++; }
+	TrackedItem(unsigned int producer, unsigned int sequence) : Producer(producer), Sequence(sequence) { liveTrackedItems++; }
+	TrackedItem(const TrackedItem& other) : Producer(other.Producer), Sequence(other.Sequence) { liveTrackedItems++; }
+	TrackedItem& operator=(const TrackedItem& other) = default;
+	~TrackedItem() { liveTrackedItems--; }
+};
+
+// --------------------------------------------------------
+// Stands in for the WIC (or libpng) decoder: a gradient the
+// size given in the name ("image_64x32.png"), or a failure
+// for any name with "missing" in it
+// --------------------------------------------------------
+bool LoadImageRGBA(const std::wstring& file, unsigned int& width, unsigned int& height, std::vector<unsigned char>& rgba)
+{
+	size_t size = file.rfind(L'_');
+	if (file.find(L"missing") != std::wstring::npos || size == std::wstring::npos)
+		return false;
+
+	width = (unsigned int)std::stoul(file.substr(size + 1));
+	height = (unsigned int)std::stoul(file.substr(file.find(L'x', size) + 1));
+	rgba.resize((size_t)width * height * 4);
+	for (size_t ii = 0; ii < rgba.size(); ii++)
+		rgba[ii] = (unsigned char)(ii * 7);
+	return true;
+}
+
+static std::wstring ImageName(unsigned int index, unsigned int width, unsigned int height)
+{
+	return L"image" + std::to_wstring(index) + L"_" + std::to_wstring(width) + L"x" + std::to_wstring(height) + L".png";
+}
+
+// --------------------------------------------------------
+// The queue on its own
+// --------------------------------------------------------
+TEST(QueueIsFirstInFirstOut)
+{
+	MPSCQueue<unsigned int> queue;
+	unsigned int item = 0;
+	CHECK(!queue.TryPop(item));
+
+	for (unsigned int ii = 0; ii < 100; ii++)
+		queue.Push(ii);
+	CHECK(queue.GetCount() == 100);
+
+	bool inOrder = true;
+	for (unsigned int ii = 0; ii < 100; ii++)
+		inOrder = inOrder && queue.TryPop(item) && item == ii;
+	CHECK(inOrder);
+	CHECK(!queue.TryPop(item));
+	CHECK(queue.GetCount() == 0);
+}
+
+TEST(QueueFreesWhatItHolds)
+{
+	int liveBefore = liveTrackedItems.load();
+	{
+		MPSCQueue<TrackedItem> queue;
+		for (unsigned int ii = 0; ii < 300; ii++)
+			queue.Push(TrackedItem(0, ii));
+
+		// Popped items are freed by the consumer as it goes...
+		TrackedItem item;
+		for (unsigned int ii = 0; ii < 200; ii++)
+			queue.TryPop(item);
+
+		// ...so only what's left (plus the spent node and the copy here) is alive
+		CHECK(liveTrackedItems.load() == liveBefore + 100 + 2);
+	}
+
+	// And the rest go with the queue
+	CHECK(liveTrackedItems.load() == liveBefore);
+}
+
+// Several producers pushing as fast as they can while the consumer pops:
+// every item arrives once, each producer's in the order it pushed them
+TEST(ProducersStayInOrderUnderContention)
+{
+	const unsigned int producerCount = 4;
+	const unsigned int itemsPerProducer = 20000;
+	int liveBefore = liveTrackedItems.load();
+	{
+		MPSCQueue<TrackedItem> queue;
+		std::atomic<unsigned int> ready(0);
+
+		std::vector<std::thread> producers;
+		for (unsigned int p = 0; p < producerCount; p++)
+		{
+			producers.emplace_back([&queue, &ready, p, producerCount]()
+			{
+				// Start together, for as much contention as possible
+				ready++;
+				while (ready.load() < producerCount)
+					std::this_thread::yield();
+
+				for (unsigned int ii = 0; ii < itemsPerProducer; ii++)
+					queue.Push(TrackedItem(p, ii));
+			});
+		}
+
+		std::vector<unsigned int> nextSequence(producerCount, 0);
+		bool inOrder = true;
+		unsigned int popped = 0;
+		TrackedItem item;
+		while (popped < producerCount * itemsPerProducer)
+		{
+			if (!queue.TryPop(item))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			inOrder = inOrder && item.Producer < producerCount && item.Sequence == nextSequence[item.Producer];
+			nextSequence[item.Producer % producerCount]++;
+			popped++;
+		}
+
+		for (std::thread& producer : producers)
+			producer.join();
+
+		CHECK(inOrder);
+		CHECK(!queue.TryPop(item));
+		CHECK(queue.GetCount() == 0);
+		for (unsigned int p = 0; p < producerCount; p++)
+			CHECK(nextSequence[p] == itemsPerProducer);
+	}
+	CHECK(liveTrackedItems.load() == liveBefore);
+}
+
+// --------------------------------------------------------
+// The loader
+// --------------------------------------------------------
+TEST(HundredsOfImagesAllArriveOnce)
+{
+	const unsigned int imageCount = 400;
+	std::shared_ptr<ThreadPool> threadPool = std::make_shared<ThreadPool>(3);
+	ImageLoader loader(threadPool);
+
+	std::vector<unsigned int> uploads(imageCount, 0);
+	bool sizesMatch = true;
+	for (unsigned int ii = 0; ii < imageCount; ii++)
+	{
+		unsigned int width = 4u << (ii % 5);
+		unsigned int height = 4u << ((ii + 2) % 5);
+		loader.Load(ImageName(ii, width, height), MipContent::SRGBColor, [&, ii, width, height](LoadedImage& image)
+		{
+			uploads[ii]++;
+			sizesMatch = sizesMatch &&
+				!image.Mips.empty() &&
+				image.Mips[0].Width == width &&
+				image.Mips[0].Height == height &&
+				image.Mips.back().Width == 1 &&
+				image.Mips.back().Height == 1;
+		});
+	}
+	CHECK(loader.GetPendingCount() > 0);
+
+	loader.UploadAll();
+	CHECK(loader.GetPendingCount() == 0);
+	CHECK(loader.GetDecodedCount() == 0);
+	CHECK(sizesMatch);
+
+	bool eachOnce = true;
+	for (unsigned int count : uploads)
+		eachOnce = eachOnce && count == 1;
+	CHECK(eachOnce);
+}
+
+// With one worker, decodes finish in the order they were loaded, so
+// uploads have to come out in that order too - and no call to Upload()
+// ever hands over more than it's allowed
+TEST(UploadsAreBoundedAndInOrder)
+{
+	const unsigned int imageCount = 300;
+	const unsigned int maxUploadsPerFrame = 7;
+	std::shared_ptr<ThreadPool> threadPool = std::make_shared<ThreadPool>(1);
+	ImageLoader loader(threadPool);
+
+	unsigned int uploadsSoFar = 0;
+	bool inOrder = true;
+	for (unsigned int ii = 0; ii < imageCount; ii++)
+	{
+		loader.Load([ii](LoadedImage& image)
+		{
+			MipLevel level = {};
+			level.Width = 16u << (ii % 4);
+			level.Height = level.Width;
+			level.Pixels.assign((size_t)level.Width * level.Height * 4, (unsigned char)ii);
+			image.Mips = GenerateMipChain(level.Pixels.data(), level.Width, level.Height, MipContent::Data);
+			return true;
+		},
+		[&, ii](LoadedImage& image)
+		{
+			inOrder = inOrder && ii == uploadsSoFar && image.Mips[0].Pixels[0] == (unsigned char)ii;
+			uploadsSoFar++;
+		});
+	}
+
+	bool bounded = true;
+	while (uploadsSoFar < imageCount)
+	{
+		unsigned int uploaded = loader.Upload(maxUploadsPerFrame);
+		bounded = bounded && uploaded <= maxUploadsPerFrame;
+		if (uploaded == 0)
+			std::this_thread::yield();
+	}
+
+	CHECK(bounded);
+	CHECK(inOrder);
+	CHECK(loader.GetPendingCount() == 0);
+}
+
+TEST(FailedDecodesStillReachTheirUpload)
+{
+	std::shared_ptr<ThreadPool> threadPool = std::make_shared<ThreadPool>(2);
+	ImageLoader loader(threadPool);
+
+	unsigned int failures = 0;
+	unsigned int successes = 0;
+	for (unsigned int ii = 0; ii < 100; ii++)
+	{
+		std::wstring file = ii % 3 == 0 ? L"missing_" + std::to_wstring(ii) + L".png" : ImageName(ii, 8, 8);
+		loader.Load(file, [&](LoadedImage& image)
+		{
+			if (image.Mips.empty())
+				failures += image.Error.find("missing") != std::string::npos ? 1 : 0;
+			else
+				successes += image.Mips.size() == 1 && image.Mips[0].Pixels.size() == 8 * 8 * 4 ? 1 : 0;
+		});
+	}
+
+	// A decode that fills in mips and then fails hands over no mips
+	bool partialDropped = false;
+	loader.Load([](LoadedImage& image)
+	{
+		image.Mips.resize(3);
+		return false;
+	},
+	[&](LoadedImage& image) { partialDropped = image.Mips.empty(); });
+
+	loader.UploadAll();
+	CHECK(failures == 34);
+	CHECK(successes == 66);
+	CHECK(partialDropped);
+}
+
+// Every decode and upload function (and whatever they hold on to) is let go
+// of once its image is uploaded, and anything never uploaded goes with the loader
+TEST(LoadsAreFreedOnceUploaded)
+{
+	std::shared_ptr<ThreadPool> threadPool = std::make_shared<ThreadPool>(3);
+	int liveBefore = liveTrackedItems.load();
+	{
+		ImageLoader loader(threadPool);
+		for (unsigned int ii = 0; ii < 500; ii++)
+		{
+			auto held = std::make_shared<TrackedItem>(0, ii);
+			loader.Load(
+				[held](LoadedImage& image) { image.Mips.resize(1); return true; },
+				[held](LoadedImage&) {});
+		}
+
+		loader.UploadAll();
+		CHECK(liveTrackedItems.load() == liveBefore);
+
+		// Decoded but never uploaded
+		for (unsigned int ii = 0; ii < 200; ii++)
+		{
+			auto held = std::make_shared<TrackedItem>(1, ii);
+			loader.Load(
+				[held](LoadedImage&) { return true; },
+				[held](LoadedImage&) {});
+		}
+		CHECK(liveTrackedItems.load() > liveBefore);
+	}
+	CHECK(liveTrackedItems.load() == liveBefore);
+}
+
+int main() { return RunAllTests(); }
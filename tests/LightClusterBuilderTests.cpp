@@ -0,0 +1,240 @@
+#include "TestFramework.h"
+#include "LightClusterBuilder.h"
+#include "TestScenes.h"
+
+#include <random>
+
+using namespace DirectX;
+
+static const float CAMERA_NEAR = 0.1f;
+static const float CAMERA_FAR = 200.0f;
+
+// --------------------------------------------------------
+// Lights placed in front of the test camera, whose view
+// space positions are their world space ones
+// --------------------------------------------------------
+struct ClusterScene : TestCamera
+{
+	LightClusterBuilder Builder = LightClusterBuilder(Pool);
+	std::vector<Light> Lights;
+
+	ClusterScene() : TestCamera(XM_PIDIV4, 16.0f / 9.0f, CAMERA_NEAR, CAMERA_FAR, 3) {}
+
+	void AddLight(int type, XMFLOAT3 position, float range, XMFLOAT3 direction = XMFLOAT3(0, 0, 1), float outerAngle = 0.0f)
+	{
+		Light light = {};
+		light.Type = type;
+		light.Position = position;
+		light.Range = range;
+		light.Direction = direction;
+		light.SpotOuterAngle = outerAngle;
+		light.ShadowIndex = -1;
+		Lights.push_back(light);
+	}
+
+	void Build() { Builder.Build(Lights, View, Projection, CAMERA_NEAR, CAMERA_FAR); }
+
+	// The cluster a view space point falls in, or -1 if it's off screen or out of range
+	int FindCluster(const XMFLOAT3& p) const
+	{
+		if (p.z <= CAMERA_NEAR || p.z >= CAMERA_FAR)
+			return -1;
+
+		float ndcX = p.x * Projection._11 / p.z;
+		float ndcY = p.y * Projection._22 / p.z;
+		if (fabsf(ndcX) >= 1.0f || fabsf(ndcY) >= 1.0f)
+			return -1;
+
+		int x = (int)((ndcX + 1.0f) * 0.5f * CLUSTER_COUNT_X);
+		int y = (int)((1.0f - ndcY) * 0.5f * CLUSTER_COUNT_Y);
+		int z = (int)floorf(logf(p.z) * Builder.GetSliceScale() + Builder.GetSliceBias());
+		z = z < 0 ? 0 : (z >= CLUSTER_COUNT_Z ? CLUSTER_COUNT_Z - 1 : z);
+		return (z * CLUSTER_COUNT_Y + y) * CLUSTER_COUNT_X + x;
+	}
+
+	bool ClusterHasLight(int cluster, unsigned int lightIndex) const
+	{
+		const XMUINT3& range = Builder.GetClusterRanges()[cluster];
+		const std::vector<unsigned int>& indices = Builder.GetLightIndices();
+		for (unsigned int ii = range.x; ii < range.x + range.y + range.z; ii++)
+		{
+			if (indices[ii] == lightIndex)
+				return true;
+		}
+		return false;
+	}
+
+	unsigned int CountClustersWithLight(unsigned int lightIndex) const
+	{
+		unsigned int count = 0;
+		for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+			count += ClusterHasLight(cluster, lightIndex) ? 1 : 0;
+		return count;
+	}
+};
+
+TEST(SliceScaleAndBiasMapDepthToSlices)
+{
+	ClusterScene scene;
+	scene.Build();
+
+	// The near plane starts slice 0 and the far plane ends the last one
+	float scale = scene.Builder.GetSliceScale();
+	float bias = scene.Builder.GetSliceBias();
+	CHECK_NEAR(logf(CAMERA_NEAR) * scale + bias, 0.0f, 1e-3f);
+	CHECK_NEAR(logf(CAMERA_FAR) * scale + bias, (float)CLUSTER_COUNT_Z, 1e-3f);
+
+	// Each slice is the same ratio deeper than the last
+	float ratio = powf(CAMERA_FAR / CAMERA_NEAR, 1.0f / CLUSTER_COUNT_Z);
+	CHECK_NEAR(logf(CAMERA_NEAR * ratio * ratio * ratio) * scale + bias, 3.0f, 1e-3f);
+}
+
+TEST(NoLightsMeansEmptyClusters)
+{
+	ClusterScene scene;
+	scene.AddLight(LIGHT_TYPE_DIRECTIONAL, XMFLOAT3(0, 0, 0), 0.0f, XMFLOAT3(0, -1, 0));
+	scene.Build();
+
+	// Directional lights are left to the shader's global loop
+	CHECK(scene.Builder.GetLightIndices().empty());
+	CHECK(scene.Builder.GetClusterRanges().size() == CLUSTER_COUNT);
+	for (const XMUINT3& range : scene.Builder.GetClusterRanges())
+		CHECK(range.y == 0 && range.z == 0);
+}
+
+TEST(PointLightReachesItsOwnClusterOnly)
+{
+	ClusterScene scene;
+	scene.AddLight(LIGHT_TYPE_POINT, XMFLOAT3(1, 0.5f, 20), 0.5f);
+	scene.Build();
+
+	int own = scene.FindCluster(XMFLOAT3(1, 0.5f, 20));
+	CHECK(own >= 0);
+	CHECK(scene.ClusterHasLight(own, 0));
+
+	// Nowhere near the far corner of the screen
+	CHECK(!scene.ClusterHasLight(scene.FindCluster(XMFLOAT3(-40, -20, 150)), 0));
+
+	// A small light only touches a handful of clusters
+	unsigned int count = scene.CountClustersWithLight(0);
+	CHECK(count >= 1 && count < 30);
+}
+
+TEST(LightsOutsideTheDepthRangeAreDropped)
+{
+	ClusterScene scene;
+	scene.AddLight(LIGHT_TYPE_POINT, XMFLOAT3(0, 0, -10), 5.0f); // Behind the camera
+	scene.AddLight(LIGHT_TYPE_POINT, XMFLOAT3(0, 0, 300), 50.0f); // Past the far plane
+	scene.Build();
+
+	CHECK(scene.Builder.GetLightIndices().empty());
+}
+
+TEST(EveryPointInsideALightFindsIt)
+{
+	// No false negatives: sample points in each light's sphere (or spot
+	// light's cone) and make sure the cluster they land in lists the light
+	ClusterScene scene;
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	for (int ii = 0; ii < 40; ii++)
+	{
+		XMFLOAT3 position(unit(random) * 30.0f, unit(random) * 15.0f, 40.0f + unit(random) * 35.0f);
+		scene.AddLight(LIGHT_TYPE_POINT, position, 1.0f + (unit(random) + 1.0f) * 3.0f);
+	}
+	for (int ii = 0; ii < 20; ii++)
+	{
+		XMFLOAT3 position(unit(random) * 30.0f, unit(random) * 15.0f, 40.0f + unit(random) * 35.0f);
+		XMFLOAT3 direction(unit(random), unit(random), unit(random));
+		float angle = 0.2f + (unit(random) + 1.0f) * 0.6f; // Both narrow and wide cones
+		scene.AddLight(LIGHT_TYPE_SPOT, position, 8.0f, direction, angle);
+	}
+	scene.Build();
+
+	unsigned int misses = 0;
+	unsigned int samples = 0;
+	for (unsigned int lightIndex = 0; lightIndex < scene.Lights.size(); lightIndex++)
+	{
+		const Light& light = scene.Lights[lightIndex];
+		XMVECTOR position = XMLoadFloat3(&light.Position);
+		XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&light.Direction));
+
+		for (int s = 0; s < 300; s++)
+		{
+			XMVECTOR offset = XMVectorSet(unit(random), unit(random), unit(random), 0);
+			if (XMVectorGetX(XMVector3Length(offset)) > 1.0f)
+				continue;
+			offset = XMVectorScale(offset, light.Range);
+
+			// Inside the cone, for spot lights
+			if (light.Type == LIGHT_TYPE_SPOT)
+			{
+				float length = XMVectorGetX(XMVector3Length(offset));
+				if (length < 1e-3f || XMVectorGetX(XMVector3Dot(offset, direction)) < length * cosf(light.SpotOuterAngle))
+					continue;
+			}
+
+			XMFLOAT3 point;
+			XMStoreFloat3(&point, XMVectorAdd(position, offset));
+			int cluster = scene.FindCluster(point);
+			if (cluster < 0)
+				continue;
+
+			samples++;
+			misses += scene.ClusterHasLight(cluster, lightIndex) ? 0 : 1;
+		}
+	}
+	CHECK(samples > 1000);
+	CHECK(misses == 0);
+}
+
+TEST(RangesArePackedPointLightsFirst)
+{
+	ClusterScene scene;
+	scene.AddLight(LIGHT_TYPE_POINT, XMFLOAT3(0, 0, 10), 3.0f);
+	scene.AddLight(LIGHT_TYPE_POINT, XMFLOAT3(0.5f, 0, 10), 3.0f);
+	scene.AddLight(LIGHT_TYPE_SPOT, XMFLOAT3(0, 0, 5), 10.0f, XMFLOAT3(0, 0, 1), 0.5f);
+	scene.Build();
+
+	// One compact list, in cluster order
+	unsigned int expectedOffset = 0;
+	for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+	{
+		const XMUINT3& range = scene.Builder.GetClusterRanges()[cluster];
+		CHECK(range.x == expectedOffset);
+		for (unsigned int ii = 0; ii < range.y + range.z; ii++)
+		{
+			int type = scene.Lights[scene.Builder.GetLightIndices()[range.x + ii]].Type;
+			CHECK(type == (ii < range.y ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT));
+		}
+		expectedOffset += range.y + range.z;
+	}
+	CHECK(expectedOffset == scene.Builder.GetLightIndices().size());
+
+	// Where all three overlap
+	const XMUINT3& center = scene.Builder.GetClusterRanges()[scene.FindCluster(XMFLOAT3(0.2f, 0, 10))];
+	CHECK(center.y == 2);
+	CHECK(center.z == 1);
+}
+
+TEST(RebuildingReplacesLastFramesLists)
+{
+	ClusterScene scene;
+	scene.AddLight(LIGHT_TYPE_POINT, XMFLOAT3(0, 0, 10), 3.0f);
+	scene.Build();
+	size_t firstCount = scene.Builder.GetLightIndices().size();
+	CHECK(firstCount > 0);
+
+	scene.Build();
+	CHECK(scene.Builder.GetLightIndices().size() == firstCount);
+
+	scene.Lights.clear();
+	scene.Build();
+	CHECK(scene.Builder.GetLightIndices().empty());
+}
+
+int main()
+{
+	return RunAllTests();
+}
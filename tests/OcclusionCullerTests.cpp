@@ -0,0 +1,158 @@
+#include "TestFramework.h"
+#include "OcclusionCuller.h"
+#include "TestScenes.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Square walls facing the test camera, so what's hidden is
+// easy to work out by hand
+// --------------------------------------------------------
+static const float CAMERA_NEAR = 0.1f;
+static const float CAMERA_FAR = 100.0f;
+
+struct CullerScene : TestCamera
+{
+	OcclusionCuller Culler = OcclusionCuller(Pool);
+
+	CullerScene() : TestCamera(XM_PIDIV2, 2.0f, CAMERA_NEAR, CAMERA_FAR, 2)
+	{
+		Culler.BeginFrame(View, Projection);
+	}
+
+	// A halfSize square centered at (x, y, z), clockwise toward the camera unless flipped
+	void AddWall(float x, float y, float z, float halfSize, bool flipped = false)
+	{
+		std::vector<XMFLOAT3> positions = {
+			XMFLOAT3(-halfSize, -halfSize, 0),
+			XMFLOAT3(-halfSize, halfSize, 0),
+			XMFLOAT3(halfSize, halfSize, 0),
+			XMFLOAT3(halfSize, -halfSize, 0) };
+		std::vector<unsigned int> indices = flipped ?
+			std::vector<unsigned int>{ 0, 2, 1, 0, 3, 2 } :
+			std::vector<unsigned int>{ 0, 1, 2, 0, 2, 3 };
+
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixTranslation(x, y, z));
+		Culler.AddOccluder(positions, indices, world);
+	}
+};
+
+static BoundingBox Box(float x, float y, float z, float halfSize)
+{
+	return BoundingBox(XMFLOAT3(x, y, z), XMFLOAT3(halfSize, halfSize, halfSize));
+}
+
+TEST(EmptyBufferHidesNothingOnScreen)
+{
+	CullerScene scene;
+	scene.Culler.RasterizeOccluders();
+
+	CHECK(scene.Culler.IsVisible(Box(0, 0, 20, 1)));
+	CHECK(scene.Culler.IsVisible(Box(5, -3, 50, 0.5f)));
+}
+
+TEST(BoundsOutsideTheFrustumAreNotVisible)
+{
+	CullerScene scene;
+	scene.Culler.RasterizeOccluders();
+
+	// 90 degrees tall and twice as wide, so at z = 10 the screen spans x +-20, y +-10
+	CHECK(!scene.Culler.IsVisible(Box(40, 0, 10, 1)));
+	CHECK(!scene.Culler.IsVisible(Box(0, 20, 10, 1)));
+	CHECK(!scene.Culler.IsVisible(Box(0, 0, 150, 1)));
+}
+
+TEST(BoundsCrossingTheNearPlaneAreVisible)
+{
+	CullerScene scene;
+	scene.AddWall(0, 0, 5, 50);
+	scene.Culler.RasterizeOccluders();
+
+	// The camera's inside these, so nothing can hide them
+	CHECK(scene.Culler.IsVisible(Box(0, 0, 0, 1)));
+}
+
+TEST(WallHidesWhatIsBehindIt)
+{
+	CullerScene scene;
+	scene.AddWall(0, 0, 10, 30);
+	scene.Culler.RasterizeOccluders();
+
+	CHECK(scene.Culler.GetOccluderTriangleCount() == 2);
+	CHECK(!scene.Culler.IsVisible(Box(0, 0, 20, 1)));
+	CHECK(!scene.Culler.IsVisible(Box(-8, 4, 40, 2)));
+
+	// In front of the wall
+	CHECK(scene.Culler.IsVisible(Box(0, 0, 5, 1)));
+}
+
+TEST(BoundsPeekingPastAnEdgeAreVisible)
+{
+	CullerScene scene;
+	scene.AddWall(0, 0, 10, 2);
+	scene.Culler.RasterizeOccluders();
+
+	// Right behind the wall, and past its right edge
+	CHECK(!scene.Culler.IsVisible(Box(0, 0, 20, 1)));
+	CHECK(scene.Culler.IsVisible(Box(4, 0, 20, 1)));
+	CHECK(scene.Culler.IsVisible(Box(0, 0, 20, 6)));
+}
+
+TEST(BackFacingOccludersAreSkipped)
+{
+	CullerScene scene;
+	scene.AddWall(0, 0, 10, 30, true);
+	scene.Culler.RasterizeOccluders();
+
+	CHECK(scene.Culler.GetOccluderTriangleCount() == 0);
+	CHECK(scene.Culler.IsVisible(Box(0, 0, 20, 1)));
+}
+
+TEST(DepthMatchesTheProjection)
+{
+	CullerScene scene;
+	scene.AddWall(0, 0, 10, 30);
+	scene.Culler.RasterizeOccluders();
+
+	// A flat wall facing the camera is one depth everywhere on screen
+	float expected = CAMERA_FAR / (CAMERA_FAR - CAMERA_NEAR) * (1.0f - CAMERA_NEAR / 10.0f);
+	const std::vector<float>& depth = scene.Culler.GetDepthBuffer();
+	unsigned int width = scene.Culler.GetWidth();
+	unsigned int height = scene.Culler.GetHeight();
+	CHECK(depth.size() == (size_t)width * height);
+	CHECK_NEAR(depth[(height / 2) * width + width / 2], expected, 1e-4f);
+	CHECK_NEAR(depth[0], expected, 1e-4f);
+	CHECK_NEAR(depth.back(), expected, 1e-4f);
+}
+
+TEST(NearerOccluderWins)
+{
+	CullerScene scene;
+	scene.AddWall(0, 0, 30, 60);
+	scene.AddWall(0, 0, 10, 3);
+	scene.Culler.RasterizeOccluders();
+
+	// Between the walls: hidden by the small one in the middle, visible around it
+	CHECK(!scene.Culler.IsVisible(Box(0, 0, 20, 1)));
+	CHECK(scene.Culler.IsVisible(Box(10, 0, 20, 1)));
+	CHECK(!scene.Culler.IsVisible(Box(10, 0, 40, 1)));
+}
+
+TEST(BeginFrameClearsTheBuffer)
+{
+	CullerScene scene;
+	scene.AddWall(0, 0, 10, 30);
+	scene.Culler.RasterizeOccluders();
+	CHECK(!scene.Culler.IsVisible(Box(0, 0, 20, 1)));
+
+	scene.Culler.BeginFrame(scene.View, scene.Projection);
+	scene.Culler.RasterizeOccluders();
+	CHECK(scene.Culler.GetOccluderTriangleCount() == 0);
+	CHECK(scene.Culler.IsVisible(Box(0, 0, 20, 1)));
+}
+
+int main()
+{
+	return RunAllTests();
+}
@@ -0,0 +1,371 @@
+#include "TestFramework.h"
+#include "Hash.h"
+#include "ShaderReflectionCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+// D3D_CBUFFER_TYPE and DXGI_FORMAT values, as the cache stores them
+static const unsigned int CBUFFER_TYPE_CBUFFER = 0;
+static const unsigned int CBUFFER_TYPE_RESOURCE_BIND_INFO = 3;
+static const unsigned int FORMAT_R32G32B32_FLOAT = 6;
+static const unsigned int FORMAT_R32G32_FLOAT = 16;
+
+// Bytes before the first array: magic, version, hash and five counts
+static const size_t HEADER_SIZE = 4 + 4 + 8 + 5 * 4;
+
+// --------------------------------------------------------
+// The game's two shaders as ReflectShader() saw them when
+// they were last compiled: bound resources, every buffer
+// (structured buffers show up as resource bind info with a
+// single $Element) and the vertex shader's inputs
+// --------------------------------------------------------
+static ShaderReflectionResource Resource(const char* name, unsigned int bindPoint)
+{
+	return { HashFNV1a(name), bindPoint };
+}
+
+static void AddBuffer(ShaderReflectionData& reflection, const char* name, unsigned int type, unsigned int bindPoint, unsigned int size, std::vector<ShaderReflectionVariable> variables)
+{
+	reflection.ConstantBuffers.push_back({ name, type, bindPoint, size, (unsigned int)reflection.Variables.size(), (unsigned int)variables.size() });
+	reflection.Variables.insert(reflection.Variables.end(), variables.begin(), variables.end());
+}
+
+static ShaderReflectionVariable Variable(const char* name, unsigned int offset, unsigned int size)
+{
+	return { HashFNV1a(name), offset, size };
+}
+
+static ShaderReflectionData GetRecordedVertexShader()
+{
+	ShaderReflectionData reflection;
+	AddBuffer(reflection, "PerFrame", CBUFFER_TYPE_CBUFFER, 0, 128, {
+		Variable("view", 0, 64),
+		Variable("projection", 64, 64) });
+	AddBuffer(reflection, "PerObject", CBUFFER_TYPE_CBUFFER, 2, 128, {
+		Variable("world", 0, 64),
+		Variable("worldInvTranspose", 64, 64) });
+
+	reflection.InputElements = {
+		{ "POSITION", 0, FORMAT_R32G32B32_FLOAT, false },
+		{ "TEXCOORD", 0, FORMAT_R32G32_FLOAT, false },
+		{ "NORMAL", 0, FORMAT_R32G32B32_FLOAT, false },
+		{ "TANGENT", 0, FORMAT_R32G32B32_FLOAT, false } };
+	return reflection;
+}
+
+static ShaderReflectionData GetRecordedPixelShader()
+{
+	ShaderReflectionData reflection;
+	reflection.ShaderResourceViews = {
+		Resource("Albedo", 0),
+		Resource("NormalMap", 1),
+		Resource("ORMMap", 2),
+		Resource("ShadowAtlas", 3),
+		Resource("VirtualPageTable", 4),
+		Resource("VirtualShadowPool", 5),
+		Resource("Lights", 6),
+		Resource("ClusterRanges", 7),
+		Resource("ClusterLightIndices", 8),
+		Resource("SpecularEnvironment", 9),
+		Resource("BRDFLookup", 10) };
+	reflection.Samplers = {
+		Resource("BasicSampler", 0),
+		Resource("ShadowSampler", 1),
+		Resource("ClampSampler", 2) };
+
+	AddBuffer(reflection, "PerFrame", CBUFFER_TYPE_CBUFFER, 0, 1584, {
+		Variable("camPos", 0, 12),
+		Variable("numDirectionalLights", 12, 4),
+		Variable("clusterParams", 16, 16),
+		Variable("perObjectLights", 32, 4),
+		Variable("shadowViewProjections", 48, 1024),
+		Variable("shadowAtlasRects", 1072, 256),
+		Variable("cascadeSplits", 1328, 16),
+		Variable("numCascades", 1344, 4),
+		Variable("virtualShadowViewProjection", 1360, 64),
+		Variable("skyIrradianceSH", 1424, 144),
+		Variable("skyAmbientIntensity", 1568, 4) });
+	AddBuffer(reflection, "PerMaterial", CBUFFER_TYPE_CBUFFER, 1, 64, {
+		Variable("colorTint", 0, 16),
+		Variable("uvScale", 16, 8),
+		Variable("uvOffset", 24, 8),
+		Variable("roughness", 32, 4),
+		Variable("textureSlices", 48, 16) });
+	AddBuffer(reflection, "PerObject", CBUFFER_TYPE_CBUFFER, 2, 48, {
+		Variable("objectLights", 0, 32),
+		Variable("objectLightCounts", 32, 12) });
+	AddBuffer(reflection, "Lights", CBUFFER_TYPE_RESOURCE_BIND_INFO, 6, 64, { Variable("$Element", 0, 64) });
+	AddBuffer(reflection, "ClusterRanges", CBUFFER_TYPE_RESOURCE_BIND_INFO, 7, 12, { Variable("$Element", 0, 12) });
+	AddBuffer(reflection, "ClusterLightIndices", CBUFFER_TYPE_RESOURCE_BIND_INFO, 8, 4, { Variable("$Element", 0, 4) });
+	return reflection;
+}
+
+// Stand-ins for the .cso files the hashes come from
+static const char VERTEX_SHADER_BYTECODE[] = "DXBC vertex shader";
+static const char PIXEL_SHADER_BYTECODE[] = "DXBC pixel shader";
+
+static bool SameResources(const std::vector<ShaderReflectionResource>& a, const std::vector<ShaderReflectionResource>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].NameHash != b[i].NameHash || a[i].BindPoint != b[i].BindPoint)
+			return false;
+	}
+	return true;
+}
+
+static bool SameReflection(const ShaderReflectionData& a, const ShaderReflectionData& b)
+{
+	if (!SameResources(a.ShaderResourceViews, b.ShaderResourceViews) ||
+		!SameResources(a.Samplers, b.Samplers) ||
+		a.ConstantBuffers.size() != b.ConstantBuffers.size() ||
+		a.Variables.size() != b.Variables.size() ||
+		a.InputElements.size() != b.InputElements.size())
+		return false;
+
+	for (size_t i = 0; i < a.ConstantBuffers.size(); i++)
+	{
+		const ShaderReflectionBuffer& x = a.ConstantBuffers[i];
+		const ShaderReflectionBuffer& y = b.ConstantBuffers[i];
+		if (x.Name != y.Name || x.Type != y.Type || x.BindPoint != y.BindPoint || x.Size != y.Size ||
+			x.FirstVariable != y.FirstVariable || x.VariableCount != y.VariableCount)
+			return false;
+	}
+
+	for (size_t i = 0; i < a.Variables.size(); i++)
+	{
+		const ShaderReflectionVariable& x = a.Variables[i];
+		const ShaderReflectionVariable& y = b.Variables[i];
+		if (x.NameHash != y.NameHash || x.ByteOffset != y.ByteOffset || x.Size != y.Size)
+			return false;
+	}
+
+	for (size_t i = 0; i < a.InputElements.size(); i++)
+	{
+		const ShaderReflectionInputElement& x = a.InputElements[i];
+		const ShaderReflectionInputElement& y = b.InputElements[i];
+		if (x.SemanticName != y.SemanticName || x.SemanticIndex != y.SemanticIndex ||
+			x.Format != y.Format || x.PerInstance != y.PerInstance)
+			return false;
+	}
+	return true;
+}
+
+static unsigned long long HashOf(const char* bytecode)
+{
+	return HashShaderBytecode(bytecode, strlen(bytecode));
+}
+
+// --------------------------------------------------------
+// Round trips
+// --------------------------------------------------------
+TEST(RecordedShadersRoundTrip)
+{
+	ShaderReflectionData shaders[] = { GetRecordedVertexShader(), GetRecordedPixelShader() };
+	const char* bytecode[] = { VERTEX_SHADER_BYTECODE, PIXEL_SHADER_BYTECODE };
+	for (int i = 0; i < 2; i++)
+	{
+		std::vector<unsigned char> bytes = SerializeShaderReflection(shaders[i], HashOf(bytecode[i]));
+
+		ShaderReflectionData loaded;
+		CHECK(DeserializeShaderReflection(bytes.data(), bytes.size(), HashOf(bytecode[i]), loaded));
+		CHECK(SameReflection(loaded, shaders[i]));
+	}
+}
+
+TEST(PerInstanceInputsRoundTrip)
+{
+	ShaderReflectionData reflection = GetRecordedVertexShader();
+	reflection.InputElements.push_back({ "WORLD_PER_INSTANCE", 3, FORMAT_R32G32B32_FLOAT, true });
+
+	std::vector<unsigned char> bytes = SerializeShaderReflection(reflection, 1);
+	ShaderReflectionData loaded;
+	CHECK(DeserializeShaderReflection(bytes.data(), bytes.size(), 1, loaded));
+	CHECK(SameReflection(loaded, reflection));
+	CHECK(loaded.InputElements.back().PerInstance);
+	CHECK(!loaded.InputElements.front().PerInstance);
+}
+
+TEST(EmptyReflectionRoundTrips)
+{
+	std::vector<unsigned char> bytes = SerializeShaderReflection(ShaderReflectionData(), 7);
+	CHECK(bytes.size() == HEADER_SIZE);
+
+	ShaderReflectionData loaded = GetRecordedPixelShader();
+	CHECK(DeserializeShaderReflection(bytes.data(), bytes.size(), 7, loaded));
+	CHECK(SameReflection(loaded, ShaderReflectionData()));
+}
+
+// The layout in ShaderReflectionCache.cpp, entry by entry - a change here
+// needs CACHE_VERSION bumped so old files are thrown away
+TEST(LayoutMatchesTheDocumentedFormat)
+{
+	ShaderReflectionData reflection = GetRecordedPixelShader();
+	std::vector<unsigned char> bytes = SerializeShaderReflection(reflection, HashOf(PIXEL_SHADER_BYTECODE));
+
+	size_t expected = HEADER_SIZE;
+	expected += 12 * reflection.ShaderResourceViews.size();
+	expected += 12 * reflection.Samplers.size();
+	for (const ShaderReflectionBuffer& buffer : reflection.ConstantBuffers)
+		expected += 24 + buffer.Name.size();
+	expected += 16 * reflection.Variables.size();
+	CHECK(bytes.size() == expected);
+
+	unsigned int magic = 0;
+	unsigned int version = 0;
+	unsigned long long hash = 0;
+	memcpy(&magic, &bytes[0], 4);
+	memcpy(&version, &bytes[4], 4);
+	memcpy(&hash, &bytes[8], 8);
+	CHECK(memcmp(&bytes[0], "REFL", 4) == 0);
+	CHECK(magic == 0x4C464552);
+	CHECK(version == 1);
+	CHECK(hash == HashOf(PIXEL_SHADER_BYTECODE));
+
+	unsigned int counts[5];
+	memcpy(counts, &bytes[16], sizeof(counts));
+	CHECK(counts[0] == 11);
+	CHECK(counts[1] == 3);
+	CHECK(counts[2] == 6);
+	CHECK(counts[3] == 21);
+	CHECK(counts[4] == 0);
+
+	// First SRV right after the counts: Albedo at t0
+	unsigned long long albedoHash = 0;
+	unsigned int albedoSlot = ~0u;
+	memcpy(&albedoHash, &bytes[HEADER_SIZE], 8);
+	memcpy(&albedoSlot, &bytes[HEADER_SIZE + 8], 4);
+	CHECK(albedoHash == HashFNV1a("Albedo"));
+	CHECK(albedoSlot == 0);
+}
+
+// --------------------------------------------------------
+// Stale and damaged files
+// --------------------------------------------------------
+TEST(BytecodeHashMatchesFNV1a)
+{
+	CHECK(HashOf(PIXEL_SHADER_BYTECODE) == HashFNV1a(PIXEL_SHADER_BYTECODE));
+	CHECK(HashOf(PIXEL_SHADER_BYTECODE) != HashOf(VERTEX_SHADER_BYTECODE));
+	CHECK(HashShaderBytecode("", 0) == FNV1A_OFFSET_BASIS);
+}
+
+TEST(RecompiledShaderIsRejected)
+{
+	ShaderReflectionData reflection = GetRecordedPixelShader();
+	std::vector<unsigned char> bytes = SerializeShaderReflection(reflection, HashOf(PIXEL_SHADER_BYTECODE));
+
+	ShaderReflectionData loaded;
+	CHECK(!DeserializeShaderReflection(bytes.data(), bytes.size(), HashOf(VERTEX_SHADER_BYTECODE), loaded));
+	CHECK(loaded.ShaderResourceViews.empty());
+}
+
+TEST(WrongMagicOrVersionIsRejected)
+{
+	std::vector<unsigned char> bytes = SerializeShaderReflection(GetRecordedVertexShader(), 1);
+	ShaderReflectionData loaded;
+
+	std::vector<unsigned char> badMagic = bytes;
+	badMagic[0] ^= 0xFF;
+	CHECK(!DeserializeShaderReflection(badMagic.data(), badMagic.size(), 1, loaded));
+
+	std::vector<unsigned char> badVersion = bytes;
+	badVersion[4]++;
+	CHECK(!DeserializeShaderReflection(badVersion.data(), badVersion.size(), 1, loaded));
+}
+
+TEST(EveryTruncationIsRejected)
+{
+	ShaderReflectionData shaders[] = { GetRecordedVertexShader(), GetRecordedPixelShader() };
+	for (const ShaderReflectionData& shader : shaders)
+	{
+		std::vector<unsigned char> bytes = SerializeShaderReflection(shader, 1);
+		int accepted = 0;
+		for (size_t length = 0; length < bytes.size(); length++)
+		{
+			ShaderReflectionData loaded;
+			if (DeserializeShaderReflection(bytes.data(), length, 1, loaded))
+				accepted++;
+		}
+		CHECK(accepted == 0);
+	}
+}
+
+TEST(TrailingBytesAreRejected)
+{
+	std::vector<unsigned char> bytes = SerializeShaderReflection(GetRecordedPixelShader(), 1);
+	bytes.push_back(0);
+
+	ShaderReflectionData loaded;
+	CHECK(!DeserializeShaderReflection(bytes.data(), bytes.size(), 1, loaded));
+}
+
+TEST(VariablesOutsideTheTableAreRejected)
+{
+	ShaderReflectionData reflection = GetRecordedVertexShader();
+	ShaderReflectionData loaded;
+
+	// PerObject's two variables, starting one past the end
+	reflection.ConstantBuffers[1].FirstVariable = 3;
+	std::vector<unsigned char> bytes = SerializeShaderReflection(reflection, 1);
+	CHECK(!DeserializeShaderReflection(bytes.data(), bytes.size(), 1, loaded));
+
+	// A count big enough to wrap around if added to the start
+	reflection.ConstantBuffers[1].FirstVariable = 2;
+	reflection.ConstantBuffers[1].VariableCount = ~0u;
+	bytes = SerializeShaderReflection(reflection, 1);
+	CHECK(!DeserializeShaderReflection(bytes.data(), bytes.size(), 1, loaded));
+}
+
+TEST(HugeCountsAreRejected)
+{
+	std::vector<unsigned char> bytes = SerializeShaderReflection(GetRecordedPixelShader(), 1);
+	ShaderReflectionData loaded;
+
+	// Each of the five counts in turn, as if the file were damaged
+	for (size_t count = 0; count < 5; count++)
+	{
+		std::vector<unsigned char> damaged = bytes;
+		unsigned int huge = 0x40000000;
+		memcpy(&damaged[16 + count * 4], &huge, 4);
+		CHECK(!DeserializeShaderReflection(damaged.data(), damaged.size(), 1, loaded));
+	}
+}
+
+// --------------------------------------------------------
+// Cache files
+// --------------------------------------------------------
+TEST(SavedFileLoadsBack)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "ShaderReflectionCacheTests.refl";
+	ShaderReflectionData reflection = GetRecordedPixelShader();
+	unsigned long long hash = HashOf(PIXEL_SHADER_BYTECODE);
+
+	CHECK(SaveShaderReflection(path.wstring(), hash, reflection));
+
+	ShaderReflectionData loaded;
+	CHECK(LoadShaderReflection(path.wstring(), hash, loaded));
+	CHECK(SameReflection(loaded, reflection));
+	CHECK(!LoadShaderReflection(path.wstring(), HashOf(VERTEX_SHADER_BYTECODE), loaded));
+
+	// Saving again replaces the file rather than appending to it
+	CHECK(SaveShaderReflection(path.wstring(), hash, GetRecordedVertexShader()));
+	CHECK(LoadShaderReflection(path.wstring(), hash, loaded));
+	CHECK(SameReflection(loaded, GetRecordedVertexShader()));
+
+	std::filesystem::remove(path);
+}
+
+TEST(MissingFileFailsToLoad)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "ShaderReflectionCacheTests.missing.refl";
+	std::filesystem::remove(path);
+
+	ShaderReflectionData loaded;
+	CHECK(!LoadShaderReflection(path.wstring(), 1, loaded));
+}
+
+int main() { return RunAllTests(); }
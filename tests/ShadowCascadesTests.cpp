@@ -0,0 +1,251 @@
+#include "TestFramework.h"
+#include "ShadowCascades.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+// Where a world space point lands in a view's clip space, after the divide
+static XMFLOAT3 Project(const ShadowView& view, const XMFLOAT3& point)
+{
+	XMMATRIX viewProjection = XMMatrixMultiply(XMLoadFloat4x4(&view.View), XMLoadFloat4x4(&view.Projection));
+	XMFLOAT3 projected;
+	XMStoreFloat3(&projected, XMVector3TransformCoord(XMLoadFloat3(&point), viewProjection));
+	return projected;
+}
+
+static bool IsInsideClipSpace(const XMFLOAT3& p, float tolerance = 1e-4f)
+{
+	return
+		p.x >= -1.0f - tolerance && p.x <= 1.0f + tolerance &&
+		p.y >= -1.0f - tolerance && p.y <= 1.0f + tolerance &&
+		p.z >= -tolerance && p.z <= 1.0f + tolerance;
+}
+
+static bool SameMatrices(const ShadowView& a, const ShadowView& b)
+{
+	return
+		memcmp(&a.View, &b.View, sizeof(XMFLOAT4X4)) == 0 &&
+		memcmp(&a.Projection, &b.Projection, sizeof(XMFLOAT4X4)) == 0;
+}
+
+// The 8 corners of an axis aligned box, as a stand in for a frustum slice
+static void GetBoxCorners(const XMFLOAT3& center, const XMFLOAT3& extents, XMFLOAT3 cornersOut[8])
+{
+	BoundingBox(center, extents).GetCorners(cornersOut);
+}
+
+static const BoundingBox SCENE_BOUNDS(XMFLOAT3(0, 0, 0), XMFLOAT3(50, 20, 50));
+static const XMFLOAT3 LIGHT_DOWN(0, -1, 0);
+
+// --------------------------------------------------------
+// Split distances
+// --------------------------------------------------------
+TEST(UniformSplitsAreEvenlySpaced)
+{
+	float splits[4];
+	ShadowCascades::ComputeSplitDistances(1.0f, 101.0f, 0.0f, 4, splits);
+	CHECK_NEAR(splits[0], 26.0f, 1e-4f);
+	CHECK_NEAR(splits[1], 51.0f, 1e-4f);
+	CHECK_NEAR(splits[2], 76.0f, 1e-4f);
+	CHECK(splits[3] == 101.0f);
+}
+
+TEST(LogarithmicSplitsAreGeometric)
+{
+	float splits[3];
+	ShadowCascades::ComputeSplitDistances(1.0f, 1000.0f, 1.0f, 3, splits);
+	CHECK_NEAR(splits[0], 10.0f, 1e-3f);
+	CHECK_NEAR(splits[1], 100.0f, 1e-2f);
+	CHECK(splits[2] == 1000.0f);
+}
+
+TEST(SplitsIncreaseAndEndAtTheFarPlane)
+{
+	for (float lambda = 0.0f; lambda <= 1.0f; lambda += 0.25f)
+	{
+		float splits[MAX_SHADOW_CASCADES];
+		ShadowCascades::ComputeSplitDistances(0.1f, 200.0f, lambda, MAX_SHADOW_CASCADES, splits);
+
+		CHECK(splits[0] > 0.1f);
+		for (int ii = 1; ii < MAX_SHADOW_CASCADES; ii++)
+			CHECK(splits[ii] > splits[ii - 1]);
+		CHECK(splits[MAX_SHADOW_CASCADES - 1] == 200.0f);
+	}
+}
+
+// --------------------------------------------------------
+// Frustum slices
+// --------------------------------------------------------
+TEST(SliceCornersSitAtTheSliceDepths)
+{
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&view, XMMatrixIdentity());
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 0.5f, 100.0f));
+
+	XMFLOAT3 corners[8];
+	ShadowCascades::GetFrustumSliceCorners(view, projection, 0.5f, 100.0f, 10.0f, 40.0f, corners);
+
+	// A 90 degree square frustum is as wide as it is deep
+	for (int ii = 0; ii < 4; ii++)
+	{
+		CHECK_NEAR(corners[ii].z, 10.0f, 1e-3f);
+		CHECK_NEAR(fabsf(corners[ii].x), 10.0f, 1e-3f);
+		CHECK_NEAR(fabsf(corners[ii].y), 10.0f, 1e-3f);
+
+		CHECK_NEAR(corners[ii + 4].z, 40.0f, 1e-2f);
+		CHECK_NEAR(fabsf(corners[ii + 4].x), 40.0f, 1e-2f);
+		CHECK_NEAR(fabsf(corners[ii + 4].y), 40.0f, 1e-2f);
+	}
+}
+
+// --------------------------------------------------------
+// Cascade fitting
+// --------------------------------------------------------
+TEST(CascadeContainsItsSlice)
+{
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(3, 2, -5, 0), XMVectorSet(0.3f, -0.2f, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f));
+
+	const XMFLOAT3 lightDirections[3] = { XMFLOAT3(1, -1, 1), XMFLOAT3(-0.2f, -1, 0.5f), LIGHT_DOWN };
+	for (const XMFLOAT3& lightDirection : lightDirections)
+	{
+		XMFLOAT3 corners[8];
+		ShadowCascades::GetFrustumSliceCorners(view, projection, 0.1f, 100.0f, 5.0f, 20.0f, corners);
+		ShadowView cascade = ShadowCascades::FitCascade(corners, lightDirection, SCENE_BOUNDS, 1024);
+
+		CHECK(!cascade.Perspective);
+		for (const XMFLOAT3& corner : corners)
+			CHECK(IsInsideClipSpace(Project(cascade, corner)));
+	}
+}
+
+TEST(CascadeReachesBackToEveryCaster)
+{
+	XMFLOAT3 corners[8];
+	GetBoxCorners(XMFLOAT3(0, 0, 0), XMFLOAT3(4, 2, 4), corners);
+	ShadowView cascade = ShadowCascades::FitCascade(corners, LIGHT_DOWN, SCENE_BOUNDS, 1024);
+
+	// Nothing in the scene between the light and the slice can be clipped away
+	XMFLOAT3 sceneCorners[BoundingBox::CORNER_COUNT];
+	SCENE_BOUNDS.GetCorners(sceneCorners);
+	for (const XMFLOAT3& corner : sceneCorners)
+		CHECK(Project(cascade, corner).z >= 0.0f);
+}
+
+TEST(CascadeSizeIgnoresCameraRotation)
+{
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f));
+
+	float scale = 0.0f;
+	for (int step = 0; step < 8; step++)
+	{
+		float yaw = step * XM_PI / 4.0f;
+		XMFLOAT4X4 view;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorZero(), XMVectorSet(sinf(yaw), 0, cosf(yaw), 0), XMVectorSet(0, 1, 0, 0)));
+
+		XMFLOAT3 corners[8];
+		ShadowCascades::GetFrustumSliceCorners(view, projection, 0.1f, 100.0f, 5.0f, 20.0f, corners);
+		ShadowView cascade = ShadowCascades::FitCascade(corners, XMFLOAT3(1, -1, 1), SCENE_BOUNDS, 1024);
+
+		if (step == 0)
+			scale = cascade.Projection._11;
+		CHECK(cascade.Projection._11 == scale);
+		CHECK(cascade.Projection._22 == scale);
+	}
+}
+
+TEST(CascadeSnapsToWholeTexels)
+{
+	// Straight down, the light's x and y are the world's x and z
+	const unsigned int resolution = 1024;
+	XMFLOAT3 corners[8];
+	GetBoxCorners(XMFLOAT3(3.37f, 0, -1.91f), XMFLOAT3(4, 2, 4), corners);
+	ShadowView cascade = ShadowCascades::FitCascade(corners, LIGHT_DOWN, SCENE_BOUNDS, resolution);
+
+	// The world origin, and so every other texel corner, lands on the texel grid
+	XMFLOAT3 origin = Project(cascade, XMFLOAT3(0, 0, 0));
+	float texelX = origin.x * resolution * 0.5f;
+	float texelY = origin.y * resolution * 0.5f;
+	CHECK_NEAR(texelX, roundf(texelX), 1e-2f);
+	CHECK_NEAR(texelY, roundf(texelY), 1e-2f);
+}
+
+TEST(CascadeHoldsStillUntilTheSliceMovesATexel)
+{
+	// A slice radius of 6 over 1024 texels, so a texel is exactly 12 / 1024
+	const unsigned int resolution = 1024;
+	const float texelSize = 12.0f / resolution;
+
+	XMFLOAT3 corners[8];
+	GetBoxCorners(XMFLOAT3(0, 0, 0), XMFLOAT3(4, 2, 4), corners);
+	ShadowView still = ShadowCascades::FitCascade(corners, LIGHT_DOWN, SCENE_BOUNDS, resolution);
+
+	// Less than half a texel either way keeps the exact same matrices,
+	// which is what the static shadow cache is keyed on
+	const float nudges[4] = { 0.3f, -0.3f, 0.45f, -0.1f };
+	for (float nudge : nudges)
+	{
+		GetBoxCorners(XMFLOAT3(nudge * texelSize, 0, nudge * texelSize), XMFLOAT3(4, 2, 4), corners);
+		CHECK(SameMatrices(ShadowCascades::FitCascade(corners, LIGHT_DOWN, SCENE_BOUNDS, resolution), still));
+	}
+
+	// A whole texel moves it
+	GetBoxCorners(XMFLOAT3(texelSize, 0, 0), XMFLOAT3(4, 2, 4), corners);
+	ShadowView moved = ShadowCascades::FitCascade(corners, LIGHT_DOWN, SCENE_BOUNDS, resolution);
+	CHECK(!SameMatrices(moved, still));
+	CHECK_NEAR(moved.View._41 - still.View._41, -texelSize, 1e-5f);
+}
+
+// --------------------------------------------------------
+// Spot and point lights
+// --------------------------------------------------------
+TEST(SpotLightLooksDownItsCone)
+{
+	ShadowView spot = ShadowCascades::FitSpotLight(XMFLOAT3(1, 5, 2), XMFLOAT3(0, -1, 0), XM_PIDIV4, 20.0f);
+	CHECK(spot.Perspective);
+
+	XMFLOAT3 center = Project(spot, XMFLOAT3(1, -5, 2));
+	CHECK_NEAR(center.x, 0.0f, 1e-4f);
+	CHECK_NEAR(center.y, 0.0f, 1e-4f);
+	CHECK(IsInsideClipSpace(center));
+
+	// Past the range, and outside the outer angle
+	CHECK(Project(spot, XMFLOAT3(1, -20, 2)).z > 1.0f);
+	CHECK(!IsInsideClipSpace(Project(spot, XMFLOAT3(8, 0, 2))));
+}
+
+TEST(PointLightFacesCoverEveryDirection)
+{
+	const XMFLOAT3 position(2, 3, 4);
+	const XMFLOAT3 directions[6] = {
+		XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0),
+		XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0),
+		XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1) };
+
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		ShadowView view = ShadowCascades::FitPointLightFace(position, 10.0f, face);
+		for (unsigned int other = 0; other < 6; other++)
+		{
+			XMFLOAT3 point(
+				position.x + directions[other].x * 5.0f,
+				position.y + directions[other].y * 5.0f,
+				position.z + directions[other].z * 5.0f);
+
+			// Only its own face sees a point straight down its axis
+			XMFLOAT3 projected = Project(view, point);
+			bool inFront = XMVectorGetZ(XMVector3Transform(XMLoadFloat3(&point), XMLoadFloat4x4(&view.View))) > 0.0f;
+			CHECK((inFront && IsInsideClipSpace(projected)) == (face == other));
+		}
+	}
+}
+
+int main()
+{
+	return RunAllTests();
+}
@@ -0,0 +1,199 @@
+#include "TestFramework.h"
+#include "CubeMap.h"
+#include "SphericalHarmonics.h"
+#include "TestScenes.h"
+
+using namespace DirectX;
+
+// Normalization constants of bands 0, 1 and 2's 3z^2 - 1 term
+static const float Y0 = 0.282095f;
+static const float Y1 = 0.488603f;
+static const float Y6 = 0.315392f;
+
+// Gamma-encoded bytes in the 8 bit faces leave this much error in the
+// coefficients, even after averaging over every texel
+static const float COEFFICIENT_TOLERANCE = 0.01f;
+static const float DIFFUSE_TOLERANCE = 0.004f;
+
+static XMFLOAT3 Gray(float value) { return XMFLOAT3(value, value, value); }
+
+// Directions spread over the whole sphere, including the cube's edges and corners
+static std::vector<XMFLOAT3> GetTestDirections()
+{
+	std::vector<XMFLOAT3> directions;
+	for (int x = -1; x <= 1; x++)
+	{
+		for (int y = -1; y <= 1; y++)
+		{
+			for (int z = -1; z <= 1; z++)
+			{
+				if (x == 0 && y == 0 && z == 0)
+					continue;
+				XMFLOAT3 direction;
+				XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet((float)x, (float)y, (float)z, 0)));
+				directions.push_back(direction);
+			}
+		}
+	}
+	directions.push_back(XMFLOAT3(0.6f, 0.0f, 0.8f));
+	directions.push_back(XMFLOAT3(0.0f, -0.28f, 0.96f));
+	return directions;
+}
+
+// --------------------------------------------------------
+// Projection of environments whose SH9 is known exactly
+// --------------------------------------------------------
+TEST(ConstantEnvironmentIsOnlyBandZero)
+{
+	ThreadPool threadPool;
+	SH9Color sh = ProjectCubemapSH9(RenderCubemap([](XMFLOAT3) { return Gray(1.0f); }, 32), threadPool);
+
+	// Integral of Y0 over the sphere
+	CHECK_NEAR(sh.Coefficients[0].x, 4.0f * XM_PI * Y0, 1e-4f);
+	CHECK_NEAR(sh.Coefficients[0].y, 4.0f * XM_PI * Y0, 1e-4f);
+	for (unsigned int k = 1; k < SH9_COEFFICIENTS; k++)
+		CHECK_NEAR(sh.Coefficients[k].x, 0.0f, 1e-4f);
+
+	// A white sky lights a white surface facing any way at full brightness
+	SH9Color diffuse = ComputeSH9DiffuseConstants(sh);
+	for (XMFLOAT3 normal : GetTestDirections())
+		CHECK_NEAR(EvaluateSH9Diffuse(diffuse, normal).x, 1.0f, 1e-4f);
+}
+
+// A sky that's brighter overhead (+z here): 0.5 + 0.5z, which is all
+// bands 0 and 1
+TEST(LinearGradientProjectsOntoBandOne)
+{
+	ThreadPool threadPool;
+	SH9Color sh = ProjectCubemapSH9(RenderCubemap([](XMFLOAT3 d) { return Gray(0.5f + 0.5f * d.z); }, 64), threadPool);
+
+	// The integral of z^2 over the sphere is 4 pi / 3
+	CHECK_NEAR(sh.Coefficients[0].x, 0.5f * 4.0f * XM_PI * Y0, COEFFICIENT_TOLERANCE);
+	CHECK_NEAR(sh.Coefficients[2].x, 0.5f * 4.0f * XM_PI / 3.0f * Y1, COEFFICIENT_TOLERANCE);
+	const unsigned int others[] = { 1, 3, 4, 5, 6, 7, 8 };
+	for (unsigned int k : others)
+		CHECK_NEAR(sh.Coefficients[k].x, 0.0f, COEFFICIENT_TOLERANCE);
+
+	// Band limited, so the coefficients give back the sky itself...
+	for (XMFLOAT3 direction : GetTestDirections())
+		CHECK_NEAR(EvaluateSH9(sh, direction).x, 0.5f + 0.5f * direction.z, COEFFICIENT_TOLERANCE);
+
+	// ...and cosine weighted over a hemisphere, band 1 keeps 2/3 of itself
+	SH9Color diffuse = ComputeSH9DiffuseConstants(sh);
+	for (XMFLOAT3 normal : GetTestDirections())
+		CHECK_NEAR(EvaluateSH9Diffuse(diffuse, normal).x, 0.5f + normal.z / 3.0f, DIFFUSE_TOLERANCE);
+}
+
+// 0.4 + 0.2 (3z^2 - 1): a bright horizon band's opposite, all in band 2
+TEST(QuadraticEnvironmentProjectsOntoBandTwo)
+{
+	ThreadPool threadPool;
+	SH9Color sh = ProjectCubemapSH9(RenderCubemap([](XMFLOAT3 d) { return Gray(0.4f + 0.2f * (3.0f * d.z * d.z - 1.0f)); }, 64), threadPool);
+
+	// The integral of (3z^2 - 1)^2 over the sphere is 16 pi / 5
+	CHECK_NEAR(sh.Coefficients[0].x, 0.4f * 4.0f * XM_PI * Y0, COEFFICIENT_TOLERANCE);
+	CHECK_NEAR(sh.Coefficients[6].x, 0.2f * 16.0f * XM_PI / 5.0f * Y6, COEFFICIENT_TOLERANCE);
+	const unsigned int others[] = { 1, 2, 3, 4, 5, 7, 8 };
+	for (unsigned int k : others)
+		CHECK_NEAR(sh.Coefficients[k].x, 0.0f, COEFFICIENT_TOLERANCE);
+
+	// Band 2 keeps a quarter of itself through the cosine lobe
+	SH9Color diffuse = ComputeSH9DiffuseConstants(sh);
+	for (XMFLOAT3 normal : GetTestDirections())
+		CHECK_NEAR(EvaluateSH9Diffuse(diffuse, normal).x, 0.4f + 0.05f * (3.0f * normal.z * normal.z - 1.0f), DIFFUSE_TOLERANCE);
+}
+
+// Each channel leaning a different way shows every face is oriented right
+TEST(ChannelsProjectAlongTheirOwnAxes)
+{
+	ThreadPool threadPool;
+	SH9Color sh = ProjectCubemapSH9(RenderCubemap([](XMFLOAT3 d)
+	{
+		return XMFLOAT3(0.5f + 0.5f * d.x, 0.5f + 0.5f * d.y, 0.5f - 0.5f * d.z);
+	}, 48), threadPool);
+
+	float band1 = 0.5f * 4.0f * XM_PI / 3.0f * Y1;
+	CHECK_NEAR(sh.Coefficients[3].x, band1, COEFFICIENT_TOLERANCE); // x
+	CHECK_NEAR(sh.Coefficients[1].y, band1, COEFFICIENT_TOLERANCE); // y
+	CHECK_NEAR(sh.Coefficients[2].z, -band1, COEFFICIENT_TOLERANCE); // z
+	CHECK_NEAR(sh.Coefficients[1].x, 0.0f, COEFFICIENT_TOLERANCE);
+	CHECK_NEAR(sh.Coefficients[2].x, 0.0f, COEFFICIENT_TOLERANCE);
+	CHECK_NEAR(sh.Coefficients[3].y, 0.0f, COEFFICIENT_TOLERANCE);
+	CHECK_NEAR(sh.Coefficients[3].z, 0.0f, COEFFICIENT_TOLERANCE);
+
+	// Mixed terms, like xy, from the product of two channels' skies
+	SH9Color mixed = ProjectCubemapSH9(RenderCubemap([](XMFLOAT3 d) { return Gray(0.5f + 0.5f * d.x * d.y); }, 48), threadPool);
+	CHECK_NEAR(mixed.Coefficients[4].x, 0.5f * 4.0f * XM_PI / 15.0f * 1.092548f, COEFFICIENT_TOLERANCE);
+	CHECK_NEAR(mixed.Coefficients[5].x, 0.0f, COEFFICIENT_TOLERANCE);
+	CHECK_NEAR(mixed.Coefficients[7].x, 0.0f, COEFFICIENT_TOLERANCE);
+	CHECK_NEAR(mixed.Coefficients[8].x, 0.0f, COEFFICIENT_TOLERANCE);
+}
+
+// A small bright patch overhead: its irradiance falls off with the cosine
+// to the normal, which band 2 can only approximate - but it's close, and
+// it never lights the opposite side much
+TEST(SmallLightFallsOffWithTheCosine)
+{
+	ThreadPool threadPool;
+	const float cosRadius = 0.95f;
+	SH9Color sh = ProjectCubemapSH9(RenderCubemap([cosRadius](XMFLOAT3 d) { return Gray(d.z > cosRadius ? 1.0f : 0.0f); }, 128), threadPool);
+	SH9Color diffuse = ComputeSH9DiffuseConstants(sh);
+
+	// Solid angle of the cap times the cosine (near 1 inside it), over pi
+	float expected = 2.0f * XM_PI * (1.0f - cosRadius) * (1.0f + cosRadius) / 2.0f / XM_PI;
+	CHECK_NEAR(EvaluateSH9Diffuse(diffuse, XMFLOAT3(0, 0, 1)).x, expected, expected * 0.1f);
+	CHECK_NEAR(EvaluateSH9Diffuse(diffuse, XMFLOAT3(0.8f, 0, 0.6f)).x, expected * 0.6f, expected * 0.1f);
+	CHECK(fabsf(EvaluateSH9Diffuse(diffuse, XMFLOAT3(0, 0, -1)).x) < expected * 0.1f);
+}
+
+// --------------------------------------------------------
+// Edge cases
+// --------------------------------------------------------
+TEST(OddSizedFacesAreFullyCounted)
+{
+	// 30 texels across leaves two lanes of every row's last group empty
+	ThreadPool threadPool;
+	SH9Color sh = ProjectCubemapSH9(RenderCubemap([](XMFLOAT3 d) { return Gray(0.5f + 0.5f * d.x); }, 30), threadPool);
+	CHECK_NEAR(sh.Coefficients[0].x, 0.5f * 4.0f * XM_PI * Y0, COEFFICIENT_TOLERANCE);
+	CHECK_NEAR(sh.Coefficients[3].x, 0.5f * 4.0f * XM_PI / 3.0f * Y1, COEFFICIENT_TOLERANCE);
+}
+
+TEST(ResultDoesNotDependOnThreadCount)
+{
+	std::vector<MipLevel> faces = RenderCubemap([](XMFLOAT3 d) { return XMFLOAT3(0.5f + 0.5f * d.x * d.z, 0.3f, 0.5f + 0.4f * d.y); }, 40);
+
+	ThreadPool oneThread(1);
+	ThreadPool manyThreads(6);
+	SH9Color a = ProjectCubemapSH9(faces, oneThread);
+	SH9Color b = ProjectCubemapSH9(faces, manyThreads);
+
+	bool identical = true;
+	for (unsigned int k = 0; k < SH9_COEFFICIENTS; k++)
+	{
+		identical = identical &&
+			a.Coefficients[k].x == b.Coefficients[k].x &&
+			a.Coefficients[k].y == b.Coefficients[k].y &&
+			a.Coefficients[k].z == b.Coefficients[k].z;
+	}
+	CHECK(identical);
+}
+
+TEST(FacesThatDoNotFitGiveZeros)
+{
+	ThreadPool threadPool;
+	std::vector<MipLevel> faces = RenderCubemap([](XMFLOAT3) { return Gray(1.0f); }, 8);
+
+	std::vector<MipLevel> missing(faces.begin(), faces.begin() + 5);
+	std::vector<MipLevel> mismatched = faces;
+	mismatched[3].Width = 4;
+	std::vector<MipLevel> truncated = faces;
+	truncated[5].Pixels.pop_back();
+
+	for (const std::vector<MipLevel>* bad : { &missing, &mismatched, &truncated })
+	{
+		SH9Color sh = ProjectCubemapSH9(*bad, threadPool);
+		CHECK(sh.Coefficients[0].x == 0.0f && sh.Coefficients[0].y == 0.0f && sh.Coefficients[0].z == 0.0f);
+	}
+}
+
+int main() { return RunAllTests(); }
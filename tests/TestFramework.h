@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// --------------------------------------------------------
+// Just enough of a test runner for the CPU-side modules,
+// with nothing outside the standard library:
+//
+//   TEST(SplitsEndAtTheFarPlane)
+//   {
+//       CHECK(splits[3] == farDist);
+//       CHECK_NEAR(splits[0], 2.5f, 1e-4f);
+//   }
+//
+//   int main() { return RunAllTests(); }
+//
+// A failed check prints where it was and carries on, and
+// RunAllTests() returns nonzero if any check failed.
+// --------------------------------------------------------
+struct TestCase
+{
+	const char* Name;
+	void (*Run)();
+};
+
+inline std::vector<TestCase>& GetTestCases()
+{
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+inline int& GetTestFailureCount()
+{
+	static int failures = 0;
+	return failures;
+}
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, void (*run)()) { GetTestCases().push_back({ name, run }); }
+};
+
+inline void ReportTestFailure(const char* file, int line, const char* expression)
+{
+	printf("  %s(%d): failed: %s\n", file, line, expression);
+	GetTestFailureCount()++;
+}
+
+inline int RunAllTests()
+{
+	int failedTests = 0;
+	for (const TestCase& test : GetTestCases())
+	{
+		int failuresBefore = GetTestFailureCount();
+		test.Run();
+
+		bool passed = GetTestFailureCount() == failuresBefore;
+		printf("[%s] %s\n", passed ? "PASS" : "FAIL", test.Name);
+		if (!passed)
+			failedTests++;
+	}
+
+	printf("%zu tests, %d failed\n", GetTestCases().size(), failedTests);
+	return failedTests == 0 ? 0 : 1;
+}
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) ReportTestFailure(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+	do { if (!(std::fabs((double)(actual) - (double)(expected)) <= (double)(tolerance))) { \
+		ReportTestFailure(__FILE__, __LINE__, #actual " ~= " #expected); \
+		printf("    %g vs %g\n", (double)(actual), (double)(expected)); } } while (0)
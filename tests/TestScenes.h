@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CubeMap.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+#include <DirectXMath.h>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// --------------------------------------------------------
+// Fixtures shared by more than one test file
+// --------------------------------------------------------
+
+// --------------------------------------------------------
+// A camera at the origin looking down +Z, so view space is
+// world space and positions can be read off directly, plus
+// the worker pool the module under test runs on
+// --------------------------------------------------------
+struct TestCamera
+{
+	std::shared_ptr<ThreadPool> Pool;
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+
+	TestCamera(float fieldOfView, float aspectRatio, float nearClip, float farClip, unsigned int threads)
+		: Pool(std::make_shared<ThreadPool>(threads))
+	{
+		DirectX::XMStoreFloat4x4(&View, DirectX::XMMatrixLookToLH(
+			DirectX::XMVectorZero(),
+			DirectX::XMVectorSet(0, 0, 1, 0),
+			DirectX::XMVectorSet(0, 1, 0, 0)));
+		DirectX::XMStoreFloat4x4(&Projection, DirectX::XMMatrixPerspectiveFovLH(fieldOfView, aspectRatio, nearClip, farClip));
+	}
+};
+
+// --------------------------------------------------------
+// Renders an analytic environment into six RGBA8 faces the
+// way they'd come from disk: linear radiance (0 to 1) at
+// each texel's center, encoded with the shaders' 2.2 gamma
+// --------------------------------------------------------
+typedef std::function<DirectX::XMFLOAT3(DirectX::XMFLOAT3 direction)> Environment;
+
+inline std::vector<MipLevel> RenderCubemap(const Environment& environment, unsigned int size)
+{
+	std::vector<MipLevel> faces(6);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		faces[face].Width = size;
+		faces[face].Height = size;
+		faces[face].Pixels.resize((size_t)size * size * 4);
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float u = (x + 0.5f) * 2.0f / size - 1.0f;
+				float v = (y + 0.5f) * 2.0f / size - 1.0f;
+				DirectX::XMFLOAT3 radiance = environment(GetCubeFaceDirection(face, u, v));
+
+				unsigned char* texel = &faces[face].Pixels[((size_t)y * size + x) * 4];
+				const float channels[3] = { radiance.x, radiance.y, radiance.z };
+				for (unsigned int c = 0; c < 3; c++)
+					texel[c] = (unsigned char)(powf(channels[c], 1.0f / 2.2f) * 255.0f + 0.5f);
+				texel[3] = 255;
+			}
+		}
+	}
+	return faces;
+}
@@ -0,0 +1,164 @@
+#include "TestFramework.h"
+#include "TextureArrayPacker.h"
+
+// DXGI_FORMAT values, as the packer stores them
+static const unsigned int FORMAT_R8G8B8A8_UNORM = 28;
+static const unsigned int FORMAT_BC5_UNORM = 83;
+static const unsigned int FORMAT_BC7_UNORM_SRGB = 99;
+
+static TextureArrayInput Texture(unsigned int size, unsigned int format, unsigned int mipLevels)
+{
+	return { size, size, format, mipLevels };
+}
+
+// Every input has a slot, each slot points back at its input, and
+// every texture in an array matches it
+static bool PlanIsConsistent(const std::vector<TextureArrayInput>& textures, const TextureArrayPlan& plan, unsigned int maxSlices)
+{
+	if (plan.Slots.size() != textures.size())
+		return false;
+
+	size_t packed = 0;
+	for (const TextureArrayBucket& bucket : plan.Arrays)
+	{
+		if (bucket.Textures.empty() || bucket.Textures.size() > maxSlices)
+			return false;
+
+		for (unsigned int t : bucket.Textures)
+		{
+			const TextureArrayInput& texture = textures[t];
+			if (texture.Width != bucket.Width || texture.Height != bucket.Height ||
+				texture.Format != bucket.Format || texture.MipLevels != bucket.MipLevels)
+				return false;
+		}
+		packed += bucket.Textures.size();
+	}
+
+	for (unsigned int t = 0; t < (unsigned int)textures.size(); t++)
+	{
+		const TextureArraySlot& slot = plan.Slots[t];
+		if (slot.Array >= plan.Arrays.size() ||
+			slot.Slice >= plan.Arrays[slot.Array].Textures.size() ||
+			plan.Arrays[slot.Array].Textures[slot.Slice] != t)
+			return false;
+	}
+	return packed == textures.size();
+}
+
+TEST(NoTexturesMeansNoArrays)
+{
+	TextureArrayPlan plan = PlanTextureArrays({}, 16);
+	CHECK(plan.Arrays.empty());
+	CHECK(plan.Slots.empty());
+}
+
+TEST(MatchingTexturesShareOneArray)
+{
+	std::vector<TextureArrayInput> textures(5, Texture(512, FORMAT_BC7_UNORM_SRGB, 10));
+	TextureArrayPlan plan = PlanTextureArrays(textures, 16);
+
+	CHECK(plan.Arrays.size() == 1);
+	CHECK(PlanIsConsistent(textures, plan, 16));
+	for (unsigned int t = 0; t < 5; t++)
+		CHECK(plan.Slots[t].Array == 0 && plan.Slots[t].Slice == t);
+}
+
+TEST(SizeFormatAndMipsEachSplitArrays)
+{
+	std::vector<TextureArrayInput> textures = {
+		Texture(512, FORMAT_BC7_UNORM_SRGB, 10),
+		Texture(256, FORMAT_BC7_UNORM_SRGB, 9),
+		Texture(512, FORMAT_BC5_UNORM, 10),
+		Texture(512, FORMAT_BC7_UNORM_SRGB, 1),
+		{ 512, 256, FORMAT_BC7_UNORM_SRGB, 10 },
+		Texture(512, FORMAT_BC7_UNORM_SRGB, 10) };
+	TextureArrayPlan plan = PlanTextureArrays(textures, 16);
+
+	CHECK(plan.Arrays.size() == 5);
+	CHECK(PlanIsConsistent(textures, plan, 16));
+
+	// The last texture joins the first one's array
+	CHECK(plan.Slots[5].Array == plan.Slots[0].Array);
+	CHECK(plan.Slots[5].Slice == 1);
+}
+
+TEST(FullArraysStartANewOne)
+{
+	std::vector<TextureArrayInput> textures(10, Texture(256, FORMAT_R8G8B8A8_UNORM, 9));
+	TextureArrayPlan plan = PlanTextureArrays(textures, 4);
+
+	CHECK(plan.Arrays.size() == 3);
+	CHECK(plan.Arrays[0].Textures.size() == 4);
+	CHECK(plan.Arrays[1].Textures.size() == 4);
+	CHECK(plan.Arrays[2].Textures.size() == 2);
+	CHECK(plan.Slots[9].Array == 2 && plan.Slots[9].Slice == 1);
+	CHECK(PlanIsConsistent(textures, plan, 4));
+}
+
+TEST(ArraysAreInOrderOfFirstUse)
+{
+	std::vector<TextureArrayInput> textures = {
+		Texture(128, FORMAT_BC5_UNORM, 8),
+		Texture(512, FORMAT_BC7_UNORM_SRGB, 10),
+		Texture(128, FORMAT_BC5_UNORM, 8) };
+	TextureArrayPlan plan = PlanTextureArrays(textures, 16);
+
+	CHECK(plan.Arrays.size() == 2);
+	CHECK(plan.Arrays[0].Width == 128 && plan.Arrays[0].Format == FORMAT_BC5_UNORM);
+	CHECK(plan.Arrays[1].Width == 512 && plan.Arrays[1].Format == FORMAT_BC7_UNORM_SRGB);
+	CHECK(plan.Arrays[0].Textures.size() == 2 && plan.Arrays[0].Textures[1] == 2);
+}
+
+// Interleaved buckets filling up at different times still never
+// put a texture into an array that's already full
+TEST(InterleavedBucketsStayUnderTheLimit)
+{
+	std::vector<TextureArrayInput> textures;
+	for (unsigned int i = 0; i < 60; i++)
+	{
+		unsigned int size = 64u << (i % 3);
+		unsigned int format = (i % 5 == 0) ? FORMAT_BC5_UNORM : FORMAT_BC7_UNORM_SRGB;
+		textures.push_back(Texture(size, format, 7 + i % 3));
+	}
+
+	TextureArrayPlan plan = PlanTextureArrays(textures, 3);
+	CHECK(PlanIsConsistent(textures, plan, 3));
+
+	// Only the newest array of each kind can be partly filled
+	for (size_t a = 0; a < plan.Arrays.size(); a++)
+	{
+		const TextureArrayBucket& bucket = plan.Arrays[a];
+		for (size_t b = a + 1; b < plan.Arrays.size(); b++)
+		{
+			const TextureArrayBucket& later = plan.Arrays[b];
+			if (later.Width == bucket.Width && later.Height == bucket.Height &&
+				later.Format == bucket.Format && later.MipLevels == bucket.MipLevels)
+				CHECK(bucket.Textures.size() == 3);
+		}
+	}
+}
+
+TEST(ZeroMaxSlicesMeansOnePerArray)
+{
+	std::vector<TextureArrayInput> textures(3, Texture(64, FORMAT_R8G8B8A8_UNORM, 7));
+	TextureArrayPlan plan = PlanTextureArrays(textures, 0);
+
+	CHECK(plan.Arrays.size() == 3);
+	CHECK(PlanIsConsistent(textures, plan, 1));
+}
+
+TEST(SameInputsGiveTheSamePlan)
+{
+	std::vector<TextureArrayInput> textures;
+	for (unsigned int i = 0; i < 40; i++)
+		textures.push_back(Texture(128u << (i % 2), i % 4 == 0 ? FORMAT_BC5_UNORM : FORMAT_BC7_UNORM_SRGB, 8 + i % 2));
+
+	TextureArrayPlan first = PlanTextureArrays(textures, 8);
+	TextureArrayPlan second = PlanTextureArrays(textures, 8);
+
+	CHECK(first.Arrays.size() == second.Arrays.size());
+	for (size_t t = 0; t < textures.size(); t++)
+		CHECK(first.Slots[t].Array == second.Slots[t].Array && first.Slots[t].Slice == second.Slots[t].Slice);
+}
+
+int main() { return RunAllTests(); }
@@ -0,0 +1,348 @@
+#include "TestFramework.h"
+#include "TextureStreaming.h"
+
+using namespace DirectX;
+
+// Bytes per 4x4 block of BC1 and BC7
+static const unsigned int BC1_BLOCK_BYTES = 8;
+static const unsigned int BC7_BLOCK_BYTES = 16;
+
+static StreamingTextureInfo Texture(unsigned int size, unsigned int mipLevels, unsigned int blockBytes = BC7_BLOCK_BYTES, unsigned int slices = 1)
+{
+	return { size, size, mipLevels, slices, blockBytes };
+}
+
+// Bytes of one square mip, which is at least one block
+static unsigned long long MipBytes(unsigned int size, unsigned int blockBytes)
+{
+	unsigned long long blocks = (size + 3) / 4;
+	return blocks * blocks * blockBytes;
+}
+
+// --------------------------------------------------------
+// Demand estimation
+// --------------------------------------------------------
+TEST(OneTexelPerPixelIsMipZero)
+{
+	// A 1024 texture over one world unit, seen from where one unit
+	// covers 1024 pixels
+	float screenScale = 1024.0f * 8.0f;
+	CHECK_NEAR(ComputeRequiredMip(1024.0f, 1.0f, 8.0f, screenScale), 0.0f, 1e-5f);
+}
+
+TEST(EachDoublingOfDistanceIsAMip)
+{
+	float screenScale = 1024.0f;
+	float atOne = ComputeRequiredMip(1024.0f, 1.0f, 1.0f, screenScale);
+	CHECK_NEAR(ComputeRequiredMip(1024.0f, 1.0f, 2.0f, screenScale), atOne + 1.0f, 1e-4f);
+	CHECK_NEAR(ComputeRequiredMip(1024.0f, 1.0f, 16.0f, screenScale), atOne + 4.0f, 1e-4f);
+	CHECK_NEAR(ComputeRequiredMip(1024.0f, 1.0f, 3.0f, screenScale), atOne + 1.5849625f, 1e-4f);
+
+	// Denser UVs and bigger textures need more texels just the same
+	CHECK_NEAR(ComputeRequiredMip(1024.0f, 4.0f, 1.0f, screenScale), atOne + 2.0f, 1e-4f);
+	CHECK_NEAR(ComputeRequiredMip(2048.0f, 1.0f, 1.0f, screenScale), atOne + 1.0f, 1e-4f);
+}
+
+TEST(RequiredMipIsNeverNegative)
+{
+	CHECK(ComputeRequiredMip(1024.0f, 1.0f, 0.01f, 1024.0f) == 0.0f);
+	CHECK(ComputeRequiredMip(1024.0f, 1.0f, 0.0f, 1024.0f) == 0.0f);
+	CHECK(ComputeRequiredMip(1024.0f, 1.0f, -5.0f, 1024.0f) == 0.0f);
+}
+
+TEST(NoDensityAsksForFullResolution)
+{
+	CHECK(ComputeRequiredMip(1024.0f, 0.0f, 100.0f, 1024.0f) == 0.0f);
+	CHECK(ComputeRequiredMip(1024.0f, 1.0f, 100.0f, 0.0f) == 0.0f);
+}
+
+TEST(UVDensityIsUVAreaOverSurfaceArea)
+{
+	// A 2x2 quad with the whole texture across it
+	Vertex quad[4] = {};
+	quad[0].Position = XMFLOAT3(0, 0, 0); quad[0].UV = XMFLOAT2(0, 0);
+	quad[1].Position = XMFLOAT3(2, 0, 0); quad[1].UV = XMFLOAT2(1, 0);
+	quad[2].Position = XMFLOAT3(2, 2, 0); quad[2].UV = XMFLOAT2(1, 1);
+	quad[3].Position = XMFLOAT3(0, 2, 0); quad[3].UV = XMFLOAT2(0, 1);
+	unsigned int indices[6] = { 0, 1, 2, 0, 2, 3 };
+	CHECK_NEAR(ComputeMeshUVDensity(quad, indices, 6), 0.5f, 1e-6f);
+
+	// Tiling the texture 4 times each way
+	for (Vertex& vertex : quad)
+		vertex.UV = XMFLOAT2(vertex.UV.x * 4, vertex.UV.y * 4);
+	CHECK_NEAR(ComputeMeshUVDensity(quad, indices, 6), 2.0f, 1e-6f);
+
+	// Mirrored UVs still count
+	for (Vertex& vertex : quad)
+		vertex.UV.x = -vertex.UV.x;
+	CHECK_NEAR(ComputeMeshUVDensity(quad, indices, 6), 2.0f, 1e-6f);
+
+	// No UV area at all
+	for (Vertex& vertex : quad)
+		vertex.UV = XMFLOAT2(0.5f, 0.5f);
+	CHECK(ComputeMeshUVDensity(quad, indices, 6) == 0.0f);
+	CHECK(ComputeMeshUVDensity(quad, indices, 0) == 0.0f);
+}
+
+// --------------------------------------------------------
+// Tails
+// --------------------------------------------------------
+TEST(TailIsTheFirstSmallEnoughMip)
+{
+	CHECK(GetStreamingTailMip(1024, 1024, 11) == 4);
+	CHECK(GetStreamingTailMip(2048, 512, 12) == 5);
+	CHECK(GetStreamingTailMip(64, 64, 7) == 0);
+	CHECK(GetStreamingTailMip(32, 32, 6) == 0);
+}
+
+TEST(ShortChainsEndInTheirLastMip)
+{
+	CHECK(GetStreamingTailMip(1024, 1024, 3) == 2);
+	CHECK(GetStreamingTailMip(1024, 1024, 1) == 0);
+	CHECK(GetStreamingTailMip(1024, 1024, 0) == 0);
+
+	// More levels than a texture could have doesn't shift past 31 bits
+	CHECK(GetStreamingTailMip(1u << 31, 1u << 31, 40) == 25);
+}
+
+TEST(NewTexturesStartWithOnlyTheirTail)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int texture = planner.AddTexture(Texture(1024, 11));
+
+	CHECK(planner.GetTailMip(texture) == 4);
+	CHECK(planner.GetResidentMip(texture) == 4);
+	CHECK(planner.GetTargetMip(texture) == 4);
+
+	// 64x64 down to 1x1
+	unsigned long long tailBytes = 0;
+	for (unsigned int size = 64; size > 0; size /= 2)
+		tailBytes += MipBytes(size, BC7_BLOCK_BYTES);
+	CHECK(planner.GetResidentBytes() == tailBytes);
+}
+
+TEST(MissingMipCountMeansJustTheTopMip)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int texture = planner.AddTexture(Texture(256, 0));
+
+	CHECK(planner.GetInfo(texture).MipLevels == 1);
+	CHECK(planner.GetTailMip(texture) == 0);
+
+	// The top mip is counted, rather than nothing at all
+	CHECK(planner.GetResidentBytes() == MipBytes(256, BC7_BLOCK_BYTES));
+	CHECK(planner.GetMipChainBytes(texture, 0) == MipBytes(256, BC7_BLOCK_BYTES));
+}
+
+TEST(ChainBytesCoverEverySlice)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int texture = planner.AddTexture(Texture(16, 5, BC1_BLOCK_BYTES, 3));
+
+	// 16, 8, 4, then 2 and 1 still take a whole block
+	unsigned long long perSlice = (16 + 4 + 1 + 1 + 1) * BC1_BLOCK_BYTES;
+	CHECK(planner.GetMipChainBytes(texture, 0) == perSlice * 3);
+	CHECK(planner.GetMipChainBytes(texture, 2) == 3 * BC1_BLOCK_BYTES * 3);
+	CHECK(planner.GetMipChainBytes(texture, 5) == 0);
+}
+
+// --------------------------------------------------------
+// Keeping and decaying requests
+// --------------------------------------------------------
+TEST(WantedMipRoundsDownTheLowestRequest)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int texture = planner.AddTexture(Texture(1024, 11));
+
+	planner.RequestMip(texture, 2.7f);
+	planner.RequestMip(texture, 1.9f);
+	planner.RequestMip(texture, 3.0f);
+	planner.Update();
+	CHECK(planner.GetWantedMip(texture) == 1);
+	CHECK(planner.GetTargetMip(texture) == 1);
+
+	// Never past the tail, however coarse the request
+	unsigned int other = planner.AddTexture(Texture(1024, 11));
+	planner.RequestMip(other, 9.0f);
+	planner.Update();
+	CHECK(planner.GetWantedMip(other) == 4);
+}
+
+TEST(UnusedMipsAreKeptForAWhile)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int texture = planner.AddTexture(Texture(1024, 11));
+
+	planner.RequestMip(texture, 0.0f);
+	planner.Update();
+	CHECK(planner.GetWantedMip(texture) == 0);
+
+	// Out of view, but still kept for STREAMING_KEEP_UPDATES updates
+	bool keptThroughout = true;
+	for (unsigned int update = 0; update < STREAMING_KEEP_UPDATES; update++)
+	{
+		planner.Update();
+		keptThroughout = keptThroughout && planner.GetWantedMip(texture) == 0;
+	}
+	CHECK(keptThroughout);
+
+	// Then back to just the tail
+	planner.Update();
+	CHECK(planner.GetWantedMip(texture) == 4);
+}
+
+TEST(FinerRequestsTakeOverRightAway)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int texture = planner.AddTexture(Texture(1024, 11));
+
+	planner.RequestMip(texture, 3.0f);
+	planner.Update();
+	planner.RequestMip(texture, 1.0f);
+	planner.Update();
+	CHECK(planner.GetWantedMip(texture) == 1);
+}
+
+TEST(CoarserRequestsWaitForTheFinerOneToLapse)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int texture = planner.AddTexture(Texture(1024, 11));
+
+	planner.RequestMip(texture, 1.0f);
+	planner.Update();
+
+	// Walking away: mip 3 is all it needs now, but mip 1 is kept...
+	for (unsigned int update = 0; update < STREAMING_KEEP_UPDATES; update++)
+	{
+		planner.RequestMip(texture, 3.0f);
+		planner.Update();
+	}
+	CHECK(planner.GetWantedMip(texture) == 1);
+
+	// ...until it lapses, and then the coarser request is what's kept
+	planner.RequestMip(texture, 3.0f);
+	planner.Update();
+	CHECK(planner.GetWantedMip(texture) == 3);
+
+	// Which lapses in turn
+	for (unsigned int update = 0; update <= STREAMING_KEEP_UPDATES; update++)
+		planner.Update();
+	CHECK(planner.GetWantedMip(texture) == 4);
+}
+
+TEST(TurningBackRefreshesTheKeptMip)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int texture = planner.AddTexture(Texture(1024, 11));
+
+	planner.RequestMip(texture, 0.0f);
+	planner.Update();
+	for (unsigned int update = 0; update < STREAMING_KEEP_UPDATES - 1; update++)
+		planner.Update();
+
+	// Seen again just before it would lapse, so it's kept for another full stretch
+	planner.RequestMip(texture, 0.0f);
+	planner.Update();
+	for (unsigned int update = 0; update < STREAMING_KEEP_UPDATES; update++)
+		planner.Update();
+	CHECK(planner.GetWantedMip(texture) == 0);
+}
+
+// --------------------------------------------------------
+// The budget
+// --------------------------------------------------------
+TEST(EverythingWantedFitsALargeBudget)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int a = planner.AddTexture(Texture(1024, 11));
+	unsigned int b = planner.AddTexture(Texture(512, 10));
+
+	planner.RequestMip(a, 0.0f);
+	planner.RequestMip(b, 1.0f);
+	planner.Update();
+	CHECK(planner.GetTargetMip(a) == 0);
+	CHECK(planner.GetTargetMip(b) == 1);
+	CHECK(planner.GetTargetBytes() == planner.GetWantedBytes());
+}
+
+TEST(BiggestTopMipsAreDroppedFirst)
+{
+	TextureStreamingPlanner planner(0);
+	unsigned int a = planner.AddTexture(Texture(1024, 11));
+	unsigned int b = planner.AddTexture(Texture(512, 10));
+	planner.RequestMip(a, 0.0f);
+	planner.RequestMip(b, 0.0f);
+
+	// Room for everything but a's top mip: that goes, and b keeps all of its
+	unsigned long long everything = planner.GetMipChainBytes(a, 0) + planner.GetMipChainBytes(b, 0);
+	planner.SetBudget(everything - 1);
+	planner.Update();
+	CHECK(planner.GetWantedMip(a) == 0);
+	CHECK(planner.GetTargetMip(a) == 1);
+	CHECK(planner.GetTargetMip(b) == 0);
+
+	// Room for one less 512: a's mip 1 and b's mip 0 are the same size,
+	// and the first one found goes
+	planner.RequestMip(a, 0.0f);
+	planner.RequestMip(b, 0.0f);
+	planner.SetBudget(everything - MipBytes(1024, BC7_BLOCK_BYTES) - 1);
+	planner.Update();
+	CHECK(planner.GetTargetMip(a) == 2);
+	CHECK(planner.GetTargetMip(b) == 0);
+	CHECK(planner.GetTargetBytes() <= planner.GetBudget());
+}
+
+TEST(TargetsFitTheBudgetWheneverTailsDo)
+{
+	TextureStreamingPlanner planner(0);
+	std::vector<unsigned int> textures;
+	for (unsigned int t = 0; t < 12; t++)
+		textures.push_back(planner.AddTexture(Texture(256u << (t % 3), 9 + t % 3, t % 2 ? BC1_BLOCK_BYTES : BC7_BLOCK_BYTES, 1 + t % 4)));
+
+	unsigned long long tailBytes = planner.GetTargetBytes();
+	for (unsigned long long budget = tailBytes; budget < tailBytes * 64; budget = budget * 3 / 2)
+	{
+		for (unsigned int texture : textures)
+			planner.RequestMip(texture, 0.0f);
+		planner.SetBudget(budget);
+		planner.Update();
+
+		CHECK(planner.GetTargetBytes() <= budget);
+		for (unsigned int texture : textures)
+		{
+			CHECK(planner.GetTargetMip(texture) >= planner.GetWantedMip(texture));
+			CHECK(planner.GetTargetMip(texture) <= planner.GetTailMip(texture));
+		}
+	}
+}
+
+TEST(TailsStayPastTheBudget)
+{
+	TextureStreamingPlanner planner(0);
+	unsigned int a = planner.AddTexture(Texture(1024, 11));
+	unsigned int b = planner.AddTexture(Texture(2048, 12));
+	planner.RequestMip(a, 0.0f);
+	planner.RequestMip(b, 0.0f);
+	planner.Update();
+
+	CHECK(planner.GetTargetMip(a) == planner.GetTailMip(a));
+	CHECK(planner.GetTargetMip(b) == planner.GetTailMip(b));
+	CHECK(planner.GetTargetBytes() > 0);
+}
+
+TEST(ResidentMipIsOnlyWhatTheStreamerSays)
+{
+	TextureStreamingPlanner planner(1ull << 30);
+	unsigned int texture = planner.AddTexture(Texture(1024, 11));
+	planner.RequestMip(texture, 0.0f);
+	planner.Update();
+
+	// Wanted isn't loaded yet
+	CHECK(planner.GetResidentMip(texture) == 4);
+	CHECK(planner.GetResidentBytes() < planner.GetTargetBytes());
+
+	planner.SetResidentMip(texture, 0);
+	CHECK(planner.GetResidentBytes() == planner.GetTargetBytes());
+}
+
+int main() { return RunAllTests(); }
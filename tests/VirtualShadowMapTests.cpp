@@ -0,0 +1,190 @@
+#include "TestFramework.h"
+#include "VirtualShadowMap.h"
+
+using namespace DirectX;
+
+static const unsigned int PHYSICAL_PAGE_COUNT = VSM_PHYSICAL_PAGES_PER_SIDE * VSM_PHYSICAL_PAGES_PER_SIDE;
+
+// UV rect covering pages [x0, x1] by [y0, y1], staying clear of the page edges
+static void PageRect(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, XMFLOAT2& uvMin, XMFLOAT2& uvMax)
+{
+	const float page = 1.0f / VSM_PAGES_PER_SIDE;
+	uvMin = XMFLOAT2((x0 + 0.25f) * page, (y0 + 0.25f) * page);
+	uvMax = XMFLOAT2((x1 + 0.75f) * page, (y1 + 0.75f) * page);
+}
+
+static void MarkPages(VirtualShadowMap& vsm, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+{
+	XMFLOAT2 uvMin, uvMax;
+	PageRect(x0, y0, x1, y1, uvMin, uvMax);
+	vsm.MarkNeeded(uvMin, uvMax);
+}
+
+static bool IsMapped(const VirtualShadowMap& vsm, unsigned int x, unsigned int y)
+{
+	return vsm.GetPageTable()[y * VSM_PAGES_PER_SIDE + x] != VSM_INVALID_PAGE;
+}
+
+TEST(NeededPagesAreMappedAndRenderedOnce)
+{
+	VirtualShadowMap vsm;
+	vsm.BeginFrame();
+	MarkPages(vsm, 3, 5, 3, 5);
+	vsm.Update();
+
+	CHECK(vsm.GetNeededPageCount() == 1);
+	CHECK(vsm.GetResidentPageCount() == 1);
+	CHECK(vsm.IsPageTableChanged());
+	CHECK(IsMapped(vsm, 3, 5));
+	CHECK(vsm.GetPagesToRender().size() == 1);
+	CHECK(vsm.GetPagesToRender()[0].VirtualX == 3);
+	CHECK(vsm.GetPagesToRender()[0].VirtualY == 5);
+
+	// Still needed, nothing changed: no rendering, no page table upload
+	vsm.BeginFrame();
+	MarkPages(vsm, 3, 5, 3, 5);
+	vsm.Update();
+	CHECK(vsm.GetPagesToRender().empty());
+	CHECK(!vsm.IsPageTableChanged());
+	CHECK(IsMapped(vsm, 3, 5));
+}
+
+TEST(RectsCoverEveryPageTheyTouch)
+{
+	VirtualShadowMap vsm;
+	vsm.BeginFrame();
+	MarkPages(vsm, 10, 20, 12, 21);
+	MarkPages(vsm, 11, 21, 11, 21); // Already marked
+	vsm.Update();
+
+	CHECK(vsm.GetNeededPageCount() == 6);
+	CHECK(vsm.GetPagesToRender().size() == 6);
+	CHECK(IsMapped(vsm, 12, 21));
+	CHECK(!IsMapped(vsm, 13, 21));
+}
+
+TEST(RectsOffTheMapAreClampedOrIgnored)
+{
+	VirtualShadowMap vsm;
+	vsm.BeginFrame();
+	vsm.MarkNeeded(XMFLOAT2(1.5f, 0.5f), XMFLOAT2(2.0f, 0.6f)); // Entirely off
+	vsm.MarkNeeded(XMFLOAT2(0.5f, 0.5f), XMFLOAT2(0.4f, 0.6f)); // Inside out
+	CHECK(vsm.GetNeededPageCount() == 0);
+
+	// Huge values still land on the last page
+	vsm.MarkNeeded(XMFLOAT2(0.999f, 0.999f), XMFLOAT2(1e30f, 1e30f));
+	vsm.MarkNeeded(XMFLOAT2(-1e30f, -1e30f), XMFLOAT2(0.001f, 0.001f));
+	vsm.Update();
+	CHECK(vsm.GetNeededPageCount() == 2);
+	CHECK(IsMapped(vsm, VSM_PAGES_PER_SIDE - 1, VSM_PAGES_PER_SIDE - 1));
+	CHECK(IsMapped(vsm, 0, 0));
+}
+
+TEST(MovedCastersRedrawWhereTheyWereAndAre)
+{
+	VirtualShadowMap vsm;
+	XMFLOAT2 before[2], after[2];
+	PageRect(0, 0, 0, 0, before[0], before[1]);
+	PageRect(2, 0, 2, 0, after[0], after[1]);
+
+	vsm.BeginFrame();
+	MarkPages(vsm, 0, 0, 3, 0);
+	vsm.UpdateCaster(7, before[0], before[1], 1);
+	vsm.Update();
+	CHECK(vsm.GetPagesToRender().size() == 4);
+
+	// Same version: nothing to do
+	vsm.BeginFrame();
+	MarkPages(vsm, 0, 0, 3, 0);
+	vsm.UpdateCaster(7, before[0], before[1], 1);
+	vsm.Update();
+	CHECK(vsm.GetPagesToRender().empty());
+
+	// Moved: its old page and its new page, and only those
+	vsm.BeginFrame();
+	MarkPages(vsm, 0, 0, 3, 0);
+	vsm.UpdateCaster(7, after[0], after[1], 2);
+	vsm.Update();
+	CHECK(vsm.GetPagesToRender().size() == 2);
+	bool redrewOld = false;
+	bool redrewNew = false;
+	for (const VirtualShadowMap::PageRender& page : vsm.GetPagesToRender())
+	{
+		redrewOld |= page.VirtualX == 0;
+		redrewNew |= page.VirtualX == 2;
+	}
+	CHECK(redrewOld && redrewNew);
+}
+
+TEST(LeastRecentlyUsedPagesAreEvictedFirst)
+{
+	// Two halves of the pool, used on different frames
+	const unsigned int halfRows = PHYSICAL_PAGE_COUNT / 2 / VSM_PAGES_PER_SIDE;
+	VirtualShadowMap vsm;
+
+	vsm.BeginFrame();
+	MarkPages(vsm, 0, 0, VSM_PAGES_PER_SIDE - 1, halfRows - 1);
+	vsm.Update();
+
+	vsm.BeginFrame();
+	MarkPages(vsm, 0, halfRows, VSM_PAGES_PER_SIDE - 1, 2 * halfRows - 1);
+	vsm.Update();
+	CHECK(vsm.GetResidentPageCount() == PHYSICAL_PAGE_COUNT);
+	CHECK(vsm.GetEvictionCount() == 0);
+
+	// The pool is full, so one new row has to come out of the older half
+	vsm.BeginFrame();
+	MarkPages(vsm, 0, 100, VSM_PAGES_PER_SIDE - 1, 100);
+	vsm.Update();
+	CHECK(vsm.GetEvictionCount() == VSM_PAGES_PER_SIDE);
+	CHECK(vsm.GetUnmappedPageCount() == 0);
+	CHECK(vsm.GetPagesToRender().size() == VSM_PAGES_PER_SIDE);
+
+	unsigned int olderMapped = 0;
+	unsigned int newerMapped = 0;
+	for (unsigned int y = 0; y < 2 * halfRows; y++)
+	{
+		for (unsigned int x = 0; x < VSM_PAGES_PER_SIDE; x++)
+		{
+			if (IsMapped(vsm, x, y))
+				(y < halfRows ? olderMapped : newerMapped)++;
+		}
+	}
+	CHECK(newerMapped == halfRows * VSM_PAGES_PER_SIDE);
+	CHECK(olderMapped == (halfRows - 1) * VSM_PAGES_PER_SIDE);
+}
+
+TEST(PagesNeededThisFrameAreNeverEvicted)
+{
+	const unsigned int rows = PHYSICAL_PAGE_COUNT / VSM_PAGES_PER_SIDE;
+	VirtualShadowMap vsm;
+
+	// One more row than fits
+	vsm.BeginFrame();
+	MarkPages(vsm, 0, 0, VSM_PAGES_PER_SIDE - 1, rows);
+	vsm.Update();
+	CHECK(vsm.GetResidentPageCount() == PHYSICAL_PAGE_COUNT);
+	CHECK(vsm.GetUnmappedPageCount() == VSM_PAGES_PER_SIDE);
+	CHECK(vsm.GetEvictionCount() == 0);
+	CHECK(vsm.GetPagesToRender().size() == PHYSICAL_PAGE_COUNT);
+}
+
+TEST(InvalidateAllRedrawsEveryResidentPage)
+{
+	VirtualShadowMap vsm;
+	vsm.BeginFrame();
+	MarkPages(vsm, 0, 0, 4, 4);
+	vsm.Update();
+
+	vsm.InvalidateAll();
+	vsm.BeginFrame();
+	MarkPages(vsm, 0, 0, 4, 4);
+	vsm.Update();
+	CHECK(vsm.GetPagesToRender().size() == 25);
+	CHECK(!vsm.IsPageTableChanged());
+}
+
+int main()
+{
+	return RunAllTests();
+}
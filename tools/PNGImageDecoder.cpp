@@ -0,0 +1,31 @@
+#include "TextureCooker.h"
+#include "PathHelpers.h"
+
+#include <png.h>
+
+// --------------------------------------------------------
+// The portable build's stand-in for WICImageDecoder.cpp:
+// PNGs only, through libpng's simplified API, which is all
+// the cook reads.  Like WIC's 32bppRGBA conversion, 8 bit
+// images come through as they are stored, with no gamma
+// applied.
+// --------------------------------------------------------
+bool LoadImageRGBA(const std::wstring& file, unsigned int& width, unsigned int& height, std::vector<unsigned char>& rgba)
+{
+	png_image image = {};
+	image.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&image, WideToNarrow(file).c_str()))
+		return false;
+
+	image.format = PNG_FORMAT_RGBA;
+	rgba.resize(PNG_IMAGE_SIZE(image));
+	if (!png_image_finish_read(&image, 0, rgba.data(), 0, 0))
+	{
+		png_image_free(&image);
+		return false;
+	}
+
+	width = image.width;
+	height = image.height;
+	return true;
+}
@@ -0,0 +1,58 @@
+#include "PathHelpers.h"
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+// --------------------------------------------------------
+// TextureCook [folder]
+//
+// The offline texture cook, which used to be the game's
+// -cook-textures mode: every PBR texture in the folder is
+// decoded, given its mips, block compressed and written as
+// a .dds next to its source (where the game picks it up),
+// one texture per thread.  Without a folder it cooks the
+// game's own, COOK_TEXTURE_FOLDER from CMakeLists.txt.
+//
+// Returns nonzero if anything failed to cook.
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	std::string folder = argc > 1 ? argv[1] : COOK_TEXTURE_FOLDER;
+	std::vector<TextureCookJob> jobs = GetTextureCookJobs(NarrowToWide(folder));
+	std::vector<TextureCookResult> results(jobs.size());
+	if (jobs.empty())
+	{
+		printf("No textures in %s\n", folder.c_str());
+		return 1;
+	}
+
+	ThreadPool threadPool;
+	auto start = std::chrono::high_resolution_clock::now();
+	threadPool.ParallelFor((unsigned int)jobs.size(), [&](unsigned int ii)
+	{
+		CookTexture(jobs[ii], results[ii]);
+	});
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	int failed = 0;
+	for (size_t ii = 0; ii < jobs.size(); ii++)
+	{
+		printf("%s: %ux%u, %u mips, %.2f dB, %.1f ms%s%s\n",
+			WideToNarrow(std::filesystem::path(jobs[ii].Destination).filename().wstring()).c_str(),
+			results[ii].Width,
+			results[ii].Height,
+			results[ii].MipLevels,
+			results[ii].PSNR,
+			results[ii].Milliseconds,
+			results[ii].Succeeded ? "" : " - FAILED ",
+			results[ii].Error.c_str());
+
+		if (!results[ii].Succeeded)
+			failed++;
+	}
+	printf("%zu textures in %.1f ms on %u threads\n", jobs.size(), elapsed.count(), threadPool.GetThreadCount());
+	return failed == 0 ? 0 : 1;
+}